@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ==============
+// This file contains the implementation of the `CameraPath` class, which
+// moves the camera along timed keys instead of the user's input.
+//
+// RESPONSIBILITIES:
+// - Read and write path files of timed camera keys.
+// - Build the scripted orbit the benchmark flies by default.
+// - Place the camera on the spline through the keys at any time.
+//
+// NOTE: The spline passes through every key, so a recorded path replays
+// through the places that were recorded, only the turns between them are
+// rounded off.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// declaration of the global variables and defines
+namespace
+{
+	// point of a Catmull-Rom segment between p1 and p2
+	glm::vec3 CatmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+	{
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return(0.5f * ((2.0f * p1) +
+			(p2 - p0) * t +
+			(2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+			(3.0f * p1 - p0 - 3.0f * p2 + p3) * t3));
+	}
+}
+
+/***********************************************************
+ *  CameraPath()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraPath::CameraPath()
+{
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading the keys of a path file.
+ *  Blank lines and comments are skipped, and a line that
+ *  does not hold seven numbers, or a key earlier than the
+ *  one before it, fails the whole file.
+ ***********************************************************/
+bool CameraPath::Load(const char* filePath)
+{
+	m_keys.clear();
+
+	std::ifstream file(filePath);
+	if (!file.is_open())
+	{
+		std::cout << "Could not open the camera path: " << filePath << std::endl;
+		return(false);
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		size_t first = line.find_first_not_of(" \t\r");
+		if ((first == std::string::npos) || (line[first] == '#'))
+		{
+			continue;
+		}
+
+		std::istringstream fields(line);
+		PATH_KEY key;
+		fields >> key.seconds
+			>> key.position.x >> key.position.y >> key.position.z
+			>> key.target.x >> key.target.y >> key.target.z;
+		if (fields.fail() || ((m_keys.empty() == false) && (key.seconds < m_keys.back().seconds)))
+		{
+			std::cout << filePath << "(" << lineNumber << "): expected a key later than the one before, "
+				<< "as seconds and the position and target xyz" << std::endl;
+			m_keys.clear();
+			return(false);
+		}
+		m_keys.push_back(key);
+	}
+
+	if (m_keys.empty())
+	{
+		std::cout << "The camera path has no keys: " << filePath << std::endl;
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Save()
+ *
+ *  This method is used for writing the keys to a path file
+ *  that Load() reads back.
+ ***********************************************************/
+bool CameraPath::Save(const char* filePath) const
+{
+	std::ofstream file(filePath);
+	if (!file.is_open())
+	{
+		std::cout << "Could not write the camera path: " << filePath << std::endl;
+		return(false);
+	}
+
+	file << "# seconds position.x position.y position.z target.x target.y target.z\n";
+	for (size_t i = 0; i < m_keys.size(); ++i)
+	{
+		const PATH_KEY& key = m_keys[i];
+		file << key.seconds << " "
+			<< key.position.x << " " << key.position.y << " " << key.position.z << " "
+			<< key.target.x << " " << key.target.y << " " << key.target.z << "\n";
+	}
+
+	std::cout << "Wrote " << m_keys.size() << " camera keys to " << filePath << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  AddKey()
+ *
+ *  This method is used for adding a key at the end of the
+ *  path.
+ ***********************************************************/
+void CameraPath::AddKey(float seconds, const glm::vec3& position, const glm::vec3& target)
+{
+	PATH_KEY key;
+	key.seconds = seconds;
+	key.position = position;
+	key.target = target;
+	m_keys.push_back(key);
+}
+
+/***********************************************************
+ *  CreateOrbit()
+ *
+ *  This method is used for scripting a flight around a
+ *  point, at a height above it and looking at it.  The
+ *  camera starts in front of the point, on its +Z side
+ *  where the default camera looks from, swings to one end
+ *  of the arc, across to the other end and back, so the
+ *  last key is the first one again.
+ ***********************************************************/
+void CameraPath::CreateOrbit(const glm::vec3& center, float radius, float height, float arcDegrees, float seconds, int keyCount)
+{
+	m_keys.clear();
+	keyCount = std::max(keyCount, 4);
+
+	for (int i = 0; i <= keyCount; ++i)
+	{
+		float fraction = (float)i / (float)keyCount;
+		float angle = glm::radians(arcDegrees * 0.5f) * std::sin(glm::radians(360.0f) * fraction);
+		glm::vec3 position = center + glm::vec3(std::sin(angle) * radius, height, std::cos(angle) * radius);
+		AddKey(seconds * fraction, position, center);
+	}
+}
+
+/***********************************************************
+ *  Duration()
+ *
+ *  This method is used for getting the time of the last
+ *  key.
+ ***********************************************************/
+float CameraPath::Duration() const
+{
+	if (m_keys.empty())
+	{
+		return(0.0f);
+	}
+	return(m_keys.back().seconds);
+}
+
+/***********************************************************
+ *  Evaluate()
+ *
+ *  This method is used for placing the camera on the path.
+ *  The segment holding the time is found by a binary
+ *  search, and the keys on either side of it shape the
+ *  spline, the end keys standing in for the missing
+ *  neighbours at the ends.
+ ***********************************************************/
+void CameraPath::Evaluate(float seconds, glm::vec3& position, glm::vec3& front) const
+{
+	if (m_keys.empty())
+	{
+		return;
+	}
+
+	int lastKey = (int)m_keys.size() - 1;
+	glm::vec3 target;
+	if ((lastKey == 0) || (seconds <= m_keys[0].seconds))
+	{
+		position = m_keys[0].position;
+		target = m_keys[0].target;
+	}
+	else if (seconds >= m_keys[lastKey].seconds)
+	{
+		position = m_keys[lastKey].position;
+		target = m_keys[lastKey].target;
+	}
+	else
+	{
+		// first key later than the time, the segment ends there
+		int next = 1;
+		int count = lastKey;
+		while (count > 0)
+		{
+			int step = count / 2;
+			if (m_keys[next + step].seconds <= seconds)
+			{
+				next += step + 1;
+				count -= step + 1;
+			}
+			else
+			{
+				count = step;
+			}
+		}
+
+		const PATH_KEY& k0 = m_keys[std::max(next - 2, 0)];
+		const PATH_KEY& k1 = m_keys[next - 1];
+		const PATH_KEY& k2 = m_keys[next];
+		const PATH_KEY& k3 = m_keys[std::min(next + 1, lastKey)];
+
+		float length = k2.seconds - k1.seconds;
+		float t = (length > 0.0f) ? (seconds - k1.seconds) / length : 0.0f;
+		position = CatmullRom(k0.position, k1.position, k2.position, k3.position, t);
+		target = CatmullRom(k0.target, k1.target, k2.target, k3.target, t);
+	}
+
+	glm::vec3 direction = target - position;
+	if (glm::dot(direction, direction) > 1.0e-8f)
+	{
+		front = glm::normalize(direction);
+	}
+}
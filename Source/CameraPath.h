@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// a camera flight through the scene as timed keys, recorded from the user's
+// movement or scripted, that the simulation replays for repeatable runs
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  This class keeps a list of keys, each the camera
+ *  position and the point it looks at after a number of
+ *  seconds.  Between the keys both points follow a
+ *  Catmull-Rom spline, so a path made of a few keys still
+ *  flies smoothly, and the camera holds the last key after
+ *  the end.  Paths are stored as text with one key per
+ *  line - "seconds px py pz tx ty tz" - so a recording can
+ *  be edited by hand, and lines starting with # are
+ *  comments.
+ ***********************************************************/
+class CameraPath
+{
+public:
+	// camera placement at one point in time
+	struct PATH_KEY
+	{
+		// time since the start of the path
+		float seconds;
+		glm::vec3 position;
+		// point the camera looks at
+		glm::vec3 target;
+	};
+
+	// constructor
+	CameraPath();
+
+	// read a path file, false when it cannot be read or holds
+	// no key, in which case the path is left empty
+	bool Load(const char* filePath);
+	// write the keys to a path file
+	bool Save(const char* filePath) const;
+
+	// remove every key
+	void Clear() { m_keys.clear(); }
+	// add a key, later than the ones added before
+	void AddKey(float seconds, const glm::vec3& position, const glm::vec3& target);
+	// replace the keys with a swing along an arc in front of
+	// a point and back, looking at it, so the path ends where
+	// it starts
+	void CreateOrbit(const glm::vec3& center, float radius, float height, float arcDegrees, float seconds, int keyCount);
+
+	// check whether there is a key to follow
+	bool IsEmpty() const { return m_keys.empty(); }
+	// time of the last key
+	float Duration() const;
+	// get the camera position and normalized viewing direction
+	// at a time, clamped to the ends of the path
+	void Evaluate(float seconds, glm::vec3& position, glm::vec3& front) const;
+
+private:
+	std::vector<PATH_KEY> m_keys;
+};
@@ -0,0 +1,246 @@
+///////////////////////////////////////////////////////////////////////////////
+// cookedtexture.cpp
+// =================
+// This file contains the implementation of the `CookedTexture` class, which
+// reads the block compressed texture files made by the texture cooker.
+//
+// RESPONSIBILITIES:
+// - Map a .ctex file and reject anything truncated or malformed.
+// - Upload the stored mip chain with glCompressedTexImage2D.
+//
+// NOTE: The stored chain replaces glGenerateMipmap, so a cooked texture needs
+// no decode and no GPU work beyond the copy.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CookedTexture.h"
+
+#include <algorithm>
+#include <cstring>
+
+const uint32_t CookedTexture::MAX_MIP_LEVELS;
+const uint32_t CookedTexture::FILE_VERSION;
+
+/***********************************************************
+ *  CookedTexture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CookedTexture::CookedTexture()
+{
+	m_pHeader = NULL;
+	m_pLevels = NULL;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a cooked file and
+ *  checking that the header, the level table and every
+ *  level fit in the file and match the stored format.
+ ***********************************************************/
+bool CookedTexture::Open(const char* filePath)
+{
+	Close();
+
+	if (m_file.Open(filePath) == false)
+	{
+		return(false);
+	}
+
+	const COOKED_HEADER* pHeader = (const COOKED_HEADER*)m_file.Data();
+	size_t tableEnd = sizeof(COOKED_HEADER);
+	bool bValid = (m_file.Size() >= sizeof(COOKED_HEADER)) &&
+		(memcmp(pHeader->magic, "CTEX", 4) == 0) &&
+		(pHeader->version == FILE_VERSION) &&
+		(BlockBytes(pHeader->format) != 0) &&
+		(pHeader->mipCount >= 1) &&
+		(pHeader->mipCount <= MAX_MIP_LEVELS);
+
+	if (bValid)
+	{
+		tableEnd += pHeader->mipCount * sizeof(COOKED_LEVEL);
+		bValid = (m_file.Size() >= tableEnd);
+	}
+
+	const COOKED_LEVEL* pLevels = (const COOKED_LEVEL*)(m_file.Data() + sizeof(COOKED_HEADER));
+	for (uint32_t level = 0; bValid && (level < pHeader->mipCount); ++level)
+	{
+		uint32_t width = std::max(pHeader->width >> level, 1u);
+		uint32_t height = std::max(pHeader->height >> level, 1u);
+
+		bValid = (pLevels[level].width == width) &&
+			(pLevels[level].height == height) &&
+			(pLevels[level].size == LevelBytes(pHeader->format, width, height)) &&
+			(pLevels[level].offset >= tableEnd) &&
+			((size_t)pLevels[level].offset + pLevels[level].size <= m_file.Size());
+	}
+
+	if (bValid == false)
+	{
+		m_file.Close();
+		return(false);
+	}
+
+	m_pHeader = pHeader;
+	m_pLevels = pLevels;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for releasing the mapped file.
+ ***********************************************************/
+void CookedTexture::Close()
+{
+	m_file.Close();
+	m_pHeader = NULL;
+	m_pLevels = NULL;
+}
+
+/***********************************************************
+ *  PrefetchLevels()
+ *
+ *  This method is used for reading in the pages of a range
+ *  of levels ahead of an upload.  The cooker stores the
+ *  levels one after the other, so this is one block of the
+ *  file.
+ ***********************************************************/
+void CookedTexture::PrefetchLevels(uint32_t firstLevel, uint32_t lastLevel) const
+{
+	lastLevel = std::min(lastLevel, m_pHeader->mipCount - 1);
+	if (firstLevel > lastLevel)
+	{
+		return;
+	}
+
+	size_t begin = m_pLevels[firstLevel].offset;
+	size_t end = begin;
+	for (uint32_t level = firstLevel; level <= lastLevel; ++level)
+	{
+		begin = std::min(begin, (size_t)m_pLevels[level].offset);
+		end = std::max(end, (size_t)m_pLevels[level].offset + m_pLevels[level].size);
+	}
+	m_file.Prefetch(begin, end - begin);
+}
+
+/***********************************************************
+ *  DataSize()
+ *
+ *  This method is used for adding up the compressed bytes
+ *  of the mip levels from firstLevel to the smallest.
+ ***********************************************************/
+size_t CookedTexture::DataSize(uint32_t firstLevel) const
+{
+	size_t size = 0;
+	for (uint32_t level = firstLevel; level < m_pHeader->mipCount; ++level)
+	{
+		size += m_pLevels[level].size;
+	}
+	return(size);
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for passing the levels from
+ *  firstLevel down to the texture bound to GL_TEXTURE_2D,
+ *  so a streamed texture can start at a smaller level.  No
+ *  pixel unpack buffer may be bound, since the data
+ *  pointers are into the mapped file.
+ ***********************************************************/
+void CookedTexture::Upload(uint32_t firstLevel) const
+{
+	GLenum format = GLFormat(m_pHeader->format);
+
+	for (uint32_t level = firstLevel; level < m_pHeader->mipCount; ++level)
+	{
+		glCompressedTexImage2D(
+			GL_TEXTURE_2D,
+			(GLint)(level - firstLevel),
+			format,
+			(GLsizei)m_pLevels[level].width,
+			(GLsizei)m_pLevels[level].height,
+			0,
+			(GLsizei)m_pLevels[level].size,
+			LevelData(level));
+	}
+
+	// the chain is complete only down to the stored level
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)(m_pHeader->mipCount - 1 - firstLevel));
+}
+
+/***********************************************************
+ *  GLFormat()
+ *
+ *  This method is used for getting the OpenGL internal
+ *  format of a cooked format.
+ ***********************************************************/
+GLenum CookedTexture::GLFormat(uint32_t format)
+{
+	switch (format)
+	{
+	case COOKED_FORMAT_BC1:
+		return(GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+	case COOKED_FORMAT_BC3:
+		return(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+	default:
+		return(GL_NONE);
+	}
+}
+
+/***********************************************************
+ *  BlockBytes()
+ *
+ *  This method is used for getting the size of one 4x4
+ *  block of a cooked format.
+ ***********************************************************/
+uint32_t CookedTexture::BlockBytes(uint32_t format)
+{
+	switch (format)
+	{
+	case COOKED_FORMAT_BC1:
+		return(8);
+	case COOKED_FORMAT_BC3:
+		return(16);
+	default:
+		return(0);
+	}
+}
+
+/***********************************************************
+ *  LevelBytes()
+ *
+ *  This method is used for getting the size of a level.
+ *  Partial blocks at the edges still take a whole block.
+ ***********************************************************/
+uint32_t CookedTexture::LevelBytes(uint32_t format, uint32_t width, uint32_t height)
+{
+	return(((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format));
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking for the S3TC extension
+ *  that provides BC1 and BC3.
+ ***********************************************************/
+bool CookedTexture::IsSupported()
+{
+	return(GLEW_EXT_texture_compression_s3tc ? true : false);
+}
+
+/***********************************************************
+ *  CookedPath()
+ *
+ *  This method is used for turning an image path such as
+ *  textures/brick.jpg into textures/brick.jpg.ctex.  The
+ *  image extension is kept so gold.jpg and gold.png do not
+ *  share a cooked file.
+ ***********************************************************/
+std::string CookedTexture::CookedPath(const std::string& sourcePath)
+{
+	return(sourcePath + ".ctex");
+}
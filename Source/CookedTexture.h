@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// cookedtexture.h
+// ============
+// layout of the cooked texture files written by the texture cooker, and a
+// reader that uploads their compressed mip levels straight from a mapping
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  CookedTexture
+ *
+ *  This class reads a .ctex file - a header, a table with
+ *  one entry per mip level, and the block compressed levels
+ *  from largest to smallest.  BC1 is used for opaque images
+ *  and BC3 for images with alpha.  The file is mapped, not
+ *  read, and each level is passed to the driver directly
+ *  from the mapping.
+ ***********************************************************/
+class CookedTexture
+{
+public:
+	// block compression formats
+	enum COOKED_FORMAT
+	{
+		COOKED_FORMAT_BC1 = 1,
+		COOKED_FORMAT_BC3 = 3
+	};
+
+	// start of every cooked file, followed by mipCount levels
+	struct COOKED_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipCount;
+		uint32_t reserved[2];
+	};
+
+	// position and size of one mip level in the file
+	struct COOKED_LEVEL
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	// most mip levels, enough for a 32768 pixel texture
+	static const uint32_t MAX_MIP_LEVELS = 16;
+	// current file version
+	static const uint32_t FILE_VERSION = 1;
+
+	// constructor
+	CookedTexture();
+
+	// map and check a cooked file
+	bool Open(const char* filePath);
+	// release the mapping
+	void Close();
+	// load the mapped pages now, for calling on a worker
+	void Prefetch() const { m_file.Prefetch(); }
+	// load only the pages of a range of mip levels
+	void PrefetchLevels(uint32_t firstLevel, uint32_t lastLevel) const;
+
+	// header of the open file
+	const COOKED_HEADER& Header() const { return *m_pHeader; }
+	// mip level table entry
+	const COOKED_LEVEL& Level(uint32_t level) const { return m_pLevels[level]; }
+	// compressed bytes of a mip level
+	const unsigned char* LevelData(uint32_t level) const { return m_file.Data() + m_pLevels[level].offset; }
+	// bytes of every mip level together
+	size_t DataSize() const { return DataSize(0); }
+
+	// upload every mip level into the bound 2D texture
+	void Upload() const { Upload(0); }
+	// upload the levels from firstLevel down into the bound
+	// 2D texture, firstLevel becoming its level 0
+	void Upload(uint32_t firstLevel) const;
+	// bytes of the levels from firstLevel down
+	size_t DataSize(uint32_t firstLevel) const;
+
+	// OpenGL enum of a cooked format, GL_NONE when unknown
+	static GLenum GLFormat(uint32_t format);
+	// bytes of one 4x4 block, 0 when the format is unknown
+	static uint32_t BlockBytes(uint32_t format);
+	// bytes of a level of the passed in size
+	static uint32_t LevelBytes(uint32_t format, uint32_t width, uint32_t height);
+	// check whether the GPU can sample the cooked formats
+	static bool IsSupported();
+	// cooked file name of a source image, with .ctex added
+	static std::string CookedPath(const std::string& sourcePath);
+
+private:
+	MappedFile m_file;
+	const COOKED_HEADER* m_pHeader;
+	const COOKED_LEVEL* m_pLevels;
+};
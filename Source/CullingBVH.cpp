@@ -0,0 +1,442 @@
+///////////////////////////////////////////////////////////////////////////////
+// cullingbvh.cpp
+// ==============
+// This file contains the implementation of the `CullingBVH` class, which
+// rejects the scene objects that are outside the view frustum.
+//
+// RESPONSIBILITIES:
+// - Build a bounding volume hierarchy over the object world bounds.
+// - Refit the tree when objects move, without rebuilding it.
+// - Extract the frustum planes from the view-projection matrix and test the
+//   tree boxes against all of them at once with SSE2 or NEON.
+//
+// NOTE: The nodes are stored depth first, so the first child of a node is
+// the next node, every subtree covers one contiguous range of objects, and a
+// refit is a single pass from the last node to the first.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CullingBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define CULLING_BVH_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define CULLING_BVH_NEON
+#include <arm_neon.h>
+#endif
+
+// Namespace for the tree limits
+namespace
+{
+	// deepest tree the culling walk can hold on its stack
+	const int MAX_TREE_DEPTH = 64;
+
+	// grow a box to hold another box
+	void Merge(CullingBVH::AABB& box, const CullingBVH::AABB& other)
+	{
+		box.minimum = glm::min(box.minimum, other.minimum);
+		box.maximum = glm::max(box.maximum, other.maximum);
+	}
+}
+
+const int CullingBVH::MAX_LEAF_OBJECTS;
+
+/***********************************************************
+ *  CullingBVH()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CullingBVH::CullingBVH()
+{
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the tree top down,
+ *  splitting every range of objects at the median of their
+ *  centers along the widest axis.
+ ***********************************************************/
+void CullingBVH::Build(const std::vector<AABB>& bounds)
+{
+	int count = (int)bounds.size();
+
+	m_nodes.clear();
+	m_objects.resize(count);
+	m_buildCenters.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		m_objects[i] = i;
+		m_buildCenters[i] = (bounds[i].minimum + bounds[i].maximum) * 0.5f;
+	}
+
+	if (count > 0)
+	{
+		m_nodes.reserve(2 * (count / MAX_LEAF_OBJECTS + 1));
+		BuildNode(bounds, 0, count);
+	}
+	m_buildCenters.clear();
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is used for adding the node of one range of
+ *  objects and, unless the range fits a leaf, its two
+ *  children.
+ ***********************************************************/
+int CullingBVH::BuildNode(const std::vector<AABB>& bounds, int first, int count)
+{
+	int nodeIndex = (int)m_nodes.size();
+	m_nodes.push_back(NODE());
+
+	AABB box = bounds[m_objects[first]];
+	AABB centers = { m_buildCenters[m_objects[first]], m_buildCenters[m_objects[first]] };
+	for (int i = first + 1; i < first + count; ++i)
+	{
+		Merge(box, bounds[m_objects[i]]);
+		centers.minimum = glm::min(centers.minimum, m_buildCenters[m_objects[i]]);
+		centers.maximum = glm::max(centers.maximum, m_buildCenters[m_objects[i]]);
+	}
+
+	NODE node;
+	SetNodeBounds(node, box);
+	node.first = first;
+	node.count = count;
+	node.right = -1;
+
+	if (count > MAX_LEAF_OBJECTS)
+	{
+		glm::vec3 spread = centers.maximum - centers.minimum;
+		int axis = 0;
+		if (spread.y > spread[axis]) axis = 1;
+		if (spread.z > spread[axis]) axis = 2;
+
+		int half = count / 2;
+		std::nth_element(
+			m_objects.begin() + first,
+			m_objects.begin() + first + half,
+			m_objects.begin() + first + count,
+			[this, axis](int a, int b) { return m_buildCenters[a][axis] < m_buildCenters[b][axis]; });
+
+		BuildNode(bounds, first, half);
+		node.right = BuildNode(bounds, first + half, count - half);
+	}
+
+	m_nodes[nodeIndex] = node;
+	return(nodeIndex);
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  This method is used for recomputing every box from the
+ *  current object bounds.  Children always come after
+ *  their parent, so walking backwards visits them first.
+ ***********************************************************/
+void CullingBVH::Refit(const std::vector<AABB>& bounds)
+{
+	if (bounds.size() != m_objects.size())
+	{
+		Build(bounds);
+		return;
+	}
+
+	for (int nodeIndex = (int)m_nodes.size() - 1; nodeIndex >= 0; --nodeIndex)
+	{
+		NODE& node = m_nodes[nodeIndex];
+		AABB box;
+
+		if (node.right < 0)
+		{
+			box = bounds[m_objects[node.first]];
+			for (int i = node.first + 1; i < node.first + node.count; ++i)
+			{
+				Merge(box, bounds[m_objects[i]]);
+			}
+		}
+		else
+		{
+			const NODE& left = m_nodes[nodeIndex + 1];
+			const NODE& right = m_nodes[node.right];
+			box.minimum = glm::min(left.center - left.extent, right.center - right.extent);
+			box.maximum = glm::max(left.center + left.extent, right.center + right.extent);
+		}
+		SetNodeBounds(node, box);
+	}
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used for walking the tree and adding the
+ *  objects of every leaf whose box reaches into the
+ *  frustum.  The objects themselves are not tested again,
+ *  so a leaf can let through an object just outside.
+ ***********************************************************/
+void CullingBVH::Cull(const FRUSTUM& frustum, std::vector<int>& visibleObjects, CULL_STATS* pStats) const
+{
+	size_t firstVisible = visibleObjects.size();
+	int nodesVisited = 0;
+
+	if (m_nodes.empty() == false)
+	{
+		nodesVisited = CullSubtree(frustum, 0, visibleObjects);
+	}
+
+	if (NULL != pStats)
+	{
+		pStats->nodesVisited = nodesVisited;
+		pStats->visibleObjects = (int)(visibleObjects.size() - firstVisible);
+		pStats->culledObjects = ObjectCount() - pStats->visibleObjects;
+	}
+}
+
+/***********************************************************
+ *  CullSubtree()
+ *
+ *  This method is used for walking the part of the tree
+ *  below one node, as Cull() walks the whole tree.  The
+ *  subtrees from CollectSubtrees() can be walked on
+ *  different threads, each into a list of its own.
+ ***********************************************************/
+int CullingBVH::CullSubtree(const FRUSTUM& frustum, int rootNode, std::vector<int>& visibleObjects) const
+{
+	int nodesVisited = 0;
+
+	int stack[MAX_TREE_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = rootNode;
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = stack[--stackSize];
+		const NODE& node = m_nodes[nodeIndex];
+		nodesVisited++;
+
+		CLASSIFICATION classification = Classify(frustum, node.center, node.extent);
+		if (classification == CLASSIFY_OUTSIDE)
+		{
+			continue;
+		}
+
+		if ((classification == CLASSIFY_INSIDE) || (node.right < 0) || (stackSize + 2 > MAX_TREE_DEPTH))
+		{
+			visibleObjects.insert(
+				visibleObjects.end(),
+				m_objects.begin() + node.first,
+				m_objects.begin() + node.first + node.count);
+			continue;
+		}
+
+		stack[stackSize++] = node.right;
+		stack[stackSize++] = nodeIndex + 1;
+	}
+
+	return(nodesVisited);
+}
+
+/***********************************************************
+ *  CollectSubtrees()
+ *
+ *  This method is used for cutting the tree into subtrees
+ *  that share no objects and together hold all of them.
+ *  The subtree with the most objects is split into its two
+ *  children until there are enough, or only leaves are
+ *  left.  The nodes above the cut are not tested when the
+ *  subtrees are culled, which costs a few more box tests
+ *  than walking the tree from its root.
+ ***********************************************************/
+void CullingBVH::CollectSubtrees(int subtreeCount, std::vector<int>& subtreeRoots) const
+{
+	subtreeRoots.clear();
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	subtreeRoots.push_back(0);
+	while ((int)subtreeRoots.size() < subtreeCount)
+	{
+		int largest = -1;
+		for (size_t i = 0; i < subtreeRoots.size(); ++i)
+		{
+			const NODE& node = m_nodes[subtreeRoots[i]];
+			if ((node.right >= 0) && ((largest < 0) || (node.count > m_nodes[subtreeRoots[largest]].count)))
+			{
+				largest = (int)i;
+			}
+		}
+		if (largest < 0)
+		{
+			break;
+		}
+
+		int nodeIndex = subtreeRoots[largest];
+		subtreeRoots[largest] = nodeIndex + 1;
+		subtreeRoots.push_back(m_nodes[nodeIndex].right);
+	}
+}
+
+/***********************************************************
+ *  ExtractFrustum()
+ *
+ *  This method is used for taking the six planes from the
+ *  rows of the view-projection matrix.  Each plane is
+ *  normalized so its distances are in world units, and its
+ *  normal points into the frustum.
+ ***********************************************************/
+void CullingBVH::ExtractFrustum(const glm::mat4& viewProjection, FRUSTUM& frustum)
+{
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; ++row)
+	{
+		rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+	}
+
+	// left, right, bottom, top, near, far
+	glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2] };
+
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec4 plane(0.0f, 0.0f, 0.0f, 1.0f);
+		if (i < 6)
+		{
+			float length = glm::length(glm::vec3(planes[i]));
+			plane = (length > 0.0f) ? (planes[i] / length) : plane;
+		}
+		frustum.x[i] = plane.x;
+		frustum.y[i] = plane.y;
+		frustum.z[i] = plane.z;
+		frustum.w[i] = plane.w;
+		frustum.absX[i] = std::fabs(plane.x);
+		frustum.absY[i] = std::fabs(plane.y);
+		frustum.absZ[i] = std::fabs(plane.z);
+	}
+}
+
+/***********************************************************
+ *  TransformBounds()
+ *
+ *  This method is used for placing a local box in the
+ *  world.  The new center is the transformed center, and
+ *  the new half size sums the absolute matrix columns
+ *  scaled by the old half size.
+ ***********************************************************/
+CullingBVH::AABB CullingBVH::TransformBounds(const AABB& local, const glm::mat4& matrix)
+{
+	glm::vec3 center = (local.minimum + local.maximum) * 0.5f;
+	glm::vec3 extent = (local.maximum - local.minimum) * 0.5f;
+
+	glm::vec3 worldCenter = glm::vec3(matrix * glm::vec4(center, 1.0f));
+	glm::vec3 worldExtent =
+		glm::abs(glm::vec3(matrix[0])) * extent.x +
+		glm::abs(glm::vec3(matrix[1])) * extent.y +
+		glm::abs(glm::vec3(matrix[2])) * extent.z;
+
+	AABB world = { worldCenter - worldExtent, worldCenter + worldExtent };
+	return(world);
+}
+
+/***********************************************************
+ *  Classify()
+ *
+ *  This method is used for testing a box against all eight
+ *  plane slots, four at a time.  The box is outside when
+ *  its center is further behind any plane than its radius
+ *  along that plane, and inside when it is in front of
+ *  every plane by more than its radius.
+ ***********************************************************/
+CullingBVH::CLASSIFICATION CullingBVH::Classify(const FRUSTUM& frustum, const glm::vec3& center, const glm::vec3& extent)
+{
+	bool bOutside = false;
+	bool bIntersecting = false;
+
+#if defined(CULLING_BVH_SSE2)
+	const __m128 centerX = _mm_set1_ps(center.x);
+	const __m128 centerY = _mm_set1_ps(center.y);
+	const __m128 centerZ = _mm_set1_ps(center.z);
+	const __m128 extentX = _mm_set1_ps(extent.x);
+	const __m128 extentY = _mm_set1_ps(extent.y);
+	const __m128 extentZ = _mm_set1_ps(extent.z);
+	const __m128 zero = _mm_setzero_ps();
+	int outsideMask = 0;
+	int intersectMask = 0;
+
+	for (int i = 0; i < 8; i += 4)
+	{
+		__m128 distance = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&frustum.x[i]), centerX), _mm_mul_ps(_mm_loadu_ps(&frustum.y[i]), centerY)),
+			_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&frustum.z[i]), centerZ), _mm_loadu_ps(&frustum.w[i])));
+		__m128 radius = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&frustum.absX[i]), extentX), _mm_mul_ps(_mm_loadu_ps(&frustum.absY[i]), extentY)),
+			_mm_mul_ps(_mm_loadu_ps(&frustum.absZ[i]), extentZ));
+
+		outsideMask |= _mm_movemask_ps(_mm_cmplt_ps(distance, _mm_sub_ps(zero, radius)));
+		intersectMask |= _mm_movemask_ps(_mm_cmplt_ps(distance, radius));
+	}
+	bOutside = (outsideMask != 0);
+	bIntersecting = (intersectMask != 0);
+#elif defined(CULLING_BVH_NEON)
+	const float32x4_t centerX = vdupq_n_f32(center.x);
+	const float32x4_t centerY = vdupq_n_f32(center.y);
+	const float32x4_t centerZ = vdupq_n_f32(center.z);
+	const float32x4_t extentX = vdupq_n_f32(extent.x);
+	const float32x4_t extentY = vdupq_n_f32(extent.y);
+	const float32x4_t extentZ = vdupq_n_f32(extent.z);
+	uint32x4_t outsideMask = vdupq_n_u32(0);
+	uint32x4_t intersectMask = vdupq_n_u32(0);
+
+	for (int i = 0; i < 8; i += 4)
+	{
+		float32x4_t distance = vld1q_f32(&frustum.w[i]);
+		distance = vmlaq_f32(distance, vld1q_f32(&frustum.x[i]), centerX);
+		distance = vmlaq_f32(distance, vld1q_f32(&frustum.y[i]), centerY);
+		distance = vmlaq_f32(distance, vld1q_f32(&frustum.z[i]), centerZ);
+		float32x4_t radius = vmulq_f32(vld1q_f32(&frustum.absX[i]), extentX);
+		radius = vmlaq_f32(radius, vld1q_f32(&frustum.absY[i]), extentY);
+		radius = vmlaq_f32(radius, vld1q_f32(&frustum.absZ[i]), extentZ);
+
+		outsideMask = vorrq_u32(outsideMask, vcltq_f32(distance, vnegq_f32(radius)));
+		intersectMask = vorrq_u32(intersectMask, vcltq_f32(distance, radius));
+	}
+	uint32x2_t outside = vorr_u32(vget_low_u32(outsideMask), vget_high_u32(outsideMask));
+	uint32x2_t intersect = vorr_u32(vget_low_u32(intersectMask), vget_high_u32(intersectMask));
+	bOutside = ((vget_lane_u32(outside, 0) | vget_lane_u32(outside, 1)) != 0);
+	bIntersecting = ((vget_lane_u32(intersect, 0) | vget_lane_u32(intersect, 1)) != 0);
+#else
+	for (int i = 0; i < 8; ++i)
+	{
+		float distance = frustum.x[i] * center.x + frustum.y[i] * center.y + frustum.z[i] * center.z + frustum.w[i];
+		float radius = frustum.absX[i] * extent.x + frustum.absY[i] * extent.y + frustum.absZ[i] * extent.z;
+
+		bOutside = bOutside || (distance < -radius);
+		bIntersecting = bIntersecting || (distance < radius);
+	}
+#endif
+
+	if (bOutside)
+	{
+		return(CLASSIFY_OUTSIDE);
+	}
+	return(bIntersecting ? CLASSIFY_INTERSECTING : CLASSIFY_INSIDE);
+}
+
+/***********************************************************
+ *  SetNodeBounds()
+ *
+ *  This method is used for storing a box as the center and
+ *  half size that the plane tests use.
+ ***********************************************************/
+void CullingBVH::SetNodeBounds(NODE& node, const AABB& box)
+{
+	node.center = (box.minimum + box.maximum) * 0.5f;
+	node.extent = (box.maximum - box.minimum) * 0.5f;
+}
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// cullingbvh.h
+// ============
+// bounding volume hierarchy over the world bounds of the scene objects, for
+// rejecting everything outside the view frustum before it is drawn
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  CullingBVH
+ *
+ *  This class keeps a binary tree of axis aligned boxes
+ *  over a list of object bounds.  It is built once when
+ *  the scene is prepared and refit, keeping its shape, when
+ *  objects move.  Culling walks the tree against the six
+ *  frustum planes, testing each box against all planes at
+ *  once with SIMD.  A subtree that lies wholly inside the
+ *  frustum is accepted without testing its children.
+ ***********************************************************/
+class CullingBVH
+{
+public:
+	// axis aligned box
+	struct AABB
+	{
+		glm::vec3 minimum;
+		glm::vec3 maximum;
+	};
+
+	// the six frustum planes as structure-of-arrays, padded to
+	// eight with planes that accept everything
+	struct FRUSTUM
+	{
+		float x[8];
+		float y[8];
+		float z[8];
+		float w[8];
+		// absolute normals, for the box radius along each plane
+		float absX[8];
+		float absY[8];
+		float absZ[8];
+	};
+
+	// where a box lies relative to the frustum
+	enum CLASSIFICATION
+	{
+		CLASSIFY_OUTSIDE,
+		CLASSIFY_INTERSECTING,
+		CLASSIFY_INSIDE
+	};
+
+	// work done by the most recent Cull()
+	struct CULL_STATS
+	{
+		int nodesVisited;
+		int visibleObjects;
+		int culledObjects;
+	};
+
+	// objects kept together in one leaf
+	static const int MAX_LEAF_OBJECTS = 4;
+
+	// constructor
+	CullingBVH();
+
+	// build the tree over the passed in object bounds
+	void Build(const std::vector<AABB>& bounds);
+	// recompute the boxes for moved objects, keeping the tree
+	void Refit(const std::vector<AABB>& bounds);
+	// add the index of every object that may be in the frustum
+	void Cull(const FRUSTUM& frustum, std::vector<int>& visibleObjects, CULL_STATS* pStats) const;
+	// cut the tree into about subtreeCount subtrees that hold
+	// every object once, for culling them in parallel
+	void CollectSubtrees(int subtreeCount, std::vector<int>& subtreeRoots) const;
+	// add the index of every object below one node that may be
+	// in the frustum, returning the number of nodes visited
+	int CullSubtree(const FRUSTUM& frustum, int rootNode, std::vector<int>& visibleObjects) const;
+
+	// number of objects the tree was built over
+	int ObjectCount() const { return (int)m_objects.size(); }
+	// number of tree nodes
+	int NodeCount() const { return (int)m_nodes.size(); }
+
+	// take the frustum planes from a view-projection matrix
+	static void ExtractFrustum(const glm::mat4& viewProjection, FRUSTUM& frustum);
+	// box around a local box after a transformation
+	static AABB TransformBounds(const AABB& local, const glm::mat4& matrix);
+	// test a box, given by its center and half size, against
+	// every plane of the frustum
+	static CLASSIFICATION Classify(const FRUSTUM& frustum, const glm::vec3& center, const glm::vec3& extent);
+
+private:
+	// one tree node, covering m_objects[first, first + count)
+	struct NODE
+	{
+		glm::vec3 center;
+		int first;
+		glm::vec3 extent;
+		int count;
+		// second child, the first follows the node, or -1 for
+		// a leaf
+		int right;
+	};
+
+	std::vector<NODE> m_nodes;
+	// object indices in tree order
+	std::vector<int> m_objects;
+	// centers of the objects while building
+	std::vector<glm::vec3> m_buildCenters;
+
+	// build the node for a range of m_objects, returning its index
+	int BuildNode(const std::vector<AABB>& bounds, int first, int count);
+	// set a node's box from a combined box
+	static void SetNodeBounds(NODE& node, const AABB& box);
+};
@@ -0,0 +1,216 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.cpp
+// ===============
+// This file contains the implementation of the `FileWatcher` class, which
+// notices when the asset files used by the running scene are changed.
+//
+// RESPONSIBILITIES:
+// - Check the watched files on a background thread, away from the frame.
+// - Hold a change back until the file has stopped changing.
+// - Hand the changed files to the GL thread without blocking it.
+//
+// NOTE: Files are polled rather than watched through the operating system,
+// so the same code runs everywhere and a dozen files cost a few stat calls
+// per interval.  A change that keeps both the modification time and the size
+// is not seen.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileWatcher.h"
+
+#include <sys/stat.h>
+
+#include <chrono>
+
+/***********************************************************
+ *  FileWatcher()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FileWatcher::FileWatcher()
+{
+	m_bStopping = false;
+	m_intervalMilliseconds = 0;
+}
+
+/***********************************************************
+ *  ~FileWatcher()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Watch()
+ *
+ *  This method is used for adding a file to the watch
+ *  list.  Its current state is taken as the starting point,
+ *  so only later changes are reported, and a file that is
+ *  already watched is left alone.
+ ***********************************************************/
+void FileWatcher::Watch(const std::string& filePath)
+{
+	WATCHED_FILE file;
+	file.path = filePath;
+	file.stamp = ReadStamp(filePath);
+	file.pendingStamp = file.stamp;
+	file.bPending = false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_files.size(); ++i)
+	{
+		if (m_files[i].path == filePath)
+		{
+			return;
+		}
+	}
+	m_files.push_back(file);
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the watcher thread.
+ ***********************************************************/
+void FileWatcher::Start(int intervalMilliseconds)
+{
+	if (m_thread.joinable())
+	{
+		return;
+	}
+
+	m_intervalMilliseconds = intervalMilliseconds;
+	m_bStopping = false;
+	m_thread = std::thread(&FileWatcher::WatcherMain, this);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for waking and joining the watcher
+ *  thread.  Changes that were not taken yet are dropped.
+ ***********************************************************/
+void FileWatcher::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_all();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changed.clear();
+}
+
+/***********************************************************
+ *  PopChanged()
+ *
+ *  This method is used for taking the oldest reported
+ *  change.  The lock is only ever held for a list
+ *  operation or one round of checks, so the GL thread does
+ *  not wait on it for long.
+ ***********************************************************/
+bool FileWatcher::PopChanged(std::string& filePath)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_changed.empty())
+	{
+		return(false);
+	}
+
+	filePath = m_changed.front();
+	m_changed.pop_front();
+	return(true);
+}
+
+/***********************************************************
+ *  WatcherMain()
+ *
+ *  This method is used for running the watcher thread -
+ *  check the files, then sleep until the next interval or
+ *  until the watcher is stopped.
+ ***********************************************************/
+void FileWatcher::WatcherMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_bStopping == false)
+	{
+		CheckFiles();
+		m_wake.wait_for(lock, std::chrono::milliseconds(m_intervalMilliseconds),
+			[this]() { return m_bStopping; });
+	}
+}
+
+/***********************************************************
+ *  CheckFiles()
+ *
+ *  This method is used for comparing every watched file
+ *  against its last stamp, with the lock held.  A new stamp
+ *  is remembered first and only reported when the next
+ *  check sees it again.  A file that went away is noted but
+ *  not reported, so a save that deletes and rewrites the
+ *  file shows up as one change.
+ ***********************************************************/
+void FileWatcher::CheckFiles()
+{
+	for (size_t i = 0; i < m_files.size(); ++i)
+	{
+		WATCHED_FILE& file = m_files[i];
+		FILE_STAMP stamp = ReadStamp(file.path);
+
+		if (IsSameStamp(stamp, file.stamp))
+		{
+			file.bPending = false;
+		}
+		else if (file.bPending && IsSameStamp(stamp, file.pendingStamp))
+		{
+			file.stamp = stamp;
+			file.bPending = false;
+			if (stamp.bExists)
+			{
+				m_changed.push_back(file.path);
+			}
+		}
+		else
+		{
+			file.pendingStamp = stamp;
+			file.bPending = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  ReadStamp()
+ *
+ *  This method is used for reading the modification time
+ *  and size of a file.
+ ***********************************************************/
+FileWatcher::FILE_STAMP FileWatcher::ReadStamp(const std::string& filePath)
+{
+	FILE_STAMP stamp;
+	struct stat status;
+
+	stamp.bExists = (stat(filePath.c_str(), &status) == 0);
+	stamp.modifiedTime = stamp.bExists ? (long long)status.st_mtime : 0;
+	stamp.size = stamp.bExists ? (long long)status.st_size : 0;
+
+	return(stamp);
+}
+
+/***********************************************************
+ *  IsSameStamp()
+ *
+ *  This method is used for comparing two stamps.
+ ***********************************************************/
+bool FileWatcher::IsSameStamp(const FILE_STAMP& first, const FILE_STAMP& second)
+{
+	return((first.bExists == second.bExists) &&
+		(first.modifiedTime == second.modifiedTime) &&
+		(first.size == second.size));
+}
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.h
+// ============
+// poll a list of asset files on a background thread and report the ones
+// whose contents changed, once each change has finished being written
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  FileWatcher
+ *
+ *  This class checks the modification time and size of
+ *  every watched file at a fixed interval on a thread of
+ *  its own.  A change is only reported once the file has
+ *  looked the same for two checks in a row, so a file that
+ *  an editor or cooker is still writing is not picked up
+ *  half way.  The changed files are collected for the GL
+ *  thread, which takes them with PopChanged() at the start
+ *  of a frame.
+ ***********************************************************/
+class FileWatcher
+{
+public:
+	// constructor
+	FileWatcher();
+	// destructor
+	~FileWatcher();
+
+	// add a file to the watch list, a file that does not
+	// exist yet is reported when it appears
+	void Watch(const std::string& filePath);
+	// start checking the watched files at the passed in interval
+	void Start(int intervalMilliseconds);
+	// stop the watcher thread
+	void Stop();
+
+	// take the next file that changed, false when none did
+	bool PopChanged(std::string& filePath);
+
+private:
+	// what a check sees of a file
+	struct FILE_STAMP
+	{
+		bool bExists;
+		long long modifiedTime;
+		long long size;
+	};
+
+	// one watched file
+	struct WATCHED_FILE
+	{
+		std::string path;
+		// stamp of the contents last reported or started with
+		FILE_STAMP stamp;
+		// stamp of a change that has not been seen twice yet
+		FILE_STAMP pendingStamp;
+		bool bPending;
+	};
+
+	// watch list and changed files, guarded by m_mutex
+	std::vector<WATCHED_FILE> m_files;
+	std::deque<std::string> m_changed;
+	std::mutex m_mutex;
+	// wakes the thread early when it is stopped
+	std::condition_variable m_wake;
+	std::thread m_thread;
+	bool m_bStopping;
+	int m_intervalMilliseconds;
+
+	// watcher thread loop
+	void WatcherMain();
+	// check every watched file once
+	void CheckFiles();
+	// read the modification time and size of a file
+	static FILE_STAMP ReadStamp(const std::string& filePath);
+	// check whether two stamps describe the same contents
+	static bool IsSameStamp(const FILE_STAMP& first, const FILE_STAMP& second);
+};
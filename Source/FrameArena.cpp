@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.cpp
+// ==============
+// This file contains the implementation of the `FrameArena` class, which
+// holds the scratch data the renderer builds and throws away every frame.
+//
+// RESPONSIBILITIES:
+// - Hand out aligned memory from one block by moving an offset.
+// - Fall back to the heap for a frame that does not fit, and grow to it.
+// - Take back the whole frame's memory at once when it is reset.
+//
+// NOTE: The block only grows, to the largest frame seen so far, so it is
+// as large as the busiest view of the scene rather than the current one.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameArena.h"
+
+#include <iostream>
+#include <new>
+
+const size_t FrameArena::DEFAULT_ALIGNMENT;
+
+// declaration of the global variables and defines
+namespace
+{
+	// slack added when the block grows, so a slowly busier view
+	// does not grow it every frame
+	const size_t g_GrowthSlackBytes = 16 * 1024;
+	// heap blocks of one frame that fit without growing the list
+	const size_t g_ReservedOverflowBlocks = 64;
+
+	// bytes to skip from an address to the next one with a power
+	// of two alignment
+	size_t AlignmentPadding(const unsigned char* pAddress, size_t alignment)
+	{
+		size_t address = reinterpret_cast<size_t>(pAddress);
+		return(((address + alignment - 1) & ~(alignment - 1)) - address);
+	}
+
+	// get heap memory without throwing, through operator new so
+	// the heap counter sees it
+	unsigned char* AllocateHeap(size_t bytes)
+	{
+		return(static_cast<unsigned char*>(::operator new(bytes, std::nothrow)));
+	}
+}
+
+/***********************************************************
+ *  FrameArena()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameArena::FrameArena()
+{
+	m_pBlock = NULL;
+	m_capacity = 0;
+	m_offset = 0;
+	m_overflowBytes = 0;
+}
+
+/***********************************************************
+ *  ~FrameArena()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameArena::~FrameArena()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for allocating the block the frames
+ *  are carved from.
+ ***********************************************************/
+void FrameArena::Create(size_t capacityBytes)
+{
+	Destroy();
+
+	m_pBlock = AllocateHeap(capacityBytes);
+	if (NULL == m_pBlock)
+	{
+		std::cout << "Could not allocate the frame arena of " << capacityBytes << " bytes" << std::endl;
+		capacityBytes = 0;
+	}
+	m_capacity = capacityBytes;
+	m_offset = 0;
+	m_overflowBlocks.reserve(g_ReservedOverflowBlocks);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the block and the heap
+ *  memory of the frame in progress.
+ ***********************************************************/
+void FrameArena::Destroy()
+{
+	for (size_t i = 0; i < m_overflowBlocks.size(); ++i)
+	{
+		::operator delete(m_overflowBlocks[i]);
+	}
+	m_overflowBlocks.clear();
+	m_overflowBytes = 0;
+
+	::operator delete(m_pBlock);
+	m_pBlock = NULL;
+	m_capacity = 0;
+	m_offset = 0;
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used for taking the next aligned range of
+ *  the block.  A request that does not fit gets a heap block
+ *  of its own, which is kept until the next Reset().
+ ***********************************************************/
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	if (NULL != m_pBlock)
+	{
+		size_t start = m_offset + AlignmentPadding(m_pBlock + m_offset, alignment);
+		if (start + bytes <= m_capacity)
+		{
+			m_offset = start + bytes;
+			return(m_pBlock + start);
+		}
+	}
+
+	// the heap block is padded so the range inside it can be
+	// aligned, and counted at the padded size so the grown
+	// block has room for the same padding
+	size_t paddedBytes = bytes + alignment;
+	unsigned char* pOverflow = AllocateHeap(paddedBytes);
+	if (NULL == pOverflow)
+	{
+		std::cout << "Could not allocate " << bytes << " bytes of frame memory" << std::endl;
+		return(NULL);
+	}
+	m_overflowBlocks.push_back(pOverflow);
+	m_overflowBytes += paddedBytes;
+
+	return(pOverflow + AlignmentPadding(pOverflow, alignment));
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used for starting the next frame.  When
+ *  the frame that ended spilled onto the heap, the block is
+ *  replaced by one big enough for all of it; nothing in the
+ *  old block may be used after a Reset() anyway.
+ ***********************************************************/
+void FrameArena::Reset()
+{
+	if (0 != m_overflowBytes)
+	{
+		size_t capacity = m_offset + m_overflowBytes + g_GrowthSlackBytes;
+		for (size_t i = 0; i < m_overflowBlocks.size(); ++i)
+		{
+			::operator delete(m_overflowBlocks[i]);
+		}
+		m_overflowBlocks.clear();
+		m_overflowBytes = 0;
+
+		unsigned char* pBlock = AllocateHeap(capacity);
+		if (NULL != pBlock)
+		{
+			::operator delete(m_pBlock);
+			m_pBlock = pBlock;
+			m_capacity = capacity;
+		}
+	}
+
+	m_offset = 0;
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting how much of the arena
+ *  the frame in progress has used.
+ ***********************************************************/
+void FrameArena::GetStats(ARENA_STATS& stats) const
+{
+	stats.usedBytes = m_offset + m_overflowBytes;
+	stats.capacityBytes = m_capacity;
+	stats.overflowAllocations = (int)m_overflowBlocks.size();
+}
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.h
+// ============
+// hand out memory for data that only lives until the end of the frame from
+// one block, and take all of it back at once when the frame is shown
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  FrameArena
+ *
+ *  This class is a bump allocator - an allocation moves an
+ *  offset into one block on by its size, and Reset(),
+ *  called once the frame is swapped, moves it back to the
+ *  start.  Nothing is freed on its own and no destructors
+ *  run, so the arena only holds plain data such as command
+ *  lists and index arrays.  When a frame needs more than
+ *  the block holds, the rest is taken from the heap and the
+ *  next Reset() grows the block to the most the frame used,
+ *  so after a few frames every frame fits and the arena
+ *  stops touching the heap.  It is not thread safe; the
+ *  render thread allocates and jobs only write into what
+ *  it handed out.
+ ***********************************************************/
+class FrameArena
+{
+public:
+	// usage of the arena, read before a Reset()
+	struct ARENA_STATS
+	{
+		// bytes handed out this frame, heap blocks included
+		size_t usedBytes;
+		// size of the block
+		size_t capacityBytes;
+		// allocations that did not fit in the block
+		int overflowAllocations;
+	};
+
+	// alignment of every allocation that does not ask for more
+	static const size_t DEFAULT_ALIGNMENT = 16;
+
+	// constructor
+	FrameArena();
+	// destructor
+	~FrameArena();
+
+	// allocate the block
+	void Create(size_t capacityBytes);
+	// free the block and any heap memory taken this frame
+	void Destroy();
+
+	// get uninitialized memory that lasts until the next Reset(),
+	// alignment being a power of two
+	void* Allocate(size_t bytes, size_t alignment = DEFAULT_ALIGNMENT);
+	// get an array of count values left for the caller to fill
+	template <typename T>
+	T* AllocateArray(size_t count)
+	{
+		size_t alignment = (alignof(T) > DEFAULT_ALIGNMENT) ? alignof(T) : DEFAULT_ALIGNMENT;
+		return static_cast<T*>(Allocate(sizeof(T) * count, alignment));
+	}
+
+	// take back everything handed out, growing the block first
+	// when the frame did not fit in it
+	void Reset();
+
+	// usage of the frame in progress
+	void GetStats(ARENA_STATS& stats) const;
+
+private:
+	unsigned char* m_pBlock;
+	size_t m_capacity;
+	// offset of the next free byte of the block
+	size_t m_offset;
+	// allocations of this frame that did not fit in the block,
+	// and their size
+	std::vector<void*> m_overflowBlocks;
+	size_t m_overflowBytes;
+};
@@ -0,0 +1,551 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculling.cpp
+// ==============
+// This file contains the implementation of the `GpuCulling` class, which
+// decides on the GPU which scene instances are drawn.
+//
+// RESPONSIBILITIES:
+// - Keep the world bounds of every instance in a shader storage buffer.
+// - Run the culling compute pass over the frame's indirect commands.
+// - Copy the opaque depth and reduce it into a max depth pyramid.
+// - Read the pass counters back through fenced buffers without stalling.
+//
+// NOTE: The pyramid is built from the depth of the frame before, with that
+// frame's view-projection, so an object that comes out from behind an
+// occluder is drawn one frame late.  Boxes that reach behind the camera are
+// never occlusion culled.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GpuCulling.h"
+#include "ShaderBlocks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// declaration of the global variables and defines
+namespace
+{
+	const char* const CULL_SHADER_PATH = "shaders/cullComputeShader.glsl";
+	const char* const PYRAMID_SHADER_PATH = "shaders/depthPyramidComputeShader.glsl";
+	// work group size of the pyramid shader, in each direction
+	const int PYRAMID_GROUP_SIZE = 8;
+	// image unit the pyramid shader writes through
+	const GLuint PYRAMID_IMAGE_UNIT = 0;
+}
+
+const int GpuCulling::GROUP_SIZE;
+const int GpuCulling::STATS_BUFFER_COUNT;
+
+/***********************************************************
+ *  GpuCulling()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GpuCulling::GpuCulling()
+{
+	m_cullProgram = 0;
+	m_pyramidProgram = 0;
+	memset(&m_cullUniforms, 0, sizeof(m_cullUniforms));
+	memset(&m_pyramidUniforms, 0, sizeof(m_pyramidUniforms));
+	m_dirtyFirst = 0;
+	m_dirtyLast = -1;
+	m_boundsBuffer = 0;
+	m_boundsCapacity = 0;
+	m_culledCommandBuffer = 0;
+	m_commandCapacity = 0;
+	m_culledMatrixBuffer = 0;
+	m_culledSettingsBuffer = 0;
+	m_instanceCapacity = 0;
+	for (int i = 0; i < STATS_BUFFER_COUNT; ++i)
+	{
+		m_statsBuffers[i] = 0;
+		m_statsFences[i] = 0;
+	}
+	m_statsIndex = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_depthTexture = 0;
+	m_pyramidTexture = 0;
+	m_depthWidth = 0;
+	m_depthHeight = 0;
+	m_pyramidLevels = 0;
+	m_pyramidViewProjection = glm::mat4(1.0f);
+	m_bPyramidValid = false;
+	m_bUseOcclusion = true;
+}
+
+/***********************************************************
+ *  ~GpuCulling()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GpuCulling::~GpuCulling()
+{
+	if (0 != m_cullProgram) glDeleteProgram(m_cullProgram);
+	if (0 != m_pyramidProgram) glDeleteProgram(m_pyramidProgram);
+	if (0 != m_boundsBuffer) glDeleteBuffers(1, &m_boundsBuffer);
+	if (0 != m_culledCommandBuffer) glDeleteBuffers(1, &m_culledCommandBuffer);
+	if (0 != m_culledMatrixBuffer) glDeleteBuffers(1, &m_culledMatrixBuffer);
+	if (0 != m_culledSettingsBuffer) glDeleteBuffers(1, &m_culledSettingsBuffer);
+	for (int i = 0; i < STATS_BUFFER_COUNT; ++i)
+	{
+		if (0 != m_statsFences[i]) glDeleteSync(m_statsFences[i]);
+		if (0 != m_statsBuffers[i]) glDeleteBuffers(1, &m_statsBuffers[i]);
+	}
+	if (0 != m_depthTexture) glDeleteTextures(1, &m_depthTexture);
+	if (0 != m_pyramidTexture) glDeleteTextures(1, &m_pyramidTexture);
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking for OpenGL 4.3, which
+ *  has compute shaders, shader storage buffers and image
+ *  load and store.
+ ***********************************************************/
+bool GpuCulling::IsSupported()
+{
+	return(GLEW_VERSION_4_3 ? true : false);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for compiling the culling and the
+ *  pyramid programs and creating the buffers the pass
+ *  reads and writes.  False means the scene has to be
+ *  culled on the CPU.
+ ***********************************************************/
+bool GpuCulling::Create()
+{
+	if (IsSupported() == false)
+	{
+		return(false);
+	}
+
+	m_cullProgram = LoadComputeProgram(CULL_SHADER_PATH);
+	m_pyramidProgram = LoadComputeProgram(PYRAMID_SHADER_PATH);
+	if ((0 == m_cullProgram) || (0 == m_pyramidProgram))
+	{
+		return(false);
+	}
+
+	m_cullUniforms.frustumPlanes = glGetUniformLocation(m_cullProgram, "frustumPlanes");
+	m_cullUniforms.occlusionViewProjection = glGetUniformLocation(m_cullProgram, "occlusionViewProjection");
+	m_cullUniforms.bUseOcclusion = glGetUniformLocation(m_cullProgram, "bUseOcclusion");
+	m_cullUniforms.depthPyramid = glGetUniformLocation(m_cullProgram, "depthPyramid");
+	m_cullUniforms.pyramidLevels = glGetUniformLocation(m_cullProgram, "pyramidLevels");
+	m_cullUniforms.pyramidSize = glGetUniformLocation(m_cullProgram, "pyramidSize");
+	m_cullUniforms.viewportSize = glGetUniformLocation(m_cullProgram, "viewportSize");
+	m_pyramidUniforms.sourceDepth = glGetUniformLocation(m_pyramidProgram, "sourceDepth");
+	m_pyramidUniforms.sourceLevel = glGetUniformLocation(m_pyramidProgram, "sourceLevel");
+	m_pyramidUniforms.sourceSize = glGetUniformLocation(m_pyramidProgram, "sourceSize");
+
+	// both programs read their texture from the same unit
+	glProgramUniform1i(m_cullProgram, m_cullUniforms.depthPyramid, DEPTH_PYRAMID_TEXTURE_UNIT);
+	glProgramUniform1i(m_pyramidProgram, m_pyramidUniforms.sourceDepth, DEPTH_PYRAMID_TEXTURE_UNIT);
+
+	glGenBuffers(1, &m_boundsBuffer);
+	glGenBuffers(1, &m_culledCommandBuffer);
+	glGenBuffers(1, &m_culledMatrixBuffer);
+	glGenBuffers(1, &m_culledSettingsBuffer);
+	glGenBuffers(STATS_BUFFER_COUNT, m_statsBuffers);
+
+	CULL_STATS zeroStats;
+	memset(&zeroStats, 0, sizeof(zeroStats));
+	for (int i = 0; i < STATS_BUFFER_COUNT; ++i)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuffers[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zeroStats), &zeroStats, GL_DYNAMIC_READ);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetInstanceCount()
+ *
+ *  This method is used for sizing the bounds list for the
+ *  instances of a newly built scene.  Every instance starts
+ *  with an empty box until its bounds are set.
+ ***********************************************************/
+void GpuCulling::SetInstanceCount(int count)
+{
+	m_bounds.assign(count * 2, glm::vec4(0.0f));
+	m_dirtyFirst = 0;
+	m_dirtyLast = count - 1;
+}
+
+/***********************************************************
+ *  SetInstanceBounds()
+ *
+ *  This method is used for storing the world bounds of one
+ *  instance and growing the range of bounds that is sent
+ *  with the next pass.
+ ***********************************************************/
+void GpuCulling::SetInstanceBounds(int instance, const CullingBVH::AABB& bounds)
+{
+	if ((instance < 0) || (instance * 2 >= (int)m_bounds.size()))
+	{
+		return;
+	}
+
+	m_bounds[instance * 2] = glm::vec4(bounds.minimum, 1.0f);
+	m_bounds[instance * 2 + 1] = glm::vec4(bounds.maximum, 1.0f);
+
+	if (m_dirtyFirst > m_dirtyLast)
+	{
+		m_dirtyFirst = instance;
+		m_dirtyLast = instance;
+	}
+	else
+	{
+		m_dirtyFirst = std::min(m_dirtyFirst, instance);
+		m_dirtyLast = std::max(m_dirtyLast, instance);
+	}
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used for running the culling pass, with
+ *  one work group per indirect command.  The pass reads
+ *  the commands and the instances they draw from the
+ *  passed in buffers and writes the surviving instances and
+ *  the rewritten commands into the culled buffers, which
+ *  are then ready for the multi-draw.
+ ***********************************************************/
+void GpuCulling::Cull(const glm::mat4& viewProjection, GLuint sourceCommands, int commandCount, GLuint sourceMatrices, GLuint sourceSettings)
+{
+	if ((0 == m_cullProgram) || (commandCount <= 0))
+	{
+		return;
+	}
+
+	CollectStats();
+	UploadBounds();
+	ReserveCulledBuffers(commandCount);
+
+	// the planes in the FRUSTUM layout, one vec4 each
+	CullingBVH::FRUSTUM frustum;
+	CullingBVH::ExtractFrustum(viewProjection, frustum);
+	glm::vec4 planes[6];
+	for (int i = 0; i < 6; ++i)
+	{
+		planes[i] = glm::vec4(frustum.x[i], frustum.y[i], frustum.z[i], frustum.w[i]);
+	}
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(m_cullProgram);
+
+	bool bUseOcclusion = m_bUseOcclusion && m_bPyramidValid;
+	glUniform4fv(m_cullUniforms.frustumPlanes, 6, &planes[0][0]);
+	glUniformMatrix4fv(m_cullUniforms.occlusionViewProjection, 1, GL_FALSE, &m_pyramidViewProjection[0][0]);
+	glUniform1i(m_cullUniforms.bUseOcclusion, bUseOcclusion ? 1 : 0);
+	glUniform1i(m_cullUniforms.pyramidLevels, m_pyramidLevels);
+	glUniform2i(m_cullUniforms.pyramidSize, std::max(m_depthWidth / 2, 1), std::max(m_depthHeight / 2, 1));
+	glUniform2f(m_cullUniforms.viewportSize, (float)m_depthWidth, (float)m_depthHeight);
+
+	glActiveTexture(GL_TEXTURE0 + DEPTH_PYRAMID_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_pyramidTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_SOURCE_COMMAND_BINDING, sourceCommands);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_CULLED_COMMAND_BINDING, m_culledCommandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_BOUNDS_BINDING, m_boundsBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_SOURCE_MATRIX_BINDING, sourceMatrices);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_CULLED_MATRIX_BINDING, m_culledMatrixBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_SOURCE_SETTINGS_BINDING, sourceSettings);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_CULLED_SETTINGS_BINDING, m_culledSettingsBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_STATS_BINDING, m_statsBuffers[m_statsIndex]);
+
+	glDispatchCompute((GLuint)commandCount, 1, 1);
+
+	// the draws read the commands and the instance attributes
+	// the pass wrote, and the next pass reads the counters
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	m_statsFences[m_statsIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_statsIndex = (m_statsIndex + 1) % STATS_BUFFER_COUNT;
+
+	glUseProgram((GLuint)previousProgram);
+}
+
+/***********************************************************
+ *  BuildDepthPyramid()
+ *
+ *  This method is used for copying the depth buffer of the
+ *  bound framebuffer, once the opaque objects are drawn,
+ *  and reducing it into the pyramid.  Each texel keeps the
+ *  farthest depth of the texels it covers one level down,
+ *  so a box that is behind that depth everywhere it covers
+ *  is hidden.
+ ***********************************************************/
+void GpuCulling::BuildDepthPyramid(const glm::mat4& viewProjection, int width, int height)
+{
+	if ((0 == m_pyramidProgram) || (width < 2) || (height < 2))
+	{
+		return;
+	}
+
+	if ((width != m_depthWidth) || (height != m_depthHeight))
+	{
+		ResizeDepthPyramid(width, height);
+	}
+
+	glActiveTexture(GL_TEXTURE0 + DEPTH_PYRAMID_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(m_pyramidProgram);
+
+	int sourceWidth = width;
+	int sourceHeight = height;
+	for (int level = 0; level < m_pyramidLevels; ++level)
+	{
+		// level 0 reduces the depth copy, every later level
+		// the pyramid level before it
+		if (level > 0)
+		{
+			glBindTexture(GL_TEXTURE_2D, m_pyramidTexture);
+		}
+		glUniform1i(m_pyramidUniforms.sourceLevel, (level > 0) ? level - 1 : 0);
+		glUniform2i(m_pyramidUniforms.sourceSize, sourceWidth, sourceHeight);
+
+		int levelWidth = std::max(sourceWidth / 2, 1);
+		int levelHeight = std::max(sourceHeight / 2, 1);
+		glBindImageTexture(PYRAMID_IMAGE_UNIT, m_pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute(
+			(GLuint)((levelWidth + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE),
+			(GLuint)((levelHeight + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE),
+			1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		sourceWidth = levelWidth;
+		sourceHeight = levelHeight;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glUseProgram((GLuint)previousProgram);
+
+	m_pyramidViewProjection = viewProjection;
+	m_bPyramidValid = true;
+}
+
+/***********************************************************
+ *  ResizeDepthPyramid()
+ *
+ *  This method is used for recreating the depth copy and
+ *  the pyramid for a new framebuffer size.  Level 0 of the
+ *  pyramid is half the size, rounded down, and the last
+ *  level is a single texel.
+ ***********************************************************/
+void GpuCulling::ResizeDepthPyramid(int width, int height)
+{
+	if (0 != m_depthTexture) glDeleteTextures(1, &m_depthTexture);
+	if (0 != m_pyramidTexture) glDeleteTextures(1, &m_pyramidTexture);
+
+	m_depthWidth = width;
+	m_depthHeight = height;
+	m_bPyramidValid = false;
+
+	int levelWidth = std::max(width / 2, 1);
+	int levelHeight = std::max(height / 2, 1);
+	m_pyramidLevels = 1;
+	while ((levelWidth > 1) || (levelHeight > 1))
+	{
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+		m_pyramidLevels++;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + DEPTH_PYRAMID_TEXTURE_UNIT);
+
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+	glGenTextures(1, &m_pyramidTexture);
+	glBindTexture(GL_TEXTURE_2D, m_pyramidTexture);
+	glTexStorage2D(GL_TEXTURE_2D, m_pyramidLevels, GL_R32F, std::max(width / 2, 1), std::max(height / 2, 1));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  ReserveCulledBuffers()
+ *
+ *  This method is used for growing the buffers the pass
+ *  writes to hold every command and every instance.  Their
+ *  contents come from the pass, so nothing is uploaded.
+ ***********************************************************/
+void GpuCulling::ReserveCulledBuffers(int commandCount)
+{
+	if (commandCount > m_commandCapacity)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_culledCommandBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, commandCount * sizeof(MeshLibrary::DRAW_COMMAND), NULL, GL_DYNAMIC_COPY);
+		m_commandCapacity = commandCount;
+	}
+
+	int instanceCount = std::max((int)m_bounds.size() / 2, 1);
+	if (instanceCount > m_instanceCapacity)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_culledMatrixBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCount * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_culledSettingsBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCount * sizeof(MeshLibrary::INSTANCE_SETTINGS), NULL, GL_DYNAMIC_COPY);
+		m_instanceCapacity = instanceCount;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  UploadBounds()
+ *
+ *  This method is used for sending the bounds of the
+ *  instances that moved since the last pass.  The buffer
+ *  only grows, so a new scene of the same size does not
+ *  reallocate it.
+ ***********************************************************/
+void GpuCulling::UploadBounds()
+{
+	if (m_dirtyFirst > m_dirtyLast)
+	{
+		return;
+	}
+
+	int instanceCount = (int)m_bounds.size() / 2;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_boundsBuffer);
+	if (instanceCount > m_boundsCapacity)
+	{
+		glBufferData(GL_SHADER_STORAGE_BUFFER, m_bounds.size() * sizeof(glm::vec4), m_bounds.data(), GL_DYNAMIC_DRAW);
+		m_boundsCapacity = instanceCount;
+	}
+	else
+	{
+		glBufferSubData(
+			GL_SHADER_STORAGE_BUFFER,
+			m_dirtyFirst * 2 * sizeof(glm::vec4),
+			(m_dirtyLast - m_dirtyFirst + 1) * 2 * sizeof(glm::vec4),
+			&m_bounds[m_dirtyFirst * 2]);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_dirtyFirst = 0;
+	m_dirtyLast = -1;
+}
+
+/***********************************************************
+ *  CollectStats()
+ *
+ *  This method is used for reading the counters of the
+ *  passes whose fence has signaled, oldest first so the
+ *  newest wins, and clearing the buffer the next pass
+ *  writes.  The passes finish in order, so the first one
+ *  still running ends the search, and nothing is read that
+ *  the GPU has not written yet.  When the GPU is so far
+ *  behind that the next buffer is still pending, its
+ *  counters are dropped rather than waited for.
+ ***********************************************************/
+void GpuCulling::CollectStats()
+{
+	for (int i = 0; i < STATS_BUFFER_COUNT; ++i)
+	{
+		int buffer = (m_statsIndex + i) % STATS_BUFFER_COUNT;
+		GLsync fence = m_statsFences[buffer];
+		if (0 == fence)
+		{
+			continue;
+		}
+
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (GL_TIMEOUT_EXPIRED == result)
+		{
+			break;
+		}
+		if (GL_WAIT_FAILED != result)
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuffers[buffer]);
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(m_stats), &m_stats);
+		}
+		glDeleteSync(fence);
+		m_statsFences[buffer] = 0;
+	}
+
+	if (0 != m_statsFences[m_statsIndex])
+	{
+		glDeleteSync(m_statsFences[m_statsIndex]);
+		m_statsFences[m_statsIndex] = 0;
+	}
+
+	CULL_STATS zeroStats;
+	memset(&zeroStats, 0, sizeof(zeroStats));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_statsBuffers[m_statsIndex]);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zeroStats), &zeroStats);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  LoadComputeProgram()
+ *
+ *  This method is used for compiling a compute shader from
+ *  a GLSL file and linking it into a program of its own,
+ *  returning 0 and printing the log when either fails.
+ ***********************************************************/
+GLuint GpuCulling::LoadComputeProgram(const char* filePath)
+{
+	std::ifstream file(filePath);
+	if (file.is_open() == false)
+	{
+		std::cout << "Could not open compute shader " << filePath << std::endl;
+		return(0);
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	std::string source = stream.str();
+	const char* sourceText = source.c_str();
+
+	GLint status = GL_FALSE;
+	char log[1024] = { 0 };
+
+	GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shader, 1, &sourceText, NULL);
+	glCompileShader(shader);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		std::cout << "Compute shader " << filePath << " failed to compile:" << std::endl << log << std::endl;
+		glDeleteShader(shader);
+		return(0);
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		std::cout << "Compute shader " << filePath << " failed to link:" << std::endl << log << std::endl;
+		glDeleteProgram(program);
+		return(0);
+	}
+
+	return(program);
+}
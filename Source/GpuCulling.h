@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculling.h
+// ============
+// cull the scene instances on the GPU against the view frustum and a depth
+// pyramid of the previous frame, writing the surviving draws for the
+// multi-draw-indirect submission
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CullingBVH.h"
+#include "MeshLibrary.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  GpuCulling
+ *
+ *  This class runs a compute pass over the indirect draw
+ *  commands of a frame.  Each command's instances are
+ *  tested against the frustum planes and against a max
+ *  depth pyramid (Hi-Z) built from the opaque depth of the
+ *  previous frame.  The surviving instances are compacted,
+ *  in order, into culled copies of the instance matrix and
+ *  settings buffers, and each command's instance count is
+ *  rewritten to match, so the CPU never reads visibility
+ *  back.  The counts of the pass are written to a small
+ *  ring of buffers and read back for the profiler a few
+ *  frames late, once the fence after their pass signaled,
+ *  so reading them never waits on the GPU.
+ ***********************************************************/
+class GpuCulling
+{
+public:
+	// counters of the most recently finished pass
+	struct CULL_STATS
+	{
+		int visibleInstances;
+		int frustumCulled;
+		int occlusionCulled;
+		// triangles of the surviving instances
+		int triangles;
+	};
+
+	// instances that one compute work group tests at a time
+	static const int GROUP_SIZE = 64;
+	// passes whose counters can wait to be read back
+	static const int STATS_BUFFER_COUNT = 3;
+
+	// constructor
+	GpuCulling();
+	// destructor
+	~GpuCulling();
+
+	// check whether the driver has compute shaders and shader
+	// storage buffers
+	static bool IsSupported();
+	// compile the compute programs and create the buffers
+	bool Create();
+	// check whether Create() succeeded
+	bool IsCreated() const { return (0 != m_cullProgram) && (0 != m_pyramidProgram); }
+
+	// set the number of instances, forgetting their bounds
+	void SetInstanceCount(int count);
+	// set the world bounds of one instance, sent with the
+	// next pass
+	void SetInstanceBounds(int instance, const CullingBVH::AABB& bounds);
+	// turn the depth pyramid test on or off, leaving only the
+	// frustum test
+	void SetUseOcclusion(bool bUse) { m_bUseOcclusion = bUse; }
+
+	// cull the instances of the commands in the passed in
+	// buffers, for the passed in view-projection matrix
+	void Cull(const glm::mat4& viewProjection, GLuint sourceCommands, int commandCount, GLuint sourceMatrices, GLuint sourceSettings);
+	// copy the depth buffer of the bound framebuffer and
+	// reduce it into the pyramid the next pass tests against
+	void BuildDepthPyramid(const glm::mat4& viewProjection, int width, int height);
+	// forget the pyramid, so the next pass only tests the
+	// frustum until a new one is built
+	void InvalidateDepthPyramid() { m_bPyramidValid = false; }
+
+	// buffers the pass writes, laid out like their sources
+	GLuint CulledCommandBuffer() const { return m_culledCommandBuffer; }
+	GLuint CulledMatrixBuffer() const { return m_culledMatrixBuffer; }
+	GLuint CulledSettingsBuffer() const { return m_culledSettingsBuffer; }
+
+	// counters of the most recently finished pass
+	const CULL_STATS& Stats() const { return m_stats; }
+
+private:
+	// uniform locations of the culling program
+	struct CULL_UNIFORMS
+	{
+		GLint frustumPlanes;
+		GLint occlusionViewProjection;
+		GLint bUseOcclusion;
+		GLint depthPyramid;
+		GLint pyramidLevels;
+		GLint pyramidSize;
+		GLint viewportSize;
+	};
+
+	// uniform locations of the pyramid program
+	struct PYRAMID_UNIFORMS
+	{
+		GLint sourceDepth;
+		GLint sourceLevel;
+		GLint sourceSize;
+	};
+
+	GLuint m_cullProgram;
+	GLuint m_pyramidProgram;
+	CULL_UNIFORMS m_cullUniforms;
+	PYRAMID_UNIFORMS m_pyramidUniforms;
+
+	// world bounds of every instance as minimum and maximum
+	// pairs, with the range changed since the last upload
+	std::vector<glm::vec4> m_bounds;
+	int m_dirtyFirst;
+	int m_dirtyLast;
+	GLuint m_boundsBuffer;
+	int m_boundsCapacity;
+
+	// buffers written by the pass, with the entries they hold
+	GLuint m_culledCommandBuffer;
+	int m_commandCapacity;
+	GLuint m_culledMatrixBuffer;
+	GLuint m_culledSettingsBuffer;
+	int m_instanceCapacity;
+	// counters written by the last passes, the fence after
+	// each pass, 0 once read, and the buffer the next pass
+	// writes, which is the oldest one
+	GLuint m_statsBuffers[STATS_BUFFER_COUNT];
+	GLsync m_statsFences[STATS_BUFFER_COUNT];
+	int m_statsIndex;
+	// counters of the newest pass read back
+	CULL_STATS m_stats;
+
+	// copy of the depth buffer, and its max reduction with a
+	// level 0 of half the copy's size
+	GLuint m_depthTexture;
+	GLuint m_pyramidTexture;
+	int m_depthWidth;
+	int m_depthHeight;
+	int m_pyramidLevels;
+	// view-projection the depth was rendered with
+	glm::mat4 m_pyramidViewProjection;
+	bool m_bPyramidValid;
+	bool m_bUseOcclusion;
+
+	// recreate the depth copy and pyramid for a new size
+	void ResizeDepthPyramid(int width, int height);
+	// make the buffers written by the pass big enough
+	void ReserveCulledBuffers(int commandCount);
+	// send the bounds changed since the last pass
+	void UploadBounds();
+	// read the counters of the passes that finished and clear
+	// the buffer for the next one
+	void CollectStats();
+	// compile and link a compute shader from a GLSL file
+	static GLuint LoadComputeProgram(const char* filePath);
+};
@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+// heapcounter.cpp
+// ===============
+// This file contains the replacement of the global operator new and delete
+// and the implementation of the `HeapCounter` class, which reads what they
+// counted.
+//
+// RESPONSIBILITIES:
+// - Forward every new and delete of the program to malloc and free.
+// - Count the allocations and bytes of each thread and of the program.
+// - Hand the counts of a frame to the profiler and reset them.
+//
+// NOTE: The counters must work before main() and after the other globals
+// are gone, so they are plain atomics and thread_local integers that need
+// no construction, and the replacement never allocates itself.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HeapCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// declaration of the global variables and defines
+namespace
+{
+	// counts of every thread since they were last taken
+	std::atomic<int> g_ProgramAllocations(0);
+	std::atomic<long long> g_ProgramBytes(0);
+
+	// counts of the calling thread since it last took them
+	thread_local int t_threadAllocations = 0;
+	thread_local long long t_threadBytes = 0;
+
+	// count an allocation and take the memory for it, NULL when
+	// there is none
+	void* CountedAlloc(size_t size)
+	{
+		void* pMemory = malloc((0 != size) ? size : 1);
+		if (NULL != pMemory)
+		{
+			t_threadAllocations++;
+			t_threadBytes += (long long)size;
+			g_ProgramAllocations.fetch_add(1, std::memory_order_relaxed);
+			g_ProgramBytes.fetch_add((long long)size, std::memory_order_relaxed);
+		}
+		return(pMemory);
+	}
+
+	// give the memory of an allocation back
+	void CountedFree(void* pMemory)
+	{
+		free(pMemory);
+	}
+}
+
+/***********************************************************
+ *  operator new()
+ *
+ *  The replacements of the global allocation functions.
+ *  The throwing forms report a failed allocation with
+ *  std::bad_alloc as the standard ones do.
+ ***********************************************************/
+void* operator new(size_t size)
+{
+	void* pMemory = CountedAlloc(size);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+
+void* operator new[](size_t size)
+{
+	void* pMemory = CountedAlloc(size);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return(CountedAlloc(size));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return(CountedAlloc(size));
+}
+
+/***********************************************************
+ *  operator delete()
+ *
+ *  The replacements of the global deallocation functions.
+ ***********************************************************/
+void operator delete(void* pMemory) noexcept
+{
+	CountedFree(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	CountedFree(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	CountedFree(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+	CountedFree(pMemory);
+}
+
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+{
+	CountedFree(pMemory);
+}
+
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept
+{
+	CountedFree(pMemory);
+}
+
+/***********************************************************
+ *  TakeThreadCounts()
+ *
+ *  This method is used for getting the allocations the
+ *  calling thread made since it last called, and for
+ *  starting its counts again from zero.
+ ***********************************************************/
+void HeapCounter::TakeThreadCounts(HEAP_COUNTS& counts)
+{
+	counts.allocations = t_threadAllocations;
+	counts.bytes = t_threadBytes;
+	t_threadAllocations = 0;
+	t_threadBytes = 0;
+}
+
+/***********************************************************
+ *  TakeProgramCounts()
+ *
+ *  This method is used for getting the allocations every
+ *  thread made since the last call, and for starting the
+ *  program's counts again from zero.
+ ***********************************************************/
+void HeapCounter::TakeProgramCounts(HEAP_COUNTS& counts)
+{
+	counts.allocations = g_ProgramAllocations.exchange(0, std::memory_order_relaxed);
+	counts.bytes = g_ProgramBytes.exchange(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,39 @@
+///////////////////////////////////////////////////////////////////////////////
+// heapcounter.h
+// ============
+// count the heap allocations made through operator new, for the whole
+// program and for the thread asking, so that per-frame allocations show up
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+/***********************************************************
+ *  HeapCounter
+ *
+ *  This class reads the counters kept by the program's
+ *  replacement of the global operator new and delete, which
+ *  forward to malloc and free and count every allocation
+ *  and its size on the way.  The counters are kept for all
+ *  threads together and, separately, for each thread, so
+ *  the render thread can check its own frame without the
+ *  loader and simulation threads' work mixed in.  Memory
+ *  taken with malloc directly, by the C libraries and the
+ *  GL driver, is not seen.
+ ***********************************************************/
+class HeapCounter
+{
+public:
+	// allocations made since the counts were last taken
+	struct HEAP_COUNTS
+	{
+		int allocations;
+		long long bytes;
+	};
+
+	// get the calling thread's counts since its last call and
+	// start them again from zero
+	static void TakeThreadCounts(HEAP_COUNTS& counts);
+	// get every thread's counts since the last call and start
+	// them again from zero
+	static void TakeProgramCounts(HEAP_COUNTS& counts);
+};
@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////////////////////////////////
+// hotreload.cpp
+// =============
+// This file contains the implementation of the `HotReload` class, which
+// reloads the assets of the running scene when their files change.
+//
+// RESPONSIBILITIES:
+// - Watch the scene shaders, the texture images and their cooked files, and
+//   the scene file.
+// - Have the scene shader programs rebuilt without stalling the frame where
+//   the driver allows, the scene moves over to them between frames.
+// - Pass changed textures and scene files on to the scene manager.
+//
+// NOTE: Only the file that changed is reloaded.  Everything happens on the
+// GL thread at the start of a frame, so a frame is always drawn entirely
+// with the old asset or entirely with the new one.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HotReload.h"
+#include "SceneManager.h"
+#include "ShaderPermutations.h"
+
+#include <iostream>
+#include <vector>
+
+// Namespace for the reload settings
+namespace
+{
+	// how often the watched files are checked
+	const int WATCH_INTERVAL_MILLISECONDS = 250;
+}
+
+/***********************************************************
+ *  HotReload()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+HotReload::HotReload(ShaderPermutations* pShaderPermutations, SceneManager* pSceneManager)
+{
+	m_pShaderPermutations = pShaderPermutations;
+	m_pSceneManager = pSceneManager;
+}
+
+/***********************************************************
+ *  ~HotReload()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+HotReload::~HotReload()
+{
+	Stop();
+	m_pShaderPermutations = NULL;
+	m_pSceneManager = NULL;
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for watching the shader files of
+ *  the scene program and the scene's asset files.
+ ***********************************************************/
+void HotReload::Start(const char* vertexShaderPath, const char* fragmentShaderPath)
+{
+	m_vertexShaderPath = vertexShaderPath;
+	m_fragmentShaderPath = fragmentShaderPath;
+
+	m_watcher.Watch(m_vertexShaderPath);
+	m_watcher.Watch(m_fragmentShaderPath);
+	WatchSceneAssets();
+	m_watcher.Start(WATCH_INTERVAL_MILLISECONDS);
+
+	std::cout << "Hot reload is watching the shaders and scene assets"
+		<< (m_pShaderPermutations->IsParallelCompile() ? ", compiling shaders in the background" : "") << std::endl;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for reloading the files that were
+ *  reported as changed since the last frame.  A changed
+ *  shader starts a new rebuild, replacing one that is still
+ *  under way, and a rebuild under way is checked once per
+ *  frame.  The scene manager notices the new programs when
+ *  it next draws with them.
+ ***********************************************************/
+void HotReload::Update()
+{
+	bool bShaderChanged = false;
+	std::string filePath;
+
+	while (m_watcher.PopChanged(filePath))
+	{
+		if ((filePath == m_vertexShaderPath) || (filePath == m_fragmentShaderPath))
+		{
+			bShaderChanged = true;
+		}
+		else if (m_pSceneManager->ReloadAsset(filePath))
+		{
+			// a reloaded scene can bring new textures along
+			WatchSceneAssets();
+		}
+	}
+
+	if (bShaderChanged)
+	{
+		m_pShaderPermutations->BeginRebuild();
+	}
+	if (m_pShaderPermutations->IsRebuilding())
+	{
+		m_pShaderPermutations->FinishRebuild();
+	}
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for stopping the watcher thread.  A
+ *  rebuild that is still under way is left to the program
+ *  permutations, which drop it when they are destroyed.
+ ***********************************************************/
+void HotReload::Stop()
+{
+	m_watcher.Stop();
+}
+
+/***********************************************************
+ *  WatchSceneAssets()
+ *
+ *  This method is used for adding the files the scene was
+ *  loaded from to the watch list.  Files that are watched
+ *  already are skipped by the watcher.
+ ***********************************************************/
+void HotReload::WatchSceneAssets()
+{
+	std::vector<std::string> filePaths;
+	m_pSceneManager->GetAssetFiles(filePaths);
+	for (size_t i = 0; i < filePaths.size(); ++i)
+	{
+		m_watcher.Watch(filePaths[i]);
+	}
+}
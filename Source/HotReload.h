@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// hotreload.h
+// ============
+// pick up changes to the shaders, textures and scene file while the
+// application runs, swapping each reloaded asset in between two frames
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "FileWatcher.h"
+
+#include <string>
+
+class ShaderPermutations;
+class SceneManager;
+
+/***********************************************************
+ *  HotReload
+ *
+ *  This class watches the scene shader files and the asset
+ *  files of the prepared scene with a FileWatcher.  Update()
+ *  runs at the start of each frame and only reloads the
+ *  files reported as changed: an edited shader rebuilds the
+ *  program permutations in use, in the background when the
+ *  driver has KHR_parallel_shader_compile, and they take
+ *  over from the running programs in the first frame after
+ *  they all link; the texture and scene files are handed to
+ *  the scene manager.  A shader that fails to build leaves
+ *  the running programs in place and prints the log.
+ ***********************************************************/
+class HotReload
+{
+public:
+	// constructor
+	HotReload(ShaderPermutations* pShaderPermutations, SceneManager* pSceneManager);
+	// destructor
+	~HotReload();
+
+	// start watching the shader files of the scene program
+	// and the files the prepared scene was loaded from
+	void Start(const char* vertexShaderPath, const char* fragmentShaderPath);
+	// reload the files changed since the last frame, and swap
+	// in the rebuilt shader programs once they have linked
+	void Update();
+	// stop watching
+	void Stop();
+
+private:
+	ShaderPermutations* m_pShaderPermutations;
+	SceneManager* m_pSceneManager;
+	// checks the files on a thread of its own
+	FileWatcher m_watcher;
+	std::string m_vertexShaderPath;
+	std::string m_fragmentShaderPath;
+
+	// add the scene's asset files to the watch list
+	void WatchSceneAssets();
+};
@@ -0,0 +1,404 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.cpp
+// =============
+// This file contains the implementation of the `JobSystem` class, which
+// spreads loops over the scene's render items across the CPU cores.
+//
+// RESPONSIBILITIES:
+// - Start one worker per core and put them to sleep while there is no work.
+// - Split ParallelFor() ranges into jobs and balance them by work stealing.
+// - Count the jobs, steals, lock contention and busy time for the profiler.
+//
+// NOTE: A ParallelFor() that is not worth splitting, and every call when
+// there are no workers, runs the body on the caller without touching a
+// lock, so small scenes pay nothing for the job system.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+
+// declaration of the global variables and defines
+namespace
+{
+	// the system a worker thread belongs to, and its index
+	thread_local const JobSystem* t_pJobSystem = NULL;
+	thread_local int t_threadIndex = -1;
+
+	typedef std::chrono::steady_clock CLOCK;
+
+	// nanoseconds between two clock readings
+	long long ElapsedNanoseconds(CLOCK::time_point start, CLOCK::time_point end)
+	{
+		return(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	}
+}
+
+const int JobSystem::MAX_WORKERS;
+const int JobSystem::IDLE_SPINS;
+const int JobSystem::MAX_QUEUED_JOBS;
+
+/***********************************************************
+ *  JobSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+JobSystem::JobSystem() :
+	m_queuedJobs(0),
+	m_sleepingWorkers(0),
+	m_bStopping(false)
+{
+	m_parallelNanoseconds = 0;
+	m_bInParallelFor = false;
+}
+
+/***********************************************************
+ *  ~JobSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+JobSystem::~JobSystem()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for starting the workers.  The
+ *  calling thread becomes thread 0 and runs jobs alongside
+ *  them while it waits in ParallelFor().
+ ***********************************************************/
+void JobSystem::Create(int workerCount)
+{
+	Destroy();
+
+	if (workerCount < 0)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		workerCount = (int)std::max(cores, 1u) - 1;
+	}
+	workerCount = std::min(workerCount, MAX_WORKERS);
+
+	std::vector<THREAD_STATE> threads(workerCount + 1);
+	m_threads.swap(threads);
+	m_ownerThread = std::this_thread::get_id();
+	m_queuedJobs = 0;
+	m_sleepingWorkers = 0;
+	m_bStopping = false;
+	m_parallelNanoseconds = 0;
+
+	for (int i = 1; i <= workerCount; ++i)
+	{
+		m_workers.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+	}
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for waking and joining the workers.
+ *  No ParallelFor() may be running.
+ ***********************************************************/
+void JobSystem::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_workers.size(); ++i)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+	m_threads.clear();
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is used for running a loop body over a range
+ *  on every thread.  The whole range starts as one job on
+ *  the calling thread, which splits it as it runs, and the
+ *  caller then keeps running jobs - its own or stolen ones -
+ *  until every part of the range is done.
+ ***********************************************************/
+void JobSystem::ParallelFor(int count, int grainSize, const RANGE_FUNCTION& body)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	grainSize = std::max(grainSize, 1);
+	int threadIndex = CallingThreadIndex();
+	if ((m_workers.empty()) || (count <= grainSize) || (threadIndex < 0))
+	{
+		body(0, count, std::max(threadIndex, 0));
+		return;
+	}
+
+	// only the outermost call on the creating thread is timed,
+	// the nested ones run inside its time
+	bool bOutermost = (threadIndex == 0) && (m_bInParallelFor == false);
+	CLOCK::time_point start;
+	if (bOutermost)
+	{
+		m_bInParallelFor = true;
+		start = CLOCK::now();
+	}
+
+	std::atomic<int> pending(1);
+	JOB job;
+	job.pBody = &body;
+	job.begin = 0;
+	job.end = count;
+	job.grainSize = grainSize;
+	job.pPending = &pending;
+	RunJob(job, threadIndex);
+
+	while (pending.load(std::memory_order_acquire) > 0)
+	{
+		if (PopOrSteal(threadIndex, job))
+		{
+			RunJob(job, threadIndex);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	if (bOutermost)
+	{
+		m_parallelNanoseconds += ElapsedNanoseconds(start, CLOCK::now());
+		m_bInParallelFor = false;
+	}
+}
+
+/***********************************************************
+ *  TakeStats()
+ *
+ *  This method is used for adding up the counters of every
+ *  thread and starting them again from zero.  The
+ *  utilization compares the time spent in job bodies with
+ *  the time all threads could have spent in them while the
+ *  creating thread was inside ParallelFor().
+ ***********************************************************/
+void JobSystem::TakeStats(JOB_STATS& stats)
+{
+	long long busyNanoseconds = 0;
+
+	stats.jobsRun = 0;
+	stats.jobsStolen = 0;
+	stats.contendedLocks = 0;
+	for (size_t i = 0; i < m_threads.size(); ++i)
+	{
+		THREAD_STATE& state = m_threads[i];
+		stats.jobsRun += state.jobsRun.exchange(0, std::memory_order_relaxed);
+		stats.jobsStolen += state.jobsStolen.exchange(0, std::memory_order_relaxed);
+		stats.contendedLocks += state.contendedLocks.exchange(0, std::memory_order_relaxed);
+		busyNanoseconds += state.busyNanoseconds.exchange(0, std::memory_order_relaxed);
+	}
+
+	stats.utilization = 0.0f;
+	if (m_parallelNanoseconds > 0)
+	{
+		double available = (double)m_parallelNanoseconds * (double)m_threads.size();
+		stats.utilization = (float)std::min((double)busyNanoseconds / available, 1.0);
+	}
+	m_parallelNanoseconds = 0;
+}
+
+/***********************************************************
+ *  WorkerMain()
+ *
+ *  This method is used for running a worker - run jobs
+ *  while there are any, look again for a few rounds after
+ *  the last one, and then sleep until a job is pushed or
+ *  the system is destroyed.
+ ***********************************************************/
+void JobSystem::WorkerMain(int threadIndex)
+{
+	t_pJobSystem = this;
+	t_threadIndex = threadIndex;
+
+	int idleSpins = 0;
+	for (;;)
+	{
+		JOB job;
+		if (PopOrSteal(threadIndex, job))
+		{
+			RunJob(job, threadIndex);
+			idleSpins = 0;
+			continue;
+		}
+		if (m_bStopping)
+		{
+			break;
+		}
+		if (++idleSpins < IDLE_SPINS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// a pusher reads the sleeping count after adding its job,
+		// and this worker reads the job count after adding itself,
+		// so one of them always sees the other
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleepingWorkers++;
+		m_wake.wait(lock, [this]() { return (m_queuedJobs > 0) || m_bStopping; });
+		m_sleepingWorkers--;
+		idleSpins = 0;
+	}
+}
+
+/***********************************************************
+ *  RunJob()
+ *
+ *  This method is used for running one job.  While the job
+ *  is larger than its grain size, its upper half is pushed
+ *  as a job of its own, for this thread to come back to or
+ *  for another one to steal, so the first thief takes half
+ *  the range, the next a quarter, and so on.  When the
+ *  deque is full the job keeps what is left in one piece.
+ ***********************************************************/
+void JobSystem::RunJob(JOB job, int threadIndex)
+{
+	while (job.end - job.begin > job.grainSize)
+	{
+		JOB upperHalf = job;
+		upperHalf.begin = job.begin + (job.end - job.begin) / 2;
+
+		job.pPending->fetch_add(1, std::memory_order_relaxed);
+		if (Push(threadIndex, upperHalf) == false)
+		{
+			job.pPending->fetch_sub(1, std::memory_order_relaxed);
+			break;
+		}
+		job.end = upperHalf.begin;
+	}
+
+	THREAD_STATE& state = m_threads[threadIndex];
+	CLOCK::time_point start = CLOCK::now();
+	(*job.pBody)(job.begin, job.end, threadIndex);
+	state.busyNanoseconds.fetch_add(ElapsedNanoseconds(start, CLOCK::now()), std::memory_order_relaxed);
+	state.jobsRun.fetch_add(1, std::memory_order_relaxed);
+
+	job.pPending->fetch_sub(1, std::memory_order_release);
+}
+
+/***********************************************************
+ *  Push()
+ *
+ *  This method is used for adding a job to a thread's deque
+ *  and waking a sleeping worker to take it.
+ ***********************************************************/
+bool JobSystem::Push(int threadIndex, const JOB& job)
+{
+	THREAD_STATE& state = m_threads[threadIndex];
+	LockDeque(state, state);
+	if (state.jobCount == MAX_QUEUED_JOBS)
+	{
+		state.mutex.unlock();
+		return(false);
+	}
+	state.jobs[(state.firstJob + state.jobCount) % MAX_QUEUED_JOBS] = job;
+	state.jobCount++;
+	state.mutex.unlock();
+
+	m_queuedJobs++;
+	if (m_sleepingWorkers > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wake.notify_one();
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  PopOrSteal()
+ *
+ *  This method is used for finding a job to run.  The own
+ *  deque is taken from the back, last in first out, and
+ *  the other deques from the front, starting with the next
+ *  thread so that the thieves spread over their victims.
+ *  No deque is locked while no job is queued anywhere.
+ ***********************************************************/
+bool JobSystem::PopOrSteal(int threadIndex, JOB& job)
+{
+	if (m_queuedJobs <= 0)
+	{
+		return(false);
+	}
+
+	THREAD_STATE& own = m_threads[threadIndex];
+	LockDeque(own, own);
+	if (own.jobCount > 0)
+	{
+		own.jobCount--;
+		job = own.jobs[(own.firstJob + own.jobCount) % MAX_QUEUED_JOBS];
+		own.mutex.unlock();
+		m_queuedJobs--;
+		return(true);
+	}
+	own.mutex.unlock();
+
+	int threadCount = (int)m_threads.size();
+	for (int i = 1; i < threadCount; ++i)
+	{
+		THREAD_STATE& victim = m_threads[(threadIndex + i) % threadCount];
+		LockDeque(victim, own);
+		if (victim.jobCount > 0)
+		{
+			job = victim.jobs[victim.firstJob];
+			victim.firstJob = (victim.firstJob + 1) % MAX_QUEUED_JOBS;
+			victim.jobCount--;
+			victim.mutex.unlock();
+			m_queuedJobs--;
+			own.jobsStolen.fetch_add(1, std::memory_order_relaxed);
+			return(true);
+		}
+		victim.mutex.unlock();
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  CallingThreadIndex()
+ *
+ *  This method is used for telling which of the system's
+ *  threads is calling.
+ ***********************************************************/
+int JobSystem::CallingThreadIndex() const
+{
+	if (t_pJobSystem == this)
+	{
+		return(t_threadIndex);
+	}
+	if (std::this_thread::get_id() == m_ownerThread)
+	{
+		return(0);
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  LockDeque()
+ *
+ *  This method is used for locking a deque.  A lock that
+ *  cannot be taken at once is counted against the thread
+ *  that waits for it before it blocks.
+ ***********************************************************/
+void JobSystem::LockDeque(THREAD_STATE& state, THREAD_STATE& counter)
+{
+	if (state.mutex.try_lock() == false)
+	{
+		counter.contendedLocks.fetch_add(1, std::memory_order_relaxed);
+		state.mutex.lock();
+	}
+}
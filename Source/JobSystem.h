@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.h
+// ============
+// run loops over large ranges on a pool of worker threads that steal work
+// from each other, for building the frame's draw list on every core
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  JobSystem
+ *
+ *  This class keeps a deque of jobs for every thread that
+ *  runs them - the workers, and the thread that created the
+ *  system, which joins in while it waits.  ParallelFor()
+ *  hands out a range as one job; a job larger than its
+ *  grain size splits itself in half, keeps one half and
+ *  pushes the other onto the back of its thread's deque.
+ *  A thread takes its own newest job first, where the data
+ *  is still in its cache, and steals the oldest job - the
+ *  largest range - from another deque once its own is
+ *  empty.  The deques are rings of a fixed size, so queuing
+ *  a job never allocates; a job whose thread's ring is full
+ *  stops splitting and runs the rest of its range itself.
+ *  Workers without work spin for a moment and then
+ *  sleep until a job is pushed.  Each deque has its own
+ *  lock, so threads only meet when one steals; the steals,
+ *  the contended locks and the time spent in job bodies
+ *  are counted for the profiler.
+ ***********************************************************/
+class JobSystem
+{
+public:
+	// body of a ParallelFor, called for [begin, end) with the
+	// index of the thread running it, below ThreadCount()
+	typedef std::function<void(int begin, int end, int threadIndex)> RANGE_FUNCTION;
+
+	// work done since the last TakeStats()
+	struct JOB_STATS
+	{
+		// jobs whose body ran, and those run by a thief
+		int jobsRun;
+		int jobsStolen;
+		// deque locks that were held by another thread
+		int contendedLocks;
+		// share of the threads' time inside ParallelFor() that
+		// went to job bodies, 0 to 1
+		float utilization;
+	};
+
+	// most workers started, whatever the core count
+	static const int MAX_WORKERS = 63;
+	// times an idle worker looks for work before it sleeps
+	static const int IDLE_SPINS = 64;
+	// jobs a thread's deque holds
+	static const int MAX_QUEUED_JOBS = 256;
+
+	// constructor
+	JobSystem();
+	// destructor
+	~JobSystem();
+
+	// start the workers, one per core besides the calling thread
+	// for a negative count, none for 0 so everything runs on the
+	// calling thread
+	void Create(int workerCount);
+	// stop and join the workers
+	void Destroy();
+
+	// number of threads that run jobs, the creating thread
+	// being index 0
+	int ThreadCount() const { return (int)m_threads.size(); }
+
+	// call the body over [0, count) in ranges of at least
+	// grainSize items spread over the threads, and return when
+	// every range is done; a range that is not split runs on
+	// the calling thread, as does every call from a thread
+	// other than the creating one or a worker
+	void ParallelFor(int count, int grainSize, const RANGE_FUNCTION& body);
+
+	// get the counters since the last call and reset them
+	void TakeStats(JOB_STATS& stats);
+
+private:
+	// one range of a ParallelFor
+	struct JOB
+	{
+		const RANGE_FUNCTION* pBody;
+		int begin;
+		int end;
+		int grainSize;
+		// jobs of the ParallelFor that have not finished
+		std::atomic<int>* pPending;
+	};
+
+	// deque and counters of one thread, padded so that two
+	// threads' counters do not share a cache line; the deque
+	// is the jobCount jobs of the ring from firstJob on
+	struct THREAD_STATE
+	{
+		std::mutex mutex;
+		JOB jobs[MAX_QUEUED_JOBS];
+		int firstJob;
+		int jobCount;
+		std::atomic<int> jobsRun;
+		std::atomic<int> jobsStolen;
+		std::atomic<int> contendedLocks;
+		std::atomic<long long> busyNanoseconds;
+		char padding[64];
+
+		THREAD_STATE() : firstJob(0), jobCount(0), jobsRun(0), jobsStolen(0), contendedLocks(0), busyNanoseconds(0) {}
+	};
+
+	std::vector<THREAD_STATE> m_threads;
+	std::vector<std::thread> m_workers;
+	std::thread::id m_ownerThread;
+	// jobs waiting in any deque, and workers asleep until one is
+	// pushed
+	std::atomic<int> m_queuedJobs;
+	std::atomic<int> m_sleepingWorkers;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	std::atomic<bool> m_bStopping;
+	// time the creating thread spent in outermost ParallelFor()
+	// calls, and whether it is inside one
+	long long m_parallelNanoseconds;
+	bool m_bInParallelFor;
+
+	// worker thread loop
+	void WorkerMain(int threadIndex);
+	// split a job down to its grain size, pushing the split off
+	// halves, then run what is left
+	void RunJob(JOB job, int threadIndex);
+	// add a job to the back of a thread's deque, false when it
+	// is full
+	bool Push(int threadIndex, const JOB& job);
+	// take the newest job of a thread's deque or, when it is
+	// empty, the oldest job of another one
+	bool PopOrSteal(int threadIndex, JOB& job);
+	// index of the calling thread, -1 for a thread that does
+	// not belong to this system
+	int CallingThreadIndex() const;
+	// lock a deque, counting the times it was already held
+	static void LockDeque(THREAD_STATE& state, THREAD_STATE& counter);
+};
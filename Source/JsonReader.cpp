@@ -0,0 +1,342 @@
+///////////////////////////////////////////////////////////////////////////////
+// jsonreader.cpp
+// ==============
+// This file contains the implementation of the `JsonParser` class, which
+// reads the JSON documents of the offline tools.
+//
+// RESPONSIBILITIES:
+// - Parse objects, arrays, strings, numbers, booleans and null.
+// - Report the first syntax error with the line it was found on.
+//
+// NOTE: The whole document is kept as a tree of values, which suits the
+// small scene descriptions and benchmark reports it is used for.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JsonReader.h"
+
+#include <cstdlib>
+#include <cstring>
+
+/***********************************************************
+ *  Member()
+ *
+ *  This method is used for finding an object member by its
+ *  name.
+ ***********************************************************/
+const JSON_VALUE* JSON_VALUE::Member(const char* key) const
+{
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		if (keys[i] == key)
+		{
+			return(&items[i]);
+		}
+	}
+	return(NULL);
+}
+
+/***********************************************************
+ *  JsonParser()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+JsonParser::JsonParser(const std::string& text)
+	: m_text(text), m_position(0), m_line(1)
+{
+}
+
+/***********************************************************
+ *  Parse()
+ *
+ *  This method is used for parsing the whole document,
+ *  which must hold a single value with nothing but white
+ *  space after it.
+ ***********************************************************/
+bool JsonParser::Parse(JSON_VALUE& value)
+{
+	if (ParseValue(value) == false)
+	{
+		return(false);
+	}
+	SkipSpace();
+	if (m_position < m_text.size())
+	{
+		return(Fail("unexpected text after the document"));
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Fail()
+ *
+ *  This method is used for keeping the description of the
+ *  first error.
+ ***********************************************************/
+bool JsonParser::Fail(const char* message)
+{
+	m_error = message;
+	return(false);
+}
+
+/***********************************************************
+ *  SkipSpace()
+ *
+ *  This method is used for skipping white space and
+ *  counting the lines it passes.
+ ***********************************************************/
+void JsonParser::SkipSpace()
+{
+	while (m_position < m_text.size())
+	{
+		char c = m_text[m_position];
+		if (c == '\n')
+		{
+			m_line++;
+		}
+		else if ((c != ' ') && (c != '\t') && (c != '\r'))
+		{
+			break;
+		}
+		m_position++;
+	}
+}
+
+/***********************************************************
+ *  Match()
+ *
+ *  This method is used for consuming a word when the text
+ *  continues with it.
+ ***********************************************************/
+bool JsonParser::Match(const char* word)
+{
+	size_t length = strlen(word);
+	if (m_text.compare(m_position, length, word) != 0)
+	{
+		return(false);
+	}
+	m_position += length;
+	return(true);
+}
+
+/***********************************************************
+ *  ParseValue()
+ *
+ *  This method is used for parsing a value of any type,
+ *  chosen by its first character.
+ ***********************************************************/
+bool JsonParser::ParseValue(JSON_VALUE& value)
+{
+	SkipSpace();
+	value.type = JSON_VALUE::JSON_NULL;
+	value.bValue = false;
+	value.number = 0.0;
+	value.line = m_line;
+
+	if (m_position >= m_text.size())
+	{
+		return(Fail("unexpected end of the file"));
+	}
+
+	char c = m_text[m_position];
+	if (c == '{')
+	{
+		return(ParseObject(value));
+	}
+	if (c == '[')
+	{
+		return(ParseArray(value));
+	}
+	if (c == '"')
+	{
+		value.type = JSON_VALUE::JSON_STRING;
+		return(ParseString(value.text));
+	}
+	if (Match("true") || Match("false"))
+	{
+		value.type = JSON_VALUE::JSON_BOOL;
+		value.bValue = (c == 't');
+		return(true);
+	}
+	if (Match("null"))
+	{
+		return(true);
+	}
+
+	const char* pStart = m_text.c_str() + m_position;
+	char* pEnd = NULL;
+	value.number = strtod(pStart, &pEnd);
+	if ((pEnd == pStart) || ((c != '-') && ((c < '0') || (c > '9'))))
+	{
+		return(Fail("expected a value"));
+	}
+	value.type = JSON_VALUE::JSON_NUMBER;
+	m_position += (size_t)(pEnd - pStart);
+	return(true);
+}
+
+/***********************************************************
+ *  ParseObject()
+ *
+ *  This method is used for parsing an object, keeping its
+ *  member names and values in order.
+ ***********************************************************/
+bool JsonParser::ParseObject(JSON_VALUE& value)
+{
+	value.type = JSON_VALUE::JSON_OBJECT;
+	m_position++;
+	SkipSpace();
+	if (Match("}"))
+	{
+		return(true);
+	}
+
+	for (;;)
+	{
+		SkipSpace();
+		std::string key;
+		if ((m_position >= m_text.size()) || (m_text[m_position] != '"'))
+		{
+			return(Fail("expected a member name"));
+		}
+		if (ParseString(key) == false)
+		{
+			return(false);
+		}
+		SkipSpace();
+		if (Match(":") == false)
+		{
+			return(Fail("expected ':' after a member name"));
+		}
+
+		value.keys.push_back(key);
+		value.items.push_back(JSON_VALUE());
+		if (ParseValue(value.items.back()) == false)
+		{
+			return(false);
+		}
+
+		SkipSpace();
+		if (Match("}"))
+		{
+			return(true);
+		}
+		if (Match(",") == false)
+		{
+			return(Fail("expected ',' or '}' in an object"));
+		}
+	}
+}
+
+/***********************************************************
+ *  ParseArray()
+ *
+ *  This method is used for parsing the elements of an
+ *  array.
+ ***********************************************************/
+bool JsonParser::ParseArray(JSON_VALUE& value)
+{
+	value.type = JSON_VALUE::JSON_ARRAY;
+	m_position++;
+	SkipSpace();
+	if (Match("]"))
+	{
+		return(true);
+	}
+
+	for (;;)
+	{
+		value.items.push_back(JSON_VALUE());
+		if (ParseValue(value.items.back()) == false)
+		{
+			return(false);
+		}
+
+		SkipSpace();
+		if (Match("]"))
+		{
+			return(true);
+		}
+		if (Match(",") == false)
+		{
+			return(Fail("expected ',' or ']' in an array"));
+		}
+	}
+}
+
+/***********************************************************
+ *  ParseString()
+ *
+ *  This method is used for parsing a string with its
+ *  escapes, code points of the basic plane being written
+ *  as UTF-8.
+ ***********************************************************/
+bool JsonParser::ParseString(std::string& output)
+{
+	output.clear();
+	m_position++;
+
+	while (m_position < m_text.size())
+	{
+		char c = m_text[m_position++];
+		if (c == '"')
+		{
+			return(true);
+		}
+		if (c == '\n')
+		{
+			return(Fail("line break inside a string"));
+		}
+		if (c != '\\')
+		{
+			output += c;
+			continue;
+		}
+
+		if (m_position >= m_text.size())
+		{
+			break;
+		}
+		char escape = m_text[m_position++];
+		switch (escape)
+		{
+		case '"': output += '"'; break;
+		case '\\': output += '\\'; break;
+		case '/': output += '/'; break;
+		case 'b': output += '\b'; break;
+		case 'f': output += '\f'; break;
+		case 'n': output += '\n'; break;
+		case 'r': output += '\r'; break;
+		case 't': output += '\t'; break;
+		case 'u':
+		{
+			if (m_position + 4 > m_text.size())
+			{
+				return(Fail("incomplete \\u escape"));
+			}
+			unsigned long code = strtoul(m_text.substr(m_position, 4).c_str(), NULL, 16);
+			m_position += 4;
+			// code points of the basic plane as UTF-8
+			if (code < 0x80)
+			{
+				output += (char)code;
+			}
+			else if (code < 0x800)
+			{
+				output += (char)(0xC0 | (code >> 6));
+				output += (char)(0x80 | (code & 0x3F));
+			}
+			else
+			{
+				output += (char)(0xE0 | (code >> 12));
+				output += (char)(0x80 | ((code >> 6) & 0x3F));
+				output += (char)(0x80 | (code & 0x3F));
+			}
+			break;
+		}
+		default:
+			return(Fail("unknown escape in a string"));
+		}
+	}
+
+	return(Fail("string is not closed"));
+}
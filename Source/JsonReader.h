@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// jsonreader.h
+// ============
+// read a JSON document into a tree of values, for the scene cooker and for
+// comparing benchmark reports between builds
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// one parsed JSON value
+struct JSON_VALUE
+{
+	enum TYPE
+	{
+		JSON_NULL,
+		JSON_BOOL,
+		JSON_NUMBER,
+		JSON_STRING,
+		JSON_ARRAY,
+		JSON_OBJECT
+	};
+
+	TYPE type;
+	bool bValue;
+	double number;
+	std::string text;
+	// array elements, or object member values
+	std::vector<JSON_VALUE> items;
+	// object member names, parallel to items
+	std::vector<std::string> keys;
+	// source line the value starts on
+	int line;
+
+	// get an object member, or NULL when it is missing
+	const JSON_VALUE* Member(const char* key) const;
+};
+
+/***********************************************************
+ *  JsonParser
+ *
+ *  This class reads a whole JSON document into a tree of
+ *  JSON_VALUE, stopping at the first syntax error.  It is a
+ *  small recursive descent parser for the offline tools -
+ *  the cooker and the benchmark report - and is not used
+ *  while the scene is drawn.
+ ***********************************************************/
+class JsonParser
+{
+public:
+	// parse the passed in text, which must outlive the parser
+	explicit JsonParser(const std::string& text);
+
+	// parse the document, which must hold one value
+	bool Parse(JSON_VALUE& value);
+
+	// description and line of the syntax error
+	const std::string& Error() const { return m_error; }
+	int Line() const { return m_line; }
+
+private:
+	const std::string& m_text;
+	size_t m_position;
+	int m_line;
+	std::string m_error;
+
+	// keep the error and return false
+	bool Fail(const char* message);
+	// skip white space, counting the lines
+	void SkipSpace();
+	// consume the passed in word when the text continues with it
+	bool Match(const char* word);
+
+	// parse one value of any type, and the compound ones
+	bool ParseValue(JSON_VALUE& value);
+	bool ParseObject(JSON_VALUE& value);
+	bool ParseArray(JSON_VALUE& value);
+	bool ParseString(std::string& output);
+};
@@ -0,0 +1,420 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.cpp
+// =================
+// This file contains the implementation of the `LightClusters` class, which
+// culls the point lights into the clusters of the view frustum.
+//
+// RESPONSIBILITIES:
+// - Build view-space bounds for every screen tile and depth slice.
+// - Test the light spheres against the clusters they can overlap.
+// - Pack the per-cluster light lists into buffer textures for shading.
+//
+// NOTE: Depth slices are spaced exponentially between the near and far
+// planes, so that clusters close to the camera stay small.  The fragment
+// shader finds its slice with the same formula, using the scale and bias
+// that WriteFrameData() puts into the FrameData block.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightClusters.h"
+#include "ShaderBlocks.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// declaration of the global variables and defines
+namespace
+{
+	// a light is cut off once it adds less than one color step
+	const float LIGHT_CUTOFF = 1.0f / 256.0f;
+}
+
+/***********************************************************
+ *  LightClusters()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightClusters::LightClusters()
+{
+	m_grid.tilesX = 0;
+	m_grid.tilesY = 0;
+	m_grid.depthSlices = 0;
+	m_grid.tileSize = 0;
+	m_projection = glm::mat4(0.0f);
+	m_nearPlane = 0.0f;
+	m_farPlane = 0.0f;
+	m_rangeBuffer = 0;
+	m_rangeTexture = 0;
+	m_indexBuffer = 0;
+	m_indexTexture = 0;
+}
+
+/***********************************************************
+ *  ~LightClusters()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightClusters::~LightClusters()
+{
+	if (0 != m_rangeTexture) glDeleteTextures(1, &m_rangeTexture);
+	if (0 != m_indexTexture) glDeleteTextures(1, &m_indexTexture);
+	if (0 != m_rangeBuffer) glDeleteBuffers(1, &m_rangeBuffer);
+	if (0 != m_indexBuffer) glDeleteBuffers(1, &m_indexBuffer);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the two buffer textures.
+ *  The ranges hold an offset and a count per cluster, and
+ *  the index list holds one point light index per entry.
+ ***********************************************************/
+bool LightClusters::Create()
+{
+	glGenBuffers(1, &m_rangeBuffer);
+	glGenBuffers(1, &m_indexBuffer);
+	glGenTextures(1, &m_rangeTexture);
+	glGenTextures(1, &m_indexTexture);
+
+	if ((0 == m_rangeBuffer) || (0 == m_indexBuffer) ||
+		(0 == m_rangeTexture) || (0 == m_indexTexture))
+	{
+		return(false);
+	}
+
+	// make sure both buffers have storage before the first frame
+	Upload();
+
+	glBindTexture(GL_TEXTURE_BUFFER, m_rangeTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_rangeBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, m_indexTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_indexBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  LightRadius()
+ *
+ *  This method is used for finding the distance at which
+ *  the attenuation of a point light brings its brightest
+ *  color channel below the cutoff.  Lights without distance
+ *  falloff reach every cluster.
+ ***********************************************************/
+float LightClusters::LightRadius(const POINT_LIGHT_STD140& light)
+{
+	glm::vec3 total = light.ambient + light.diffuse + light.specular;
+	float brightest = std::max(total.r, std::max(total.g, total.b));
+	if (brightest <= 0.0f)
+	{
+		return(0.0f);
+	}
+
+	// the attenuation denominator at which the light fades out
+	float limit = brightest / LIGHT_CUTOFF;
+	if (light.constant >= limit)
+	{
+		return(0.0f);
+	}
+
+	if (light.quadratic > 0.0f)
+	{
+		float b = light.linear;
+		float discriminant = (b * b) + (4.0f * light.quadratic * (limit - light.constant));
+		return((-b + std::sqrt(discriminant)) / (2.0f * light.quadratic));
+	}
+	if (light.linear > 0.0f)
+	{
+		return((limit - light.constant) / light.linear);
+	}
+
+	return(FLT_MAX);
+}
+
+/***********************************************************
+ *  SliceDepth()
+ *
+ *  This method is used for getting the view-space depth at
+ *  which a depth slice begins.
+ ***********************************************************/
+float LightClusters::SliceDepth(int slice) const
+{
+	float fraction = (float)slice / (float)m_grid.depthSlices;
+	return(m_nearPlane * std::pow(m_farPlane / m_nearPlane, fraction));
+}
+
+/***********************************************************
+ *  FindSlice()
+ *
+ *  This method is used for getting the depth slice of a
+ *  view-space depth, clamped to the grid.
+ ***********************************************************/
+int LightClusters::FindSlice(float depth) const
+{
+	if (depth <= m_nearPlane)
+	{
+		return(0);
+	}
+	if (depth >= m_farPlane)
+	{
+		return(m_grid.depthSlices - 1);
+	}
+
+	float scale = (float)m_grid.depthSlices / std::log(m_farPlane / m_nearPlane);
+	int slice = (int)(std::log(depth / m_nearPlane) * scale);
+	return(std::min(slice, m_grid.depthSlices - 1));
+}
+
+/***********************************************************
+ *  BuildClusterBounds()
+ *
+ *  This method is used for computing the view-space box
+ *  around every cluster.  The tile corners are unprojected
+ *  onto the near and far planes, and each corner ray is cut
+ *  at the two depths of the slice.  This works for both the
+ *  perspective and the orthographic projection.  The bounds
+ *  are only rebuilt when the grid or projection changes.
+ ***********************************************************/
+void LightClusters::BuildClusterBounds(const ViewManager::VIEW_STATE& viewState)
+{
+	const ViewManager::CLUSTER_GRID& grid = viewState.clusterGrid;
+	bool bSameGrid = (grid.tilesX == m_grid.tilesX) &&
+		(grid.tilesY == m_grid.tilesY) &&
+		(grid.depthSlices == m_grid.depthSlices) &&
+		(grid.tileSize == m_grid.tileSize);
+	if (bSameGrid &&
+		(viewState.projection == m_projection) &&
+		(viewState.nearPlane == m_nearPlane) &&
+		(viewState.farPlane == m_farPlane))
+	{
+		return;
+	}
+
+	m_grid = grid;
+	m_projection = viewState.projection;
+	m_nearPlane = viewState.nearPlane;
+	m_farPlane = viewState.farPlane;
+
+	int clusterCount = m_grid.tilesX * m_grid.tilesY * m_grid.depthSlices;
+	m_clusterBounds.resize(clusterCount);
+	m_clusterRanges.resize(clusterCount * 2);
+
+	glm::mat4 inverseProjection = glm::inverse(m_projection);
+	float tileWidth = 2.0f * (float)m_grid.tileSize / (float)viewState.viewportWidth;
+	float tileHeight = 2.0f * (float)m_grid.tileSize / (float)viewState.viewportHeight;
+
+	for (int y = 0; y < m_grid.tilesY; ++y)
+	{
+		for (int x = 0; x < m_grid.tilesX; ++x)
+		{
+			// corner rays of the tile, from the near to the far plane
+			glm::vec3 nearCorners[4];
+			glm::vec3 farCorners[4];
+			for (int corner = 0; corner < 4; ++corner)
+			{
+				float ndcX = -1.0f + tileWidth * (float)(x + (corner & 1));
+				float ndcY = -1.0f + tileHeight * (float)(y + (corner >> 1));
+				ndcX = std::min(ndcX, 1.0f);
+				ndcY = std::min(ndcY, 1.0f);
+
+				glm::vec4 nearPoint = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+				glm::vec4 farPoint = inverseProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+				nearCorners[corner] = glm::vec3(nearPoint) / nearPoint.w;
+				farCorners[corner] = glm::vec3(farPoint) / farPoint.w;
+			}
+
+			for (int slice = 0; slice < m_grid.depthSlices; ++slice)
+			{
+				float depths[2] = { SliceDepth(slice), SliceDepth(slice + 1) };
+				CLUSTER_BOUNDS bounds;
+				bounds.minimum = glm::vec3(FLT_MAX);
+				bounds.maximum = glm::vec3(-FLT_MAX);
+
+				for (int corner = 0; corner < 4; ++corner)
+				{
+					glm::vec3 direction = farCorners[corner] - nearCorners[corner];
+					for (int side = 0; side < 2; ++side)
+					{
+						float t = (-depths[side] - nearCorners[corner].z) / direction.z;
+						glm::vec3 point = nearCorners[corner] + (direction * t);
+						bounds.minimum = glm::min(bounds.minimum, point);
+						bounds.maximum = glm::max(bounds.maximum, point);
+					}
+				}
+
+				int cluster = x + m_grid.tilesX * (y + m_grid.tilesY * slice);
+				m_clusterBounds[cluster] = bounds;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for assigning every active point
+ *  light to the clusters its sphere overlaps.  Only the
+ *  depth slices between the near and far side of a sphere
+ *  are tested.  The pairs are then counting sorted into
+ *  one index list with an offset and count per cluster.
+ ***********************************************************/
+void LightClusters::Build(const ViewManager::VIEW_STATE& viewState, const LightManager& lights)
+{
+	if ((viewState.viewportWidth <= 0) || (viewState.viewportHeight <= 0) ||
+		(viewState.clusterGrid.depthSlices <= 0))
+	{
+		return;
+	}
+
+	BuildClusterBounds(viewState);
+
+	m_pairs.clear();
+	int tileCount = m_grid.tilesX * m_grid.tilesY;
+
+	for (int index = 0; index < lights.PointLightCount(); ++index)
+	{
+		const POINT_LIGHT_STD140& light = lights.PointLight(index);
+		if (0 == light.bActive)
+		{
+			continue;
+		}
+
+		float radius = LightRadius(light);
+		if (radius <= 0.0f)
+		{
+			continue;
+		}
+
+		glm::vec3 center = glm::vec3(viewState.view * glm::vec4(light.position, 1.0f));
+		float nearDepth = -center.z - radius;
+		float farDepth = -center.z + radius;
+		if ((farDepth < m_nearPlane) || (nearDepth > m_farPlane))
+		{
+			continue;
+		}
+
+		float radiusSquared = (radius < FLT_MAX) ? radius * radius : FLT_MAX;
+		int firstSlice = FindSlice(nearDepth);
+		int lastSlice = FindSlice(farDepth);
+
+		for (int slice = firstSlice; slice <= lastSlice; ++slice)
+		{
+			for (int tile = 0; tile < tileCount; ++tile)
+			{
+				int cluster = tile + (tileCount * slice);
+				const CLUSTER_BOUNDS& bounds = m_clusterBounds[cluster];
+
+				// distance from the sphere to the closest box point
+				glm::vec3 closest = glm::clamp(center, bounds.minimum, bounds.maximum);
+				glm::vec3 offset = center - closest;
+				if (glm::dot(offset, offset) <= radiusSquared)
+				{
+					CLUSTER_LIGHT pair;
+					pair.cluster = cluster;
+					pair.light = index;
+					m_pairs.push_back(pair);
+				}
+			}
+		}
+	}
+
+	// count the lights of each cluster, then turn the counts
+	// into offsets and fill the list in cluster order
+	std::fill(m_clusterRanges.begin(), m_clusterRanges.end(), 0);
+	for (size_t i = 0; i < m_pairs.size(); ++i)
+	{
+		m_clusterRanges[(m_pairs[i].cluster * 2) + 1]++;
+	}
+
+	GLuint offset = 0;
+	for (size_t cluster = 0; cluster < m_clusterBounds.size(); ++cluster)
+	{
+		m_clusterRanges[cluster * 2] = offset;
+		offset += m_clusterRanges[(cluster * 2) + 1];
+		m_clusterRanges[(cluster * 2) + 1] = 0;
+	}
+
+	m_lightIndices.resize(m_pairs.size());
+	for (size_t i = 0; i < m_pairs.size(); ++i)
+	{
+		GLuint* range = &m_clusterRanges[m_pairs[i].cluster * 2];
+		m_lightIndices[range[0] + range[1]] = (GLuint)m_pairs[i].light;
+		range[1]++;
+	}
+
+	Upload();
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for sending the cluster ranges and
+ *  the light index list to their buffers.  The buffers are
+ *  re-specified each frame so the driver does not need to
+ *  wait for the previous frame to finish reading them.
+ ***********************************************************/
+void LightClusters::Upload()
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, m_rangeBuffer);
+	glBufferData(
+		GL_TEXTURE_BUFFER,
+		std::max<size_t>(m_clusterRanges.size(), 2) * sizeof(GLuint),
+		m_clusterRanges.empty() ? NULL : m_clusterRanges.data(),
+		GL_STREAM_DRAW);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+	glBufferData(
+		GL_TEXTURE_BUFFER,
+		std::max<size_t>(m_lightIndices.size(), 1) * sizeof(GLuint),
+		m_lightIndices.empty() ? NULL : m_lightIndices.data(),
+		GL_STREAM_DRAW);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  BindTextures()
+ *
+ *  This method is used for binding the two buffer textures
+ *  to the texture units reserved for them.
+ ***********************************************************/
+void LightClusters::BindTextures() const
+{
+	glActiveTexture(GL_TEXTURE0 + CLUSTER_RANGE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_rangeTexture);
+	glActiveTexture(GL_TEXTURE0 + CLUSTER_INDEX_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, m_indexTexture);
+	glActiveTexture(GL_TEXTURE0);
+	Profiler::CountTextureBind();
+	Profiler::CountTextureBind();
+}
+
+/***********************************************************
+ *  WriteFrameData()
+ *
+ *  This method is used for copying the grid size and the
+ *  depth slice scale and bias into the frame data.  A grid
+ *  with no tiles tells the shader to shade every light.
+ ***********************************************************/
+void LightClusters::WriteFrameData(FRAME_DATA_STD140& frameData, bool bEnabled) const
+{
+	if ((bEnabled == false) || m_clusterBounds.empty())
+	{
+		frameData.clusterDimensions = glm::ivec4(0);
+		frameData.clusterDepth = glm::vec4(0.0f);
+		return;
+	}
+
+	float logRatio = std::log(m_farPlane / m_nearPlane);
+	float scale = (float)m_grid.depthSlices / logRatio;
+	float bias = (float)m_grid.depthSlices * std::log(m_nearPlane) / logRatio;
+
+	frameData.clusterDimensions = glm::ivec4(
+		m_grid.tilesX,
+		m_grid.tilesY,
+		m_grid.depthSlices,
+		m_grid.tileSize);
+	frameData.clusterDepth = glm::vec4(m_nearPlane, m_farPlane, scale, bias);
+}
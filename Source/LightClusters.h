@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.h
+// ============
+// split the view frustum into screen tile by depth slice clusters and list
+// the point lights that reach each cluster for clustered forward shading
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "LightManager.h"
+#include "ViewManager.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  LightClusters
+ *
+ *  This class assigns point lights to the clusters of the
+ *  view frustum on the CPU.  Every cluster gets an offset
+ *  and a count into one shared light index list.  Both are
+ *  read by the fragment shader through buffer textures, so
+ *  each fragment only shades the lights that can reach it.
+ ***********************************************************/
+class LightClusters
+{
+public:
+	// constructor
+	LightClusters();
+	// destructor
+	~LightClusters();
+
+	// create the buffer textures read by the fragment shader
+	bool Create();
+
+	// assign the lights to the clusters of the passed in view
+	void Build(const ViewManager::VIEW_STATE& viewState, const LightManager& lights);
+	// bind the buffer textures to their texture units
+	void BindTextures() const;
+	// copy the grid layout into the frame data, or turn it off
+	void WriteFrameData(FRAME_DATA_STD140& frameData, bool bEnabled) const;
+
+	// number of clusters in the current grid
+	int ClusterCount() const { return (int)m_clusterBounds.size(); }
+	// total entries in the light index list
+	int LightIndexCount() const { return (int)m_lightIndices.size(); }
+
+	// view-space distance at which a point light fades out
+	static float LightRadius(const POINT_LIGHT_STD140& light);
+
+private:
+	// view-space bounding box of one cluster
+	struct CLUSTER_BOUNDS
+	{
+		glm::vec3 minimum;
+		glm::vec3 maximum;
+	};
+
+	// one cluster and a light that reaches it
+	struct CLUSTER_LIGHT
+	{
+		int cluster;
+		int light;
+	};
+
+	// grid and projection the bounds were built for
+	ViewManager::CLUSTER_GRID m_grid;
+	glm::mat4 m_projection;
+	float m_nearPlane;
+	float m_farPlane;
+	// view-space bounds of every cluster
+	std::vector<CLUSTER_BOUNDS> m_clusterBounds;
+	// offset and count into the light index list, per cluster
+	std::vector<GLuint> m_clusterRanges;
+	// light indices of all clusters, back to back
+	std::vector<GLuint> m_lightIndices;
+	// cluster and light pairs gathered while culling
+	std::vector<CLUSTER_LIGHT> m_pairs;
+	// buffer textures holding the ranges and the index list
+	GLuint m_rangeBuffer;
+	GLuint m_rangeTexture;
+	GLuint m_indexBuffer;
+	GLuint m_indexTexture;
+
+	// rebuild the cluster bounds after the grid or projection changed
+	void BuildClusterBounds(const ViewManager::VIEW_STATE& viewState);
+	// view-space depth of the near side of a depth slice
+	float SliceDepth(int slice) const;
+	// depth slice that contains a view-space depth
+	int FindSlice(float depth) const;
+	// send the ranges and the index list to the GPU
+	void Upload();
+};
@@ -0,0 +1,263 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmanager.cpp
+// ================
+// This file contains the implementation of the `LightManager` class, which
+// keeps the lights of the scene and updates their GPU copies incrementally.
+//
+// RESPONSIBILITIES:
+// - Store the directional light and a runtime sized point light list.
+// - Track which point lights changed since the last upload.
+// - Send only the changed range of point lights to the GPU.
+//
+// NOTE: The point light list is limited by MAX_POINT_LIGHTS, which keeps
+// the PointLightData block within the 16KB uniform block size that every
+// OpenGL 3.3 implementation supports.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightManager.h"
+
+#include <algorithm>
+#include <iostream>
+
+/***********************************************************
+ *  LightManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightManager::LightManager()
+{
+	m_directionalLight = DIRECTIONAL_LIGHT_STD140();
+	m_dirtyFirst = 0;
+	m_dirtyLast = -1;
+	m_lastUploadCount = 0;
+	// the list never holds more than the block, so its storage
+	// is taken once and adding a light never reallocates it
+	m_pointLights.reserve(MAX_POINT_LIGHTS);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for allocating the point light block
+ *  at its binding point.  Lights that were added before this
+ *  call are sent at the next upload.
+ ***********************************************************/
+bool LightManager::Create()
+{
+	bool bReturn = m_pointLightBlock.Create(
+		sizeof(POINT_LIGHT_STD140) * MAX_POINT_LIGHTS,
+		POINT_LIGHT_BLOCK_BINDING);
+
+	if (m_pointLights.size() > 0)
+	{
+		m_dirtyFirst = 0;
+		m_dirtyLast = (int)m_pointLights.size() - 1;
+	}
+
+	return(bReturn);
+}
+
+/***********************************************************
+ *  SetDirectionalLight()
+ *
+ *  This method is used for setting the directional light.
+ ***********************************************************/
+void LightManager::SetDirectionalLight(
+	glm::vec3 direction,
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular,
+	bool bActive)
+{
+	m_directionalLight.direction = direction;
+	m_directionalLight.ambient = ambient;
+	m_directionalLight.diffuse = diffuse;
+	m_directionalLight.specular = specular;
+	m_directionalLight.bActive = bActive;
+}
+
+/***********************************************************
+ *  AddPointLight()
+ *
+ *  This method is used for adding a point light to the end
+ *  of the list.  The index of the new light is returned, or
+ *  -1 when the list is full.
+ ***********************************************************/
+int LightManager::AddPointLight(
+	glm::vec3 position,
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular,
+	float constant,
+	float linear,
+	float quadratic)
+{
+	if ((int)m_pointLights.size() >= MAX_POINT_LIGHTS)
+	{
+		std::cout << "Point light list is full, the limit is:" << MAX_POINT_LIGHTS << std::endl;
+		return(-1);
+	}
+
+	POINT_LIGHT_STD140 light = {};
+	light.position = position;
+	light.ambient = ambient;
+	light.diffuse = diffuse;
+	light.specular = specular;
+	light.constant = constant;
+	light.linear = linear;
+	light.quadratic = quadratic;
+	light.bActive = true;
+	m_pointLights.push_back(light);
+
+	int index = (int)m_pointLights.size() - 1;
+	MarkDirty(index);
+
+	return(index);
+}
+
+/***********************************************************
+ *  SetPointLightPosition()
+ *
+ *  This method is used for moving a point light.
+ ***********************************************************/
+void LightManager::SetPointLightPosition(int index, glm::vec3 position)
+{
+	if (IsValidIndex(index) == false)
+	{
+		return;
+	}
+
+	m_pointLights[index].position = position;
+	MarkDirty(index);
+}
+
+/***********************************************************
+ *  SetPointLightColor()
+ *
+ *  This method is used for changing the colors of a point
+ *  light.
+ ***********************************************************/
+void LightManager::SetPointLightColor(
+	int index,
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular)
+{
+	if (IsValidIndex(index) == false)
+	{
+		return;
+	}
+
+	m_pointLights[index].ambient = ambient;
+	m_pointLights[index].diffuse = diffuse;
+	m_pointLights[index].specular = specular;
+	MarkDirty(index);
+}
+
+/***********************************************************
+ *  SetPointLightAttenuation()
+ *
+ *  This method is used for changing how quickly the light
+ *  of a point light falls off with distance.
+ ***********************************************************/
+void LightManager::SetPointLightAttenuation(
+	int index,
+	float constant,
+	float linear,
+	float quadratic)
+{
+	if (IsValidIndex(index) == false)
+	{
+		return;
+	}
+
+	m_pointLights[index].constant = constant;
+	m_pointLights[index].linear = linear;
+	m_pointLights[index].quadratic = quadratic;
+	MarkDirty(index);
+}
+
+/***********************************************************
+ *  SetPointLightActive()
+ *
+ *  This method is used for turning a point light on or off.
+ ***********************************************************/
+void LightManager::SetPointLightActive(int index, bool bActive)
+{
+	if (IsValidIndex(index) == false)
+	{
+		return;
+	}
+
+	m_pointLights[index].bActive = bActive;
+	MarkDirty(index);
+}
+
+/***********************************************************
+ *  UploadChanges()
+ *
+ *  This method is used for copying the range of point
+ *  lights that changed since the last upload into the
+ *  PointLightData block.  Nothing is sent when no light
+ *  has changed.
+ ***********************************************************/
+void LightManager::UploadChanges()
+{
+	m_lastUploadCount = 0;
+
+	if (m_dirtyFirst > m_dirtyLast)
+	{
+		return;
+	}
+
+	m_lastUploadCount = m_dirtyLast - m_dirtyFirst + 1;
+	m_pointLightBlock.Update(
+		sizeof(POINT_LIGHT_STD140) * m_dirtyFirst,
+		sizeof(POINT_LIGHT_STD140) * m_lastUploadCount,
+		&m_pointLights[m_dirtyFirst]);
+
+	m_dirtyFirst = 0;
+	m_dirtyLast = -1;
+}
+
+/***********************************************************
+ *  WriteFrameData()
+ *
+ *  This method is used for copying the directional light
+ *  and the number of point lights into the frame data.
+ ***********************************************************/
+void LightManager::WriteFrameData(FRAME_DATA_STD140& frameData) const
+{
+	frameData.directionalLight = m_directionalLight;
+	frameData.pointLightCount = (int)m_pointLights.size();
+}
+
+/***********************************************************
+ *  MarkDirty()
+ *
+ *  This method is used for growing the range of point
+ *  lights that are sent at the next upload.
+ ***********************************************************/
+void LightManager::MarkDirty(int index)
+{
+	if (m_dirtyFirst > m_dirtyLast)
+	{
+		m_dirtyFirst = index;
+		m_dirtyLast = index;
+	}
+	else
+	{
+		m_dirtyFirst = std::min(m_dirtyFirst, index);
+		m_dirtyLast = std::max(m_dirtyLast, index);
+	}
+}
+
+/***********************************************************
+ *  IsValidIndex()
+ *
+ *  This method is used for checking a point light index.
+ ***********************************************************/
+bool LightManager::IsValidIndex(int index) const
+{
+	return((index >= 0) && (index < (int)m_pointLights.size()));
+}
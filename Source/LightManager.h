@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmanager.h
+// ============
+// keep the scene lights in typed arrays and send only the lights that have
+// changed to the GPU
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderBlocks.h"
+#include "UniformBuffer.h"
+
+#include <vector>
+
+/***********************************************************
+ *  LightManager
+ *
+ *  This class owns the directional light and the runtime
+ *  sized list of point lights.  Changing a point light
+ *  marks it dirty, and only the range of dirty lights is
+ *  copied into the PointLightData block, so static lights
+ *  cost nothing after the first frame.  The directional
+ *  light and the light count travel in the FrameData block.
+ ***********************************************************/
+class LightManager
+{
+public:
+	// constructor
+	LightManager();
+
+	// allocate the GPU storage of the point light list
+	bool Create();
+	// send the point light changes through an upload ring
+	void SetUploadRing(UploadRing* pUploadRing) { m_pointLightBlock.SetUploadRing(pUploadRing); }
+
+	// set the single directional light
+	void SetDirectionalLight(
+		glm::vec3 direction,
+		glm::vec3 ambient,
+		glm::vec3 diffuse,
+		glm::vec3 specular,
+		bool bActive = true);
+
+	// add a point light and get its index
+	int AddPointLight(
+		glm::vec3 position,
+		glm::vec3 ambient,
+		glm::vec3 diffuse,
+		glm::vec3 specular,
+		float constant = 1.0f,
+		float linear = 0.0f,
+		float quadratic = 0.0f);
+	// move a point light
+	void SetPointLightPosition(int index, glm::vec3 position);
+	// change the colors of a point light
+	void SetPointLightColor(int index, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular);
+	// change the distance falloff of a point light
+	void SetPointLightAttenuation(int index, float constant, float linear, float quadratic);
+	// turn a point light on or off
+	void SetPointLightActive(int index, bool bActive);
+
+	// number of point lights in the list
+	int PointLightCount() const { return (int)m_pointLights.size(); }
+	// access one point light
+	const POINT_LIGHT_STD140& PointLight(int index) const { return m_pointLights[index]; }
+	// number of point lights sent at the last upload
+	int LastUploadCount() const { return m_lastUploadCount; }
+
+	// send the changed point lights to the GPU
+	void UploadChanges();
+	// copy the directional light and light count into the frame data
+	void WriteFrameData(FRAME_DATA_STD140& frameData) const;
+
+private:
+	// the directional light
+	DIRECTIONAL_LIGHT_STD140 m_directionalLight;
+	// every point light, in PointLightData block layout
+	std::vector<POINT_LIGHT_STD140> m_pointLights;
+	// range of point lights changed since the last upload
+	int m_dirtyFirst;
+	int m_dirtyLast;
+	// number of point lights sent at the last upload
+	int m_lastUploadCount;
+	// GPU copy of the PointLightData block
+	UniformBuffer m_pointLightBlock;
+
+	// add a point light to the range sent at the next upload
+	void MarkDirty(int index);
+	// check that an index refers to an existing point light
+	bool IsValidIndex(int index) const;
+};
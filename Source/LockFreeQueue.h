@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////
+// lockfreequeue.h
+// ============
+// bounded, lock-free queue for handing work between threads without a mutex
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  LockFreeQueue
+ *
+ *  This class is a fixed capacity queue that any number of
+ *  threads can push to and pop from at the same time.  Each
+ *  slot carries a sequence number that tells a thread
+ *  whether the slot is free to write or ready to read, so a
+ *  push or pop is one compare-and-swap on the shared
+ *  position and never blocks.  The capacity is rounded up
+ *  to a power of two.
+ ***********************************************************/
+template <typename T>
+class LockFreeQueue
+{
+public:
+	// constructor
+	explicit LockFreeQueue(size_t capacity) : m_slots(RoundUpPowerOfTwo(capacity))
+	{
+		size_t size = m_slots.size();
+
+		m_mask = size - 1;
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		m_pushPosition.store(0, std::memory_order_relaxed);
+		m_popPosition.store(0, std::memory_order_relaxed);
+	}
+
+	// add a value, false when the queue is full
+	bool Push(const T& value)
+	{
+		size_t position = m_pushPosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			SLOT& slot = m_slots[position & m_mask];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+
+			if (difference == 0)
+			{
+				// the slot is free, claim it by moving the position
+				if (m_pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					slot.value = value;
+					slot.sequence.store(position + 1, std::memory_order_release);
+					return(true);
+				}
+			}
+			else if (difference < 0)
+			{
+				// the slot still holds a value nobody popped
+				return(false);
+			}
+			else
+			{
+				position = m_pushPosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// remove the oldest value, false when the queue is empty
+	bool Pop(T& value)
+	{
+		size_t position = m_popPosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			SLOT& slot = m_slots[position & m_mask];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)(position + 1);
+
+			if (difference == 0)
+			{
+				// the slot is filled, claim it by moving the position
+				if (m_popPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					value = slot.value;
+					slot.sequence.store(position + m_mask + 1, std::memory_order_release);
+					return(true);
+				}
+			}
+			else if (difference < 0)
+			{
+				// the slot has not been written yet
+				return(false);
+			}
+			else
+			{
+				position = m_popPosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	// one value and the sequence number guarding it
+	struct SLOT
+	{
+		std::atomic<size_t> sequence;
+		T value;
+
+		SLOT() : sequence(0), value() {}
+	};
+
+	std::vector<SLOT> m_slots;
+	size_t m_mask;
+	// next slot to write and to read, padded apart so that
+	// producers and consumers do not share a cache line
+	std::atomic<size_t> m_pushPosition;
+	char m_padding[64];
+	std::atomic<size_t> m_popPosition;
+
+	// smallest power of two of at least the passed in size
+	static size_t RoundUpPowerOfTwo(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+		{
+			size *= 2;
+		}
+		return(size);
+	}
+};
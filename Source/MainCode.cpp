@@ -9,6 +9,7 @@
 
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -21,14 +22,31 @@
 
 #include "SceneManager.h"
 #include "ViewManager.h"
-#include "ShapeMeshes.h"
+#include "MeshLibrary.h"
 #include "ShaderManager.h"
+#include "ShaderPermutations.h"
+#include "TransformBenchmark.h"
+#include "TextureCooker.h"
+#include "SceneCooker.h"
+#include "Profiler.h"
+#include "ProfilerOverlay.h"
+#include "HotReload.h"
+#include "Simulation.h"
+#include "FrameArena.h"
+#include "HeapCounter.h"
+#include "SceneBenchmark.h"
+#include "CameraPath.h"
 
 // Namespace for declaring global variables
 namespace
 {
 	// Macro for window title
 	const char* const WINDOW_TITLE = "7-1 FinalProject and Milestones";
+	// GLSL files of the scene shader program
+	const char* const VERTEX_SHADER_PATH = "shaders/vertexShader.glsl";
+	const char* const FRAGMENT_SHADER_PATH = "shaders/fragmentShader.glsl";
+	// start of the program binary cache files of the scene program
+	const char* const PROGRAM_CACHE_PATH = "shaders/sceneProgram";
 
 	// Main GLFW window
 	GLFWwindow* g_Window = nullptr;
@@ -39,12 +57,49 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// steps the camera and the scene animation at a fixed rate
+	Simulation* g_Simulation = nullptr;
+	// scratch memory of the frame in progress, reset at each swap
+	FrameArena* g_FrameArena = nullptr;
+	// the scene program permutations and their binary cache
+	ShaderPermutations* g_ShaderPermutations = nullptr;
+	// reloads changed shaders and assets, with --hot-reload
+	HotReload* g_HotReload = nullptr;
+	// offscreen run along a camera path, with --benchmark
+	SceneBenchmark* g_SceneBenchmark = nullptr;
+	// camera flight recorded for --record-path
+	CameraPath g_RecordedPath;
+
+	// frame timers and counters, and their on-screen overlay
+	Profiler* g_Profiler = nullptr;
+	ProfilerOverlay* g_ProfilerOverlay = nullptr;
+	// CSV file written by F2 and when the application closes
+	const char* g_ProfileCSVPath = "profile.csv";
+	bool g_bWriteProfileOnExit = false;
+	// key states of the last frame, so a held key acts once
+	bool g_bOverlayKeyDown = false;
+	bool g_bProfileKeyDown = false;
+
+	// starting size of the frame arena, which grows to the
+	// busiest frame
+	const size_t FRAME_ARENA_BYTES = 256 * 1024;
+	// frames it takes the scene to settle - to stream in its
+	// textures and grow its lists - after which the render
+	// thread should not touch the heap again
+	const int STEADY_STATE_FRAME = 120;
+	bool g_bReportedSteadyStateAllocation = false;
+
+	// transforms and passes for the --bench-transforms option
+	const int BENCHMARK_TRANSFORM_COUNT = 10000;
+	const int BENCHMARK_PASSES = 50;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+void ProcessProfilerKeys();
+void CountFrameMemory();
 
 
 /***********************************************************
@@ -55,6 +110,211 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// "--bench-transforms [count]" runs the transform
+	// microbenchmark instead of opening the scene
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--bench-transforms") == 0)
+		{
+			int count = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+			if (count <= 0)
+			{
+				count = BENCHMARK_TRANSFORM_COUNT;
+			}
+			return(TransformBenchmark::Run(count, BENCHMARK_PASSES));
+		}
+	}
+
+	// "--cook-textures <images...>" writes a cooked .ctex file
+	// next to each image instead of opening the scene
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--cook-textures") == 0)
+		{
+			std::vector<std::string> sourcePaths(argv + i + 1, argv + argc);
+			return(TextureCooker::Run(sourcePaths));
+		}
+	}
+
+	// "--cook-scene <scenes...>" compiles each JSON scene into
+	// the .cscene file next to it instead of opening the scene
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--cook-scene") == 0)
+		{
+			std::vector<std::string> sourcePaths(argv + i + 1, argv + argc);
+			return(SceneCooker::Run(sourcePaths));
+		}
+	}
+
+	// "--scene <file>" prepares a cooked .cscene file instead
+	// of the built in scene,
+	// "--profile-csv <file>" writes the frame history on exit,
+	// "--profile-overlay" shows the overlay from the start,
+	// "--texture-budget <MB>" limits the streamed texture levels
+	// "--no-multi-draw" submits the scene draw by draw,
+	// "--no-culling" draws the objects outside the view too,
+	// "--no-gpu-culling" culls on the CPU only, "--no-lod"
+	// draws the curved meshes at their finest everywhere,
+	// "--hot-reload" picks up edited shaders, textures and
+	// the scene file while the application runs,
+	// "--no-program-cache" compiles every shader program,
+	// "--no-depth-prepass" shades the opaque objects without
+	// laying down their depth first, "--no-shadows" lights
+	// everything the directional light faces, "--shadow-size
+	// <texels>" and "--shadow-cascades <count>" set the size and
+	// number of the shadow maps, "--no-simulation-thread" steps
+	// the simulation on the render thread, "--job-threads
+	// <count>" sets the workers that build the draw list, 0 to
+	// build it on the render thread alone, "--no-upload-ring"
+	// sends the buffer updates with glBufferSubData,
+	// "--record-path <file>" writes the camera's flight to a
+	// path file on exit,
+	// "--benchmark" draws a fixed number of frames offscreen
+	// along a camera path and writes a JSON report, set up by
+	// "--benchmark-size <width>x<height>", "--benchmark-frames
+	// <count>", "--benchmark-warmup <count>",
+	// "--benchmark-copies <count>" of the scene,
+	// "--benchmark-path <file>" to fly instead of the orbit,
+	// "--benchmark-report <file>", and "--benchmark-baseline
+	// <file>" with "--benchmark-threshold <percent>" to fail
+	// the run when it is slower than an earlier report
+	bool bShowOverlay = false;
+	int textureBudgetMB = 0;
+	bool bUseMultiDraw = true;
+	bool bUseCulling = true;
+	bool bUseGpuCulling = true;
+	bool bUseMeshLods = true;
+	bool bHotReload = false;
+	bool bUseProgramCache = true;
+	bool bUseDepthPrepass = true;
+	bool bUseShadows = true;
+	int shadowMapSize = 0;
+	int shadowCascadeCount = 0;
+	bool bSimulationThread = true;
+	int jobWorkerCount = -1;
+	bool bUseUploadRing = true;
+	const char* sceneFilePath = NULL;
+	const char* recordPathFile = NULL;
+	bool bBenchmark = false;
+	SceneBenchmark::SETTINGS benchmarkSettings;
+	SceneBenchmark::DefaultSettings(benchmarkSettings);
+	for (int i = 1; i < argc; ++i)
+	{
+		if ((strcmp(argv[i], "--scene") == 0) && (i + 1 < argc))
+		{
+			sceneFilePath = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--profile-csv") == 0) && (i + 1 < argc))
+		{
+			g_ProfileCSVPath = argv[++i];
+			g_bWriteProfileOnExit = true;
+		}
+		else if (strcmp(argv[i], "--profile-overlay") == 0)
+		{
+			bShowOverlay = true;
+		}
+		else if ((strcmp(argv[i], "--texture-budget") == 0) && (i + 1 < argc))
+		{
+			textureBudgetMB = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-multi-draw") == 0)
+		{
+			bUseMultiDraw = false;
+		}
+		else if (strcmp(argv[i], "--no-culling") == 0)
+		{
+			bUseCulling = false;
+		}
+		else if (strcmp(argv[i], "--no-gpu-culling") == 0)
+		{
+			bUseGpuCulling = false;
+		}
+		else if (strcmp(argv[i], "--no-lod") == 0)
+		{
+			bUseMeshLods = false;
+		}
+		else if (strcmp(argv[i], "--hot-reload") == 0)
+		{
+			bHotReload = true;
+		}
+		else if (strcmp(argv[i], "--no-program-cache") == 0)
+		{
+			bUseProgramCache = false;
+		}
+		else if (strcmp(argv[i], "--no-depth-prepass") == 0)
+		{
+			bUseDepthPrepass = false;
+		}
+		else if (strcmp(argv[i], "--no-shadows") == 0)
+		{
+			bUseShadows = false;
+		}
+		else if ((strcmp(argv[i], "--shadow-size") == 0) && (i + 1 < argc))
+		{
+			shadowMapSize = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--shadow-cascades") == 0) && (i + 1 < argc))
+		{
+			shadowCascadeCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-simulation-thread") == 0)
+		{
+			bSimulationThread = false;
+		}
+		else if ((strcmp(argv[i], "--job-threads") == 0) && (i + 1 < argc))
+		{
+			jobWorkerCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-upload-ring") == 0)
+		{
+			bUseUploadRing = false;
+		}
+		else if ((strcmp(argv[i], "--record-path") == 0) && (i + 1 < argc))
+		{
+			recordPathFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			bBenchmark = true;
+		}
+		else if ((strcmp(argv[i], "--benchmark-size") == 0) && (i + 1 < argc))
+		{
+			const char* size = argv[++i];
+			const char* height = strchr(size, 'x');
+			benchmarkSettings.width = atoi(size);
+			benchmarkSettings.height = (NULL != height) ? atoi(height + 1) : 0;
+		}
+		else if ((strcmp(argv[i], "--benchmark-frames") == 0) && (i + 1 < argc))
+		{
+			benchmarkSettings.frames = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--benchmark-warmup") == 0) && (i + 1 < argc))
+		{
+			benchmarkSettings.warmupFrames = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--benchmark-copies") == 0) && (i + 1 < argc))
+		{
+			benchmarkSettings.sceneCopies = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--benchmark-path") == 0) && (i + 1 < argc))
+		{
+			benchmarkSettings.cameraPathFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--benchmark-report") == 0) && (i + 1 < argc))
+		{
+			benchmarkSettings.reportPath = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--benchmark-baseline") == 0) && (i + 1 < argc))
+		{
+			benchmarkSettings.baselinePath = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--benchmark-threshold") == 0) && (i + 1 < argc))
+		{
+			benchmarkSettings.regressionThreshold = (float)atof(argv[++i]) / 100.0f;
+		}
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -67,6 +327,18 @@ int main(int argc, char* argv[])
 	g_ViewManager = new ViewManager(
 		g_ShaderManager);
 
+	// the benchmark only needs the window for its context and
+	// draws into a target of its own size
+	if (bBenchmark)
+	{
+		if ((benchmarkSettings.width <= 0) || (benchmarkSettings.height <= 0))
+		{
+			std::cout << "The benchmark size must be given as <width>x<height>" << std::endl;
+			return(EXIT_FAILURE);
+		}
+		g_ViewManager->SetOffscreenSize(benchmarkSettings.width, benchmarkSettings.height);
+	}
+
 	// try to create the main display window
 	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
 
@@ -76,20 +348,115 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"shaders/vertexShader.glsl",
-		"shaders/fragmentShader.glsl");
-	g_ShaderManager->use();
+	// load the shader code from the external GLSL files, each
+	// permutation of it is built when it is first drawn with
+	g_ShaderPermutations = new ShaderPermutations();
+	if (g_ShaderPermutations->Create(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH, PROGRAM_CACHE_PATH) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+	g_ShaderPermutations->SetUseBinaryCache(bUseProgramCache);
+
+	if (bBenchmark)
+	{
+		g_SceneBenchmark = new SceneBenchmark();
+		if (g_SceneBenchmark->Create(benchmarkSettings) == false)
+		{
+			return(EXIT_FAILURE);
+		}
+		g_SceneBenchmark->SetCommandLine(argc, argv);
+		bShowOverlay = false;
+	}
+
+	// the per-frame draw lists are built in the frame arena
+	g_FrameArena = new FrameArena();
+	g_FrameArena->Create(FRAME_ARENA_BYTES);
 
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager = new SceneManager(g_ShaderPermutations);
+	g_SceneManager->SetFrameArena(g_FrameArena);
+	if (textureBudgetMB > 0)
+	{
+		g_SceneManager->SetTextureBudget((size_t)textureBudgetMB * 1024 * 1024);
+	}
+	if (NULL != sceneFilePath)
+	{
+		g_SceneManager->SetSceneFile(sceneFilePath);
+	}
+	g_SceneManager->SetShadowSettings(shadowMapSize, shadowCascadeCount);
+	g_SceneManager->SetJobWorkers(jobWorkerCount);
+	g_SceneManager->SetUseUploadRing(bUseUploadRing);
+	if (NULL != g_SceneBenchmark)
+	{
+		g_SceneManager->SetSceneCopies(g_SceneBenchmark->Settings().sceneCopies);
+	}
 	g_SceneManager->PrepareScene();
+	if (bUseMultiDraw == false)
+	{
+		g_SceneManager->SetUseMultiDraw(false);
+	}
+	g_SceneManager->SetUseFrustumCulling(bUseCulling);
+	g_SceneManager->SetUseGpuCulling(bUseGpuCulling);
+	g_SceneManager->SetUseMeshLods(bUseMeshLods);
+	g_SceneManager->SetUseDepthPrepass(bUseDepthPrepass);
+	g_SceneManager->SetUseShadows(bUseShadows);
+
+	if (bHotReload)
+	{
+		g_HotReload = new HotReload(g_ShaderPermutations, g_SceneManager);
+		g_HotReload->Start(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+	}
+
+	// F1 shows the profiler overlay, F2 writes the CSV file
+	g_Profiler = new Profiler();
+	g_Profiler->Create();
+	g_ProfilerOverlay = new ProfilerOverlay();
+	g_ProfilerOverlay->Create();
+	g_ProfilerOverlay->SetVisible(bShowOverlay);
+
+	// the camera and the mobile move on from here, on the
+	// simulation thread unless it was turned off - or, for the
+	// benchmark, along its path one fixed frame at a time on
+	// the render thread, so every run draws the same frames
+	g_Simulation = new Simulation();
+	g_ViewManager->SetSimulation(g_Simulation);
+	if (NULL != g_SceneBenchmark)
+	{
+		glm::vec3 copiesMinimum;
+		glm::vec3 copiesMaximum;
+		g_SceneManager->GetSceneCopiesExtent(copiesMinimum, copiesMaximum);
+		if (g_SceneBenchmark->PreparePath(copiesMinimum, copiesMaximum) == false)
+		{
+			return(EXIT_FAILURE);
+		}
+		g_Simulation->SetCameraPath(&g_SceneBenchmark->Path());
+		g_Simulation->SetFixedFrameTime(1.0 / (double)SceneBenchmark::FRAMES_PER_SECOND);
+		bSimulationThread = false;
+	}
+	else if (NULL != recordPathFile)
+	{
+		g_Simulation->SetRecording(&g_RecordedPath);
+	}
+	g_Simulation->Start(bSimulationThread);
 
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
+		g_Profiler->BeginFrame();
+
+		// the benchmark draws into its offscreen target
+		if (NULL != g_SceneBenchmark)
+		{
+			g_SceneBenchmark->BeginFrame();
+		}
+
+		// swap in the assets edited since the last frame
+		if (NULL != g_HotReload)
+		{
+			g_HotReload->Update();
+		}
+
 		// Enable z-depth
 		glEnable(GL_DEPTH_TEST);
 
@@ -98,38 +465,182 @@ int main(int argc, char* argv[])
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
+		{
+			ProfileScope scope(g_Profiler, Profiler::SCOPE_PREPARE_VIEW);
+			g_ViewManager->PrepareSceneView();
+		}
 
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+		// pose and refresh the 3D scene as simulated
+		{
+			ProfileScope scope(g_Profiler, Profiler::SCOPE_UPDATE_SCENE);
+			g_SceneManager->UpdateScene(g_ViewManager->GetSimulationState().mobileDegrees);
+			g_SceneManager->SetViewState(g_ViewManager->GetViewState());
+		}
+		{
+			ProfileScope scope(g_Profiler, Profiler::SCOPE_RENDER_SCENE, true);
+			g_SceneManager->RenderScene();
+		}
 
+		// draw the profiler results over the finished scene
+		ProcessProfilerKeys();
+		{
+			ProfileScope scope(g_Profiler, Profiler::SCOPE_OVERLAY, true);
+			const ViewManager::VIEW_STATE& viewState = g_ViewManager->GetViewState();
+			g_ProfilerOverlay->Draw(*g_Profiler, viewState.viewportWidth, viewState.viewportHeight);
+		}
 
 		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+		{
+			ProfileScope scope(g_Profiler, Profiler::SCOPE_SWAP_BUFFERS);
+			glfwSwapBuffers(g_Window);
+		}
 
 		// query the latest GLFW events
 		glfwPollEvents();
+
+		// nothing built for the frame is used after the swap
+		CountFrameMemory();
+		g_FrameArena->Reset();
+
+		g_Profiler->EndFrame();
+
+		// the benchmark ends once it has every measured frame
+		if (NULL != g_SceneBenchmark)
+		{
+			g_SceneBenchmark->EndFrame(*g_Profiler);
+			if (g_SceneBenchmark->IsFinished())
+			{
+				break;
+			}
+		}
+	}
+
+	if (g_bWriteProfileOnExit)
+	{
+		g_Profiler->WriteCSV(g_ProfileCSVPath);
+	}
+
+	// the report is written while the GL context is still there
+	// to name the renderer
+	int exitCode = EXIT_SUCCESS;
+	if (NULL != g_SceneBenchmark)
+	{
+		exitCode = g_SceneBenchmark->Finish();
+		delete g_SceneBenchmark;
+		g_SceneBenchmark = NULL;
 	}
 
 	// clear the allocated manager objects from memory
+	if (NULL != g_Simulation)
+	{
+		g_Simulation->Stop();
+		if (NULL != recordPathFile)
+		{
+			g_RecordedPath.Save(recordPathFile);
+		}
+		g_ViewManager->SetSimulation(NULL);
+		delete g_Simulation;
+		g_Simulation = NULL;
+	}
+	if (NULL != g_HotReload)
+	{
+		delete g_HotReload;
+		g_HotReload = NULL;
+	}
+	if (NULL != g_ProfilerOverlay)
+	{
+		delete g_ProfilerOverlay;
+		g_ProfilerOverlay = NULL;
+	}
+	if (NULL != g_Profiler)
+	{
+		delete g_Profiler;
+		g_Profiler = NULL;
+	}
 	if (NULL != g_SceneManager)
 	{
 		delete g_SceneManager;
 		g_SceneManager = NULL;
 	}
+	if (NULL != g_FrameArena)
+	{
+		delete g_FrameArena;
+		g_FrameArena = NULL;
+	}
 	if (NULL != g_ViewManager)
 	{
 		delete g_ViewManager;
 		g_ViewManager = NULL;
 	}
+	if (NULL != g_ShaderPermutations)
+	{
+		delete g_ShaderPermutations;
+		g_ShaderPermutations = NULL;
+	}
 	if (NULL != g_ShaderManager)
 	{
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
 
-	// Terminates the program successfully
-	exit(EXIT_SUCCESS);
+	// Terminates the program, failing a benchmark that regressed
+	exit(exitCode);
+}
+
+/***********************************************************
+ *	ProcessProfilerKeys()
+ *
+ *  This function is used to toggle the profiler overlay
+ *  with F1 and write the profiler CSV file with F2.  Each
+ *  key acts once per press, not once per frame.
+ ***********************************************************/
+void ProcessProfilerKeys()
+{
+	bool bOverlayKey = (glfwGetKey(g_Window, GLFW_KEY_F1) == GLFW_PRESS);
+	if (bOverlayKey && (g_bOverlayKeyDown == false))
+	{
+		g_ProfilerOverlay->ToggleVisible();
+	}
+	g_bOverlayKeyDown = bOverlayKey;
+
+	bool bProfileKey = (glfwGetKey(g_Window, GLFW_KEY_F2) == GLFW_PRESS);
+	if (bProfileKey && (g_bProfileKeyDown == false))
+	{
+		g_Profiler->WriteCSV(g_ProfileCSVPath);
+	}
+	g_bProfileKeyDown = bProfileKey;
+}
+
+/***********************************************************
+ *	CountFrameMemory()
+ *
+ *  This function is used to hand the profiler the heap
+ *  allocations the render thread made this frame and the
+ *  frame arena memory it used.  Once the scene has settled
+ *  the first frame that still allocates is reported, since
+ *  every allocation then is one made again each frame.
+ ***********************************************************/
+void CountFrameMemory()
+{
+	HeapCounter::HEAP_COUNTS heapCounts;
+	HeapCounter::TakeThreadCounts(heapCounts);
+	FrameArena::ARENA_STATS arenaStats;
+	g_FrameArena->GetStats(arenaStats);
+
+	Profiler::CountMemory(
+		heapCounts.allocations,
+		(int)(heapCounts.bytes / 1024),
+		(int)arenaStats.usedBytes);
+
+	if ((g_Profiler->FrameIndex() > STEADY_STATE_FRAME) &&
+		(heapCounts.allocations > 0) &&
+		(g_bReportedSteadyStateAllocation == false))
+	{
+		std::cout << "Render thread allocated " << heapCounts.allocations
+			<< " times (" << heapCounts.bytes << " bytes) in steady state frame "
+			<< g_Profiler->FrameIndex() << std::endl;
+		g_bReportedSteadyStateAllocation = true;
+	}
 }
 
 /***********************************************************
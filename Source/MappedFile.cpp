@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.cpp
+// ==============
+// This file contains the implementation of the `MappedFile` class, which
+// gives read-only access to a file through a memory mapping.
+//
+// RESPONSIBILITIES:
+// - Map and unmap files with CreateFileMapping on Windows and mmap elsewhere.
+// - Fault the pages in ahead of time on a worker thread when asked.
+//
+// NOTE: Empty files cannot be mapped and are reported as failures.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Namespace for the mapping constants
+namespace
+{
+	// smallest page size of the supported platforms
+	const size_t PREFETCH_STRIDE = 4096;
+}
+
+/***********************************************************
+ *  MappedFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_size = 0;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+}
+
+/***********************************************************
+ *  ~MappedFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping the whole file for
+ *  reading.  Any earlier mapping is released first.
+ ***********************************************************/
+bool MappedFile::Open(const char* filePath)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return(false);
+	}
+
+	LARGE_INTEGER fileSize;
+	if ((GetFileSizeEx(file, &fileSize) == FALSE) || (fileSize.QuadPart <= 0))
+	{
+		CloseHandle(file);
+		return(false);
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL == mapping)
+	{
+		CloseHandle(file);
+		return(false);
+	}
+
+	void* pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (NULL == pView)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return(false);
+	}
+
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_pData = (const unsigned char*)pView;
+	m_size = (size_t)fileSize.QuadPart;
+#else
+	int file = open(filePath, O_RDONLY);
+	if (file < 0)
+	{
+		return(false);
+	}
+
+	struct stat fileStatus;
+	if ((fstat(file, &fileStatus) != 0) || (fileStatus.st_size <= 0))
+	{
+		close(file);
+		return(false);
+	}
+
+	void* pView = mmap(NULL, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	// the mapping stays valid after the descriptor is closed
+	close(file);
+	if (pView == MAP_FAILED)
+	{
+		return(false);
+	}
+
+	m_pData = (const unsigned char*)pView;
+	m_size = (size_t)fileStatus.st_size;
+#endif
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for releasing the mapping.
+ ***********************************************************/
+void MappedFile::Close()
+{
+	if (NULL == m_pData)
+	{
+		return;
+	}
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_pData);
+	CloseHandle((HANDLE)m_mappingHandle);
+	CloseHandle((HANDLE)m_fileHandle);
+#else
+	munmap((void*)m_pData, m_size);
+#endif
+
+	m_pData = NULL;
+	m_size = 0;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+}
+
+/***********************************************************
+ *  Prefetch()
+ *
+ *  This method is used for touching every page of a range
+ *  of the mapping so the operating system reads it in now.
+ ***********************************************************/
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	size_t end = std::min(offset + size, m_size);
+	volatile unsigned char sum = 0;
+	for (size_t position = offset; position < end; position += PREFETCH_STRIDE)
+	{
+		sum += m_pData[position];
+	}
+	// the stride can step over the last page of the range
+	if (offset < end)
+	{
+		sum += m_pData[end - 1];
+	}
+}
+
+/***********************************************************
+ *  MoveOver()
+ *
+ *  This method is used for renaming a newly written file
+ *  over an older one.  The cookers write to a temporary
+ *  file and move it over the cooked file last, so a program
+ *  watching the cooked file never reads it half written,
+ *  and on POSIX systems a mapping of the old file keeps its
+ *  pages.  Windows refuses while the old file is mapped.
+ ***********************************************************/
+bool MappedFile::MoveOver(const char* sourcePath, const char* destinationPath)
+{
+#if defined(_WIN32)
+	return(MoveFileExA(sourcePath, destinationPath, MOVEFILE_REPLACE_EXISTING) != FALSE);
+#else
+	return(rename(sourcePath, destinationPath) == 0);
+#endif
+}
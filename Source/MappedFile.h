@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.h
+// ============
+// map a whole file read-only into memory so its bytes can be used in place
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps a file into the address space with the
+ *  operating system's file mapping, so reading it costs no
+ *  copy and pages are only loaded as they are touched.  The
+ *  mapping is released by Close() or the destructor.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map the passed in file, false when it cannot be opened
+	bool Open(const char* filePath);
+	// release the mapping
+	void Close();
+
+	// mapped bytes, or NULL when nothing is mapped
+	const unsigned char* Data() const { return m_pData; }
+	// number of mapped bytes
+	size_t Size() const { return m_size; }
+
+	// read one byte of every page so the mapping is loaded
+	// now, on the calling thread, instead of on first use
+	void Prefetch() const { Prefetch(0, m_size); }
+	// read in only the pages of a byte range
+	void Prefetch(size_t offset, size_t size) const;
+
+	// put a finished file in place of another in one step,
+	// for writing files that a running program may have mapped
+	static bool MoveOver(const char* sourcePath, const char* destinationPath);
+
+private:
+	const unsigned char* m_pData;
+	size_t m_size;
+	// operating system handles of the file and the mapping
+	void* m_fileHandle;
+	void* m_mappingHandle;
+
+	// mapping objects cannot be copied
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
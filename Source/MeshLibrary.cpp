@@ -0,0 +1,979 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshlibrary.cpp
+// ===============
+// This file contains the implementation of the `MeshLibrary` class, which
+// generates the basic 3D shape meshes and draws them with instancing.
+//
+// RESPONSIBILITIES:
+// - Generate the plane, box, sphere, cylinder, pyramid, cone and torus meshes.
+// - Quantize every mesh into one shared vertex and index buffer pair.
+// - Keep per-instance model matrix and draw settings buffers shared by all of
+//   the meshes.
+// - Draw a contiguous range of instances with a single instanced draw call,
+//   or a whole list of such draws with one multi-draw-indirect call.
+//
+// NOTE: The generated shapes follow the ShapeMeshes conventions so that the
+// scene transformations written for them keep their meaning - the plane spans
+// -1..1 in X/Z, the box and pyramid are unit sized around the origin and the
+// cylinder and cone stand on Y=0 with a radius and height of 1.  The shapes
+// are generated in floats and quantized when they are appended to the shared
+// buffers, so the generators read the same as before.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshLibrary.h"
+#include "Profiler.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// tessellation of the curved primitives at each level of
+	// detail, the cone uses the cylinder sectors
+	const int SPHERE_STACKS[MAX_MESH_LODS] = { 18, 10, 6, 4 };
+	const int SPHERE_SECTORS[MAX_MESH_LODS] = { 36, 20, 12, 8 };
+	const int CYLINDER_SECTORS[MAX_MESH_LODS] = { 36, 20, 12, 8 };
+	const int TORUS_MAIN_SEGMENTS[MAX_MESH_LODS] = { 36, 24, 16, 10 };
+	const int TORUS_TUBE_SEGMENTS[MAX_MESH_LODS] = { 18, 10, 6, 4 };
+	// smallest size across, in pixels, that each level but
+	// the coarsest is used down to
+	const float LOD_MIN_PIXELS[MAX_MESH_LODS - 1] = { 200.0f, 80.0f, 30.0f };
+	// how far past a switch point the size has to go before
+	// the level changes, so that it does not flicker
+	const float LOD_HYSTERESIS = 0.2f;
+	const float TORUS_MAIN_RADIUS = 1.0f;
+	const float TORUS_TUBE_RADIUS = 0.1f;
+
+	// vertex attribute locations used by vertexShader.glsl
+	const GLuint POSITION_LOCATION = 0;
+	const GLuint NORMAL_LOCATION = 1;
+	const GLuint TEXCOORD_LOCATION = 2;
+	// a mat4 attribute occupies four consecutive locations
+	const GLuint INSTANCE_MATRIX_LOCATION = 3;
+	// per-instance draw settings used by the multi-draw path
+	const GLuint INSTANCE_COLOR_LOCATION = 7;
+	const GLuint INSTANCE_UV_SCALE_LOCATION = 8;
+	const GLuint INSTANCE_INDICES_LOCATION = 9;
+
+	// packed positions cover -RANGE..RANGE, must match the
+	// MESH_POSITION_RANGE define in vertexShader.glsl
+	const float MESH_POSITION_RANGE = 2.0f;
+
+	// round a -1..1 value to a snorm16
+	int16_t ToSnorm16(float value)
+	{
+		value = std::min(std::max(value, -1.0f), 1.0f);
+		return((int16_t)std::lround(value * 32767.0f));
+	}
+
+	// round a 0..1 value to a unorm16
+	uint16_t ToUnorm16(float value)
+	{
+		value = std::min(std::max(value, 0.0f), 1.0f);
+		return((uint16_t)std::lround(value * 65535.0f));
+	}
+
+	// fold a unit normal onto the octahedron and flatten it
+	// to two -1..1 values
+	glm::vec2 OctahedralEncode(const glm::vec3& normal)
+	{
+		float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+		glm::vec2 encoded = glm::vec2(normal.x, normal.y) / std::max(sum, 1.0e-8f);
+		if (normal.z < 0.0f)
+		{
+			// the lower half folds over the diagonals
+			glm::vec2 folded(1.0f - std::fabs(encoded.y), 1.0f - std::fabs(encoded.x));
+			encoded.x = (encoded.x >= 0.0f) ? folded.x : -folded.x;
+			encoded.y = (encoded.y >= 0.0f) ? folded.y : -folded.y;
+		}
+		return(encoded);
+	}
+}
+
+/***********************************************************
+ *  MeshLibrary()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshLibrary::MeshLibrary()
+{
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		for (int lod = 0; lod < MAX_MESH_LODS; lod++)
+		{
+			m_meshes[i][lod].baseVertex = 0;
+			m_meshes[i][lod].firstIndex = 0;
+			m_meshes[i][lod].nIndices = 0;
+		}
+		m_lodCounts[i] = 1;
+		m_bounds[i].minimum = glm::vec3(0.0f);
+		m_bounds[i].maximum = glm::vec3(0.0f);
+	}
+	m_vao = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_instanceVBO = 0;
+	m_instanceCapacity = 0;
+	m_settingsVBO = 0;
+	m_settingsCapacity = 0;
+	m_indirectBuffer = 0;
+	m_indirectCapacity = 0;
+	m_pUploadRing = NULL;
+}
+
+/***********************************************************
+ *  ~MeshLibrary()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MeshLibrary::~MeshLibrary()
+{
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		glDeleteBuffers(1, &m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+	}
+	if (m_instanceVBO != 0)
+	{
+		glDeleteBuffers(1, &m_instanceVBO);
+		glDeleteBuffers(1, &m_settingsVBO);
+	}
+	if (m_indirectBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_indirectBuffer);
+	}
+}
+
+/***********************************************************
+ *  LoadMeshes()
+ *
+ *  This method is used for generating every basic mesh into
+ *  the shared buffers, and the instance buffer that the
+ *  meshes read from.
+ ***********************************************************/
+void MeshLibrary::LoadMeshes()
+{
+	// the instance buffers must exist before the mesh VAO is
+	// created, since the VAO refers to them
+	glm::mat4 identity(1.0f);
+	glGenBuffers(1, &m_instanceVBO);
+	SetInstanceData(&identity, 1);
+	INSTANCE_SETTINGS defaultSettings = { glm::vec4(1.0f), glm::vec2(1.0f), -1, 0 };
+	glGenBuffers(1, &m_settingsVBO);
+	SetInstanceSettings(&defaultSettings, 1);
+	if (SupportsMultiDraw())
+	{
+		glGenBuffers(1, &m_indirectBuffer);
+	}
+
+	std::vector<VERTEX> vertices;
+	std::vector<GLuint> indices;
+	std::vector<PACKED_VERTEX> packedVertices;
+	std::vector<GLushort> packedIndices;
+
+	BuildPlane(vertices, indices);
+	AppendMesh(MESH_PLANE, 0, vertices, indices, packedVertices, packedIndices);
+	BuildBox(vertices, indices);
+	AppendMesh(MESH_BOX, 0, vertices, indices, packedVertices, packedIndices);
+	BuildPyramid4(vertices, indices);
+	AppendMesh(MESH_PYRAMID4, 0, vertices, indices, packedVertices, packedIndices);
+
+	// the curved meshes get every level of detail
+	for (int lod = 0; lod < MAX_MESH_LODS; lod++)
+	{
+		BuildSphere(vertices, indices, lod);
+		AppendMesh(MESH_SPHERE, lod, vertices, indices, packedVertices, packedIndices);
+		BuildCylinder(vertices, indices, lod);
+		AppendMesh(MESH_CYLINDER, lod, vertices, indices, packedVertices, packedIndices);
+		BuildCone(vertices, indices, lod);
+		AppendMesh(MESH_CONE, lod, vertices, indices, packedVertices, packedIndices);
+		BuildTorus(vertices, indices, lod);
+		AppendMesh(MESH_TORUS, lod, vertices, indices, packedVertices, packedIndices);
+	}
+
+	UploadMeshes(packedVertices, packedIndices);
+}
+
+/***********************************************************
+ *  SetInstanceData()
+ *
+ *  This method is used for replacing the whole instance
+ *  matrix buffer.  The buffer only grows, so re-sending a
+ *  scene of the same size does not reallocate GPU memory.
+ ***********************************************************/
+void MeshLibrary::SetInstanceData(const glm::mat4* matrices, int count)
+{
+	StoreBufferData(GL_ARRAY_BUFFER, m_instanceVBO, m_instanceCapacity, count, sizeof(glm::mat4), matrices);
+}
+
+/***********************************************************
+ *  SetInstanceSettings()
+ *
+ *  This method is used for replacing the draw settings of
+ *  every instance, in the same order as the matrices.  The
+ *  settings only change when the scene is rebuilt.
+ ***********************************************************/
+void MeshLibrary::SetInstanceSettings(const INSTANCE_SETTINGS* settings, int count)
+{
+	StoreBufferData(GL_ARRAY_BUFFER, m_settingsVBO, m_settingsCapacity, count, sizeof(INSTANCE_SETTINGS), settings);
+}
+
+/***********************************************************
+ *  StoreBufferData()
+ *
+ *  This method is used for sending data to a buffer that
+ *  only grows, so re-sending data of the same size does
+ *  not reallocate GPU memory.
+ ***********************************************************/
+void MeshLibrary::StoreBufferData(GLenum target, GLuint buffer, int& capacity, int count, size_t elementSize, const void* data)
+{
+	if (count > capacity)
+	{
+		glBindBuffer(target, buffer);
+		glBufferData(target, count * elementSize, data, GL_DYNAMIC_DRAW);
+		glBindBuffer(target, 0);
+		capacity = count;
+	}
+	else if (count > 0)
+	{
+		UpdateBufferData(target, buffer, 0, count * elementSize, data);
+	}
+}
+
+/***********************************************************
+ *  UpdateBufferData()
+ *
+ *  This method is used for overwriting a range of a buffer.
+ *  With an upload ring the data is written into the ring
+ *  and copied on the GPU, so the driver neither copies it
+ *  nor waits for draws still reading the old contents.
+ ***********************************************************/
+void MeshLibrary::UpdateBufferData(GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	if ((NULL != m_pUploadRing) && m_pUploadRing->CopyToBuffer(buffer, offset, size, data))
+	{
+		return;
+	}
+
+	glBindBuffer(target, buffer);
+	glBufferSubData(target, offset, size, data);
+	glBindBuffer(target, 0);
+}
+
+/***********************************************************
+ *  UpdateInstanceData()
+ *
+ *  This method is used for overwriting only the instance
+ *  matrices of objects that have moved.
+ ***********************************************************/
+void MeshLibrary::UpdateInstanceData(int firstInstance, int count, const glm::mat4* matrices)
+{
+	if ((count <= 0) || (firstInstance < 0) || (firstInstance + count > m_instanceCapacity))
+	{
+		return;
+	}
+
+	UpdateBufferData(
+		GL_ARRAY_BUFFER,
+		m_instanceVBO,
+		firstInstance * sizeof(glm::mat4),
+		count * sizeof(glm::mat4),
+		matrices);
+}
+
+/***********************************************************
+ *  BeginDraws()
+ *
+ *  This method is used for binding the VAO that every mesh
+ *  shares, once for a whole run of draws.
+ ***********************************************************/
+void MeshLibrary::BeginDraws() const
+{
+	glBindVertexArray(m_vao);
+}
+
+/***********************************************************
+ *  EndDraws()
+ *
+ *  This method is used for unbinding the shared VAO, so
+ *  later code cannot change it by accident.
+ ***********************************************************/
+void MeshLibrary::EndDraws() const
+{
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  DrawMeshInstanced()
+ *
+ *  This method is used for drawing instanceCount copies of
+ *  a mesh, reading the model matrices that start at
+ *  firstInstance in the instance buffer.  The mesh and its
+ *  level of detail are picked by their base vertex and
+ *  first index in the shared buffers, so no VAO is bound
+ *  here.
+ ***********************************************************/
+void MeshLibrary::DrawMeshInstanced(MESH_TYPE mesh, int lod, int firstInstance, int instanceCount) const
+{
+	if ((mesh < 0) || (mesh >= MESH_COUNT) || (instanceCount <= 0))
+	{
+		return;
+	}
+
+	const GLMesh& glMesh = m_meshes[mesh][std::min(std::max(lod, 0), m_lodCounts[mesh] - 1)];
+	// OpenGL 3.3 has no base instance, so the instance
+	// attributes are re-pointed at the first matrix instead
+	BindInstanceAttributes(m_instanceVBO, m_settingsVBO, firstInstance);
+	glDrawElementsInstancedBaseVertex(
+		GL_TRIANGLES,
+		glMesh.nIndices,
+		GL_UNSIGNED_SHORT,
+		(void*)(glMesh.firstIndex * sizeof(GLushort)),
+		instanceCount,
+		glMesh.baseVertex);
+	Profiler::CountDrawCall((glMesh.nIndices / 3) * instanceCount);
+}
+
+/***********************************************************
+ *  SupportsMultiDraw()
+ *
+ *  This method is used for checking for OpenGL 4.3, which
+ *  has glMultiDrawElementsIndirect and reads the base
+ *  instance of each command.
+ ***********************************************************/
+bool MeshLibrary::SupportsMultiDraw()
+{
+	return(GLEW_VERSION_4_3 ? true : false);
+}
+
+/***********************************************************
+ *  MakeDrawCommand()
+ *
+ *  This method is used for filling in the indirect command
+ *  that draws a range of instances of a mesh.  The base
+ *  instance makes the instance attributes start at the
+ *  range, so nothing has to be re-pointed.
+ ***********************************************************/
+void MeshLibrary::MakeDrawCommand(MESH_TYPE mesh, int lod, int firstInstance, int instanceCount, DRAW_COMMAND& command) const
+{
+	const GLMesh& glMesh = m_meshes[mesh][std::min(std::max(lod, 0), m_lodCounts[mesh] - 1)];
+
+	command.count = (GLuint)glMesh.nIndices;
+	command.instanceCount = (GLuint)instanceCount;
+	command.firstIndex = (GLuint)glMesh.firstIndex;
+	command.baseVertex = glMesh.baseVertex;
+	command.baseInstance = (GLuint)firstInstance;
+}
+
+/***********************************************************
+ *  SelectLod()
+ *
+ *  This method is used for picking the level of detail of
+ *  an instance from its size on screen.  A level is used
+ *  while the instance covers at least its minimum pixels,
+ *  but the current level is only left once the size is
+ *  LOD_HYSTERESIS past the switch point, so an instance
+ *  near a switch point does not pop back and forth.  Pass
+ *  -1 for an instance that has no level yet.
+ ***********************************************************/
+int MeshLibrary::SelectLod(MESH_TYPE mesh, float pixels, int currentLod) const
+{
+	int lodCount = m_lodCounts[mesh];
+	int lod = 0;
+	while ((lod < lodCount - 1) && (pixels < LOD_MIN_PIXELS[lod]))
+	{
+		lod++;
+	}
+
+	if ((currentLod < 0) || (currentLod >= lodCount) || (lod == currentLod))
+	{
+		return(lod);
+	}
+
+	if (lod < currentLod)
+	{
+		// finer, once the size is well above the switch point
+		bool bSwitch = (pixels >= LOD_MIN_PIXELS[currentLod - 1] * (1.0f + LOD_HYSTERESIS));
+		return(bSwitch ? lod : currentLod);
+	}
+
+	// coarser, once the size is well below the switch point
+	bool bSwitch = (pixels < LOD_MIN_PIXELS[currentLod] * (1.0f - LOD_HYSTERESIS));
+	return(bSwitch ? lod : currentLod);
+}
+
+/***********************************************************
+ *  TessellatedRadius()
+ *
+ *  This method is used for measuring the part of a mesh
+ *  that its level of detail rounds off - the radius around
+ *  the Y axis for the cylinder and the cone and around the
+ *  Z axis for the torus - so that a long thin string is
+ *  sized by its thickness rather than its length.
+ ***********************************************************/
+float MeshLibrary::TessellatedRadius(MESH_TYPE mesh, const glm::mat4& model)
+{
+	float x = glm::length(glm::vec3(model[0]));
+	float y = glm::length(glm::vec3(model[1]));
+	float z = glm::length(glm::vec3(model[2]));
+
+	switch (mesh)
+	{
+	case MESH_CYLINDER:
+	case MESH_CONE:
+		return(std::max(x, z));
+	case MESH_TORUS:
+		return(std::max(x, y) * (TORUS_MAIN_RADIUS + TORUS_TUBE_RADIUS));
+	default:
+		return(std::max(x, std::max(y, z)));
+	}
+}
+
+/***********************************************************
+ *  SetDrawCommands()
+ *
+ *  This method is used for replacing the indirect command
+ *  buffer.  A copy is kept to count the triangles drawn.
+ ***********************************************************/
+void MeshLibrary::SetDrawCommands(const DRAW_COMMAND* commands, int count)
+{
+	if (m_indirectBuffer == 0)
+	{
+		return;
+	}
+
+	m_drawCommands.assign(commands, commands + count);
+	StoreBufferData(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer, m_indirectCapacity, count, sizeof(DRAW_COMMAND), commands);
+}
+
+/***********************************************************
+ *  DrawMultiIndirect()
+ *
+ *  This method is used for submitting a range of the
+ *  indirect commands with one call.  The instance
+ *  attributes point at the first instance, each command's
+ *  base instance takes it from there.
+ ***********************************************************/
+void MeshLibrary::DrawMultiIndirect(int firstCommand, int commandCount) const
+{
+	if ((m_indirectBuffer == 0) || (commandCount <= 0) ||
+		(firstCommand < 0) || (firstCommand + commandCount > (int)m_drawCommands.size()))
+	{
+		return;
+	}
+
+	BindInstanceAttributes(m_instanceVBO, m_settingsVBO, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glMultiDrawElementsIndirect(
+		GL_TRIANGLES,
+		GL_UNSIGNED_SHORT,
+		(void*)(firstCommand * sizeof(DRAW_COMMAND)),
+		commandCount,
+		0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	int triangles = 0;
+	for (int i = firstCommand; i < firstCommand + commandCount; ++i)
+	{
+		triangles += (int)((m_drawCommands[i].count / 3) * m_drawCommands[i].instanceCount);
+	}
+	Profiler::CountDrawCall(triangles);
+}
+
+/***********************************************************
+ *  DrawCulledMultiIndirect()
+ *
+ *  This method is used for submitting commands that a
+ *  culling pass wrote on the GPU.  The commands keep their
+ *  base instances, and the pass packed the kept instances
+ *  to the front of each command's range in its own matrix
+ *  and settings buffers, so the attributes are pointed at
+ *  those for this call; the other draws point them back at
+ *  the library's buffers.  The CPU does not know how many
+ *  instances survived, so the triangles are passed in.
+ ***********************************************************/
+void MeshLibrary::DrawCulledMultiIndirect(GLuint commandBuffer, GLuint matrixBuffer, GLuint settingsBuffer,
+	int firstCommand, int commandCount, int triangles) const
+{
+	if ((commandBuffer == 0) || (commandCount <= 0) || (firstCommand < 0))
+	{
+		return;
+	}
+
+	BindInstanceAttributes(matrixBuffer, settingsBuffer, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(
+		GL_TRIANGLES,
+		GL_UNSIGNED_SHORT,
+		(void*)(firstCommand * sizeof(DRAW_COMMAND)),
+		commandCount,
+		0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	Profiler::CountDrawCall(triangles);
+}
+
+/***********************************************************
+ *  BindInstanceAttributes()
+ *
+ *  This method is used for pointing the four mat4 column
+ *  attributes and the settings attributes of the bound VAO
+ *  at the passed in instance.
+ ***********************************************************/
+void MeshLibrary::BindInstanceAttributes(GLuint matrixBuffer, GLuint settingsBuffer, int firstInstance) const
+{
+	const GLsizei stride = sizeof(glm::mat4);
+	const size_t baseOffset = firstInstance * sizeof(glm::mat4);
+
+	glBindBuffer(GL_ARRAY_BUFFER, matrixBuffer);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(
+			INSTANCE_MATRIX_LOCATION + column,
+			4,
+			GL_FLOAT,
+			GL_FALSE,
+			stride,
+			(void*)(baseOffset + column * sizeof(glm::vec4)));
+	}
+
+	const GLsizei settingsStride = sizeof(INSTANCE_SETTINGS);
+	const size_t settingsOffset = firstInstance * sizeof(INSTANCE_SETTINGS);
+	glBindBuffer(GL_ARRAY_BUFFER, settingsBuffer);
+	glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, settingsStride,
+		(void*)(settingsOffset + offsetof(INSTANCE_SETTINGS, color)));
+	glVertexAttribPointer(INSTANCE_UV_SCALE_LOCATION, 2, GL_FLOAT, GL_FALSE, settingsStride,
+		(void*)(settingsOffset + offsetof(INSTANCE_SETTINGS, uvScale)));
+	glVertexAttribIPointer(INSTANCE_INDICES_LOCATION, 2, GL_INT, settingsStride,
+		(void*)(settingsOffset + offsetof(INSTANCE_SETTINGS, textureSlot)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  AppendMesh()
+ *
+ *  This method is used for quantizing one level of a
+ *  generated mesh onto the end of the shared lists and
+ *  remembering where it starts.  How far the mesh reaches
+ *  is taken from the float positions of its finest level,
+ *  before they are rounded.  The indices stay
+ *  relative to the mesh, the base vertex offsets them when
+ *  drawing, so 16 bits are enough for each mesh on its own.
+ ***********************************************************/
+void MeshLibrary::AppendMesh(
+	MESH_TYPE mesh,
+	int lod,
+	const std::vector<VERTEX>& vertices,
+	const std::vector<GLuint>& indices,
+	std::vector<PACKED_VERTEX>& packedVertices,
+	std::vector<GLushort>& packedIndices)
+{
+	GLMesh& glMesh = m_meshes[mesh][lod];
+
+	if (vertices.size() > 65536)
+	{
+		std::cout << "Mesh " << mesh << " has too many vertices for 16-bit indices" << std::endl;
+		return;
+	}
+
+	glMesh.baseVertex = (GLint)packedVertices.size();
+	glMesh.firstIndex = (GLsizei)packedIndices.size();
+	glMesh.nIndices = (GLsizei)indices.size();
+	m_lodCounts[mesh] = std::max(m_lodCounts[mesh], lod + 1);
+
+	// the coarser levels lie inside the finest one
+	CullingBVH::AABB& bounds = m_bounds[mesh];
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		if (lod == 0)
+		{
+			if (i == 0)
+			{
+				bounds.minimum = vertices[i].position;
+				bounds.maximum = vertices[i].position;
+			}
+			bounds.minimum = glm::min(bounds.minimum, vertices[i].position);
+			bounds.maximum = glm::max(bounds.maximum, vertices[i].position);
+		}
+		packedVertices.push_back(PackVertex(vertices[i]));
+	}
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		packedIndices.push_back((GLushort)indices[i]);
+	}
+}
+
+/***********************************************************
+ *  PackVertex()
+ *
+ *  This method is used for quantizing one vertex - the
+ *  position scaled into snorm16, the normal octahedral
+ *  encoded into two snorm16, and the texture coordinate
+ *  as unorm16.
+ ***********************************************************/
+MeshLibrary::PACKED_VERTEX MeshLibrary::PackVertex(const VERTEX& vertex)
+{
+	PACKED_VERTEX packed;
+	glm::vec3 position = vertex.position / MESH_POSITION_RANGE;
+	glm::vec2 normal = OctahedralEncode(glm::normalize(vertex.normal));
+
+	packed.position[0] = ToSnorm16(position.x);
+	packed.position[1] = ToSnorm16(position.y);
+	packed.position[2] = ToSnorm16(position.z);
+	packed.position[3] = 0;
+	packed.normal[0] = ToSnorm16(normal.x);
+	packed.normal[1] = ToSnorm16(normal.y);
+	packed.uv[0] = ToUnorm16(vertex.uv.x);
+	packed.uv[1] = ToUnorm16(vertex.uv.y);
+
+	return(packed);
+}
+
+/***********************************************************
+ *  UploadMeshes()
+ *
+ *  This method is used for creating the VAO that every mesh
+ *  shares, with the packed vertex buffer, the index buffer
+ *  and the instance attributes.
+ ***********************************************************/
+void MeshLibrary::UploadMeshes(
+	const std::vector<PACKED_VERTEX>& packedVertices,
+	const std::vector<GLushort>& packedIndices)
+{
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, packedVertices.size() * sizeof(PACKED_VERTEX), packedVertices.data(), GL_STATIC_DRAW);
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, packedIndices.size() * sizeof(GLushort), packedIndices.data(), GL_STATIC_DRAW);
+
+	// the normalized integers read as floats in the shader
+	const GLsizei stride = sizeof(PACKED_VERTEX);
+	glVertexAttribPointer(POSITION_LOCATION, 4, GL_SHORT, GL_TRUE, stride, (void*)offsetof(PACKED_VERTEX, position));
+	glEnableVertexAttribArray(POSITION_LOCATION);
+	glVertexAttribPointer(NORMAL_LOCATION, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(PACKED_VERTEX, normal));
+	glEnableVertexAttribArray(NORMAL_LOCATION);
+	glVertexAttribPointer(TEXCOORD_LOCATION, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(PACKED_VERTEX, uv));
+	glEnableVertexAttribArray(TEXCOORD_LOCATION);
+
+	// the model matrix advances once per instance, not per vertex
+	BindInstanceAttributes(m_instanceVBO, m_settingsVBO, 0);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+		glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + column, 1);
+	}
+	const GLuint settingsLocations[3] = { INSTANCE_COLOR_LOCATION, INSTANCE_UV_SCALE_LOCATION, INSTANCE_INDICES_LOCATION };
+	for (int i = 0; i < 3; i++)
+	{
+		glEnableVertexAttribArray(settingsLocations[i]);
+		glVertexAttribDivisor(settingsLocations[i], 1);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	int levelCount = 0;
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		levelCount += m_lodCounts[i];
+	}
+	std::cout << "Packed " << MESH_COUNT << " meshes at " << levelCount << " levels of detail: "
+		<< packedVertices.size() << " vertices, "
+		<< packedIndices.size() << " indices, "
+		<< (packedVertices.size() * sizeof(PACKED_VERTEX) + packedIndices.size() * sizeof(GLushort)) / 1024
+		<< " KB" << std::endl;
+}
+
+/***********************************************************
+ *  BuildPlane()
+ *
+ *  This method is used for generating a flat plane facing
+ *  up the Y axis that spans -1 to 1 in X and Z.
+ ***********************************************************/
+void MeshLibrary::BuildPlane(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices)
+{
+	vertices.clear();
+	indices.clear();
+
+	const glm::vec3 up(0.0f, 1.0f, 0.0f);
+	vertices.push_back({ glm::vec3(-1.0f, 0.0f, 1.0f), up, glm::vec2(0.0f, 0.0f) });
+	vertices.push_back({ glm::vec3(1.0f, 0.0f, 1.0f), up, glm::vec2(1.0f, 0.0f) });
+	vertices.push_back({ glm::vec3(1.0f, 0.0f, -1.0f), up, glm::vec2(1.0f, 1.0f) });
+	vertices.push_back({ glm::vec3(-1.0f, 0.0f, -1.0f), up, glm::vec2(0.0f, 1.0f) });
+
+	indices = { 0, 1, 2, 0, 2, 3 };
+}
+
+/***********************************************************
+ *  BuildBox()
+ *
+ *  This method is used for generating a unit cube centered
+ *  on the origin, with each face mapped to the full texture.
+ ***********************************************************/
+void MeshLibrary::BuildBox(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices)
+{
+	vertices.clear();
+	indices.clear();
+
+	// each face is given by its normal and the two axes
+	// that span it, so the corners can be generated
+	const glm::vec3 normals[6] = {
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+	const glm::vec3 rightAxes[6] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f) };
+	const glm::vec3 upAxes[6] = {
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+
+	for (int face = 0; face < 6; face++)
+	{
+		GLuint base = (GLuint)vertices.size();
+		glm::vec3 center = normals[face] * 0.5f;
+		glm::vec3 right = rightAxes[face] * 0.5f;
+		glm::vec3 up = upAxes[face] * 0.5f;
+
+		vertices.push_back({ center - right - up, normals[face], glm::vec2(0.0f, 0.0f) });
+		vertices.push_back({ center + right - up, normals[face], glm::vec2(1.0f, 0.0f) });
+		vertices.push_back({ center + right + up, normals[face], glm::vec2(1.0f, 1.0f) });
+		vertices.push_back({ center - right + up, normals[face], glm::vec2(0.0f, 1.0f) });
+
+		indices.insert(indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+	}
+}
+
+/***********************************************************
+ *  BuildSphere()
+ *
+ *  This method is used for generating a unit radius UV
+ *  sphere centered on the origin.
+ ***********************************************************/
+void MeshLibrary::BuildSphere(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices, int lod)
+{
+	vertices.clear();
+	indices.clear();
+
+	const int stacks = SPHERE_STACKS[lod];
+	const int sectors = SPHERE_SECTORS[lod];
+
+	for (int stack = 0; stack <= stacks; stack++)
+	{
+		// from the north pole down to the south pole
+		float phi = glm::half_pi<float>() - stack * glm::pi<float>() / stacks;
+		float ringRadius = cos(phi);
+		float y = sin(phi);
+
+		for (int sector = 0; sector <= sectors; sector++)
+		{
+			float theta = sector * glm::two_pi<float>() / sectors;
+			glm::vec3 position(ringRadius * cos(theta), y, ringRadius * sin(theta));
+			glm::vec2 uv((float)sector / sectors, 1.0f - (float)stack / stacks);
+			vertices.push_back({ position, position, uv });
+		}
+	}
+
+	for (int stack = 0; stack < stacks; stack++)
+	{
+		GLuint row = stack * (sectors + 1);
+		GLuint nextRow = row + sectors + 1;
+		for (int sector = 0; sector < sectors; sector++)
+		{
+			indices.insert(indices.end(), {
+				row + sector, nextRow + sector, row + sector + 1,
+				row + sector + 1, nextRow + sector, nextRow + sector + 1 });
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildCylinder()
+ *
+ *  This method is used for generating a unit radius
+ *  cylinder standing on Y=0 with a height of 1, including
+ *  the top and bottom caps.
+ ***********************************************************/
+void MeshLibrary::BuildCylinder(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices, int lod)
+{
+	vertices.clear();
+	indices.clear();
+
+	const int sectors = CYLINDER_SECTORS[lod];
+
+	// sides
+	for (int sector = 0; sector <= sectors; sector++)
+	{
+		float theta = sector * glm::two_pi<float>() / sectors;
+		glm::vec3 normal(cos(theta), 0.0f, sin(theta));
+		float u = (float)sector / sectors;
+		vertices.push_back({ normal, normal, glm::vec2(u, 0.0f) });
+		vertices.push_back({ normal + glm::vec3(0.0f, 1.0f, 0.0f), normal, glm::vec2(u, 1.0f) });
+	}
+	for (int sector = 0; sector < sectors; sector++)
+	{
+		GLuint i = sector * 2;
+		indices.insert(indices.end(), { i, i + 1, i + 2, i + 2, i + 1, i + 3 });
+	}
+
+	// top and bottom caps as triangle fans around a center vertex
+	for (int cap = 0; cap < 2; cap++)
+	{
+		float y = (cap == 0) ? 0.0f : 1.0f;
+		glm::vec3 normal(0.0f, (cap == 0) ? -1.0f : 1.0f, 0.0f);
+		GLuint center = (GLuint)vertices.size();
+		vertices.push_back({ glm::vec3(0.0f, y, 0.0f), normal, glm::vec2(0.5f, 0.5f) });
+		for (int sector = 0; sector <= sectors; sector++)
+		{
+			float theta = sector * glm::two_pi<float>() / sectors;
+			glm::vec3 position(cos(theta), y, sin(theta));
+			glm::vec2 uv(0.5f + 0.5f * position.x, 0.5f + 0.5f * position.z);
+			vertices.push_back({ position, normal, uv });
+		}
+		for (int sector = 0; sector < sectors; sector++)
+		{
+			indices.insert(indices.end(), { center, center + 1 + sector, center + 2 + sector });
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildPyramid4()
+ *
+ *  This method is used for generating a four sided pyramid
+ *  with a unit square base at Y=-0.5 and its apex at Y=0.5.
+ ***********************************************************/
+void MeshLibrary::BuildPyramid4(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices)
+{
+	vertices.clear();
+	indices.clear();
+
+	const glm::vec3 apex(0.0f, 0.5f, 0.0f);
+	const glm::vec3 corners[4] = {
+		glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(0.5f, -0.5f, 0.5f),
+		glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(-0.5f, -0.5f, -0.5f) };
+
+	// four triangular sides, each with its own flat normal
+	for (int side = 0; side < 4; side++)
+	{
+		const glm::vec3& a = corners[side];
+		const glm::vec3& b = corners[(side + 1) % 4];
+		glm::vec3 normal = glm::normalize(glm::cross(b - a, apex - a));
+		GLuint base = (GLuint)vertices.size();
+		vertices.push_back({ a, normal, glm::vec2(0.0f, 0.0f) });
+		vertices.push_back({ b, normal, glm::vec2(1.0f, 0.0f) });
+		vertices.push_back({ apex, normal, glm::vec2(0.5f, 1.0f) });
+		indices.insert(indices.end(), { base, base + 1, base + 2 });
+	}
+
+	// square base
+	const glm::vec3 down(0.0f, -1.0f, 0.0f);
+	GLuint base = (GLuint)vertices.size();
+	vertices.push_back({ corners[0], down, glm::vec2(0.0f, 0.0f) });
+	vertices.push_back({ corners[1], down, glm::vec2(1.0f, 0.0f) });
+	vertices.push_back({ corners[2], down, glm::vec2(1.0f, 1.0f) });
+	vertices.push_back({ corners[3], down, glm::vec2(0.0f, 1.0f) });
+	indices.insert(indices.end(), { base, base + 2, base + 1, base, base + 3, base + 2 });
+}
+
+/***********************************************************
+ *  BuildCone()
+ *
+ *  This method is used for generating a unit radius cone
+ *  standing on Y=0 with its tip at Y=1.
+ ***********************************************************/
+void MeshLibrary::BuildCone(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices, int lod)
+{
+	vertices.clear();
+	indices.clear();
+
+	const int sectors = CYLINDER_SECTORS[lod];
+
+	// the side normal leans up by 45 degrees for a cone
+	// whose height equals its radius
+	const float slope = 0.70710678f;
+
+	for (int sector = 0; sector <= sectors; sector++)
+	{
+		float theta = sector * glm::two_pi<float>() / sectors;
+		glm::vec3 rim(cos(theta), 0.0f, sin(theta));
+		glm::vec3 normal(rim.x * slope, slope, rim.z * slope);
+		float u = (float)sector / sectors;
+		vertices.push_back({ rim, normal, glm::vec2(u, 0.0f) });
+		vertices.push_back({ glm::vec3(0.0f, 1.0f, 0.0f), normal, glm::vec2(u, 1.0f) });
+	}
+	for (int sector = 0; sector < sectors; sector++)
+	{
+		GLuint i = sector * 2;
+		indices.insert(indices.end(), { i, i + 1, i + 2 });
+	}
+
+	// bottom cap
+	const glm::vec3 down(0.0f, -1.0f, 0.0f);
+	GLuint center = (GLuint)vertices.size();
+	vertices.push_back({ glm::vec3(0.0f), down, glm::vec2(0.5f, 0.5f) });
+	for (int sector = 0; sector <= sectors; sector++)
+	{
+		float theta = sector * glm::two_pi<float>() / sectors;
+		glm::vec3 position(cos(theta), 0.0f, sin(theta));
+		vertices.push_back({ position, down, glm::vec2(0.5f + 0.5f * position.x, 0.5f + 0.5f * position.z) });
+	}
+	for (int sector = 0; sector < sectors; sector++)
+	{
+		indices.insert(indices.end(), { center, center + 2 + sector, center + 1 + sector });
+	}
+}
+
+/***********************************************************
+ *  BuildTorus()
+ *
+ *  This method is used for generating a torus lying in the
+ *  XY plane around the Z axis.
+ ***********************************************************/
+void MeshLibrary::BuildTorus(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices, int lod)
+{
+	vertices.clear();
+	indices.clear();
+
+	const int mainSegments = TORUS_MAIN_SEGMENTS[lod];
+	const int tubeSegments = TORUS_TUBE_SEGMENTS[lod];
+
+	for (int i = 0; i <= mainSegments; i++)
+	{
+		float mainAngle = i * glm::two_pi<float>() / mainSegments;
+		glm::vec3 ringDirection(cos(mainAngle), sin(mainAngle), 0.0f);
+
+		for (int j = 0; j <= tubeSegments; j++)
+		{
+			float tubeAngle = j * glm::two_pi<float>() / tubeSegments;
+			glm::vec3 normal = ringDirection * cos(tubeAngle) + glm::vec3(0.0f, 0.0f, sin(tubeAngle));
+			glm::vec3 position = ringDirection * TORUS_MAIN_RADIUS + normal * TORUS_TUBE_RADIUS;
+			glm::vec2 uv((float)i / mainSegments, (float)j / tubeSegments);
+			vertices.push_back({ position, normal, uv });
+		}
+	}
+
+	for (int i = 0; i < mainSegments; i++)
+	{
+		GLuint row = i * (tubeSegments + 1);
+		GLuint nextRow = row + tubeSegments + 1;
+		for (int j = 0; j < tubeSegments; j++)
+		{
+			indices.insert(indices.end(), {
+				row + j, nextRow + j, row + j + 1,
+				row + j + 1, nextRow + j, nextRow + j + 1 });
+		}
+	}
+}
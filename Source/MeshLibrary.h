@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshlibrary.h
+// ============
+// generate the basic 3D shape meshes into one shared, quantized vertex and
+// index buffer and draw them with per-instance model matrices
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CullingBVH.h"
+#include "UploadRing.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// basic shape meshes that scene objects can be drawn with
+enum MESH_TYPE
+{
+	MESH_PLANE,
+	MESH_BOX,
+	MESH_SPHERE,
+	MESH_CYLINDER,
+	MESH_PYRAMID4,
+	MESH_CONE,
+	MESH_TORUS,
+	MESH_COUNT
+};
+
+// most tessellation levels a curved mesh is generated at
+const int MAX_MESH_LODS = 4;
+
+/***********************************************************
+ *  MeshLibrary
+ *
+ *  This class generates the same basic shapes as the
+ *  ShapeMeshes utility (unit sized, same orientation and
+ *  texture mapping) and adds an instanced draw path.  All
+ *  of the meshes live in one vertex buffer and one index
+ *  buffer behind a single VAO, with 16-byte quantized
+ *  vertices, so a draw only picks its base vertex and first
+ *  index.  The model matrix comes from a shared instance
+ *  buffer at vertex attribute locations 3 to 6, and the
+ *  per-instance draw settings from a parallel buffer at
+ *  locations 7 to 9.  With OpenGL 4.3 a whole list of draws
+ *  can go out as one glMultiDrawElementsIndirect.  The
+ *  curved meshes are generated at several levels of detail,
+ *  LOD 0 being the finest, and every draw picks one.
+ ***********************************************************/
+class MeshLibrary
+{
+public:
+	// draw settings of one instance, read by the shaders in
+	// place of the per-draw uniforms during a multi-draw
+	struct INSTANCE_SETTINGS
+	{
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		// texture table slot, or -1 to draw with the color
+		GLint textureSlot;
+		GLint materialIndex;
+	};
+
+	// one draw in the indirect buffer, laid out the way
+	// glMultiDrawElementsIndirect reads it
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// constructor
+	MeshLibrary();
+	// destructor
+	~MeshLibrary();
+
+	// generate all of the basic meshes in GPU memory
+	void LoadMeshes();
+
+	// replace the contents of the instance matrix buffer
+	void SetInstanceData(const glm::mat4* matrices, int count);
+	// overwrite a range of the instance matrix buffer
+	void UpdateInstanceData(int firstInstance, int count, const glm::mat4* matrices);
+	// replace the contents of the instance settings buffer
+	void SetInstanceSettings(const INSTANCE_SETTINGS* settings, int count);
+	// send the buffer updates through an upload ring, NULL to
+	// send them with glBufferSubData
+	void SetUploadRing(UploadRing* pUploadRing) { m_pUploadRing = pUploadRing; }
+
+	// bind the shared VAO before a run of mesh draws
+	void BeginDraws() const;
+	// unbind the shared VAO after the last mesh draw
+	void EndDraws() const;
+	// draw a range of instances of a mesh at a level of
+	// detail with one draw call, between BeginDraws() and
+	// EndDraws()
+	void DrawMeshInstanced(MESH_TYPE mesh, int lod, int firstInstance, int instanceCount) const;
+
+	// box around a mesh in its own coordinates
+	const CullingBVH::AABB& LocalBounds(MESH_TYPE mesh) const { return m_bounds[mesh]; }
+
+	// number of levels of detail a mesh was generated at
+	int LodCount(MESH_TYPE mesh) const { return m_lodCounts[mesh]; }
+	// pick the level of detail for an instance covering the
+	// passed in pixels across, staying at the current level
+	// until the size is clearly past the switch point
+	int SelectLod(MESH_TYPE mesh, float pixels, int currentLod) const;
+	// radius of the part of a mesh that its level of detail
+	// tessellates, after the passed in model matrix
+	static float TessellatedRadius(MESH_TYPE mesh, const glm::mat4& model);
+
+	// check whether the driver can run multi-draw-indirect
+	static bool SupportsMultiDraw();
+	// fill in the indirect command for a range of instances
+	// of a mesh at a level of detail
+	void MakeDrawCommand(MESH_TYPE mesh, int lod, int firstInstance, int instanceCount, DRAW_COMMAND& command) const;
+	// replace the contents of the indirect command buffer
+	void SetDrawCommands(const DRAW_COMMAND* commands, int count);
+	// submit a range of the indirect commands with one call,
+	// between BeginDraws() and EndDraws()
+	void DrawMultiIndirect(int firstCommand, int commandCount) const;
+	// submit a range of the commands a culling pass wrote,
+	// drawing the instances it kept, and report the passed in
+	// triangle count to the profiler
+	void DrawCulledMultiIndirect(GLuint commandBuffer, GLuint matrixBuffer, GLuint settingsBuffer,
+		int firstCommand, int commandCount, int triangles) const;
+
+	// buffers a culling pass reads the draws from
+	GLuint IndirectBuffer() const { return m_indirectBuffer; }
+	GLuint InstanceBuffer() const { return m_instanceVBO; }
+	GLuint SettingsBuffer() const { return m_settingsVBO; }
+
+	// convenience entry points for drawing from the first instance
+	// at the finest level of detail
+	void DrawPlaneMeshInstanced(int count) const { DrawMeshInstanced(MESH_PLANE, 0, 0, count); }
+	void DrawBoxMeshInstanced(int count) const { DrawMeshInstanced(MESH_BOX, 0, 0, count); }
+	void DrawSphereMeshInstanced(int count) const { DrawMeshInstanced(MESH_SPHERE, 0, 0, count); }
+	void DrawCylinderMeshInstanced(int count) const { DrawMeshInstanced(MESH_CYLINDER, 0, 0, count); }
+	void DrawPyramid4MeshInstanced(int count) const { DrawMeshInstanced(MESH_PYRAMID4, 0, 0, count); }
+	void DrawConeMeshInstanced(int count) const { DrawMeshInstanced(MESH_CONE, 0, 0, count); }
+	void DrawTorusMeshInstanced(int count) const { DrawMeshInstanced(MESH_TORUS, 0, 0, count); }
+
+private:
+	// where one mesh lives in the shared buffers
+	struct GLMesh
+	{
+		GLint baseVertex;
+		GLsizei firstIndex;
+		GLsizei nIndices;
+	};
+
+	// interleaved position, normal and texture coordinate, as
+	// the shape generators produce it
+	struct VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+
+	// the VERTEX quantized for the GPU, 16 bytes instead of 32
+	struct PACKED_VERTEX
+	{
+		// snorm16 position divided by MESH_POSITION_RANGE,
+		// the fourth component pads to 8 bytes
+		int16_t position[4];
+		// snorm16 octahedral encoding of the unit normal
+		int16_t normal[2];
+		// unorm16 texture coordinate
+		uint16_t uv[2];
+	};
+
+	// generated mesh ranges, indexed by MESH_TYPE and level
+	// of detail, and the levels each mesh has
+	GLMesh m_meshes[MESH_COUNT][MAX_MESH_LODS];
+	int m_lodCounts[MESH_COUNT];
+	// local bounds of the generated meshes, indexed by MESH_TYPE
+	CullingBVH::AABB m_bounds[MESH_COUNT];
+	// VAO and buffers shared by every mesh
+	GLuint m_vao;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	// per-instance model matrices shared by every mesh
+	GLuint m_instanceVBO;
+	// number of matrices the instance buffer can hold
+	int m_instanceCapacity;
+	// per-instance draw settings, in the same order
+	GLuint m_settingsVBO;
+	int m_settingsCapacity;
+	// indirect draw commands, with a CPU copy for counting
+	GLuint m_indirectBuffer;
+	int m_indirectCapacity;
+	std::vector<DRAW_COMMAND> m_drawCommands;
+	// ring the buffer updates are written through, when set
+	UploadRing* m_pUploadRing;
+
+	// quantize one level of a generated mesh onto the end of
+	// the shared vertex and index lists
+	void AppendMesh(
+		MESH_TYPE mesh,
+		int lod,
+		const std::vector<VERTEX>& vertices,
+		const std::vector<GLuint>& indices,
+		std::vector<PACKED_VERTEX>& packedVertices,
+		std::vector<GLushort>& packedIndices);
+	// create the shared VAO and buffers from the packed lists
+	void UploadMeshes(
+		const std::vector<PACKED_VERTEX>& packedVertices,
+		const std::vector<GLushort>& packedIndices);
+	// quantize one vertex into the packed layout
+	static PACKED_VERTEX PackVertex(const VERTEX& vertex);
+	// point the instance attributes at the passed in instance
+	// of the passed in matrix and settings buffers
+	void BindInstanceAttributes(GLuint matrixBuffer, GLuint settingsBuffer, int firstInstance) const;
+	// grow a buffer to hold the passed in data, or overwrite
+	// it when it is big enough already
+	void StoreBufferData(GLenum target, GLuint buffer, int& capacity, int count, size_t elementSize, const void* data);
+	// overwrite a range of a buffer, through the upload ring
+	// while it has room
+	void UpdateBufferData(GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+
+	// geometry generators for each basic shape, the curved
+	// ones at the tessellation of a level of detail
+	void BuildPlane(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices);
+	void BuildBox(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices);
+	void BuildSphere(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices, int lod);
+	void BuildCylinder(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices, int lod);
+	void BuildPyramid4(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices);
+	void BuildCone(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices, int lod);
+	void BuildTorus(std::vector<VERTEX>& vertices, std::vector<GLuint>& indices, int lod);
+};
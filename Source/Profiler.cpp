@@ -0,0 +1,540 @@
+///////////////////////////////////////////////////////////////////////////////
+// profiler.cpp
+// ============
+// This file contains the implementation of the `Profiler` class, which
+// measures where the time of every frame goes.
+//
+// RESPONSIBILITIES:
+// - Time frame stages on the CPU and, without stalling, on the GPU.
+// - Count draw calls, triangles, uniform uploads and texture binds.
+// - Count the jobs, steals and lock contention of the job system.
+// - Count the render thread's heap allocations and frame arena use.
+// - Count the upload ring traffic and the stalls waiting on its fences.
+// - Keep a rolling history for p50/p95/p99 percentiles and CSV exports.
+//
+// NOTE: GPU results arrive two frames late, so the newest frames of the
+// history show -1 for their GPU times until the queries complete.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+const int Profiler::HISTORY_FRAMES;
+const int Profiler::GPU_QUERY_FRAMES;
+int Profiler::s_counters[Profiler::COUNTER_COUNT] = { 0 };
+
+/***********************************************************
+ *  Profiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+Profiler::Profiler()
+{
+	m_records.reserve(HISTORY_FRAMES);
+	m_samples.reserve(HISTORY_FRAMES);
+	m_newestRecord = -1;
+	m_frameIndex = 0;
+	m_bFrameStarted = false;
+	m_openGpuScope = -1;
+
+	for (int set = 0; set < GPU_QUERY_FRAMES; ++set)
+	{
+		for (int scope = 0; scope < SCOPE_COUNT; ++scope)
+		{
+			m_queries[set][scope] = 0;
+			m_queryFrame[set][scope] = -1;
+		}
+	}
+}
+
+/***********************************************************
+ *  ~Profiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+Profiler::~Profiler()
+{
+	if (m_queries[0][0] != 0)
+	{
+		glDeleteQueries(GPU_QUERY_FRAMES * SCOPE_COUNT, &m_queries[0][0]);
+	}
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the timer queries.
+ *  Without them the GPU scopes quietly do nothing.
+ ***********************************************************/
+void Profiler::Create()
+{
+	if (m_queries[0][0] == 0)
+	{
+		glGenQueries(GPU_QUERY_FRAMES * SCOPE_COUNT, &m_queries[0][0]);
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a new frame record.
+ *  The GPU results of the query set used two frames ago
+ *  are collected first, since that set is reused now.
+ ***********************************************************/
+void Profiler::BeginFrame()
+{
+	Clock::time_point now = Clock::now();
+
+	m_current.frame = m_frameIndex;
+	m_current.frameMilliseconds = 0.0f;
+	if (m_frameIndex > 0)
+	{
+		m_current.frameMilliseconds =
+			std::chrono::duration<float, std::milli>(now - m_frameStart).count();
+	}
+	for (int scope = 0; scope < SCOPE_COUNT; ++scope)
+	{
+		m_current.cpuMilliseconds[scope] = 0.0f;
+		m_current.gpuMilliseconds[scope] = -1.0f;
+	}
+	for (int counter = 0; counter < COUNTER_COUNT; ++counter)
+	{
+		s_counters[counter] = 0;
+	}
+
+	CollectGpuResults(m_frameIndex % GPU_QUERY_FRAMES);
+
+	m_frameStart = now;
+	m_bFrameStarted = true;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for storing the finished frame in
+ *  the history, replacing the oldest frame once it is full.
+ ***********************************************************/
+void Profiler::EndFrame()
+{
+	if (m_bFrameStarted == false)
+	{
+		return;
+	}
+
+	for (int counter = 0; counter < COUNTER_COUNT; ++counter)
+	{
+		m_current.counters[counter] = s_counters[counter];
+	}
+
+	if ((int)m_records.size() < HISTORY_FRAMES)
+	{
+		m_records.push_back(m_current);
+		m_newestRecord = (int)m_records.size() - 1;
+	}
+	else
+	{
+		m_newestRecord = (m_newestRecord + 1) % HISTORY_FRAMES;
+		m_records[m_newestRecord] = m_current;
+	}
+
+	m_frameIndex++;
+	m_bFrameStarted = false;
+}
+
+/***********************************************************
+ *  BeginCpuScope()
+ *
+ *  This method is used for starting the CPU timer of a
+ *  scope.
+ ***********************************************************/
+void Profiler::BeginCpuScope(PROFILE_SCOPE scope)
+{
+	m_scopeStart[scope] = Clock::now();
+}
+
+/***********************************************************
+ *  EndCpuScope()
+ *
+ *  This method is used for adding the time since the scope
+ *  started to the frame in progress.
+ ***********************************************************/
+void Profiler::EndCpuScope(PROFILE_SCOPE scope)
+{
+	m_current.cpuMilliseconds[scope] +=
+		std::chrono::duration<float, std::milli>(Clock::now() - m_scopeStart[scope]).count();
+}
+
+/***********************************************************
+ *  BeginGpuScope()
+ *
+ *  This method is used for starting the GPU timer of a
+ *  scope.  OpenGL allows only one GL_TIME_ELAPSED query at
+ *  a time, so false is returned while another one is open.
+ ***********************************************************/
+bool Profiler::BeginGpuScope(PROFILE_SCOPE scope)
+{
+	if ((m_queries[0][0] == 0) || (m_openGpuScope >= 0))
+	{
+		return(false);
+	}
+
+	int querySet = m_frameIndex % GPU_QUERY_FRAMES;
+	glBeginQuery(GL_TIME_ELAPSED, m_queries[querySet][scope]);
+	m_queryFrame[querySet][scope] = m_frameIndex;
+	m_openGpuScope = scope;
+
+	return(true);
+}
+
+/***********************************************************
+ *  EndGpuScope()
+ *
+ *  This method is used for stopping the GPU timer of a
+ *  scope.
+ ***********************************************************/
+void Profiler::EndGpuScope(PROFILE_SCOPE scope)
+{
+	if (m_openGpuScope != scope)
+	{
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	m_openGpuScope = -1;
+}
+
+/***********************************************************
+ *  CollectGpuResults()
+ *
+ *  This method is used for reading the finished queries of
+ *  a query set into the frames they were issued in.  A
+ *  result that is not ready yet is dropped rather than
+ *  waited for, so the CPU never stalls on the GPU.
+ ***********************************************************/
+void Profiler::CollectGpuResults(int querySet)
+{
+	for (int scope = 0; scope < SCOPE_COUNT; ++scope)
+	{
+		int frame = m_queryFrame[querySet][scope];
+		if (frame < 0)
+		{
+			continue;
+		}
+		m_queryFrame[querySet][scope] = -1;
+
+		GLint available = 0;
+		glGetQueryObjectiv(m_queries[querySet][scope], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+		{
+			continue;
+		}
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(m_queries[querySet][scope], GL_QUERY_RESULT, &nanoseconds);
+
+		FRAME_RECORD* pRecord = FindRecord(frame);
+		if (NULL != pRecord)
+		{
+			pRecord->gpuMilliseconds[scope] = (float)((double)nanoseconds / 1.0e6);
+		}
+	}
+}
+
+/***********************************************************
+ *  FindRecord()
+ *
+ *  This method is used for finding the kept record of a
+ *  frame number.
+ ***********************************************************/
+Profiler::FRAME_RECORD* Profiler::FindRecord(int frame)
+{
+	if (m_newestRecord < 0)
+	{
+		return(NULL);
+	}
+
+	int count = (int)m_records.size();
+	int age = m_records[m_newestRecord].frame - frame;
+	if ((age < 0) || (age >= count))
+	{
+		return(NULL);
+	}
+
+	return(&m_records[(m_newestRecord - age + count) % count]);
+}
+
+/***********************************************************
+ *  Record()
+ *
+ *  This method is used for getting a kept frame in order,
+ *  starting with the oldest one.
+ ***********************************************************/
+const Profiler::FRAME_RECORD& Profiler::Record(int index) const
+{
+	int count = (int)m_records.size();
+	int oldest = (count < HISTORY_FRAMES) ? 0 : (m_newestRecord + 1) % HISTORY_FRAMES;
+
+	return(m_records[(oldest + index) % count]);
+}
+
+/***********************************************************
+ *  FramePercentiles()
+ *
+ *  This method is used for the percentiles of the time
+ *  between frames.  The first frame has no previous frame
+ *  and is left out.
+ ***********************************************************/
+Profiler::PERCENTILES Profiler::FramePercentiles() const
+{
+	m_samples.clear();
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		if (m_records[i].frame > 0)
+		{
+			m_samples.push_back(m_records[i].frameMilliseconds);
+		}
+	}
+	return(ComputePercentiles());
+}
+
+/***********************************************************
+ *  CpuPercentiles()
+ *
+ *  This method is used for the percentiles of the CPU time
+ *  of a scope.
+ ***********************************************************/
+Profiler::PERCENTILES Profiler::CpuPercentiles(PROFILE_SCOPE scope) const
+{
+	m_samples.clear();
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		m_samples.push_back(m_records[i].cpuMilliseconds[scope]);
+	}
+	return(ComputePercentiles());
+}
+
+/***********************************************************
+ *  GpuPercentiles()
+ *
+ *  This method is used for the percentiles of the GPU time
+ *  of a scope, over the frames whose results arrived.
+ ***********************************************************/
+Profiler::PERCENTILES Profiler::GpuPercentiles(PROFILE_SCOPE scope) const
+{
+	m_samples.clear();
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		if (m_records[i].gpuMilliseconds[scope] >= 0.0f)
+		{
+			m_samples.push_back(m_records[i].gpuMilliseconds[scope]);
+		}
+	}
+	return(ComputePercentiles());
+}
+
+/***********************************************************
+ *  CounterPercentiles()
+ *
+ *  This method is used for the percentiles of a counter.
+ ***********************************************************/
+Profiler::PERCENTILES Profiler::CounterPercentiles(PROFILE_COUNTER counter) const
+{
+	m_samples.clear();
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		m_samples.push_back((float)m_records[i].counters[counter]);
+	}
+	return(ComputePercentiles());
+}
+
+/***********************************************************
+ *  ComputePercentiles()
+ *
+ *  This method is used for sorting the gathered samples and
+ *  picking the nearest rank for each percentile.  With no
+ *  samples all percentiles are -1.
+ ***********************************************************/
+Profiler::PERCENTILES Profiler::ComputePercentiles() const
+{
+	PERCENTILES percentiles;
+	percentiles.p50 = -1.0f;
+	percentiles.p95 = -1.0f;
+	percentiles.p99 = -1.0f;
+
+	if (m_samples.empty())
+	{
+		return(percentiles);
+	}
+
+	std::sort(m_samples.begin(), m_samples.end());
+	int last = (int)m_samples.size() - 1;
+	percentiles.p50 = m_samples[(int)(last * 0.50f + 0.5f)];
+	percentiles.p95 = m_samples[(int)(last * 0.95f + 0.5f)];
+	percentiles.p99 = m_samples[(int)(last * 0.99f + 0.5f)];
+
+	return(percentiles);
+}
+
+/***********************************************************
+ *  WriteCSV()
+ *
+ *  This method is used for writing every kept frame, oldest
+ *  first, as one CSV row.  GPU times that never arrived are
+ *  written as -1.
+ ***********************************************************/
+bool Profiler::WriteCSV(const char* filePath) const
+{
+	std::ofstream file(filePath);
+	if (!file.is_open())
+	{
+		std::cout << "Could not open the profile CSV file: " << filePath << std::endl;
+		return(false);
+	}
+
+	file << "frame,frame_ms";
+	for (int scope = 0; scope < SCOPE_COUNT; ++scope)
+	{
+		file << "," << ScopeName((PROFILE_SCOPE)scope) << "_cpu_ms";
+	}
+	for (int scope = 0; scope < SCOPE_COUNT; ++scope)
+	{
+		file << "," << ScopeName((PROFILE_SCOPE)scope) << "_gpu_ms";
+	}
+	for (int counter = 0; counter < COUNTER_COUNT; ++counter)
+	{
+		file << "," << CounterName((PROFILE_COUNTER)counter);
+	}
+	file << "\n";
+
+	for (int i = 0; i < RecordCount(); ++i)
+	{
+		const FRAME_RECORD& record = Record(i);
+
+		file << record.frame << "," << record.frameMilliseconds;
+		for (int scope = 0; scope < SCOPE_COUNT; ++scope)
+		{
+			file << "," << record.cpuMilliseconds[scope];
+		}
+		for (int scope = 0; scope < SCOPE_COUNT; ++scope)
+		{
+			file << "," << record.gpuMilliseconds[scope];
+		}
+		for (int counter = 0; counter < COUNTER_COUNT; ++counter)
+		{
+			file << "," << record.counters[counter];
+		}
+		file << "\n";
+	}
+
+	std::cout << "Wrote " << RecordCount() << " profiled frames to " << filePath << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  ScopeName()
+ *
+ *  This method is used for getting the name of a scope.
+ ***********************************************************/
+const char* Profiler::ScopeName(PROFILE_SCOPE scope)
+{
+	switch (scope)
+	{
+	case SCOPE_PREPARE_VIEW:
+		return("PrepareSceneView");
+	case SCOPE_UPDATE_SCENE:
+		return("UpdateScene");
+	case SCOPE_RENDER_SCENE:
+		return("RenderScene");
+	case SCOPE_OVERLAY:
+		return("Overlay");
+	case SCOPE_SWAP_BUFFERS:
+		return("SwapBuffers");
+	default:
+		return("Unknown");
+	}
+}
+
+/***********************************************************
+ *  CounterName()
+ *
+ *  This method is used for getting the name of a counter.
+ ***********************************************************/
+const char* Profiler::CounterName(PROFILE_COUNTER counter)
+{
+	switch (counter)
+	{
+	case COUNTER_DRAW_CALLS:
+		return("DrawCalls");
+	case COUNTER_TRIANGLES:
+		return("Triangles");
+	case COUNTER_UNIFORM_UPLOADS:
+		return("UniformUploads");
+	case COUNTER_TEXTURE_BINDS:
+		return("TextureBinds");
+	case COUNTER_OBJECTS_DRAWN:
+		return("ObjectsDrawn");
+	case COUNTER_OBJECTS_CULLED:
+		return("ObjectsCulled");
+	case COUNTER_JOBS_RUN:
+		return("JobsRun");
+	case COUNTER_JOBS_STOLEN:
+		return("JobsStolen");
+	case COUNTER_CONTENDED_LOCKS:
+		return("ContendedLocks");
+	case COUNTER_JOB_UTILIZATION:
+		return("JobUtilization%");
+	case COUNTER_HEAP_ALLOCATIONS:
+		return("HeapAllocs");
+	case COUNTER_HEAP_KILOBYTES:
+		return("HeapKB");
+	case COUNTER_ARENA_BYTES:
+		return("FrameArenaBytes");
+	case COUNTER_UPLOAD_KILOBYTES:
+		return("UploadKB");
+	case COUNTER_UPLOAD_STALLS:
+		return("UploadStalls");
+	default:
+		return("Unknown");
+	}
+}
+
+/***********************************************************
+ *  ProfileScope()
+ *
+ *  The constructor for the class, which starts the timers
+ ***********************************************************/
+ProfileScope::ProfileScope(Profiler* pProfiler, Profiler::PROFILE_SCOPE scope, bool bGpu)
+{
+	m_pProfiler = pProfiler;
+	m_scope = scope;
+	m_bGpu = false;
+
+	if (NULL != m_pProfiler)
+	{
+		m_pProfiler->BeginCpuScope(m_scope);
+		if (bGpu)
+		{
+			m_bGpu = m_pProfiler->BeginGpuScope(m_scope);
+		}
+	}
+}
+
+/***********************************************************
+ *  ~ProfileScope()
+ *
+ *  The destructor for the class, which stops the timers
+ ***********************************************************/
+ProfileScope::~ProfileScope()
+{
+	if (NULL != m_pProfiler)
+	{
+		if (m_bGpu)
+		{
+			m_pProfiler->EndGpuScope(m_scope);
+		}
+		m_pProfiler->EndCpuScope(m_scope);
+	}
+}
@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////////
+// profiler.h
+// ============
+// time the stages of every frame on the CPU and the GPU, count the draw work
+// and keep a rolling history for percentiles, the overlay and CSV exports
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <vector>
+
+/***********************************************************
+ *  Profiler
+ *
+ *  This class records one FRAME_RECORD per frame.  CPU
+ *  scopes are timed with a high resolution clock.  GPU
+ *  scopes use GL_TIME_ELAPSED queries in two sets that
+ *  alternate by frame, so a result is only read back two
+ *  frames later and is dropped instead of waited for when
+ *  it is still not ready.  GPU scopes cannot nest.  The
+ *  counters are static so any module can bump them without
+ *  holding a profiler pointer.
+ ***********************************************************/
+class Profiler
+{
+public:
+	// timed stages of a frame
+	enum PROFILE_SCOPE
+	{
+		SCOPE_PREPARE_VIEW,
+		SCOPE_UPDATE_SCENE,
+		SCOPE_RENDER_SCENE,
+		SCOPE_OVERLAY,
+		SCOPE_SWAP_BUFFERS,
+		SCOPE_COUNT
+	};
+
+	// work counted during a frame
+	enum PROFILE_COUNTER
+	{
+		COUNTER_DRAW_CALLS,
+		COUNTER_TRIANGLES,
+		COUNTER_UNIFORM_UPLOADS,
+		COUNTER_TEXTURE_BINDS,
+		COUNTER_OBJECTS_DRAWN,
+		COUNTER_OBJECTS_CULLED,
+		COUNTER_JOBS_RUN,
+		COUNTER_JOBS_STOLEN,
+		COUNTER_CONTENDED_LOCKS,
+		COUNTER_JOB_UTILIZATION,
+		COUNTER_HEAP_ALLOCATIONS,
+		COUNTER_HEAP_KILOBYTES,
+		COUNTER_ARENA_BYTES,
+		COUNTER_UPLOAD_KILOBYTES,
+		COUNTER_UPLOAD_STALLS,
+		COUNTER_COUNT
+	};
+
+	// measurements of one frame
+	struct FRAME_RECORD
+	{
+		// frame number since the profiler was created
+		int frame;
+		// time since the start of the previous frame
+		float frameMilliseconds;
+		// CPU time of every scope, 0 when it did not run
+		float cpuMilliseconds[SCOPE_COUNT];
+		// GPU time of every scope, -1 until the result arrives
+		float gpuMilliseconds[SCOPE_COUNT];
+		// value of every counter
+		int counters[COUNTER_COUNT];
+	};
+
+	// rolling percentiles of one measurement
+	struct PERCENTILES
+	{
+		float p50;
+		float p95;
+		float p99;
+	};
+
+	// frames kept for the percentiles and the CSV export
+	static const int HISTORY_FRAMES = 240;
+	// GPU query sets, alternating by frame
+	static const int GPU_QUERY_FRAMES = 2;
+
+	// constructor
+	Profiler();
+	// destructor
+	~Profiler();
+
+	// create the GPU timer queries
+	void Create();
+
+	// start and finish a frame
+	void BeginFrame();
+	void EndFrame();
+
+	// start and stop timing a scope on the CPU
+	void BeginCpuScope(PROFILE_SCOPE scope);
+	void EndCpuScope(PROFILE_SCOPE scope);
+	// start and stop timing a scope on the GPU, false when
+	// another GPU scope is still open
+	bool BeginGpuScope(PROFILE_SCOPE scope);
+	void EndGpuScope(PROFILE_SCOPE scope);
+
+	// rolling percentiles over the kept frames
+	PERCENTILES FramePercentiles() const;
+	PERCENTILES CpuPercentiles(PROFILE_SCOPE scope) const;
+	PERCENTILES GpuPercentiles(PROFILE_SCOPE scope) const;
+	PERCENTILES CounterPercentiles(PROFILE_COUNTER counter) const;
+
+	// number of kept frames
+	int RecordCount() const { return (int)m_records.size(); }
+	// kept frame, 0 is the oldest
+	const FRAME_RECORD& Record(int index) const;
+	// number of frames started so far
+	int FrameIndex() const { return m_frameIndex; }
+
+	// write every kept frame to a CSV file
+	bool WriteCSV(const char* filePath) const;
+
+	// readable names used by the overlay and the CSV header
+	static const char* ScopeName(PROFILE_SCOPE scope);
+	static const char* CounterName(PROFILE_COUNTER counter);
+
+	// count the work of the frame in progress
+	static void CountDrawCall(int triangles)
+	{
+		s_counters[COUNTER_DRAW_CALLS]++;
+		s_counters[COUNTER_TRIANGLES] += triangles;
+	}
+	static void CountUniformUpload() { s_counters[COUNTER_UNIFORM_UPLOADS]++; }
+	static void CountTextureBind() { s_counters[COUNTER_TEXTURE_BINDS]++; }
+	static void CountObjects(int drawn, int culled)
+	{
+		s_counters[COUNTER_OBJECTS_DRAWN] += drawn;
+		s_counters[COUNTER_OBJECTS_CULLED] += culled;
+	}
+	// the utilization is a percentage of the threads' time
+	// inside parallel loops
+	static void CountJobs(int run, int stolen, int contendedLocks, int utilizationPercent)
+	{
+		s_counters[COUNTER_JOBS_RUN] += run;
+		s_counters[COUNTER_JOBS_STOLEN] += stolen;
+		s_counters[COUNTER_CONTENDED_LOCKS] += contendedLocks;
+		s_counters[COUNTER_JOB_UTILIZATION] = utilizationPercent;
+	}
+	// the heap counts are the render thread's, the arena size
+	// is what the frame took from the frame arena
+	static void CountMemory(int heapAllocations, int heapKilobytes, int arenaBytes)
+	{
+		s_counters[COUNTER_HEAP_ALLOCATIONS] += heapAllocations;
+		s_counters[COUNTER_HEAP_KILOBYTES] += heapKilobytes;
+		s_counters[COUNTER_ARENA_BYTES] = arenaBytes;
+	}
+	// data written through the upload ring, and the times it
+	// waited for the GPU to free a region
+	static void CountUploads(int kilobytes, int stalls)
+	{
+		s_counters[COUNTER_UPLOAD_KILOBYTES] += kilobytes;
+		s_counters[COUNTER_UPLOAD_STALLS] += stalls;
+	}
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// counters of the frame in progress
+	static int s_counters[COUNTER_COUNT];
+
+	// ring of kept frames and the slot of the newest one
+	std::vector<FRAME_RECORD> m_records;
+	int m_newestRecord;
+	// frame in progress
+	FRAME_RECORD m_current;
+	int m_frameIndex;
+	// start times of the frame and of the open CPU scopes
+	Clock::time_point m_frameStart;
+	Clock::time_point m_scopeStart[SCOPE_COUNT];
+	bool m_bFrameStarted;
+	// GPU timer queries and the frame each one was issued in
+	GLuint m_queries[GPU_QUERY_FRAMES][SCOPE_COUNT];
+	int m_queryFrame[GPU_QUERY_FRAMES][SCOPE_COUNT];
+	// GPU scope that is open, or -1
+	int m_openGpuScope;
+	// values gathered for a percentile
+	mutable std::vector<float> m_samples;
+
+	// read back the GPU results of the query set about to be reused
+	void CollectGpuResults(int querySet);
+	// kept frame for a frame number, or NULL when it is gone
+	FRAME_RECORD* FindRecord(int frame);
+	// percentiles of the gathered samples
+	PERCENTILES ComputePercentiles() const;
+};
+
+/***********************************************************
+ *  ProfileScope
+ *
+ *  This class times the block it is declared in.  A NULL
+ *  profiler turns it into a no-op, so scopes can stay in
+ *  place when profiling is off.
+ ***********************************************************/
+class ProfileScope
+{
+public:
+	// start timing, optionally on the GPU as well
+	ProfileScope(Profiler* pProfiler, Profiler::PROFILE_SCOPE scope, bool bGpu = false);
+	// stop timing
+	~ProfileScope();
+
+private:
+	Profiler* m_pProfiler;
+	Profiler::PROFILE_SCOPE m_scope;
+	bool m_bGpu;
+};
@@ -0,0 +1,421 @@
+///////////////////////////////////////////////////////////////////////////////
+// profileroverlay.cpp
+// ===================
+// This file contains the implementation of the `ProfilerOverlay` class,
+// which shows the profiler results on screen.
+//
+// RESPONSIBILITIES:
+// - Lay out the p50/p95/p99 rows of every timer and counter.
+// - Draw a bar per kept frame with the frame time budget marked.
+// - Render everything without disturbing the scene's GL state.
+//
+// NOTE: The text uses a tiny built in font, so the overlay needs no font
+// files or texture loading.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ProfilerOverlay.h"
+
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+
+// Namespace for the overlay layout and font
+namespace
+{
+	// pixels per font pixel
+	const float FONT_SCALE = 2.0f;
+	// font cell size in font pixels, including spacing
+	const float GLYPH_ADVANCE = 4.0f;
+	const float LINE_ADVANCE = 7.0f;
+	// panel position, padding and width in characters
+	const float PANEL_MARGIN = 10.0f;
+	const float PANEL_PADDING = 8.0f;
+	const int PANEL_COLUMNS = 46;
+	// graph height in pixels and the time it represents
+	const float GRAPH_HEIGHT = 60.0f;
+	const float GRAPH_MILLISECONDS = 33.3f;
+	// frame time budget marked in the graph
+	const float BUDGET_MILLISECONDS = 16.7f;
+	// frames between geometry rebuilds
+	const int OVERLAY_REFRESH_FRAMES = 15;
+
+	const glm::vec4 PANEL_COLOR(0.0f, 0.0f, 0.0f, 0.7f);
+	const glm::vec4 HEADER_COLOR(1.0f, 0.85f, 0.3f, 1.0f);
+	const glm::vec4 TEXT_COLOR(0.9f, 0.9f, 0.9f, 1.0f);
+	const glm::vec4 GOOD_COLOR(0.3f, 0.9f, 0.3f, 1.0f);
+	const glm::vec4 SLOW_COLOR(0.95f, 0.8f, 0.2f, 1.0f);
+	const glm::vec4 BAD_COLOR(0.95f, 0.25f, 0.2f, 1.0f);
+	const glm::vec4 BUDGET_COLOR(1.0f, 1.0f, 1.0f, 0.4f);
+
+	// one character of the 3x5 font, with the left column in
+	// bit 2 of each row
+	struct GLYPH
+	{
+		char character;
+		unsigned char rows[5];
+	};
+
+	const GLYPH g_Font[] =
+	{
+		{ '0', { 7, 5, 5, 5, 7 } }, { '1', { 2, 6, 2, 2, 7 } },
+		{ '2', { 7, 1, 7, 4, 7 } }, { '3', { 7, 1, 7, 1, 7 } },
+		{ '4', { 5, 5, 7, 1, 1 } }, { '5', { 7, 4, 7, 1, 7 } },
+		{ '6', { 7, 4, 7, 5, 7 } }, { '7', { 7, 1, 1, 1, 1 } },
+		{ '8', { 7, 5, 7, 5, 7 } }, { '9', { 7, 5, 7, 1, 7 } },
+		{ 'A', { 2, 5, 7, 5, 5 } }, { 'B', { 6, 5, 6, 5, 6 } },
+		{ 'C', { 3, 4, 4, 4, 3 } }, { 'D', { 6, 5, 5, 5, 6 } },
+		{ 'E', { 7, 4, 6, 4, 7 } }, { 'F', { 7, 4, 6, 4, 4 } },
+		{ 'G', { 3, 4, 5, 5, 3 } }, { 'H', { 5, 5, 7, 5, 5 } },
+		{ 'I', { 7, 2, 2, 2, 7 } }, { 'J', { 1, 1, 1, 5, 2 } },
+		{ 'K', { 5, 5, 6, 5, 5 } }, { 'L', { 4, 4, 4, 4, 7 } },
+		{ 'M', { 5, 7, 7, 5, 5 } }, { 'N', { 6, 5, 5, 5, 5 } },
+		{ 'O', { 2, 5, 5, 5, 2 } }, { 'P', { 6, 5, 6, 4, 4 } },
+		{ 'Q', { 2, 5, 5, 6, 3 } }, { 'R', { 6, 5, 6, 5, 5 } },
+		{ 'S', { 3, 4, 2, 1, 6 } }, { 'T', { 7, 2, 2, 2, 2 } },
+		{ 'U', { 5, 5, 5, 5, 7 } }, { 'V', { 5, 5, 5, 5, 2 } },
+		{ 'W', { 5, 5, 7, 7, 5 } }, { 'X', { 5, 5, 2, 5, 5 } },
+		{ 'Y', { 5, 5, 2, 2, 2 } }, { 'Z', { 7, 1, 2, 4, 7 } },
+		{ '.', { 0, 0, 0, 0, 2 } }, { ':', { 0, 2, 0, 2, 0 } },
+		{ '-', { 0, 0, 7, 0, 0 } }, { '%', { 5, 1, 2, 4, 5 } },
+		{ '/', { 1, 1, 2, 4, 4 } }, { '(', { 2, 4, 4, 4, 2 } },
+		{ ')', { 2, 1, 1, 1, 2 } }, { '_', { 0, 0, 0, 0, 7 } },
+	};
+
+	/***********************************************************
+	 *  FindGlyph()
+	 *
+	 *  This function is used for looking up a character in the
+	 *  font.  Lower case letters use the upper case glyphs, and
+	 *  NULL is returned for spaces and unknown characters.
+	 ***********************************************************/
+	const GLYPH* FindGlyph(char character)
+	{
+		char upper = (char)toupper((unsigned char)character);
+		for (size_t i = 0; i < sizeof(g_Font) / sizeof(g_Font[0]); ++i)
+		{
+			if (g_Font[i].character == upper)
+			{
+				return(&g_Font[i]);
+			}
+		}
+		return(NULL);
+	}
+}
+
+/***********************************************************
+ *  ProfilerOverlay()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ProfilerOverlay::ProfilerOverlay()
+{
+	m_pShaderManager = NULL;
+	m_vao = 0;
+	m_vbo = 0;
+	m_builtFrame = -1;
+	m_bVisible = false;
+}
+
+/***********************************************************
+ *  ~ProfilerOverlay()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ProfilerOverlay::~ProfilerOverlay()
+{
+	if (m_vbo != 0)
+	{
+		glDeleteBuffers(1, &m_vbo);
+	}
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+	}
+	if (NULL != m_pShaderManager)
+	{
+		delete m_pShaderManager;
+		m_pShaderManager = NULL;
+	}
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for loading the overlay shader and
+ *  setting up the vertex layout - a pixel position and a
+ *  normalized byte color per vertex.
+ ***********************************************************/
+bool ProfilerOverlay::Create()
+{
+	m_pShaderManager = new ShaderManager();
+	GLuint programID = m_pShaderManager->LoadShaders(
+		"shaders/overlayVertexShader.glsl",
+		"shaders/overlayFragmentShader.glsl");
+	if ((programID == 0) || (m_uniformCache.Reflect(programID) == false))
+	{
+		return(false);
+	}
+	m_screenSize = m_uniformCache.Handle<glm::vec2>("screenSize");
+
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vbo);
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(OVERLAY_VERTEX),
+		(void*)offsetof(OVERLAY_VERTEX, x));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(OVERLAY_VERTEX),
+		(void*)offsetof(OVERLAY_VERTEX, color));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used for drawing the overlay over the
+ *  finished scene.  Depth testing is turned off for the
+ *  overlay, and the previous program is bound again after,
+ *  so the scene code sees no change.
+ ***********************************************************/
+void ProfilerOverlay::Draw(const Profiler& profiler, int width, int height)
+{
+	if ((m_bVisible == false) || (m_vao == 0) || (width <= 0) || (height <= 0))
+	{
+		return;
+	}
+
+	int frame = profiler.FrameIndex();
+	if ((m_builtFrame < 0) || (frame - m_builtFrame >= OVERLAY_REFRESH_FRAMES))
+	{
+		Rebuild(profiler);
+		m_builtFrame = frame;
+
+		// the whole buffer is replaced, so the driver can
+		// hand out fresh memory instead of waiting
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(OVERLAY_VERTEX), m_vertices.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLboolean bDepthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean bBlend = glIsEnabled(GL_BLEND);
+
+	// the panel is see-through
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	m_pShaderManager->use();
+	m_screenSize.Set(glm::vec2((float)width, (float)height));
+
+	glBindVertexArray(m_vao);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)m_vertices.size());
+	glBindVertexArray(0);
+
+	glUseProgram((GLuint)previousProgram);
+	if (bDepthTest == GL_TRUE)
+	{
+		glEnable(GL_DEPTH_TEST);
+	}
+	if (bBlend == GL_FALSE)
+	{
+		glDisable(GL_BLEND);
+	}
+}
+
+/***********************************************************
+ *  Rebuild()
+ *
+ *  This method is used for laying out the panel - a header,
+ *  one percentile row per timer and counter, and a graph of
+ *  the kept frame times colored against the budget.  GPU
+ *  rows are only shown for scopes that have GPU results.
+ ***********************************************************/
+void ProfilerOverlay::Rebuild(const Profiler& profiler)
+{
+	const float glyphWidth = GLYPH_ADVANCE * FONT_SCALE;
+	const float lineHeight = LINE_ADVANCE * FONT_SCALE;
+
+	float left = PANEL_MARGIN;
+	float top = PANEL_MARGIN;
+	float panelWidth = PANEL_COLUMNS * glyphWidth + PANEL_PADDING * 2.0f;
+
+	// the background goes first so it is drawn below the text,
+	// and its height is filled in once the rows are known
+	m_vertices.clear();
+	AddRect(left, top, panelWidth, 0.0f, PANEL_COLOR);
+
+	float x = left + PANEL_PADDING;
+	float y = top + PANEL_PADDING;
+	char line[64];
+
+	snprintf(line, sizeof(line), "%-22s %7s %7s %7s", "PROFILE (MS)", "P50", "P95", "P99");
+	AddText(x, y, line, HEADER_COLOR);
+	y += lineHeight;
+
+	AddPercentileRow(x, y, "FRAME", profiler.FramePercentiles(), false);
+	y += lineHeight;
+
+	for (int scope = 0; scope < Profiler::SCOPE_COUNT; ++scope)
+	{
+		snprintf(line, sizeof(line), "CPU %s", Profiler::ScopeName((Profiler::PROFILE_SCOPE)scope));
+		AddPercentileRow(x, y, line, profiler.CpuPercentiles((Profiler::PROFILE_SCOPE)scope), false);
+		y += lineHeight;
+	}
+	for (int scope = 0; scope < Profiler::SCOPE_COUNT; ++scope)
+	{
+		Profiler::PERCENTILES percentiles = profiler.GpuPercentiles((Profiler::PROFILE_SCOPE)scope);
+		if (percentiles.p50 < 0.0f)
+		{
+			continue;
+		}
+		snprintf(line, sizeof(line), "GPU %s", Profiler::ScopeName((Profiler::PROFILE_SCOPE)scope));
+		AddPercentileRow(x, y, line, percentiles, false);
+		y += lineHeight;
+	}
+	for (int counter = 0; counter < Profiler::COUNTER_COUNT; ++counter)
+	{
+		AddPercentileRow(x, y, Profiler::CounterName((Profiler::PROFILE_COUNTER)counter),
+			profiler.CounterPercentiles((Profiler::PROFILE_COUNTER)counter), true);
+		y += lineHeight;
+	}
+
+	// one bar per kept frame, newest on the right
+	y += PANEL_PADDING;
+	float graphBottom = y + GRAPH_HEIGHT;
+	float barWidth = (PANEL_COLUMNS * glyphWidth) / Profiler::HISTORY_FRAMES;
+	int first = Profiler::HISTORY_FRAMES - profiler.RecordCount();
+
+	for (int i = 0; i < profiler.RecordCount(); ++i)
+	{
+		const Profiler::FRAME_RECORD& record = profiler.Record(i);
+		float milliseconds = record.frameMilliseconds;
+		float barHeight = GRAPH_HEIGHT * glm::min(milliseconds / GRAPH_MILLISECONDS, 1.0f);
+
+		glm::vec4 color = GOOD_COLOR;
+		if (milliseconds > GRAPH_MILLISECONDS)
+		{
+			color = BAD_COLOR;
+		}
+		else if (milliseconds > BUDGET_MILLISECONDS)
+		{
+			color = SLOW_COLOR;
+		}
+
+		AddRect(x + (first + i) * barWidth, graphBottom - barHeight, barWidth, barHeight, color);
+	}
+
+	float budgetY = graphBottom - GRAPH_HEIGHT * (BUDGET_MILLISECONDS / GRAPH_MILLISECONDS);
+	AddRect(x, budgetY, PANEL_COLUMNS * glyphWidth, 1.0f, BUDGET_COLOR);
+
+	// move the bottom corners of the background down
+	float panelBottom = graphBottom + PANEL_PADDING;
+	m_vertices[2].y = panelBottom;
+	m_vertices[4].y = panelBottom;
+	m_vertices[5].y = panelBottom;
+}
+
+/***********************************************************
+ *  AddPercentileRow()
+ *
+ *  This method is used for adding a label and its three
+ *  percentiles.  Measurements without samples yet show
+ *  dashes.
+ ***********************************************************/
+void ProfilerOverlay::AddPercentileRow(float x, float y, const char* label, const Profiler::PERCENTILES& percentiles, bool bCount)
+{
+	char line[64];
+
+	if (percentiles.p50 < 0.0f)
+	{
+		snprintf(line, sizeof(line), "%-22s %7s %7s %7s", label, "-", "-", "-");
+	}
+	else if (bCount)
+	{
+		snprintf(line, sizeof(line), "%-22s %7.0f %7.0f %7.0f", label, percentiles.p50, percentiles.p95, percentiles.p99);
+	}
+	else
+	{
+		snprintf(line, sizeof(line), "%-22s %7.2f %7.2f %7.2f", label, percentiles.p50, percentiles.p95, percentiles.p99);
+	}
+
+	AddText(x, y, line, TEXT_COLOR);
+}
+
+/***********************************************************
+ *  AddText()
+ *
+ *  This method is used for adding one rectangle per run of
+ *  lit pixels in each row of each glyph.
+ ***********************************************************/
+void ProfilerOverlay::AddText(float x, float y, const char* text, glm::vec4 color)
+{
+	for (const char* pCharacter = text; *pCharacter != '\0'; ++pCharacter)
+	{
+		const GLYPH* pGlyph = FindGlyph(*pCharacter);
+		if (NULL != pGlyph)
+		{
+			for (int row = 0; row < 5; ++row)
+			{
+				int column = 0;
+				while (column < 3)
+				{
+					if ((pGlyph->rows[row] & (4 >> column)) == 0)
+					{
+						column++;
+						continue;
+					}
+
+					int runStart = column;
+					while ((column < 3) && ((pGlyph->rows[row] & (4 >> column)) != 0))
+					{
+						column++;
+					}
+					AddRect(
+						x + runStart * FONT_SCALE,
+						y + row * FONT_SCALE,
+						(column - runStart) * FONT_SCALE,
+						FONT_SCALE,
+						color);
+				}
+			}
+		}
+		x += GLYPH_ADVANCE * FONT_SCALE;
+	}
+}
+
+/***********************************************************
+ *  AddRect()
+ *
+ *  This method is used for adding a rectangle as two
+ *  triangles.
+ ***********************************************************/
+void ProfilerOverlay::AddRect(float x, float y, float width, float height, glm::vec4 color)
+{
+	OVERLAY_VERTEX corners[4];
+	float xs[4] = { x, x + width, x + width, x };
+	float ys[4] = { y, y, y + height, y + height };
+
+	for (int i = 0; i < 4; ++i)
+	{
+		corners[i].x = xs[i];
+		corners[i].y = ys[i];
+		for (int channel = 0; channel < 4; ++channel)
+		{
+			corners[i].color[channel] = (unsigned char)(glm::clamp(color[channel], 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+
+	m_vertices.push_back(corners[0]);
+	m_vertices.push_back(corners[1]);
+	m_vertices.push_back(corners[2]);
+	m_vertices.push_back(corners[0]);
+	m_vertices.push_back(corners[2]);
+	m_vertices.push_back(corners[3]);
+}
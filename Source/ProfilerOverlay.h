@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// profileroverlay.h
+// ============
+// draw the rolling profiler percentiles and a frame time graph as a text
+// panel on top of the rendered scene
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "Profiler.h"
+#include "UniformCache.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  ProfilerOverlay
+ *
+ *  This class turns the profiler history into colored
+ *  rectangles - a background, text from a built in 3x5
+ *  pixel font and one bar per kept frame - and draws them
+ *  with a small shader of its own.  The geometry is only
+ *  rebuilt every few frames since the percentiles change
+ *  slowly.
+ ***********************************************************/
+class ProfilerOverlay
+{
+public:
+	// constructor
+	ProfilerOverlay();
+	// destructor
+	~ProfilerOverlay();
+
+	// load the overlay shader and create the vertex buffer
+	bool Create();
+
+	// show or hide the overlay
+	void SetVisible(bool bVisible) { m_bVisible = bVisible; }
+	void ToggleVisible() { m_bVisible = !m_bVisible; }
+	bool IsVisible() const { return m_bVisible; }
+
+	// draw the overlay for the passed in framebuffer size
+	void Draw(const Profiler& profiler, int width, int height);
+
+private:
+	// one corner of an overlay rectangle, in pixels
+	struct OVERLAY_VERTEX
+	{
+		float x;
+		float y;
+		unsigned char color[4];
+	};
+
+	// shader used only by the overlay
+	ShaderManager* m_pShaderManager;
+	UniformCache m_uniformCache;
+	UniformHandle<glm::vec2> m_screenSize;
+	// dynamic vertex buffer
+	GLuint m_vao;
+	GLuint m_vbo;
+	// rectangles of the last rebuild
+	std::vector<OVERLAY_VERTEX> m_vertices;
+	// profiler frame the geometry was built for
+	int m_builtFrame;
+	bool m_bVisible;
+
+	// refill the vertex list from the profiler history
+	void Rebuild(const Profiler& profiler);
+	// add one pixel rectangle
+	void AddRect(float x, float y, float width, float height, glm::vec4 color);
+	// add a line of text at the passed in top left corner
+	void AddText(float x, float y, const char* text, glm::vec4 color);
+	// add a line with the three percentiles of a measurement
+	void AddPercentileRow(float x, float y, const char* label, const Profiler::PERCENTILES& percentiles, bool bCount);
+};
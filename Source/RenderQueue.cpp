@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.cpp
+// ===============
+// This file contains the implementation of the `RenderQueue` class, which
+// collects and sorts the draw commands of one frame.
+//
+// RESPONSIBILITIES:
+// - Pack shader, texture, material, mesh and depth into 64-bit sort keys.
+// - Keep opaque commands grouped by state and translucent ones back-to-front.
+// - Sort the commands of a frame without reallocating memory.
+//
+// KEY LAYOUT (most significant bit first):
+//   opaque:      0 | shader:4 | texture:12 | material:12 | mesh:8 | depth:27
+//   translucent: 1 | far-to-near depth:24 | shader:4 | texture:12 | material:12 | mesh:8
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+// declaration of the global variables and defines
+namespace
+{
+	const uint64_t TRANSLUCENT_BIT = 1ull << 63;
+
+	const int SHADER_BITS = 4;
+	const int TEXTURE_BITS = 12;
+	const int MATERIAL_BITS = 12;
+	const int MESH_BITS = 8;
+	const int OPAQUE_DEPTH_BITS = 27;
+	const int TRANSLUCENT_DEPTH_BITS = 24;
+
+	// clamp a value into an unsigned field of the given width;
+	// -1 (no texture / no material) maps to 0 so it sorts first
+	uint64_t PackField(int value, int bits)
+	{
+		uint64_t maxValue = (1ull << bits) - 1;
+		uint64_t field = (value < 0) ? 0 : (uint64_t)value + 1;
+		return (field > maxValue) ? maxValue : field;
+	}
+
+	// quantize a normalized 0..1 depth into the given width;
+	// the product is taken in double, as a float rounds 2^27-1
+	// up to 2^27, which would carry into the field above
+	uint64_t PackDepth(float depth, int bits)
+	{
+		if (depth < 0.0f) depth = 0.0f;
+		if (depth > 1.0f) depth = 1.0f;
+		uint64_t maxValue = (1ull << bits) - 1;
+		uint64_t field = (uint64_t)((double)depth * (double)maxValue);
+		return (field > maxValue) ? maxValue : field;
+	}
+
+	// shader, texture, material and mesh fields packed together
+	uint64_t PackState(int shader, int texture, int material, int mesh)
+	{
+		uint64_t state = PackField(shader, SHADER_BITS);
+		state = (state << TEXTURE_BITS) | PackField(texture, TEXTURE_BITS);
+		state = (state << MATERIAL_BITS) | PackField(material, MATERIAL_BITS);
+		state = (state << MESH_BITS) | PackField(mesh, MESH_BITS);
+		return state;
+	}
+}
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing the commands of the
+ *  previous frame.  The memory is kept for the next frame.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+	m_commands.clear();
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for adding one draw command.
+ ***********************************************************/
+void RenderQueue::Submit(uint64_t key, int payload)
+{
+	RENDER_COMMAND command;
+	command.key = key;
+	command.payload = payload;
+	m_commands.push_back(command);
+}
+
+/***********************************************************
+ *  Append()
+ *
+ *  This method is used for adding an array of draw commands
+ *  at once.  Sort() puts them in order with the rest, so
+ *  arrays built on different threads can be added in any
+ *  order.
+ ***********************************************************/
+void RenderQueue::Append(const RENDER_COMMAND* pCommands, int count)
+{
+	m_commands.insert(m_commands.end(), pCommands, pCommands + count);
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method is used for ordering the queued commands.
+ *  Commands with equal keys keep their submission order.
+ ***********************************************************/
+void RenderQueue::Sort()
+{
+	std::sort(m_commands.begin(), m_commands.end(),
+		[](const RENDER_COMMAND& a, const RENDER_COMMAND& b)
+		{
+			if (a.key != b.key) return a.key < b.key;
+			return a.payload < b.payload;
+		});
+}
+
+/***********************************************************
+ *  MakeOpaqueKey()
+ *
+ *  This method is used for building the sort key of an
+ *  opaque draw.  The depth is the normalized view distance
+ *  and orders draws with the same state front-to-back.
+ ***********************************************************/
+uint64_t RenderQueue::MakeOpaqueKey(
+	int shader,
+	int texture,
+	int material,
+	int mesh,
+	float depth)
+{
+	uint64_t key = PackState(shader, texture, material, mesh);
+	key = (key << OPAQUE_DEPTH_BITS) | PackDepth(depth, OPAQUE_DEPTH_BITS);
+	return key;
+}
+
+/***********************************************************
+ *  MakeTranslucentKey()
+ *
+ *  This method is used for building the sort key of a
+ *  translucent draw.  The depth comes first and is inverted
+ *  so the farthest object is drawn first.
+ ***********************************************************/
+uint64_t RenderQueue::MakeTranslucentKey(
+	int shader,
+	int texture,
+	int material,
+	int mesh,
+	float depth)
+{
+	uint64_t farToNear = PackDepth(1.0f - depth, TRANSLUCENT_DEPTH_BITS);
+	uint64_t stateBits = SHADER_BITS + TEXTURE_BITS + MATERIAL_BITS + MESH_BITS;
+	uint64_t key = (farToNear << stateBits) | PackState(shader, texture, material, mesh);
+	return TRANSLUCENT_BIT | key;
+}
+
+/***********************************************************
+ *  IsTranslucent()
+ *
+ *  This method is used for checking which pass a key is in.
+ ***********************************************************/
+bool RenderQueue::IsTranslucent(uint64_t key)
+{
+	return (key & TRANSLUCENT_BIT) != 0;
+}
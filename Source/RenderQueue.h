@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderqueue.h
+// ============
+// collect the draw commands of a frame and order them by a 64-bit sort key
+// so that draws sharing GPU state are submitted next to each other
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class holds one frame of draw commands.  Each
+ *  command is a sort key and a caller defined payload (for
+ *  SceneManager, the index of a render batch).  Opaque keys
+ *  order by shader, texture, material and mesh, with a
+ *  front-to-back depth as the tie breaker.  Translucent keys
+ *  always sort after opaque ones and order back-to-front.
+ ***********************************************************/
+class RenderQueue
+{
+public:
+	struct RENDER_COMMAND
+	{
+		uint64_t key;
+		int payload;
+	};
+
+	// constructor
+	RenderQueue();
+
+	// remove all commands, keeping the allocated memory
+	void Clear();
+	// add one draw command to the queue
+	void Submit(uint64_t key, int payload);
+	// add an array of commands collected elsewhere
+	void Append(const RENDER_COMMAND* pCommands, int count);
+	// order the commands by their sort keys
+	void Sort();
+
+	// number of queued commands
+	int Size() const { return (int)m_commands.size(); }
+	// access one queued command in sorted order
+	const RENDER_COMMAND& Command(int index) const { return m_commands[index]; }
+
+	// build a key for opaque geometry
+	static uint64_t MakeOpaqueKey(
+		int shader,
+		int texture,
+		int material,
+		int mesh,
+		float depth);
+	// build a key for translucent geometry
+	static uint64_t MakeTranslucentKey(
+		int shader,
+		int texture,
+		int material,
+		int mesh,
+		float depth);
+	// check whether a key belongs to the translucent pass
+	static bool IsTranslucent(uint64_t key);
+
+private:
+	// commands of the current frame
+	std::vector<RENDER_COMMAND> m_commands;
+};
@@ -0,0 +1,774 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebenchmark.cpp
+// ==================
+// This file contains the implementation of the `SceneBenchmark` class, which
+// measures the whole renderer the same way on every run.
+//
+// RESPONSIBILITIES:
+// - Draw the frames into an offscreen target of a configurable size.
+// - Load the camera path to fly, or script an orbit over the scene copies.
+// - Keep the profiler records of the measured frames once they are complete.
+// - Write percentiles of the frame, CPU and GPU times, the draw counters and
+//   the memory counters as a JSON report.
+// - Compare the report with an earlier one and flag the regressions.
+//
+// NOTE: The simulation counts time in frames rather than on the clock, so
+// the frames drawn only depend on the path - the measured times are the
+// only part of a report that changes between runs of the same build.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBenchmark.h"
+#include "HeapCounter.h"
+#include "JsonReader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// offscreen size and frame counts of a run with nothing given
+	const int DEFAULT_WIDTH = 1920;
+	const int DEFAULT_HEIGHT = 1080;
+	const int DEFAULT_WARMUP_FRAMES = 120;
+	const int DEFAULT_FRAMES = 600;
+	const float DEFAULT_REGRESSION_THRESHOLD = 0.10f;
+	const char* const DEFAULT_REPORT_PATH = "benchmark.json";
+
+	// scripted orbit - swung across this arc in front of the
+	// scene and back in this time, keyed this often, around a
+	// point this high above the floor, from above it by this
+	// share of the radius, and kept inside the far plane
+	// however large the grid
+	const float ORBIT_ARC_DEGREES = 120.0f;
+	const float ORBIT_SECONDS = 20.0f;
+	const int ORBIT_KEYS = 32;
+	const float ORBIT_HEIGHT_SHARE = 0.4f;
+	const float ORBIT_TARGET_HEIGHT = 3.0f;
+	const float ORBIT_MINIMUM_RADIUS = 14.0f;
+	const float ORBIT_MAXIMUM_RADIUS = 60.0f;
+
+	// version of the report layout
+	const int REPORT_VERSION = 1;
+
+	/***********************************************************
+	 *  JsonWriter
+	 *
+	 *  This class writes a JSON document member by member,
+	 *  keeping the commas and the indentation of each level.
+	 ***********************************************************/
+	class JsonWriter
+	{
+	public:
+		explicit JsonWriter(std::ostream& stream)
+			: m_stream(stream)
+		{
+			m_stream << "{";
+			m_bFirst.push_back(true);
+		}
+
+		void Finish()
+		{
+			m_stream << "\n}\n";
+		}
+
+		void BeginObject(const char* key)
+		{
+			Key(key);
+			m_stream << "{";
+			m_bFirst.push_back(true);
+		}
+
+		void EndObject()
+		{
+			m_bFirst.pop_back();
+			m_stream << "\n" << std::string(m_bFirst.size(), '\t') << "}";
+		}
+
+		void Number(const char* key, double value)
+		{
+			Key(key);
+			m_stream << value;
+		}
+
+		void String(const char* key, const std::string& value)
+		{
+			Key(key);
+			WriteString(value);
+		}
+
+		void StringArray(const char* key, const std::vector<std::string>& values)
+		{
+			Key(key);
+			m_stream << "[";
+			for (size_t i = 0; i < values.size(); ++i)
+			{
+				m_stream << ((i > 0) ? ", " : "");
+				WriteString(values[i]);
+			}
+			m_stream << "]";
+		}
+
+	private:
+		std::ostream& m_stream;
+		// whether each open object has no member yet
+		std::vector<bool> m_bFirst;
+
+		void Key(const char* key)
+		{
+			m_stream << (m_bFirst.back() ? "\n" : ",\n") << std::string(m_bFirst.size(), '\t');
+			m_bFirst.back() = false;
+			WriteString(key);
+			m_stream << ": ";
+		}
+
+		void WriteString(const std::string& value)
+		{
+			m_stream << '"';
+			for (size_t i = 0; i < value.size(); ++i)
+			{
+				char c = value[i];
+				if ((c == '"') || (c == '\\'))
+				{
+					m_stream << '\\';
+				}
+				m_stream << (((unsigned char)c < 0x20) ? ' ' : c);
+			}
+			m_stream << '"';
+		}
+	};
+
+	/***********************************************************
+	 *  WriteStatistics()
+	 *
+	 *  This function is used for writing the statistics of a
+	 *  measurement as an object named by the passed in key.
+	 ***********************************************************/
+	void WriteStatistics(JsonWriter& writer, const char* key, const SceneBenchmark::STATISTICS& statistics)
+	{
+		writer.BeginObject(key);
+		writer.Number("samples", statistics.count);
+		writer.Number("mean", statistics.mean);
+		writer.Number("p50", statistics.p50);
+		writer.Number("p95", statistics.p95);
+		writer.Number("p99", statistics.p99);
+		writer.Number("max", statistics.maximum);
+		writer.EndObject();
+	}
+
+	/***********************************************************
+	 *  ReadReportNumber()
+	 *
+	 *  This function is used for reading a number of a report,
+	 *  given the names of the objects it is nested in, false
+	 *  when the report does not have it.
+	 ***********************************************************/
+	bool ReadReportNumber(const JSON_VALUE& root, const char* section, const char* group, const char* key, double& value)
+	{
+		const JSON_VALUE* pValue = root.Member(section);
+		if ((NULL != pValue) && (NULL != group))
+		{
+			pValue = pValue->Member(group);
+		}
+		if (NULL != pValue)
+		{
+			pValue = pValue->Member(key);
+		}
+		if ((NULL == pValue) || (pValue->type != JSON_VALUE::JSON_NUMBER))
+		{
+			return(false);
+		}
+		value = pValue->number;
+		return(true);
+	}
+}
+
+const int SceneBenchmark::FRAMES_PER_SECOND;
+
+/***********************************************************
+ *  SceneBenchmark()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBenchmark::SceneBenchmark()
+{
+	DefaultSettings(m_settings);
+	m_framebuffer = 0;
+	m_colorBuffer = 0;
+	m_depthBuffer = 0;
+	m_firstFrame = -1;
+	m_programAllocations = 0;
+	m_programBytes = 0;
+}
+
+/***********************************************************
+ *  ~SceneBenchmark()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneBenchmark::~SceneBenchmark()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method is used for filling in the settings of a run
+ *  at full HD along the scripted orbit of a single scene.
+ ***********************************************************/
+void SceneBenchmark::DefaultSettings(SETTINGS& settings)
+{
+	settings.width = DEFAULT_WIDTH;
+	settings.height = DEFAULT_HEIGHT;
+	settings.warmupFrames = DEFAULT_WARMUP_FRAMES;
+	settings.frames = DEFAULT_FRAMES;
+	settings.sceneCopies = 1;
+	settings.cameraPathFile = NULL;
+	settings.reportPath = DEFAULT_REPORT_PATH;
+	settings.baselinePath = NULL;
+	settings.regressionThreshold = DEFAULT_REGRESSION_THRESHOLD;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the offscreen target,
+ *  a color and a depth and stencil renderbuffer of the
+ *  benchmark's size, and for sizing the lists so the
+ *  measured frames allocate nothing for the benchmark.
+ ***********************************************************/
+bool SceneBenchmark::Create(const SETTINGS& settings)
+{
+	Destroy();
+
+	m_settings = settings;
+	m_settings.width = std::max(m_settings.width, 1);
+	m_settings.height = std::max(m_settings.height, 1);
+	m_settings.warmupFrames = std::max(m_settings.warmupFrames, 1);
+	m_settings.frames = std::max(m_settings.frames, 1);
+	m_settings.sceneCopies = std::max(m_settings.sceneCopies, 1);
+	if (NULL == m_settings.reportPath)
+	{
+		m_settings.reportPath = DEFAULT_REPORT_PATH;
+	}
+
+	glGenRenderbuffers(1, &m_colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_settings.width, m_settings.height);
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_settings.width, m_settings.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "The benchmark target of " << m_settings.width << "x" << m_settings.height
+			<< " is not complete: 0x" << std::hex << status << std::dec << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	m_records.clear();
+	m_records.reserve(m_settings.frames);
+	m_samples.reserve(m_settings.frames);
+	m_firstFrame = -1;
+	m_programAllocations = 0;
+	m_programBytes = 0;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for deleting the offscreen target.
+ ***********************************************************/
+void SceneBenchmark::Destroy()
+{
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (0 != m_colorBuffer)
+	{
+		glDeleteRenderbuffers(1, &m_colorBuffer);
+		m_colorBuffer = 0;
+	}
+	if (0 != m_depthBuffer)
+	{
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_depthBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  PreparePath()
+ *
+ *  This method is used for choosing the flight of the
+ *  camera.  A path file is flown as it was recorded; without
+ *  one the camera swings around the middle of the scene
+ *  copies, far enough out to take in the grid, up to the
+ *  distance the far plane still shows.
+ ***********************************************************/
+bool SceneBenchmark::PreparePath(const glm::vec3& copiesMinimum, const glm::vec3& copiesMaximum)
+{
+	if (NULL != m_settings.cameraPathFile)
+	{
+		m_pathName = m_settings.cameraPathFile;
+		return(m_path.Load(m_settings.cameraPathFile));
+	}
+
+	glm::vec3 center = (copiesMinimum + copiesMaximum) * 0.5f + glm::vec3(0.0f, ORBIT_TARGET_HEIGHT, 0.0f);
+	float halfDiagonal = glm::length(copiesMaximum - copiesMinimum) * 0.5f;
+	float radius = std::min(ORBIT_MINIMUM_RADIUS + halfDiagonal, ORBIT_MAXIMUM_RADIUS);
+	m_path.CreateOrbit(center, radius, radius * ORBIT_HEIGHT_SHARE, ORBIT_ARC_DEGREES, ORBIT_SECONDS, ORBIT_KEYS);
+	m_pathName = "orbit";
+	return(true);
+}
+
+/***********************************************************
+ *  SetCommandLine()
+ *
+ *  This method is used for keeping the arguments the run
+ *  was started with, so a report tells how it was made.
+ ***********************************************************/
+void SceneBenchmark::SetCommandLine(int argc, char* argv[])
+{
+	m_arguments.assign(argv + std::min(argc, 1), argv + argc);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for drawing the next frame into the
+ *  offscreen target, over all of it.
+ ***********************************************************/
+void SceneBenchmark::BeginFrame()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_settings.width, m_settings.height);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for taking the measurements after a
+ *  frame.  The GPU times of a frame are only complete once
+ *  the profiler collected them GPU_QUERY_FRAMES frames
+ *  later, so that is the record that is kept.  The
+ *  program's allocations are counted from the end of the
+ *  warm-up to the end of the last measured frame.
+ ***********************************************************/
+void SceneBenchmark::EndFrame(const Profiler& profiler)
+{
+	int count = profiler.RecordCount();
+	if (count == 0)
+	{
+		return;
+	}
+
+	int newest = profiler.Record(count - 1).frame;
+	if (m_firstFrame < 0)
+	{
+		m_firstFrame = newest + m_settings.warmupFrames;
+	}
+
+	HeapCounter::HEAP_COUNTS heapCounts;
+	if (newest == m_firstFrame - 1)
+	{
+		HeapCounter::TakeProgramCounts(heapCounts);
+	}
+	else if (newest == m_firstFrame + m_settings.frames - 1)
+	{
+		HeapCounter::TakeProgramCounts(heapCounts);
+		m_programAllocations = heapCounts.allocations;
+		m_programBytes = heapCounts.bytes;
+	}
+
+	int complete = count - 1 - Profiler::GPU_QUERY_FRAMES;
+	if ((complete < 0) || IsFinished())
+	{
+		return;
+	}
+	const Profiler::FRAME_RECORD& record = profiler.Record(complete);
+	if (record.frame >= m_firstFrame)
+	{
+		m_records.push_back(record);
+	}
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for ending the run - printing its
+ *  main figures, comparing them with the baseline report
+ *  and writing the report.  The baseline is read first, so
+ *  a run may replace the report it is compared with.
+ ***********************************************************/
+int SceneBenchmark::Finish()
+{
+	if (m_records.empty())
+	{
+		std::cout << "The benchmark ended before any frame was measured" << std::endl;
+		return(EXIT_FAILURE);
+	}
+
+	STATISTICS frame = FrameStatistics();
+	STATISTICS gpuFrame = GpuFrameStatistics();
+	STATISTICS drawCalls = CounterStatistics(Profiler::COUNTER_DRAW_CALLS);
+	std::cout << "Benchmark of " << m_records.size() << " frames at " << m_settings.width << "x" << m_settings.height
+		<< " with " << m_settings.sceneCopies << " scene copies: frame p50 " << frame.p50 << " ms, p95 "
+		<< frame.p95 << " ms, GPU p50 " << gpuFrame.p50 << " ms, " << drawCalls.mean << " draw calls" << std::endl;
+
+	bool bPassed = (NULL == m_settings.baselinePath) || CompareWithBaseline(m_settings.baselinePath);
+	if (WriteReport(m_settings.reportPath) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+	std::cout << "Wrote the benchmark report to " << m_settings.reportPath << std::endl;
+
+	return(bPassed ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/***********************************************************
+ *  ComputeStatistics()
+ *
+ *  This method is used for summarizing the gathered values,
+ *  with the percentiles picked the way the profiler picks
+ *  them.  Without values every field is -1.
+ ***********************************************************/
+SceneBenchmark::STATISTICS SceneBenchmark::ComputeStatistics()
+{
+	STATISTICS statistics;
+	statistics.count = (int)m_samples.size();
+	statistics.mean = -1.0f;
+	statistics.p50 = -1.0f;
+	statistics.p95 = -1.0f;
+	statistics.p99 = -1.0f;
+	statistics.maximum = -1.0f;
+
+	if (m_samples.empty())
+	{
+		return(statistics);
+	}
+
+	std::sort(m_samples.begin(), m_samples.end());
+	double total = 0.0;
+	for (size_t i = 0; i < m_samples.size(); ++i)
+	{
+		total += m_samples[i];
+	}
+	int last = (int)m_samples.size() - 1;
+	statistics.mean = (float)(total / (double)m_samples.size());
+	statistics.p50 = m_samples[(int)(last * 0.50f + 0.5f)];
+	statistics.p95 = m_samples[(int)(last * 0.95f + 0.5f)];
+	statistics.p99 = m_samples[(int)(last * 0.99f + 0.5f)];
+	statistics.maximum = m_samples[last];
+
+	return(statistics);
+}
+
+/***********************************************************
+ *  FrameStatistics()
+ *
+ *  This method is used for the statistics of the time
+ *  between the starts of two frames.
+ ***********************************************************/
+SceneBenchmark::STATISTICS SceneBenchmark::FrameStatistics()
+{
+	m_samples.clear();
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		m_samples.push_back(m_records[i].frameMilliseconds);
+	}
+	return(ComputeStatistics());
+}
+
+/***********************************************************
+ *  CpuStatistics()
+ *
+ *  This method is used for the statistics of a scope's CPU
+ *  time.
+ ***********************************************************/
+SceneBenchmark::STATISTICS SceneBenchmark::CpuStatistics(Profiler::PROFILE_SCOPE scope)
+{
+	m_samples.clear();
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		m_samples.push_back(m_records[i].cpuMilliseconds[scope]);
+	}
+	return(ComputeStatistics());
+}
+
+/***********************************************************
+ *  GpuStatistics()
+ *
+ *  This method is used for the statistics of a scope's GPU
+ *  time, leaving out the frames whose result never arrived.
+ ***********************************************************/
+SceneBenchmark::STATISTICS SceneBenchmark::GpuStatistics(Profiler::PROFILE_SCOPE scope)
+{
+	m_samples.clear();
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		if (m_records[i].gpuMilliseconds[scope] >= 0.0f)
+		{
+			m_samples.push_back(m_records[i].gpuMilliseconds[scope]);
+		}
+	}
+	return(ComputeStatistics());
+}
+
+/***********************************************************
+ *  GpuFrameStatistics()
+ *
+ *  This method is used for the statistics of the GPU time
+ *  of whole frames, the sum of the scopes timed on the GPU,
+ *  over the frames with every one of their results.
+ ***********************************************************/
+SceneBenchmark::STATISTICS SceneBenchmark::GpuFrameStatistics()
+{
+	// the scopes timed on the GPU are those that have a result
+	// in any measured frame
+	bool bTimed[Profiler::SCOPE_COUNT] = { false };
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		for (int scope = 0; scope < Profiler::SCOPE_COUNT; ++scope)
+		{
+			bTimed[scope] = bTimed[scope] || (m_records[i].gpuMilliseconds[scope] >= 0.0f);
+		}
+	}
+
+	m_samples.clear();
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		float total = 0.0f;
+		bool bComplete = true;
+		for (int scope = 0; scope < Profiler::SCOPE_COUNT; ++scope)
+		{
+			if (bTimed[scope])
+			{
+				bComplete = bComplete && (m_records[i].gpuMilliseconds[scope] >= 0.0f);
+				total += m_records[i].gpuMilliseconds[scope];
+			}
+		}
+		if (bComplete)
+		{
+			m_samples.push_back(total);
+		}
+	}
+	return(ComputeStatistics());
+}
+
+/***********************************************************
+ *  CounterStatistics()
+ *
+ *  This method is used for the statistics of a counter.
+ ***********************************************************/
+SceneBenchmark::STATISTICS SceneBenchmark::CounterStatistics(Profiler::PROFILE_COUNTER counter)
+{
+	m_samples.clear();
+	for (size_t i = 0; i < m_records.size(); ++i)
+	{
+		m_samples.push_back((float)m_records[i].counters[counter]);
+	}
+	return(ComputeStatistics());
+}
+
+/***********************************************************
+ *  WriteReport()
+ *
+ *  This method is used for writing the report: the run's
+ *  settings and renderer, the statistics of the frame time
+ *  and of every scope's CPU and GPU time, of every counter,
+ *  and the memory figures gathered from the counters and
+ *  the heap.
+ ***********************************************************/
+bool SceneBenchmark::WriteReport(const char* filePath)
+{
+	std::ofstream file(filePath);
+	if (!file.is_open())
+	{
+		std::cout << "Could not write the benchmark report: " << filePath << std::endl;
+		return(false);
+	}
+
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+
+	JsonWriter writer(file);
+	writer.Number("version", REPORT_VERSION);
+	writer.BeginObject("settings");
+	writer.Number("width", m_settings.width);
+	writer.Number("height", m_settings.height);
+	writer.Number("warmupFrames", m_settings.warmupFrames);
+	writer.Number("frames", (double)m_records.size());
+	writer.Number("sceneCopies", m_settings.sceneCopies);
+	writer.String("cameraPath", m_pathName);
+	writer.Number("cameraPathSeconds", m_path.Duration());
+	writer.String("renderer", (NULL != renderer) ? renderer : "");
+	writer.String("glVersion", (NULL != version) ? version : "");
+	writer.StringArray("arguments", m_arguments);
+	writer.EndObject();
+
+	WriteStatistics(writer, "frameMs", FrameStatistics());
+	WriteStatistics(writer, "gpuFrameMs", GpuFrameStatistics());
+
+	writer.BeginObject("cpuMs");
+	for (int scope = 0; scope < Profiler::SCOPE_COUNT; ++scope)
+	{
+		WriteStatistics(writer, Profiler::ScopeName((Profiler::PROFILE_SCOPE)scope),
+			CpuStatistics((Profiler::PROFILE_SCOPE)scope));
+	}
+	writer.EndObject();
+
+	writer.BeginObject("gpuMs");
+	for (int scope = 0; scope < Profiler::SCOPE_COUNT; ++scope)
+	{
+		STATISTICS statistics = GpuStatistics((Profiler::PROFILE_SCOPE)scope);
+		if (statistics.count > 0)
+		{
+			WriteStatistics(writer, Profiler::ScopeName((Profiler::PROFILE_SCOPE)scope), statistics);
+		}
+	}
+	writer.EndObject();
+
+	writer.BeginObject("counters");
+	for (int counter = 0; counter < Profiler::COUNTER_COUNT; ++counter)
+	{
+		WriteStatistics(writer, Profiler::CounterName((Profiler::PROFILE_COUNTER)counter),
+			CounterStatistics((Profiler::PROFILE_COUNTER)counter));
+	}
+	writer.EndObject();
+
+	STATISTICS heapAllocations = CounterStatistics(Profiler::COUNTER_HEAP_ALLOCATIONS);
+	STATISTICS heapKilobytes = CounterStatistics(Profiler::COUNTER_HEAP_KILOBYTES);
+	STATISTICS arenaBytes = CounterStatistics(Profiler::COUNTER_ARENA_BYTES);
+	STATISTICS uploadKilobytes = CounterStatistics(Profiler::COUNTER_UPLOAD_KILOBYTES);
+	double measuredFrames = (double)m_records.size();
+	writer.BeginObject("memory");
+	writer.Number("renderThreadAllocationsPerFrame", heapAllocations.mean);
+	writer.Number("renderThreadKilobytesPerFrame", heapKilobytes.mean);
+	writer.Number("programAllocationsPerFrame", (double)m_programAllocations / measuredFrames);
+	writer.Number("programKilobytesPerFrame", (double)m_programBytes / 1024.0 / measuredFrames);
+	writer.Number("frameArenaPeakBytes", arenaBytes.maximum);
+	writer.Number("uploadKilobytesPerFrame", uploadKilobytes.mean);
+	writer.EndObject();
+
+	writer.Finish();
+	return(true);
+}
+
+/***********************************************************
+ *  CompareWithBaseline()
+ *
+ *  This method is used for checking the run against the
+ *  report of an earlier build.  The frame and GPU time
+ *  percentiles may grow by the regression threshold, and
+ *  the counts of draw calls and allocations may not grow
+ *  at all, since the same frames are drawn.  Every figure
+ *  is printed with its change, and a baseline made with
+ *  other settings is warned about.
+ ***********************************************************/
+bool SceneBenchmark::CompareWithBaseline(const char* filePath)
+{
+	std::ifstream source(filePath, std::ios::binary);
+	if (!source.is_open())
+	{
+		std::cout << "Could not read the benchmark baseline: " << filePath << std::endl;
+		return(false);
+	}
+	std::ostringstream text;
+	text << source.rdbuf();
+	std::string document = text.str();
+
+	JSON_VALUE root;
+	JsonParser parser(document);
+	if (parser.Parse(root) == false)
+	{
+		std::cout << filePath << "(" << parser.Line() << "): " << parser.Error() << std::endl;
+		return(false);
+	}
+
+	double value = 0.0;
+	if ((ReadReportNumber(root, "settings", NULL, "width", value) && ((int)value != m_settings.width)) ||
+		(ReadReportNumber(root, "settings", NULL, "height", value) && ((int)value != m_settings.height)) ||
+		(ReadReportNumber(root, "settings", NULL, "sceneCopies", value) && ((int)value != m_settings.sceneCopies)))
+	{
+		std::cout << "WARNING: the baseline " << filePath << " was run at another size or scene copies" << std::endl;
+	}
+
+	// figures compared, the statistics they come from, and
+	// whether they may grow by the threshold or not at all
+	struct CHECK
+	{
+		const char* section;
+		const char* group;
+		const char* key;
+		float current;
+		int samples;
+		bool bTime;
+	};
+	STATISTICS frame = FrameStatistics();
+	STATISTICS gpuFrame = GpuFrameStatistics();
+	STATISTICS renderCpu = CpuStatistics(Profiler::SCOPE_RENDER_SCENE);
+	STATISTICS drawCalls = CounterStatistics(Profiler::COUNTER_DRAW_CALLS);
+	STATISTICS allocations = CounterStatistics(Profiler::COUNTER_HEAP_ALLOCATIONS);
+	const CHECK checks[] = {
+		{ "frameMs", NULL, "p50", frame.p50, frame.count, true },
+		{ "frameMs", NULL, "p95", frame.p95, frame.count, true },
+		{ "gpuFrameMs", NULL, "p50", gpuFrame.p50, gpuFrame.count, true },
+		{ "gpuFrameMs", NULL, "p95", gpuFrame.p95, gpuFrame.count, true },
+		{ "cpuMs", Profiler::ScopeName(Profiler::SCOPE_RENDER_SCENE), "p50", renderCpu.p50, renderCpu.count, true },
+		{ "counters", Profiler::CounterName(Profiler::COUNTER_DRAW_CALLS), "mean", drawCalls.mean, drawCalls.count, false },
+		{ "counters", Profiler::CounterName(Profiler::COUNTER_HEAP_ALLOCATIONS), "mean", allocations.mean, allocations.count, false } };
+
+	int regressions = 0;
+	for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); ++i)
+	{
+		const CHECK& check = checks[i];
+		double current = check.current;
+		double baseline = 0.0;
+		if ((check.samples == 0) ||
+			(ReadReportNumber(root, check.section, check.group, check.key, baseline) == false) ||
+			(baseline < 0.0))
+		{
+			continue;
+		}
+
+		// counts are compared to half a unit, which the mean of
+		// an unchanged count stays within
+		double limit = check.bTime ? baseline * (1.0 + m_settings.regressionThreshold) : baseline + 0.5;
+		bool bRegressed = (current > limit);
+		double change = (baseline > 0.0) ? (current - baseline) / baseline * 100.0 : 0.0;
+		std::cout << (bRegressed ? "REGRESSION: " : "  ") << check.section << "."
+			<< ((NULL != check.group) ? check.group : "") << ((NULL != check.group) ? "." : "")
+			<< check.key << " " << baseline << " -> " << current << " (" << (change >= 0.0 ? "+" : "")
+			<< change << "%)" << std::endl;
+		if (bRegressed)
+		{
+			regressions++;
+		}
+	}
+
+	if (regressions > 0)
+	{
+		std::cout << regressions << " figures regressed against " << filePath << std::endl;
+		return(false);
+	}
+	std::cout << "No regression against " << filePath << std::endl;
+	return(true);
+}
@@ -0,0 +1,149 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebenchmark.h
+// ============
+// render the scene offscreen along a fixed camera path and report the frame
+// times, draw work and memory as JSON, compared against an earlier report
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CameraPath.h"
+#include "Profiler.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SceneBenchmark
+ *
+ *  This class runs the benchmark started by the --benchmark
+ *  command line option.  The frames are drawn into a
+ *  framebuffer object of the chosen size rather than the
+ *  window, with vsync off, while the simulation flies the
+ *  camera along a recorded path or a scripted orbit of the
+ *  scene and counts time in frames of a fixed length, so
+ *  every run draws the same frames.  After the warm-up
+ *  frames, which stream in the textures and settle the
+ *  caches, each frame's profiler record is kept once its
+ *  GPU times have arrived.  The report holds percentiles
+ *  of the frame, CPU and GPU times, the draw counters and
+ *  the memory counters; given the report of an earlier
+ *  build, the run fails when the times grew by more than
+ *  the allowed share or the draw calls or allocations rose.
+ ***********************************************************/
+class SceneBenchmark
+{
+public:
+	// what to run and where to write the results
+	struct SETTINGS
+	{
+		// size of the offscreen target in pixels
+		int width;
+		int height;
+		// frames drawn before the measured ones, and the number
+		// of measured frames
+		int warmupFrames;
+		int frames;
+		// copies of the scene drawn side by side
+		int sceneCopies;
+		// camera path file, or NULL for the scripted orbit
+		const char* cameraPathFile;
+		// report written after the run, and an earlier report it
+		// is compared with, or NULL
+		const char* reportPath;
+		const char* baselinePath;
+		// share the times may grow by before they count as a
+		// regression, 0.1 for 10%
+		float regressionThreshold;
+	};
+
+	// summary of one measurement over the measured frames
+	struct STATISTICS
+	{
+		// number of frames with a value, the rest are -1
+		int count;
+		float mean;
+		float p50;
+		float p95;
+		float p99;
+		float maximum;
+	};
+
+	// length of a frame on the simulation's clock
+	static const int FRAMES_PER_SECOND = 60;
+
+	// constructor
+	SceneBenchmark();
+	// destructor
+	~SceneBenchmark();
+
+	// get the settings of a run with nothing given
+	static void DefaultSettings(SETTINGS& settings);
+
+	// create the offscreen target, false when the driver
+	// cannot render to it
+	bool Create(const SETTINGS& settings);
+	// delete the offscreen target
+	void Destroy();
+	// get the settings the benchmark was created with
+	const SETTINGS& Settings() const { return m_settings; }
+
+	// load the camera path, or script an orbit over the scene
+	// copies between the passed in corners
+	bool PreparePath(const glm::vec3& copiesMinimum, const glm::vec3& copiesMaximum);
+	// get the path the camera flies
+	const CameraPath& Path() const { return m_path; }
+	// keep the command line for the report
+	void SetCommandLine(int argc, char* argv[]);
+
+	// bind the offscreen target before a frame is drawn
+	void BeginFrame();
+	// take the measurements of the finished frames
+	void EndFrame(const Profiler& profiler);
+	// check whether every measured frame has been taken
+	bool IsFinished() const { return (int)m_records.size() >= m_settings.frames; }
+
+	// write the report, and compare it with the baseline when
+	// there is one; returns EXIT_FAILURE for a regression
+	int Finish();
+
+private:
+	SETTINGS m_settings;
+	// offscreen target and its attachments
+	GLuint m_framebuffer;
+	GLuint m_colorBuffer;
+	GLuint m_depthBuffer;
+	// path the camera flies, and a description for the report
+	CameraPath m_path;
+	std::string m_pathName;
+	// command line the benchmark was run with
+	std::vector<std::string> m_arguments;
+	// profiler frame of the first measured frame, -1 until the
+	// first frame ends
+	int m_firstFrame;
+	// records of the measured frames
+	std::vector<Profiler::FRAME_RECORD> m_records;
+	// every thread's allocations during the measured frames
+	int m_programAllocations;
+	long long m_programBytes;
+	// values gathered for a statistic
+	std::vector<float> m_samples;
+
+	// statistics of the values in m_samples
+	STATISTICS ComputeStatistics();
+	// gather one measurement of every kept record
+	STATISTICS FrameStatistics();
+	STATISTICS CpuStatistics(Profiler::PROFILE_SCOPE scope);
+	STATISTICS GpuStatistics(Profiler::PROFILE_SCOPE scope);
+	STATISTICS GpuFrameStatistics();
+	STATISTICS CounterStatistics(Profiler::PROFILE_COUNTER counter);
+
+	// write the report as JSON
+	bool WriteReport(const char* filePath);
+	// compare the report with the baseline report, false for
+	// a regression
+	bool CompareWithBaseline(const char* filePath);
+};
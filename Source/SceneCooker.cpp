@@ -0,0 +1,580 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenecooker.cpp
+// ===============
+// This file contains the implementation of the `SceneCooker` class, which
+// writes the cooked scene files read by `SceneFile`.
+//
+// RESPONSIBILITIES:
+// - Parse a JSON scene description and report errors with their line.
+// - Resolve mesh names, group names and tags to indices.
+// - Write the header, record tables and string block as one .cscene file.
+//
+// NOTE: The JSON reader (JsonReader.h) only runs here, offline - the
+// application itself reads nothing but cooked files.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneCooker.h"
+#include "SceneFile.h"
+#include "MeshLibrary.h"
+#include "TagTable.h"
+#include "JsonReader.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Namespace for the cooking helpers
+namespace
+{
+	// mesh names used in scene files, in MESH_TYPE order
+	const char* const MESH_NAMES[MESH_COUNT] = {
+		"plane", "box", "sphere", "cylinder", "pyramid4", "cone", "torus" };
+
+	/***********************************************************
+	 *  SceneBuilder
+	 *
+	 *  This class turns the parsed document into the tables of
+	 *  a cooked file, interning the tags and strings as it goes
+	 *  and keeping the first error it finds.
+	 ***********************************************************/
+	class SceneBuilder
+	{
+	public:
+		std::vector<SceneFile::SCENE_TEXTURE> textures;
+		std::vector<SceneFile::SCENE_MATERIAL> materials;
+		std::vector<SceneFile::SCENE_LIGHT> lights;
+		std::vector<SceneFile::SCENE_GROUP> groups;
+		std::vector<SceneFile::SCENE_OBJECT> objects;
+		std::vector<SceneFile::SCENE_TAG> tagRecords;
+		std::string strings;
+
+		SceneBuilder()
+			: m_errorLine(0)
+		{
+			// offset 0 is the empty string
+			strings.push_back('\0');
+		}
+
+		// description and line of the first error
+		const std::string& Error() const { return m_error; }
+		int ErrorLine() const { return m_errorLine; }
+
+		bool Build(const JSON_VALUE& root)
+		{
+			if (root.type != JSON_VALUE::JSON_OBJECT)
+			{
+				return(Fail(root, "the scene must be an object"));
+			}
+			const char* sections[] = { "textures", "materials", "lights", "groups", "objects" };
+			if (CheckKeys(root, sections, 5) == false)
+			{
+				return(false);
+			}
+
+			bool bValid = ForEach(root, "textures", &SceneBuilder::AddTexture) &&
+				ForEach(root, "materials", &SceneBuilder::AddMaterial) &&
+				ForEach(root, "lights", &SceneBuilder::AddLight) &&
+				ForEach(root, "groups", &SceneBuilder::AddGroup) &&
+				ForEach(root, "objects", &SceneBuilder::AddObject);
+			if (bValid == false)
+			{
+				return(false);
+			}
+
+			// the interned tags, in ID order
+			for (int tag = 0; tag < m_tags.Count(); ++tag)
+			{
+				SceneFile::SCENE_TAG record;
+				record.nameOffset = AddString(m_tags.Name(tag));
+				tagRecords.push_back(record);
+			}
+			return(true);
+		}
+
+	private:
+		TagTable m_tags;
+		// group names to their index
+		TagTable m_groupNames;
+		std::string m_error;
+		int m_errorLine;
+
+		typedef bool (SceneBuilder::*ADD_RECORD)(const JSON_VALUE& value);
+
+		bool Fail(const JSON_VALUE& value, const std::string& message)
+		{
+			if (m_error.empty())
+			{
+				m_error = message;
+				m_errorLine = value.line;
+			}
+			return(false);
+		}
+
+		uint32_t AddString(const std::string& text)
+		{
+			uint32_t offset = (uint32_t)strings.size();
+			strings.append(text);
+			strings.push_back('\0');
+			return(offset);
+		}
+
+		// unknown members are most likely misspelled names
+		bool CheckKeys(const JSON_VALUE& value, const char* const* allowed, int allowedCount)
+		{
+			for (size_t i = 0; i < value.keys.size(); ++i)
+			{
+				bool bKnown = false;
+				for (int j = 0; (j < allowedCount) && (bKnown == false); ++j)
+				{
+					bKnown = (value.keys[i] == allowed[j]);
+				}
+				if (bKnown == false)
+				{
+					return(Fail(value.items[i], "unknown member \"" + value.keys[i] + "\""));
+				}
+			}
+			return(true);
+		}
+
+		bool ForEach(const JSON_VALUE& root, const char* section, ADD_RECORD add)
+		{
+			const JSON_VALUE* pList = root.Member(section);
+			if (NULL == pList)
+			{
+				return(true);
+			}
+			if (pList->type != JSON_VALUE::JSON_ARRAY)
+			{
+				return(Fail(*pList, std::string("\"") + section + "\" must be an array"));
+			}
+			for (size_t i = 0; i < pList->items.size(); ++i)
+			{
+				const JSON_VALUE& value = pList->items[i];
+				if (value.type != JSON_VALUE::JSON_OBJECT)
+				{
+					return(Fail(value, std::string("entries of \"") + section + "\" must be objects"));
+				}
+				if ((this->*add)(value) == false)
+				{
+					return(false);
+				}
+			}
+			return(true);
+		}
+
+		// read a required string member, or an optional one
+		// that stays empty when it is missing
+		bool ReadString(const JSON_VALUE& value, const char* key, bool bRequired, std::string& text)
+		{
+			text.clear();
+			const JSON_VALUE* pMember = value.Member(key);
+			if (NULL == pMember)
+			{
+				return(bRequired ? Fail(value, std::string("missing \"") + key + "\"") : true);
+			}
+			if (pMember->type != JSON_VALUE::JSON_STRING)
+			{
+				return(Fail(*pMember, std::string("\"") + key + "\" must be a string"));
+			}
+			text = pMember->text;
+			return(true);
+		}
+
+		// read a number member, keeping the default when missing
+		bool ReadNumber(const JSON_VALUE& value, const char* key, float& number)
+		{
+			const JSON_VALUE* pMember = value.Member(key);
+			if (NULL == pMember)
+			{
+				return(true);
+			}
+			if (pMember->type != JSON_VALUE::JSON_NUMBER)
+			{
+				return(Fail(*pMember, std::string("\"") + key + "\" must be a number"));
+			}
+			number = (float)pMember->number;
+			return(true);
+		}
+
+		// read an array of numbers, keeping the defaults when
+		// the member is missing
+		bool ReadVector(const JSON_VALUE& value, const char* key, int count, float* output)
+		{
+			const JSON_VALUE* pMember = value.Member(key);
+			if (NULL == pMember)
+			{
+				return(true);
+			}
+			bool bValid = (pMember->type == JSON_VALUE::JSON_ARRAY) && ((int)pMember->items.size() == count);
+			for (int i = 0; bValid && (i < count); ++i)
+			{
+				bValid = (pMember->items[i].type == JSON_VALUE::JSON_NUMBER);
+			}
+			if (bValid == false)
+			{
+				std::ostringstream message;
+				message << "\"" << key << "\" must be an array of " << count << " numbers";
+				return(Fail(*pMember, message.str()));
+			}
+			for (int i = 0; i < count; ++i)
+			{
+				output[i] = (float)pMember->items[i].number;
+			}
+			return(true);
+		}
+
+		bool AddTexture(const JSON_VALUE& value)
+		{
+			const char* keys[] = { "tag", "path" };
+			std::string tag;
+			std::string path;
+			if ((CheckKeys(value, keys, 2) == false) ||
+				(ReadString(value, "tag", true, tag) == false) ||
+				(ReadString(value, "path", true, path) == false))
+			{
+				return(false);
+			}
+
+			SceneFile::SCENE_TEXTURE texture;
+			texture.tag = (uint32_t)m_tags.Intern(tag);
+			texture.pathOffset = AddString(path);
+			textures.push_back(texture);
+			return(true);
+		}
+
+		bool AddMaterial(const JSON_VALUE& value)
+		{
+			const char* keys[] = { "tag", "diffuse", "specular", "shininess" };
+			SceneFile::SCENE_MATERIAL material;
+			std::string tag;
+			for (int i = 0; i < 3; ++i)
+			{
+				material.diffuseColor[i] = 1.0f;
+				material.specularColor[i] = 0.0f;
+			}
+			material.shininess = 1.0f;
+
+			if ((CheckKeys(value, keys, 4) == false) ||
+				(ReadString(value, "tag", true, tag) == false) ||
+				(ReadVector(value, "diffuse", 3, material.diffuseColor) == false) ||
+				(ReadVector(value, "specular", 3, material.specularColor) == false) ||
+				(ReadNumber(value, "shininess", material.shininess) == false))
+			{
+				return(false);
+			}
+
+			material.tag = (uint32_t)m_tags.Intern(tag);
+			materials.push_back(material);
+			return(true);
+		}
+
+		bool AddLight(const JSON_VALUE& value)
+		{
+			const char* keys[] = { "type", "direction", "position", "ambient", "diffuse", "specular", "attenuation" };
+			SceneFile::SCENE_LIGHT light;
+			std::string type;
+			float attenuation[3] = { 1.0f, 0.0f, 0.0f };
+			for (int i = 0; i < 3; ++i)
+			{
+				light.position[i] = 0.0f;
+				light.ambient[i] = 0.0f;
+				light.diffuse[i] = 0.0f;
+				light.specular[i] = 0.0f;
+			}
+
+			if ((CheckKeys(value, keys, 7) == false) ||
+				(ReadString(value, "type", true, type) == false))
+			{
+				return(false);
+			}
+			if (type == "directional")
+			{
+				light.type = SceneFile::SCENE_LIGHT_DIRECTIONAL;
+				if ((NULL != value.Member("position")) || (NULL != value.Member("attenuation")))
+				{
+					return(Fail(value, "a directional light has a direction, no position or attenuation"));
+				}
+				if (ReadVector(value, "direction", 3, light.position) == false)
+				{
+					return(false);
+				}
+			}
+			else if (type == "point")
+			{
+				light.type = SceneFile::SCENE_LIGHT_POINT;
+				if (NULL != value.Member("direction"))
+				{
+					return(Fail(value, "a point light has a position, no direction"));
+				}
+				if ((ReadVector(value, "position", 3, light.position) == false) ||
+					(ReadVector(value, "attenuation", 3, attenuation) == false))
+				{
+					return(false);
+				}
+			}
+			else
+			{
+				return(Fail(value, "light type must be \"directional\" or \"point\""));
+			}
+
+			if ((ReadVector(value, "ambient", 3, light.ambient) == false) ||
+				(ReadVector(value, "diffuse", 3, light.diffuse) == false) ||
+				(ReadVector(value, "specular", 3, light.specular) == false))
+			{
+				return(false);
+			}
+
+			light.constant = attenuation[0];
+			light.linear = attenuation[1];
+			light.quadratic = attenuation[2];
+			lights.push_back(light);
+			return(true);
+		}
+
+		// index of a group named before, or -1 for no name
+		bool FindGroup(const JSON_VALUE& value, const char* key, int32_t& group)
+		{
+			std::string name;
+			group = -1;
+			if (ReadString(value, key, false, name) == false)
+			{
+				return(false);
+			}
+			if (name.empty())
+			{
+				return(true);
+			}
+			group = m_groupNames.Find(name);
+			if (group == TagTable::INVALID_TAG)
+			{
+				return(Fail(value, "group \"" + name + "\" is not defined before it is used"));
+			}
+			return(true);
+		}
+
+		bool AddGroup(const JSON_VALUE& value)
+		{
+			const char* keys[] = { "name", "position", "parent", "animated" };
+			SceneFile::SCENE_GROUP group;
+			std::string name;
+			for (int i = 0; i < 3; ++i)
+			{
+				group.position[i] = 0.0f;
+			}
+			group.flags = 0;
+
+			if ((CheckKeys(value, keys, 4) == false) ||
+				(ReadString(value, "name", true, name) == false) ||
+				(ReadVector(value, "position", 3, group.position) == false) ||
+				(FindGroup(value, "parent", group.parent) == false))
+			{
+				return(false);
+			}
+			if (m_groupNames.Find(name) != TagTable::INVALID_TAG)
+			{
+				return(Fail(value, "group \"" + name + "\" is defined more than once"));
+			}
+
+			const JSON_VALUE* pAnimated = value.Member("animated");
+			if (NULL != pAnimated)
+			{
+				if (pAnimated->type != JSON_VALUE::JSON_BOOL)
+				{
+					return(Fail(*pAnimated, "\"animated\" must be true or false"));
+				}
+				if (pAnimated->bValue)
+				{
+					group.flags |= SceneFile::SCENE_GROUP_ANIMATED;
+				}
+			}
+
+			m_groupNames.Intern(name);
+			groups.push_back(group);
+			return(true);
+		}
+
+		bool AddObject(const JSON_VALUE& value)
+		{
+			const char* keys[] = { "mesh", "group", "scale", "rotation", "position", "color", "uv", "texture", "material" };
+			SceneFile::SCENE_OBJECT object;
+			std::string mesh;
+			std::string texture;
+			std::string material;
+			for (int i = 0; i < 3; ++i)
+			{
+				object.scale[i] = 1.0f;
+				object.rotationDegrees[i] = 0.0f;
+				object.position[i] = 0.0f;
+			}
+			for (int i = 0; i < 4; ++i)
+			{
+				object.color[i] = 1.0f;
+			}
+			object.uvScale[0] = 1.0f;
+			object.uvScale[1] = 1.0f;
+
+			if ((CheckKeys(value, keys, 9) == false) ||
+				(ReadString(value, "mesh", true, mesh) == false) ||
+				(FindGroup(value, "group", object.group) == false) ||
+				(ReadVector(value, "scale", 3, object.scale) == false) ||
+				(ReadVector(value, "rotation", 3, object.rotationDegrees) == false) ||
+				(ReadVector(value, "position", 3, object.position) == false) ||
+				(ReadVector(value, "color", 4, object.color) == false) ||
+				(ReadVector(value, "uv", 2, object.uvScale) == false) ||
+				(ReadString(value, "texture", false, texture) == false) ||
+				(ReadString(value, "material", false, material) == false))
+			{
+				return(false);
+			}
+
+			object.mesh = MESH_COUNT;
+			for (int i = 0; i < MESH_COUNT; ++i)
+			{
+				if (mesh == MESH_NAMES[i])
+				{
+					object.mesh = (uint32_t)i;
+				}
+			}
+			if (object.mesh == MESH_COUNT)
+			{
+				return(Fail(value, "unknown mesh \"" + mesh + "\""));
+			}
+
+			// tags that are never defined are reported by the scene
+			// validation when the file is loaded
+			object.textureTag = texture.empty() ? -1 : m_tags.Intern(texture);
+			object.materialTag = material.empty() ? -1 : m_tags.Intern(material);
+			objects.push_back(object);
+			return(true);
+		}
+	};
+
+	/***********************************************************
+	 *  WriteTable()
+	 *
+	 *  This function is used for appending the records of one
+	 *  table to the file bytes and pointing the header at
+	 *  them.
+	 ***********************************************************/
+	template <typename T>
+	void WriteTable(const std::vector<T>& records, SceneFile::SCENE_TABLE& table, std::string& bytes)
+	{
+		table.offset = (uint32_t)bytes.size();
+		table.count = (uint32_t)records.size();
+		if (records.empty() == false)
+		{
+			bytes.append((const char*)records.data(), records.size() * sizeof(T));
+		}
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for cooking every passed in scene.
+ *  EXIT_FAILURE is returned when any of them failed.
+ ***********************************************************/
+int SceneCooker::Run(const std::vector<std::string>& sourcePaths)
+{
+	int failures = 0;
+
+	if (sourcePaths.empty())
+	{
+		std::cout << "Usage: --cook-scene <scene.json> [<scene.json> ...]" << std::endl;
+		return(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < sourcePaths.size(); ++i)
+	{
+		if (CookFile(sourcePaths[i]) == false)
+		{
+			failures++;
+		}
+	}
+
+	std::cout << "Cooked " << (sourcePaths.size() - failures) << " of " << sourcePaths.size() << " scenes" << std::endl;
+	return((failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/***********************************************************
+ *  CookFile()
+ *
+ *  This method is used for cooking one JSON scene into the
+ *  .cscene file next to it.
+ ***********************************************************/
+bool SceneCooker::CookFile(const std::string& sourcePath)
+{
+	std::ifstream source(sourcePath.c_str(), std::ios::binary);
+	if (!source.is_open())
+	{
+		std::cout << "Could not read scene:" << sourcePath << std::endl;
+		return(false);
+	}
+	std::ostringstream text;
+	text << source.rdbuf();
+	source.close();
+	std::string document = text.str();
+
+	JSON_VALUE root;
+	JsonParser parser(document);
+	if (parser.Parse(root) == false)
+	{
+		std::cout << sourcePath << "(" << parser.Line() << "): " << parser.Error() << std::endl;
+		return(false);
+	}
+
+	SceneBuilder builder;
+	if (builder.Build(root) == false)
+	{
+		std::cout << sourcePath << "(" << builder.ErrorLine() << "): " << builder.Error() << std::endl;
+		return(false);
+	}
+
+	SceneFile::SCENE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "CSCN", 4);
+	header.version = SceneFile::FILE_VERSION;
+
+	// every record is a multiple of four bytes, so the tables
+	// stay aligned when written back to back after the header
+	std::string bytes(sizeof(header), '\0');
+	WriteTable(builder.textures, header.textures, bytes);
+	WriteTable(builder.materials, header.materials, bytes);
+	WriteTable(builder.lights, header.lights, bytes);
+	WriteTable(builder.groups, header.groups, bytes);
+	WriteTable(builder.objects, header.objects, bytes);
+	WriteTable(builder.tagRecords, header.tags, bytes);
+	header.strings.offset = (uint32_t)bytes.size();
+	header.strings.count = (uint32_t)builder.strings.size();
+	bytes.append(builder.strings);
+	memcpy(&bytes[0], &header, sizeof(header));
+
+	std::string cookedPath = SceneFile::CookedPath(sourcePath);
+	// written beside the cooked file and moved over it once
+	// complete, for a running application that watches it
+	std::string writePath = cookedPath + ".tmp";
+	std::ofstream file(writePath.c_str(), std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cout << "Could not write cooked scene:" << cookedPath << std::endl;
+		return(false);
+	}
+	file.write(bytes.data(), bytes.size());
+	file.close();
+	if (file.fail() || (MappedFile::MoveOver(writePath.c_str(), cookedPath.c_str()) == false))
+	{
+		std::cout << "Could not write cooked scene:" << cookedPath << std::endl;
+		remove(writePath.c_str());
+		return(false);
+	}
+
+	std::cout << "Cooked " << sourcePath << " -> " << cookedPath
+		<< " (" << builder.objects.size() << " objects, " << builder.groups.size() << " groups, "
+		<< builder.textures.size() << " textures, " << builder.materials.size() << " materials, "
+		<< builder.lights.size() << " lights, " << (bytes.size() / 1024) << " KB)" << std::endl;
+
+	return(true);
+}
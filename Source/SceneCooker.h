@@ -0,0 +1,33 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenecooker.h
+// ============
+// offline tool that compiles JSON scene descriptions into cooked .cscene files
+// of fixed size records that the scene manager maps and uses in place
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SceneCooker
+ *
+ *  This class runs the scene cooking started by the
+ *  --cook-scene command line option.  Each JSON file lists
+ *  the textures, materials, lights, transform groups and
+ *  objects of a scene.  It is parsed once here, every tag
+ *  and group name is resolved to an index, and the tables
+ *  are written out in the layout SceneFile reads, so the
+ *  application never parses text.  No window or GL context
+ *  is needed.
+ ***********************************************************/
+class SceneCooker
+{
+public:
+	// cook every passed in scene next to its source file
+	static int Run(const std::vector<std::string>& sourcePaths);
+	// cook one scene, false when it cannot be read, has an
+	// error, or cannot be written
+	static bool CookFile(const std::string& sourcePath);
+};
@@ -0,0 +1,202 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.cpp
+// =============
+// This file contains the implementation of the `SceneFile` class, which reads
+// the cooked scene files made by the scene cooker.
+//
+// RESPONSIBILITIES:
+// - Map a .cscene file and reject anything truncated or malformed.
+// - Hand out the fixed size records and strings from the mapping.
+//
+// NOTE: Every index and offset is checked when the file is opened, so the
+// scene code can read the records without checking them again.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+#include "MeshLibrary.h"
+
+#include <cstring>
+#include <iostream>
+
+const uint32_t SceneFile::FILE_VERSION;
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+	m_pHeader = NULL;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a cooked scene file and
+ *  checking that the header, every table and every record
+ *  fit in the file.  The records are used in place, so on
+ *  success the file stays mapped until Close().
+ ***********************************************************/
+bool SceneFile::Open(const char* filePath)
+{
+	Close();
+
+	if (m_file.Open(filePath) == false)
+	{
+		return(false);
+	}
+
+	const SCENE_HEADER* pHeader = (const SCENE_HEADER*)m_file.Data();
+	bool bValid = (m_file.Size() >= sizeof(SCENE_HEADER)) &&
+		(memcmp(pHeader->magic, "CSCN", 4) == 0) &&
+		(pHeader->version == FILE_VERSION);
+
+	if (bValid)
+	{
+		m_pHeader = pHeader;
+		bValid = IsTableValid(pHeader->textures, sizeof(SCENE_TEXTURE)) &&
+			IsTableValid(pHeader->materials, sizeof(SCENE_MATERIAL)) &&
+			IsTableValid(pHeader->lights, sizeof(SCENE_LIGHT)) &&
+			IsTableValid(pHeader->groups, sizeof(SCENE_GROUP)) &&
+			IsTableValid(pHeader->objects, sizeof(SCENE_OBJECT)) &&
+			IsTableValid(pHeader->tags, sizeof(SCENE_TAG)) &&
+			IsTableValid(pHeader->strings, 1) &&
+			AreRecordsValid();
+	}
+
+	if (bValid == false)
+	{
+		std::cout << "Not a valid cooked scene file:" << filePath << std::endl;
+		Close();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for releasing the mapped file.
+ ***********************************************************/
+void SceneFile::Close()
+{
+	m_file.Close();
+	m_pHeader = NULL;
+}
+
+/***********************************************************
+ *  IsTableValid()
+ *
+ *  This method is used for checking that a table starts
+ *  after the header, is aligned for its records and ends
+ *  inside the file.
+ ***********************************************************/
+bool SceneFile::IsTableValid(const SCENE_TABLE& table, size_t recordSize) const
+{
+	if (table.count == 0)
+	{
+		return(true);
+	}
+
+	return((table.offset >= sizeof(SCENE_HEADER)) &&
+		((recordSize == 1) || ((table.offset % 4) == 0)) &&
+		((size_t)table.offset + (size_t)table.count * recordSize <= m_file.Size()));
+}
+
+/***********************************************************
+ *  AreRecordsValid()
+ *
+ *  This method is used for checking the references inside
+ *  the records - string offsets inside a string block that
+ *  ends with a zero, tags inside the tag table, meshes that
+ *  exist, and groups whose parents come before them.
+ ***********************************************************/
+bool SceneFile::AreRecordsValid() const
+{
+	const SCENE_HEADER& header = *m_pHeader;
+	uint32_t stringBytes = header.strings.count;
+	int32_t tagCount = (int32_t)header.tags.count;
+	int32_t groupCount = (int32_t)header.groups.count;
+
+	if ((stringBytes == 0) || (String(0)[stringBytes - 1] != '\0'))
+	{
+		return(false);
+	}
+
+	for (uint32_t i = 0; i < header.tags.count; ++i)
+	{
+		if (Records<SCENE_TAG>(header.tags)[i].nameOffset >= stringBytes)
+		{
+			return(false);
+		}
+	}
+
+	for (uint32_t i = 0; i < header.textures.count; ++i)
+	{
+		const SCENE_TEXTURE& texture = Texture(i);
+		if ((texture.pathOffset >= stringBytes) || (texture.tag >= header.tags.count))
+		{
+			return(false);
+		}
+	}
+
+	for (uint32_t i = 0; i < header.materials.count; ++i)
+	{
+		if (Material(i).tag >= header.tags.count)
+		{
+			return(false);
+		}
+	}
+
+	for (uint32_t i = 0; i < header.lights.count; ++i)
+	{
+		uint32_t type = Light(i).type;
+		if ((type != SCENE_LIGHT_DIRECTIONAL) && (type != SCENE_LIGHT_POINT))
+		{
+			return(false);
+		}
+	}
+
+	for (int32_t i = 0; i < groupCount; ++i)
+	{
+		int32_t parent = Group((uint32_t)i).parent;
+		if ((parent < -1) || (parent >= i))
+		{
+			return(false);
+		}
+	}
+
+	for (uint32_t i = 0; i < header.objects.count; ++i)
+	{
+		const SCENE_OBJECT& object = Object(i);
+		if ((object.mesh >= (uint32_t)MESH_COUNT) ||
+			(object.group < -1) || (object.group >= groupCount) ||
+			(object.textureTag < -1) || (object.textureTag >= tagCount) ||
+			(object.materialTag < -1) || (object.materialTag >= tagCount))
+		{
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  CookedPath()
+ *
+ *  This method is used for turning a scene source such as
+ *  scenes/nursery.json into scenes/nursery.cscene.
+ ***********************************************************/
+std::string SceneFile::CookedPath(const std::string& sourcePath)
+{
+	size_t slash = sourcePath.find_last_of("/\\");
+	size_t dot = sourcePath.find_last_of('.');
+	if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash)))
+	{
+		return(sourcePath + ".cscene");
+	}
+
+	return(sourcePath.substr(0, dot) + ".cscene");
+}
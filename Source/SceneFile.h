@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.h
+// ============
+// layout of the cooked scene files written by the scene cooker, and a reader
+// that checks them once and then serves their records straight from a mapping
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  This class reads a .cscene file - a header followed by
+ *  tables of fixed size records for the textures, the
+ *  materials, the lights, the transform groups and the
+ *  objects, a table of interned tags, and one block of
+ *  zero terminated strings.  Records refer to each other
+ *  by index and to strings by offset, so nothing has to be
+ *  parsed or fixed up: the file is mapped, checked once by
+ *  Open(), and read in place.
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// kinds of light records
+	enum SCENE_LIGHT_TYPE
+	{
+		SCENE_LIGHT_DIRECTIONAL = 0,
+		SCENE_LIGHT_POINT = 1
+	};
+
+	// bits of a group record's flags
+	enum SCENE_GROUP_FLAGS
+	{
+		// turned by the scene animation, like the mobile
+		SCENE_GROUP_ANIMATED = 1
+	};
+
+	// position and number of records of one table
+	struct SCENE_TABLE
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// start of every cooked scene file
+	struct SCENE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		SCENE_TABLE textures;
+		SCENE_TABLE materials;
+		SCENE_TABLE lights;
+		SCENE_TABLE groups;
+		SCENE_TABLE objects;
+		SCENE_TABLE tags;
+		// the string block, count being its size in bytes
+		SCENE_TABLE strings;
+	};
+
+	// one interned tag, by its string
+	struct SCENE_TAG
+	{
+		uint32_t nameOffset;
+	};
+
+	// one texture image and the tag it is loaded under
+	struct SCENE_TEXTURE
+	{
+		uint32_t pathOffset;
+		uint32_t tag;
+	};
+
+	// one object material and its tag
+	struct SCENE_MATERIAL
+	{
+		float diffuseColor[3];
+		float specularColor[3];
+		float shininess;
+		uint32_t tag;
+	};
+
+	// one directional or point light
+	struct SCENE_LIGHT
+	{
+		uint32_t type;
+		// direction of a directional light
+		float position[3];
+		float ambient[3];
+		float diffuse[3];
+		float specular[3];
+		// fall off of a point light
+		float constant;
+		float linear;
+		float quadratic;
+	};
+
+	// one transform group that objects can be attached to
+	struct SCENE_GROUP
+	{
+		float position[3];
+		// parent group, lower than the group itself, or -1
+		int32_t parent;
+		uint32_t flags;
+	};
+
+	// one scene object
+	struct SCENE_OBJECT
+	{
+		// MESH_TYPE of the object
+		uint32_t mesh;
+		// group the transform is relative to, or -1
+		int32_t group;
+		float scale[3];
+		// euler angles in degrees, applied X, then Y, then Z
+		float rotationDegrees[3];
+		float position[3];
+		float color[4];
+		float uvScale[2];
+		// texture tag, or -1 for a solid colored object
+		int32_t textureTag;
+		// material tag, or -1 for none
+		int32_t materialTag;
+	};
+
+	// current file version
+	static const uint32_t FILE_VERSION = 1;
+
+	// constructor
+	SceneFile();
+
+	// map and check a cooked scene file
+	bool Open(const char* filePath);
+	// release the mapping
+	void Close();
+	// check whether a file is open
+	bool IsOpen() const { return NULL != m_pHeader; }
+
+	// header of the open file
+	const SCENE_HEADER& Header() const { return *m_pHeader; }
+
+	// records of the open file, by index
+	const SCENE_TEXTURE& Texture(uint32_t index) const { return Records<SCENE_TEXTURE>(m_pHeader->textures)[index]; }
+	const SCENE_MATERIAL& Material(uint32_t index) const { return Records<SCENE_MATERIAL>(m_pHeader->materials)[index]; }
+	const SCENE_LIGHT& Light(uint32_t index) const { return Records<SCENE_LIGHT>(m_pHeader->lights)[index]; }
+	const SCENE_GROUP& Group(uint32_t index) const { return Records<SCENE_GROUP>(m_pHeader->groups)[index]; }
+	const SCENE_OBJECT& Object(uint32_t index) const { return Records<SCENE_OBJECT>(m_pHeader->objects)[index]; }
+	// name of an interned tag
+	const char* TagName(uint32_t tag) const { return String(Records<SCENE_TAG>(m_pHeader->tags)[tag].nameOffset); }
+	// zero terminated string at an offset into the string block
+	const char* String(uint32_t offset) const { return (const char*)(m_file.Data() + m_pHeader->strings.offset + offset); }
+
+	// cooked file name of a scene source, its extension
+	// replaced by .cscene
+	static std::string CookedPath(const std::string& sourcePath);
+
+private:
+	MappedFile m_file;
+	const SCENE_HEADER* m_pHeader;
+
+	// first record of a table in the mapping
+	template <typename T>
+	const T* Records(const SCENE_TABLE& table) const { return (const T*)(m_file.Data() + table.offset); }
+
+	// check that a table of records lies inside the file
+	bool IsTableValid(const SCENE_TABLE& table, size_t recordSize) const;
+	// check that every index and offset in the records points
+	// at something that exists
+	bool AreRecordsValid() const;
+};
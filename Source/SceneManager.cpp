@@ -32,14 +32,55 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
 // declaration of global variables
 namespace
 {
 	const char* g_ModelName = "model";
 	const char* g_ColorValueName = "objectColor";
-	const char* g_TextureValueName = "objectTexture";
+	const char* g_TextureIndexName = "textureIndex";
+	const char* g_BindlessTexturesName = "bBindlessTextures";
+	const char* g_TextureArraysName = "textureArrays";
 	const char* g_UseTextureName = "bUseTexture";
-	const char* g_UseLightingName = "bUseLighting";
+	const char* g_UseInstancingName = "bUseInstancing";
+	const char* g_UseInstanceSettingsName = "bUseInstanceSettings";
+	const char* g_UVScaleName = "UVscale";
+	const char* g_MaterialIndexName = "materialIndex";
+	const char* g_FrameBlockName = "FrameData";
+	const char* g_MaterialBlockName = "MaterialData";
+	const char* g_PointLightBlockName = "PointLightData";
+	const char* g_TextureBlockName = "TextureData";
+	const char* g_ClusterRangesName = "clusterLightRanges";
+	const char* g_ClusterIndicesName = "clusterLightIndices";
+	const char* g_ShadowBlockName = "ShadowData";
+	const char* g_ShadowCascadesName = "shadowCascades";
+	const char* g_ShadowViewProjectionName = "shadowViewProjection";
+
+	// default shadow map size in texels and number of cascades
+	const int g_ShadowMapSize = 2048;
+	const int g_ShadowCascadeCount = 3;
+
+	// fewest items of a parallel loop given to one job, loops
+	// this short run on the calling thread
+	const int g_JobGrainItems = 512;
+	// objects the culling tree needs before it is culled on
+	// every core, and the subtrees cut for each thread
+	const int g_ParallelCullObjects = 4096;
+	const int g_CullSubtreesPerThread = 4;
+
+	// starting size of each frame's region of the upload ring,
+	// which grows to the busiest frame
+	const GLsizeiptr g_UploadRegionBytes = 1024 * 1024;
+
+	// distance between the copies of the scene, wider than the
+	// floor and the room in front of the back wall
+	const float g_SceneCopySpacingX = 45.0f;
+	const float g_SceneCopySpacingZ = 25.0f;
 }
 
 /***********************************************************
@@ -47,10 +88,55 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager* pShaderManager)
+SceneManager::SceneManager(ShaderPermutations* pShaderPermutations)
 {
-	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
+	m_pShaderPermutations = pShaderPermutations;
+	for (int i = 0; i < ShaderPermutations::PERMUTATION_COUNT; ++i)
+	{
+		m_programStates[i].program = 0;
+		m_programStates[i].generation = 0;
+	}
+	m_currentPermutation = -1;
+	m_sceneFeatures = 0;
+	m_bUseLighting = false;
+	m_basicMeshes = new MeshLibrary();
+	m_dirtyInstanceFirst = 0;
+	m_dirtyInstanceLast = -1;
+	m_viewState.view = glm::mat4(1.0f);
+	m_viewState.projection = glm::mat4(1.0f);
+	m_viewState.position = glm::vec3(0.0f);
+	m_viewState.nearPlane = 0.1f;
+	m_viewState.farPlane = 100.0f;
+	m_viewState.bOrthographic = false;
+	m_viewState.viewportWidth = 0;
+	m_viewState.viewportHeight = 0;
+	m_drawState.bValid = false;
+	m_bFilterRedundantState = true;
+	m_bUseLightClusters = true;
+	m_bUseMultiDraw = false;
+	m_bBoundsDirty = false;
+	m_bUseFrustumCulling = true;
+	m_bUseGpuCulling = false;
+	m_bUseMeshLods = true;
+	m_bUseDepthPrepass = true;
+	m_shadowMapSize = g_ShadowMapSize;
+	m_shadowCascadeCount = g_ShadowCascadeCount;
+	m_bUseShadows = false;
+	m_staticShadowRunCount = 0;
+	m_bShadowCastersChanged = false;
+	m_bShadowCastersMoved = false;
+	m_shadowCommandFirst = -1;
+	m_jobWorkerCount = -1;
+	m_pFrameArena = NULL;
+	m_bUseUploadRing = true;
+	m_transformParent = -1;
+	m_sceneCopies = 1;
+	m_renderStats.drawCalls = 0;
+	m_renderStats.stateChanges = 0;
+	m_renderStats.redundantStateChanges = 0;
+	m_renderStats.drawnObjects = 0;
+	m_renderStats.culledObjects = 0;
+	m_frameData = FRAME_DATA_STD140();
 }
 
 /***********************************************************
@@ -60,7 +146,7 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
  ***********************************************************/
 SceneManager::~SceneManager()
 {
-	m_pShaderManager = NULL;
+	m_pShaderPermutations = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
 }
@@ -68,90 +154,55 @@ SceneManager::~SceneManager()
 /***********************************************************
  *  CreateGLTexture()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
- ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
-{
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// if the image was successfully read from the image file
-	if (image)
-	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
-		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
-		}
-
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
-
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+ *  This method is used for loading textures from image files
+ *  into the next slot of the texture table.  The texture
+ *  loader returns a placeholder texture right away and
+ *  decodes the image in the background; the table entry
+ *  shows the placeholder until the image arrives, so the
+ *  slot stays valid throughout.
+ ***********************************************************/
+bool SceneManager::CreateGLTexture(const char* filename, const std::string& tag)
+{
+	int tagID = InternTag(tag);
+	if (m_textureSlotsByTag[tagID] >= 0)
+	{
+		std::cout << "ERROR: texture tag \"" << tag << "\" is already loaded, skipping image:" << filename << std::endl;
+		return false;
+	}
 
-		return true;
+	if (m_textureResidency.Count() >= MAX_TEXTURES)
+	{
+		std::cout << "No free texture slot for image:" << filename << std::endl;
+		return false;
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	GLuint textureID = m_textureLoader.Request(filename);
+	m_textureSlotsByTag[tagID] = m_textureResidency.Add(textureID);
+
+	// register the texture and associate it with the special tag string
+	TEXTURE_INFO texture;
+	texture.ID = textureID;
+	texture.tag = tag;
+	texture.tagID = tagID;
+	texture.filename = filename;
+	m_textureIDs.push_back(texture);
 
-	// Error loading the image
-	return false;
+	return true;
 }
 
 /***********************************************************
  *  BindGLTextures()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for binding the texture arrays to
+ *  their texture units.  The shaders reach every texture
+ *  through the texture table, so there are no per-texture
+ *  slots, and with bindless handles nothing is bound.
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	if (m_textureResidency.Backend() == TextureResidency::BACKEND_TEXTURE_ARRAYS)
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		m_textureResidency.BindTextureArrays();
 	}
 }
 
@@ -163,10 +214,12 @@ void SceneManager::BindGLTextures()
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		glGenTextures(1, &m_textureIDs[i].ID);
-	}
+	m_textureLoader.Stop();
+	m_textureStreamer.Stop();
+	m_textureResidency.Destroy();
+	m_textureIDs.clear();
+	m_textureReloads.clear();
+	std::fill(m_textureSlotsByTag.begin(), m_textureSlotsByTag.end(), -1);
 }
 
 /***********************************************************
@@ -174,25 +227,17 @@ void SceneManager::DestroyGLTextures()
  *
  *  This method is used for getting an ID for the previously
  *  loaded texture bitmap associated with the passed in tag.
+ *  With texture arrays this is the array holding the image.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+int SceneManager::FindTextureID(const std::string& tag) const
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	int textureSlot = FindTextureSlot(tag);
+	if (textureSlot < 0)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		return(-1);
 	}
 
-	return(textureID);
+	return((int)m_textureResidency.TextureName(textureSlot));
 }
 
 /***********************************************************
@@ -201,24 +246,9 @@ int SceneManager::FindTextureID(std::string tag)
  *  This method is used for getting a slot index for the previously
  *  loaded texture bitmap associated with the passed in tag.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+int SceneManager::FindTextureSlot(const std::string& tag) const
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
-	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
-	}
-
-	return(textureSlot);
+	return(TextureSlotOf(m_tags.Find(tag)));
 }
 
 /***********************************************************
@@ -226,30 +256,19 @@ int SceneManager::FindTextureSlot(std::string tag)
  *
  *  This method is used for getting a material from the previously
  *  defined materials list that is associated with the passed in tag.
+ *  False is returned when no material has the tag.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+bool SceneManager::FindMaterial(const std::string& tag, OBJECT_MATERIAL& material) const
 {
-	if (m_objectMaterials.size() == 0)
+	int index = FindMaterialIndex(tag);
+	if (index < 0)
 	{
 		return(false);
 	}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
-	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-		}
-		else
-		{
-			index++;
-		}
-	}
+	material.diffuseColor = m_objectMaterials[index].diffuseColor;
+	material.specularColor = m_objectMaterials[index].specularColor;
+	material.shininess = m_objectMaterials[index].shininess;
 
 	return(true);
 }
@@ -267,29 +286,38 @@ void SceneManager::SetTransformations(
 	float ZrotationDegrees,
 	glm::vec3 positionXYZ)
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
+	glm::mat4 modelView = ComposeTransform(
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ);
 
-	modelView = translation * rotationZ * rotationY * rotationX * scale;
+	m_uniforms.model.Set(modelView);
+}
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
-	}
+/***********************************************************
+ *  ComposeTransform()
+ *
+ *  This method is used for building the model matrix from
+ *  the passed in scale, rotation and position values.
+ ***********************************************************/
+glm::mat4 SceneManager::ComposeTransform(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	// the rotation is combined into a quaternion and the
+	// scale is applied to its columns, instead of multiplying
+	// five separate matrices together
+	return(TransformHierarchy::Compose(TransformHierarchy::FromEuler(
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ)));
 }
 
 /***********************************************************
@@ -312,11 +340,8 @@ void SceneManager::SetShaderColor(
 	currentColor.b = blueColorValue;
 	currentColor.a = alphaValue;
 
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
-	}
+	m_uniforms.useTexture.Set(false);
+	m_uniforms.objectColor.Set(currentColor);
 }
 
 /***********************************************************
@@ -326,15 +351,14 @@ void SceneManager::SetShaderColor(
  *  associated with the passed in ID into the shader.
  ***********************************************************/
 void SceneManager::SetShaderTexture(
-	std::string textureTag)
+	const std::string& textureTag)
 {
-	if (NULL != m_pShaderManager)
+	int textureID = -1;
+	textureID = FindTextureSlot(textureTag);
+	if (textureID >= 0)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
-
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		m_uniforms.useTexture.Set(true);
+		m_uniforms.textureIndex.Set(textureID);
 	}
 }
 
@@ -346,10 +370,7 @@ void SceneManager::SetShaderTexture(
  ***********************************************************/
 void SceneManager::SetTextureUVScale(float u, float v)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
-	}
+	m_uniforms.uvScale.Set(glm::vec2(u, v));
 }
 
 /***********************************************************
@@ -359,835 +380,2704 @@ void SceneManager::SetTextureUVScale(float u, float v)
  *  into the shader.
  ***********************************************************/
 void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+	const std::string& materialTag)
 {
-	if (m_objectMaterials.size() > 0)
+	int materialIndex = FindMaterialIndex(materialTag);
+	if (materialIndex >= 0)
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
-
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
+		m_uniforms.materialIndex.Set(materialIndex);
 	}
 }
 
-/**************************************************************/
-/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
-/*** preparing and rendering their own 3D replicated scenes.***/
-/*** Please refer to the code in the OpenGL sample project  ***/
-/*** for assistance.                                        ***/
-/**************************************************************/
-
-void SceneManager::DefineObjectMaterials()
-{
-	/*** STUDENTS - add the code BELOW for defining object materials. ***/
-/*** There is no limit to the number of object materials that can ***/
-/*** be defined. Refer to the code in the OpenGL Sample for help ***/
-	OBJECT_MATERIAL plasticMaterial;
-	plasticMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	plasticMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
-	plasticMaterial.shininess = 21.0;
-	plasticMaterial.tag = "plastic";
-	m_objectMaterials.push_back(plasticMaterial);
-	OBJECT_MATERIAL woodMaterial;
-	woodMaterial.diffuseColor = glm::vec3(0.6f, 0.5f, 0.2f);
-	woodMaterial.specularColor = glm::vec3(0.1f, 0.2f, 0.2f);
-	woodMaterial.shininess = 1.0;
-	woodMaterial.tag = "wood";
-	m_objectMaterials.push_back(woodMaterial);
-	OBJECT_MATERIAL metalMaterial;
-	metalMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.2f);
-	metalMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.8f);
-	metalMaterial.shininess = 8.0;
-	metalMaterial.tag = "metal";
-	m_objectMaterials.push_back(metalMaterial);
-	OBJECT_MATERIAL glassMaterial;
-	glassMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.2f);
-	glassMaterial.specularColor = glm::vec3(0.9f, 0.9f, 0.8f);
-	glassMaterial.shininess = 10.0;
-	glassMaterial.tag = "glass";
-	m_objectMaterials.push_back(glassMaterial);
-	OBJECT_MATERIAL tileMaterial;
-	tileMaterial.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
-	tileMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.7f);
-	tileMaterial.shininess = 6.0;
-	tileMaterial.tag = "tile";
-	m_objectMaterials.push_back(tileMaterial);
-	OBJECT_MATERIAL stoneMaterial;
-	stoneMaterial.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
-	stoneMaterial.specularColor = glm::vec3(0.73f, 0.3f, 0.3f);
-	stoneMaterial.shininess = 6.0;
-	stoneMaterial.tag = "stone";
-	m_objectMaterials.push_back(stoneMaterial);
-}
-void SceneManager::SetupSceneLights()
+/***********************************************************
+ *  FindMaterialIndex()
+ *
+ *  This method is used for getting the index of a previously
+ *  defined material that is associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindMaterialIndex(const std::string& tag) const
 {
-	// this line of code is NEEDED for telling the shaders to render
-	// the 3D scene with custom lighting, if no light sources have
-	// been added then the display window will be black - to use the
-	// default OpenGL lighting then comment out the following line
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
-	/*** STUDENTS - add the code BELOW for setting up light sources ***/
-	/*** Up to five point light sources can be defined. Refer to the code ***/
-	/*** in the OpenGL Sample for help ***/
-	//Directional Light
-	m_pShaderManager->setVec3Value("directionalLight.direction", 0.2f, 5.2f, 0.5f);
-	m_pShaderManager->setVec3Value("directionalLight.ambient", 0.15f, 0.15f, 0.15f);
-	m_pShaderManager->setVec3Value("directionalLight.diffuse", 0.8f, 0.8f, 0.8f);
-	m_pShaderManager->setVec3Value("directionalLight.specular", 1.0f, 0.9f, 0.40f);
-	m_pShaderManager->setBoolValue("directionalLight.bActive", true);
-	// point light 1
-	m_pShaderManager->setVec3Value("pointLights[0].position", 0.0f, 12.0f, 0.0f);
-	m_pShaderManager->setVec3Value("pointLights[0].ambient", 0.35f, 0.35f, 0.35f);
-	m_pShaderManager->setVec3Value("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-	m_pShaderManager->setVec3Value("pointLights[0].specular", 0.25f, 0.25f, 0.25f);
-	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
-	m_pShaderManager->setVec3Value("pointLights[1].position", 0.0f, 8.0f, 0.0f);
-	m_pShaderManager->setVec3Value("pointLights[1].ambient", 0.0f, 0.0f, 0.0f);
-	m_pShaderManager->setVec3Value("pointLights[1].diffuse", 0.6f, 0.6f, 0.65f);
-	m_pShaderManager->setVec3Value("pointLights[1].specular", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setFloatValue("pointLights[1].linear", 0.10f);
-	m_pShaderManager->setFloatValue("pointLights[1].quadratic", 0.05f);
-	m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
+	return(MaterialIndexOf(m_tags.Find(tag)));
 }
+
 /***********************************************************
- *  PrepareScene()
+ *  InternTag()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene
- *  rendering
+ *  This method is used for getting the ID of a texture or
+ *  material tag, growing the lookup tables so that every
+ *  interned ID can index them.
  ***********************************************************/
-void SceneManager::PrepareScene()
+int SceneManager::InternTag(const std::string& tag)
 {
-	SetupSceneLights();
+	int tagID = m_tags.Intern(tag);
+	if (tagID >= (int)m_textureSlotsByTag.size())
+	{
+		m_textureSlotsByTag.resize(tagID + 1, -1);
+		m_materialIndicesByTag.resize(tagID + 1, -1);
+	}
 
-	DefineObjectMaterials();
+	return(tagID);
+}
 
-	// only one instance of a particular mesh needs to be
-	// loaded in memory no matter how many times it is drawn
-	// in the rendered 3D scene
-	
-	//add the textures to the scene
-	CreateGLTexture("textures/greyplastic.jpg", "plasticd_texture");
-	CreateGLTexture("textures/greenplastic.jpg", "plasticc_texture");
-	CreateGLTexture("textures/blueplastic.jpg", "plasticb_texture");
-	CreateGLTexture("textures/Redplastic.jpg", "plastic_texture");
-	CreateGLTexture("textures/sand.png", "sand_texture");
-	CreateGLTexture("textures/brick.jpg", "brick_texture");
-	CreateGLTexture("textures/whitecloth.jpg", "cloth_texture");
-
-	// after the texture image data is loaded into memory, the
-	// loaded textures need to be bound to texture slots - there
-	// are a total of 16 available slots for scene textures
-	BindGLTextures();
+/***********************************************************
+ *  TextureSlotOf()
+ *
+ *  This method is used for getting the texture slot loaded
+ *  under an interned tag.
+ ***********************************************************/
+int SceneManager::TextureSlotOf(int tagID) const
+{
+	if ((tagID < 0) || (tagID >= (int)m_textureSlotsByTag.size()))
+	{
+		return(-1);
+	}
 
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadBoxMesh();       // for the cube.
-	m_basicMeshes->LoadSphereMesh();    // for the sphere.
-	m_basicMeshes->LoadCylinderMesh();  // for the cylinder.
-	m_basicMeshes->LoadPyramid4Mesh();   // for the pyramid.
-	m_basicMeshes->LoadConeMesh();		// for the cone.
-	m_basicMeshes->LoadTorusMesh();    // for the torus.
+	return(m_textureSlotsByTag[tagID]);
 }
+
 /***********************************************************
- *  RenderScene()
+ *  MaterialIndexOf()
  *
- *  This method is used for rendering the 3D scene by
- *  transforming and drawing the basic 3D shapes
+ *  This method is used for getting the material defined
+ *  under an interned tag.
  ***********************************************************/
-void SceneManager::RenderScene()
+int SceneManager::MaterialIndexOf(int tagID) const
 {
+	if ((tagID < 0) || (tagID >= (int)m_materialIndicesByTag.size()))
+	{
+		return(-1);
+	}
 
+	return(m_materialIndicesByTag[tagID]);
+}
 
+/***********************************************************
+ *  RegisterMaterialTags()
+ *
+ *  This method is used for interning the tag of every
+ *  defined material.  When two materials share a tag the
+ *  first one is kept, as the old linear search did.
+ ***********************************************************/
+void SceneManager::RegisterMaterialTags()
+{
+	for (int index = 0; index < (int)m_objectMaterials.size(); ++index)
+	{
+		int tagID = InternTag(m_objectMaterials[index].tag);
+		if (m_materialIndicesByTag[tagID] >= 0)
+		{
+			std::cout << "ERROR: material tag \"" << m_objectMaterials[index].tag
+				<< "\" is defined more than once, the first definition is used" << std::endl;
+		}
+		else
+		{
+			m_materialIndicesByTag[tagID] = index;
+		}
+	}
+}
 
-	// declare the variables for the transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
+/***********************************************************
+ *  ValidateScene()
+ *
+ *  This method is used for checking the tags of every
+ *  registered object after the scene is built.  A texture
+ *  or material that objects use but that was never defined
+ *  is an error, since those objects draw with a solid color
+ *  or the first material.  Definitions that no object uses
+ *  are reported as warnings.  The number of errors is
+ *  returned.
+ ***********************************************************/
+int SceneManager::ValidateScene() const
+{
+	// number of objects using each tag, by tag ID
+	std::vector<int> textureUses(m_tags.Count(), 0);
+	std::vector<int> materialUses(m_tags.Count(), 0);
+	for (size_t i = 0; i < m_renderItems.size(); ++i)
+	{
+		if (m_renderItems[i].textureTag >= 0) textureUses[m_renderItems[i].textureTag]++;
+		if (m_renderItems[i].materialTag >= 0) materialUses[m_renderItems[i].materialTag]++;
+	}
 
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	SetShaderMaterial("default");           
-	SetShaderTexture("plane_texture");       
-	SetTextureUVScale(1.0f, 1.0f);           
-	
-	scaleXYZ = glm::vec3(20.0f, 1.0f, 10.0f);
+	int errors = 0;
+	int warnings = 0;
+	for (int tagID = 0; tagID < m_tags.Count(); ++tagID)
+	{
+		const std::string& tag = m_tags.Name(tagID);
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+		if ((textureUses[tagID] > 0) && (m_textureSlotsByTag[tagID] < 0))
+		{
+			std::cout << "ERROR: texture \"" << tag << "\" is used by " << textureUses[tagID]
+				<< " scene objects but was never loaded" << std::endl;
+			errors++;
+		}
+		if ((materialUses[tagID] > 0) && (m_materialIndicesByTag[tagID] < 0))
+		{
+			std::cout << "ERROR: material \"" << tag << "\" is used by " << materialUses[tagID]
+				<< " scene objects but was never defined" << std::endl;
+			errors++;
+		}
+		if ((materialUses[tagID] > 0) && (m_materialIndicesByTag[tagID] >= MAX_MATERIALS))
+		{
+			std::cout << "ERROR: material \"" << tag << "\" is past the " << MAX_MATERIALS
+				<< " materials that fit in the material table" << std::endl;
+			errors++;
+		}
+		if ((m_textureSlotsByTag[tagID] >= 0) && (textureUses[tagID] == 0))
+		{
+			std::cout << "WARNING: texture \"" << tag << "\" is loaded but no scene object uses it" << std::endl;
+			warnings++;
+		}
+		if ((m_materialIndicesByTag[tagID] >= 0) && (materialUses[tagID] == 0))
+		{
+			std::cout << "WARNING: material \"" << tag << "\" is defined but no scene object uses it" << std::endl;
+			warnings++;
+		}
+	}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
+	std::cout << "Scene validation: " << m_renderItems.size() << " objects, "
+		<< errors << " errors, " << warnings << " warnings" << std::endl;
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	return(errors);
+}
 
-	SetShaderColor(1, 1, 1, 1);
-	SetShaderMaterial("stone");
-	SetShaderTexture("sand_texture");
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
+/***********************************************************
+ *  AddStreamedTextures()
+ *
+ *  This method is used for passing the cooked files that
+ *  the loader handed over this frame to the texture
+ *  streamer, under the texture table slot of the texture
+ *  they were requested for.
+ ***********************************************************/
+void SceneManager::AddStreamedTextures()
+{
+	for (size_t i = 0; i < m_cookedImages.size(); ++i)
+	{
+		int slot = -1;
+		for (size_t index = 0; index < m_textureIDs.size(); ++index)
+		{
+			if (m_textureIDs[index].ID == m_cookedImages[i].textureID)
+			{
+				slot = (int)index;
+				break;
+			}
+		}
 
-	/****************************************************************/
+		if (slot >= 0)
+		{
+			m_textureStreamer.Add(slot, m_cookedImages[i].pCooked);
+		}
+		else
+		{
+			delete m_cookedImages[i].pCooked;
+		}
+	}
+	m_cookedImages.clear();
+}
 
-	/*** Set needed transformations before drawing the basic mesh.  ***/
-	/*** This same ordering of code should be used for transforming ***/
-	/*** and drawing all the basic 3D shapes.						***/
-	/******************************************************************/
-	// set the XYZ scale for the mesh
-	SetShaderMaterial("default");            
-	SetShaderTexture("plane_texture");      
-	SetTextureUVScale(1.0f, 1.0f);           
+/***********************************************************
+ *  GetAssetFiles()
+ *
+ *  This method is used for listing the files that a hot
+ *  reload watches - every texture image with its cooked
+ *  file, whether or not one exists yet, and the scene file
+ *  the scene was prepared from.
+ ***********************************************************/
+void SceneManager::GetAssetFiles(std::vector<std::string>& filePaths) const
+{
+	for (size_t slot = 0; slot < m_textureIDs.size(); ++slot)
+	{
+		filePaths.push_back(m_textureIDs[slot].filename);
+		filePaths.push_back(CookedTexture::CookedPath(m_textureIDs[slot].filename));
+	}
 
-	scaleXYZ = glm::vec3(20.0f, 1.0f, 10.0f);
+	if (false == m_sceneFilePath.empty())
+	{
+		filePaths.push_back(m_sceneFilePath);
+	}
+}
 
-	// set the XYZ rotation for the mesh
-	XrotationDegrees = 90.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  ReloadAsset()
+ *
+ *  This method is used for loading a changed file again.
+ *  The scene file replaces the scene, an image or cooked
+ *  file replaces the textures loaded from it.  A texture
+ *  that is streamed from its cooked file only changes when
+ *  the file is cooked again, so a change to its image is
+ *  only reported.
+ ***********************************************************/
+bool SceneManager::ReloadAsset(const std::string& filePath)
+{
+	if ((false == m_sceneFilePath.empty()) && (filePath == m_sceneFilePath))
+	{
+		ReloadSceneFile();
+		return(true);
+	}
 
-	// set the XYZ position for the mesh
-	positionXYZ = glm::vec3(0.0f, 9.0f, -10.0f);
+	bool bUsed = false;
+	for (size_t slot = 0; slot < m_textureIDs.size(); ++slot)
+	{
+		const std::string& filename = m_textureIDs[slot].filename;
+		if ((filePath == filename) && m_textureStreamer.IsStreamed((int)slot))
+		{
+			std::cout << filename << " changed, cook it again to update the streamed texture" << std::endl;
+			bUsed = true;
+		}
+		else if ((filePath == filename) || (filePath == CookedTexture::CookedPath(filename)))
+		{
+			ReloadTexture((int)slot, filename);
+			bUsed = true;
+		}
+	}
 
-	// set the transformations into memory to be used on the drawn meshes
-	SetTransformations(
-		scaleXYZ,
-		XrotationDegrees,
-		YrotationDegrees,
-		ZrotationDegrees,
-		positionXYZ);
+	return(bUsed);
+}
 
-	// set the color values into the shader
-	SetShaderColor(0.54f, 0.81f, 0.94f, 1.0f);// Light blue color for the plane.
-	SetShaderMaterial("stone");
-	SetShaderTexture("brick_texture");
+/***********************************************************
+ *  ReloadTexture()
+ *
+ *  This method is used for requesting the image of a
+ *  texture slot again.  The loader makes a new texture for
+ *  it, and the slot is only switched over once that has its
+ *  image, so the scene never shows the placeholder.  An
+ *  older reload of the same slot that is still on its way
+ *  is discarded when it arrives.
+ ***********************************************************/
+void SceneManager::ReloadTexture(int slot, const std::string& filename)
+{
+	for (size_t i = 0; i < m_textureReloads.size(); ++i)
+	{
+		if (m_textureReloads[i].slot == slot)
+		{
+			m_textureReloads[i].slot = -1;
+		}
+	}
 
-	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
-	
+	TEXTURE_RELOAD reload;
+	reload.slot = slot;
+	reload.textureID = m_textureLoader.Request(filename.c_str());
+	m_textureReloads.push_back(reload);
+	m_textureIDs[slot].filename = filename;
+}
 
-	//For the torus.
-	scaleXYZ = glm::vec3(0.5f, 0.5f, 0.25f);// Size of the Torus.
-	YrotationDegrees = 0.0f;//
-	XrotationDegrees = 90.0f;// Rotation of the Torus.
-	ZrotationDegrees = 0.0f;//
-	positionXYZ = glm::vec3(0.0f, 6.0f, 0.0f);// Position of the Torus.
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the Torus.
-	SetShaderTexture("plasticd_texture"); // Set the texture for the Torus.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(1.0f, 1.0f); // Set the texture UV scale for the Torus.
-	m_basicMeshes->DrawTorusMesh();// Draw the Torus.
-	//Mobile Arm Horizontal
-	scaleXYZ = glm::vec3(0.10f, -2.05f, 0.10f); // Size of the string. Making it thin and tall.
+/***********************************************************
+ *  FinishTextureReloads()
+ *
+ *  This method is used for swapping the reloaded textures
+ *  that received their image this frame into their slots,
+ *  between frames.  A decoded image replaces the slot's
+ *  texture, a cooked file goes to the streamer, which
+ *  switches the slot over to it.  A failed image never
+ *  arrives, so the reloads still waiting once the loader
+ *  has nothing left are given up, keeping the old image.
+ ***********************************************************/
+void SceneManager::FinishTextureReloads()
+{
+	size_t index = 0;
+	while (index < m_textureReloads.size())
+	{
+		const TEXTURE_RELOAD& reload = m_textureReloads[index];
+		bool bFinished = false;
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 90.0f;
-	positionXYZ = glm::vec3(0.0f, 6.25f, 0.0f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.8f, 0.8f, 0.8f, 1.0f); // Light gray color for the string.
-	SetShaderTexture("plasticd_texture"); // Set the texture for the Torus.
-	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawCylinderMesh();// Draw the string.
-	//Mobile Arm Vertical 1
-	scaleXYZ = glm::vec3(0.10f, -0.35f, 0.10f); // Size of the string. Making it thin and tall.
+		if (std::find(m_finishedTextures.begin(), m_finishedTextures.end(), reload.textureID) != m_finishedTextures.end())
+		{
+			bFinished = true;
+			if (reload.slot >= 0)
+			{
+				m_textureStreamer.Remove(reload.slot);
+				m_textureResidency.Replace(reload.slot, reload.textureID);
+			}
+			else
+			{
+				glDeleteTextures(1, &reload.textureID);
+			}
+		}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 6.25f, 0.0f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.8f, 0.8f, 0.8f, 1.0f); // Light gray color for the string.
-	SetShaderTexture("plasticd_texture"); // Set the texture for the Torus.
-	SetShaderMaterial("plastic");
-	m_basicMeshes->DrawCylinderMesh();// Draw the string.
-	
-	//Mobile Arm Vertical 2
-	scaleXYZ = glm::vec3(0.10f, -3.35f, 0.10f); // Size of the string. Making it thin and tall.
+		for (size_t i = 0; (bFinished == false) && (i < m_cookedImages.size()); ++i)
+		{
+			if (m_cookedImages[i].textureID == reload.textureID)
+			{
+				bFinished = true;
+				if (reload.slot >= 0)
+				{
+					m_textureStreamer.Add(reload.slot, m_cookedImages[i].pCooked);
+				}
+				else
+				{
+					delete m_cookedImages[i].pCooked;
+				}
+				glDeleteTextures(1, &reload.textureID);
+				m_cookedImages.erase(m_cookedImages.begin() + i);
+			}
+		}
 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(2.05f, 6.25f, 0.0f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.8f, 0.8f, 0.8f, 1.0f); // Light gray color for the string.
-	SetShaderTexture("plasticd_texture"); // Set the texture for the Torus.
-	SetShaderMaterial("plastic"); //
-	m_basicMeshes->DrawCylinderMesh();// Draw the string.
-	
-	//Sphere Joint
-	scaleXYZ = glm::vec3(0.10f, 0.10f, 0.10f);// Size of the sphere
-	positionXYZ = glm::vec3(0.00f, 6.25f, 0.0f);
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);// Set the transformations for the sphere.
-	SetShaderTexture("plasticd_texture"); // Set the texture for the sphere.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(1.0f, 1.0f); // Set the texture UV scale for the sphere.
-	m_basicMeshes->DrawSphereMesh(); // Draw the sphere.
-	
-	//Sphere Joint 2
-	scaleXYZ = glm::vec3(0.10f, 0.10f, 0.10f);// Size of the sphere
-	positionXYZ = glm::vec3(2.05f, 6.25f, 0.0f);
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);// Set the transformations for the sphere.
-	SetShaderTexture("plasticd_texture"); // Set the texture for the sphere.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(1.0f, 1.0f); // Set the texture UV scale for the sphere.
-	m_basicMeshes->DrawSphereMesh(); // Draw the sphere.
-
-	//String 1
-	scaleXYZ = glm::vec3(0.02f, 0.65f, 0.02f); // Size of the string. Making it thin and tall.
-
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.525f, 5.30f, 0.0f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.8f, 0.8f, 0.8f, 1.0f); // Light gray color for the string.
-	m_basicMeshes->DrawCylinderMesh();// Draw the string.
-	//String 2
-	scaleXYZ = glm::vec3(0.02f, 0.65f, 0.02f);  //Makes it thin and tall like a string.
-
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-0.525f, 5.30f, 0.0f);// Position of the string in the scene.
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.8f, 0.8f, 0.8f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();// Draw the string.
-	//string 3
-	scaleXYZ = glm::vec3(0.02f, 0.65f, 0.02f); //Makes it thin and tall like a string.
-
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 5.30f, 0.50f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.8f, 0.8f, 0.8f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
-	//String 4
-	scaleXYZ = glm::vec3(0.02f, 0.65f, 0.02f); //Makes it thin and tall like a string.
-
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 5.30f, -0.50f);
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderColor(0.8f, 0.8f, 0.8f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
+		if (bFinished)
+		{
+			if (reload.slot >= 0)
+			{
+				std::cout << "Reloaded texture " << m_textureIDs[reload.slot].filename << std::endl;
+			}
+			m_textureReloads.erase(m_textureReloads.begin() + index);
+		}
+		else
+		{
+			index++;
+		}
+	}
 
+	if ((m_textureReloads.size() > 0) && (m_textureLoader.PendingCount() == 0))
+	{
+		for (size_t i = 0; i < m_textureReloads.size(); ++i)
+		{
+			if (m_textureReloads[i].slot >= 0)
+			{
+				std::cout << "Could not reload texture " << m_textureIDs[m_textureReloads[i].slot].filename
+					<< ", keeping the previous image" << std::endl;
+			}
+			glDeleteTextures(1, &m_textureReloads[i].textureID);
+		}
+		m_textureReloads.clear();
+	}
+}
 
-	//Toy Pyramid
-	scaleXYZ = glm::vec3(0.31f, 0.31f, 0.31f);//Size of the pyramid.
-	YrotationDegrees = 0.0f;
-	XrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
+/***********************************************************
+ *  RequestTextureDetail()
+ *
+ *  This method is used for estimating how many pixels each
+ *  textured object covers - its largest scaled axis
+ *  projected at its view depth - and dividing them by the
+ *  texture repeats across it.  The streamer turns that into
+ *  the mip level the object needs.  Objects wholly behind
+ *  the camera ask for nothing.
+ ***********************************************************/
+void SceneManager::RequestTextureDetail()
+{
+	m_textureStreamer.BeginFrame();
 
-	positionXYZ = glm::vec3(0.525f, 5.25f, 0.0f);// Position of the pyramid in the scene.
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the pyramid.
-	SetShaderTexture("plasticb_texture"); // Set the texture for the pyramid.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(0.10f, 0.10f); // Set the texture UV scale for the pyramid.
-	m_basicMeshes->DrawPyramid4Mesh(); // Draw the pyramid.
+	float viewportHeight = (float)std::max(m_viewState.viewportHeight, 1);
+	float pixelsPerUnit = m_viewState.projection[1][1] * 0.5f * viewportHeight;
 
-	//Toy Sphere
-	scaleXYZ = glm::vec3(0.23f, 0.23f, 0.23f);// Size of the sphere
-	positionXYZ = glm::vec3(0.0f, 5.25f, -0.50f);// Position of the sphere in the scene.
-	SetTransformations(scaleXYZ, 0, 0, 0, positionXYZ);// Set the transformations for the sphere.
-	SetShaderTexture("plasticc_texture"); // Set the texture for the sphere.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(0.20f, 0.20f); // Set the texture UV scale for the sphere.
-	m_basicMeshes->DrawSphereMesh(); // Draw the sphere.
+	for (size_t i = 0; i < m_renderItems.size(); ++i)
+	{
+		const RENDER_ITEM& item = m_renderItems[i];
+		if (m_textureStreamer.IsStreamed(item.textureSlot) == false)
+		{
+			continue;
+		}
 
-	//Toy Cube
-	scaleXYZ = glm::vec3(0.28f, 0.28f, 0.28f);// Size of the box.
-	YrotationDegrees = 0.0f;//
-	XrotationDegrees = 0.0f;//
-	ZrotationDegrees = 0.0f;//
-	positionXYZ = glm::vec3(0.0f, 5.35f, 0.50f);// Position of the box in the scene.
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the cube..
-	SetShaderTexture("plastic_texture"); // Set the texture for the box.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(0.10f, 0.10f); // Set the texture UV scale for the box.
-	m_basicMeshes->DrawBoxMesh();// Draw the box..
-
-
-	//Star
-	scaleXYZ = glm::vec3(0.18f, 0.25f, 0.08f);//Size of the one side.
-	YrotationDegrees = 0.0f;
-	XrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-
-	positionXYZ = glm::vec3(-0.525f, 5.35f, 0.0f);// Position of the pyramid in the scene.
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the pyramid.
-	SetShaderTexture("plasticb_texture"); // Set the texture for the pyramid.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(0.10f, 0.10f); // Set the texture UV scale for the pyramid.
-	m_basicMeshes->DrawPyramid4Mesh(); // Draw the pyramid.
-	// Side 2
-	scaleXYZ = glm::vec3(0.18f, 0.25f, 0.08f);//Size of the another side.
-	YrotationDegrees = 0.0f;
-	XrotationDegrees = 65.0f;
-	ZrotationDegrees = 0.0f;
-
-	positionXYZ = glm::vec3(-0.525f, 5.26f, 0.10f);// Position of the pyramid in the scene.
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the pyramid.
-	SetShaderTexture("plasticb_texture"); // Set the texture for the pyramid.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(0.10f, 0.10f); // Set the texture UV scale for the pyramid.
-	m_basicMeshes->DrawPyramid4Mesh(); // Draw the pyramid.
-	// Side 3
-	scaleXYZ = glm::vec3(0.18f, 0.25f, 0.08f);//Size of the a third side.
-	YrotationDegrees = 0.0f;
-	XrotationDegrees = -65.0f;
-	ZrotationDegrees = 0.0f;
-
-	positionXYZ = glm::vec3(-0.525f, 5.26f, -0.10f);// Position of the pyramid in the scene.
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the pyramid.
-	SetShaderTexture("plasticb_texture"); // Set the texture for the pyramid.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(0.10f, 0.10f); // Set the texture UV scale for the pyramid.
-	m_basicMeshes->DrawPyramid4Mesh(); // Draw the pyramid.
-	// Side 4
-	scaleXYZ = glm::vec3(0.18f, 0.25f, 0.08f);//Size of the fourth side.
-	YrotationDegrees = 0.0f;
-	XrotationDegrees = 145.0f;
-	ZrotationDegrees = 0.0f;
-
-	positionXYZ = glm::vec3(-0.525f, 5.15f, 0.05f);// Position of the pyramid in the scene.
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the pyramid.
-	SetShaderTexture("plasticb_texture"); // Set the texture for the pyramid.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(0.10f, 0.10f); // Set the texture UV scale for the pyramid.
-	m_basicMeshes->DrawPyramid4Mesh(); // Draw the pyramid.
-	// Side 5
-	scaleXYZ = glm::vec3(0.18f, 0.25f, 0.08f);//Size of the final side..
-	YrotationDegrees = 0.0f;
-	XrotationDegrees = -145.0f;
-	ZrotationDegrees = 0.0f;
-
-	positionXYZ = glm::vec3(-0.525f, 5.15f, -0.05f);// Position of the pyramid in the scene.
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the pyramid.
-	SetShaderTexture("plasticb_texture"); // Set the texture for the pyramid.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(0.10f, 0.10f); // Set the texture UV scale for the pyramid.
-	m_basicMeshes->DrawPyramid4Mesh(); // Draw the pyramid.
+		const glm::mat4& model = item.modelMatrix;
+		float radius = std::max(glm::length(glm::vec3(model[0])),
+			std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		float depth = 1.0f;
+		if (m_viewState.bOrthographic == false)
+		{
+			depth = -(m_viewState.view * model[3]).z;
+			if (depth + radius < m_viewState.nearPlane)
+			{
+				continue;
+			}
+			depth = std::max(depth, m_viewState.nearPlane);
+		}
 
-	//Feet of Bassinet
-	scaleXYZ = glm::vec3(0.1f, 1.72f, 0.1f);// Size of the cylinder.
-	YrotationDegrees = 0.0f;//
-	XrotationDegrees = 0.0f;//
-	ZrotationDegrees = 0.0f;//
-	positionXYZ = glm::vec3(-1.5f, 0.55f, 1.1f);// Position of the cylinder in the scene.
+		float pixels = 2.0f * radius * pixelsPerUnit / depth;
+		float repeats = std::max(std::max(item.uvScale.x, item.uvScale.y), 0.001f);
+		m_textureStreamer.RequestDetail(item.textureSlot, pixels / repeats);
+	}
+}
 
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the cylinder..
-	SetShaderTexture("plasticd_texture"); // Set the texture for the cylinder.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(1.0f, 1.0f); // Set the texture UV scale for the cylinder.
-	m_basicMeshes->DrawCylinderMesh();// Draw the cylinder..
+/***********************************************************
+ *  SelectMeshLods()
+ *
+ *  This method is used for picking the level of detail of
+ *  every drawn instance.  Its size on screen is estimated
+ *  like the texture detail, from the radius its level of
+ *  detail rounds off projected at its view depth, and the
+ *  mesh library turns that into a level, keeping the
+ *  previous one near a switch point.  Instances that were
+ *  culled keep their level until they are seen again.  The
+ *  items are spread over the job threads, each instance
+ *  being written by the one job that holds its item.
+ ***********************************************************/
+void SceneManager::SelectMeshLods()
+{
+	float viewportHeight = (float)std::max(m_viewState.viewportHeight, 1);
+	float pixelsPerUnit = m_viewState.projection[1][1] * 0.5f * viewportHeight;
 
-	//leg 2
+	m_jobSystem.ParallelFor((int)m_renderItems.size(), g_JobGrainItems,
+		[this, pixelsPerUnit](int begin, int end, int)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				const RENDER_ITEM& item = m_renderItems[i];
+				int instanceIndex = item.instanceIndex;
+				if ((instanceIndex < 0) || (m_instanceVisible[instanceIndex] == 0))
+				{
+					continue;
+				}
+				if ((m_bUseMeshLods == false) || (m_basicMeshes->LodCount(item.mesh) <= 1))
+				{
+					m_instanceLods[instanceIndex] = 0;
+					continue;
+				}
+
+				const glm::mat4& model = item.modelMatrix;
+				float radius = MeshLibrary::TessellatedRadius(item.mesh, model);
+				float depth = 1.0f;
+				if (m_viewState.bOrthographic == false)
+				{
+					depth = std::max(-(m_viewState.view * model[3]).z, m_viewState.nearPlane);
+				}
+
+				float pixels = 2.0f * radius * pixelsPerUnit / depth;
+				m_instanceLods[instanceIndex] = (signed char)m_basicMeshes->SelectLod(
+					item.mesh, pixels, m_instanceLods[instanceIndex]);
+			}
+		});
+}
 
-	scaleXYZ = glm::vec3(0.1f, 1.72f, 0.1f);// Size of the cylinder.
-	YrotationDegrees = 0.0f;//
-	XrotationDegrees = 0.0f;//
-	ZrotationDegrees = 0.0f;//
-	positionXYZ = glm::vec3(1.5f, 0.55f, 1.1f);// Position of the cylinder in the scene.
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the cylinder..
-	SetShaderTexture("plasticd_texture"); // Set the texture for the cylinder.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(1.0f, 1.0f); // Set the texture UV scale for the cylinder.
-	m_basicMeshes->DrawCylinderMesh();// Draw the cylinder..
-	//leg 4
-	
-	scaleXYZ = glm::vec3(0.1f, 1.72f, 0.1f);// Size of the cylinder.
-	YrotationDegrees = 0.0f;//
-	XrotationDegrees = 0.0f;//
-	ZrotationDegrees = 0.0f;//
-	positionXYZ = glm::vec3(-1.5f, 0.55f, -1.1f);// Position of the cylinder in the scene.
+/***********************************************************
+ *  AddTexturedObject()
+ *
+ *  This method is used for registering a textured object
+ *  with the retained scene.  The transformation is composed
+ *  and the texture and material tags are resolved once, so
+ *  no lookups are needed when the object is drawn.
+ ***********************************************************/
+int SceneManager::AddTexturedObject(
+	MESH_TYPE mesh,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ,
+	const std::string& textureTag,
+	const std::string& materialTag,
+	float u,
+	float v)
+{
+	return(AddObject(
+		mesh,
+		TransformHierarchy::FromEuler(
+			scaleXYZ,
+			XrotationDegrees,
+			YrotationDegrees,
+			ZrotationDegrees,
+			positionXYZ),
+		glm::vec4(1.0f),
+		glm::vec2(u, v),
+		InternTag(textureTag),
+		InternTag(materialTag)));
+}
+
+/***********************************************************
+ *  AddColoredObject()
+ *
+ *  This method is used for registering a solid colored
+ *  object with the retained scene.
+ ***********************************************************/
+int SceneManager::AddColoredObject(
+	MESH_TYPE mesh,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ,
+	glm::vec4 color,
+	const std::string& materialTag)
+{
+	return(AddObject(
+		mesh,
+		TransformHierarchy::FromEuler(
+			scaleXYZ,
+			XrotationDegrees,
+			YrotationDegrees,
+			ZrotationDegrees,
+			positionXYZ),
+		color,
+		glm::vec2(1.0f, 1.0f),
+		TagTable::INVALID_TAG,
+		InternTag(materialTag)));
+}
 
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the cylinder..
-	SetShaderTexture("plasticd_texture"); // Set the texture for the cylinder.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(1.0f, 1.0f); // Set the texture UV scale for the cylinder.
-	m_basicMeshes->DrawCylinderMesh();// Draw the box..
+/***********************************************************
+ *  AddObject()
+ *
+ *  This method is used for registering an object whose
+ *  tags were interned by the caller, below the current
+ *  group.  Textured objects pass a white color; a solid
+ *  colored object with alpha below one is translucent.
+ ***********************************************************/
+int SceneManager::AddObject(
+	MESH_TYPE mesh,
+	const TransformHierarchy::TRANSFORM& local,
+	glm::vec4 color,
+	glm::vec2 uvScale,
+	int textureTag,
+	int materialTag)
+{
+	RENDER_ITEM item;
+
+	item.mesh = mesh;
+	item.transformNode = AddTransformNode(local, (int)m_renderItems.size());
+	item.modelMatrix = m_transforms.WorldMatrix(item.transformNode);
+	item.color = color;
+	item.uvScale = uvScale;
+	item.textureTag = textureTag;
+	item.materialTag = materialTag;
+	item.textureSlot = TextureSlotOf(textureTag);
+	item.materialIndex = MaterialIndexOf(materialTag);
+	item.instanceIndex = -1;
+	item.bTranslucent = (color.a < 1.0f);
+
+	m_renderItems.push_back(item);
+	m_worldBounds.push_back(CullingBVH::TransformBounds(m_basicMeshes->LocalBounds(mesh), item.modelMatrix));
+
+	return((int)m_renderItems.size() - 1);
+}
 
+/***********************************************************
+ *  SetObjectTransform()
+ *
+ *  This method is used for moving a previously registered
+ *  object.  The values are relative to the group the object
+ *  was added to.  Only the dirty flag is set here, and the
+ *  matrix is recomposed by the next UpdateTransforms().
+ ***********************************************************/
+void SceneManager::SetObjectTransform(
+	int objectIndex,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	if ((objectIndex < 0) || (objectIndex >= (int)m_renderItems.size()))
+	{
+		return;
+	}
 
+	m_transforms.SetLocalTransform(
+		m_renderItems[objectIndex].transformNode,
+		TransformHierarchy::FromEuler(
+			scaleXYZ,
+			XrotationDegrees,
+			YrotationDegrees,
+			ZrotationDegrees,
+			positionXYZ));
+}
 
-	//Bassinet Border
-	int numSpheres = 10;
-	float arcRadius = 1.0f;
-	float sphereRadius = 0.15f;
-	float railHeight = 2.95f;
-	float boxLengthX = 2.0f;
-	float boxLengthZ = 1.0f;
-	float thetaStep = glm::half_pi<float>() / numSpheres;
+/***********************************************************
+ *  AddTransformNode()
+ *
+ *  This method is used for adding a transform node below
+ *  the current group and remembering which render item it
+ *  places.  Group nodes pass -1 for the item.
+ ***********************************************************/
+int SceneManager::AddTransformNode(
+	const TransformHierarchy::TRANSFORM& local,
+	int itemIndex)
+{
+	int node = m_transforms.CreateNode(m_transformParent, local);
+	m_nodeItems.push_back(itemIndex);
 
-	float railHeightFloor = 1.95f;
+	return(node);
+}
 
-	// Reusable settings
-	glm::vec3 scale(sphereRadius);
-	SetShaderMaterial("plastic");
-	SetShaderTexture("plasticd_texture");
-	SetTextureUVScale(0.3f, 0.2f);
+/***********************************************************
+ *  CreateTransformGroup()
+ *
+ *  This method is used for creating a group node below the
+ *  current group.  Objects attached to the group move with
+ *  it, so animating the group is a single node update.
+ ***********************************************************/
+int SceneManager::CreateTransformGroup(glm::vec3 positionXYZ)
+{
+	return(AddTransformNode(
+		TransformHierarchy::FromEuler(glm::vec3(1.0f), 0.0f, 0.0f, 0.0f, positionXYZ),
+		-1));
+}
 
-	// === CORNERS ===
-	// Top-Left Corner: θ from 180° to 270° (π to 3π/2)
-	for (int i = 0; i <= numSpheres; ++i) {
-		float theta = glm::pi<float>() + i * thetaStep;
-		float x = arcRadius * cos(theta);
-		float z = arcRadius * sin(theta);
-		glm::vec3 pos = glm::vec3(-boxLengthX / 2, railHeight, -boxLengthZ / 2) + glm::vec3(x, 0.0f, z); //equation for top-left corner position
-		SetTransformations(scale, 0.0f, 0.0f, 0.0f, pos);
-		m_basicMeshes->DrawSphereMesh();
-	}
-
-	// Top-Right Corner: θ from 270° to 360° (3π/2 to 2π)
-	for (int i = 0; i <= numSpheres; ++i) {
-		float theta = glm::pi<float>() * 1.5f + i * thetaStep;
-		float x = arcRadius * cos(theta);
-		float z = arcRadius * sin(theta);
-		glm::vec3 pos = glm::vec3(boxLengthX / 2, railHeight, -boxLengthZ / 2) + glm::vec3(x, 0.0f, z); //equation for top-right corner position
-		SetTransformations(scale, 0.0f, 0.0f, 0.0f, pos);
-		m_basicMeshes->DrawSphereMesh();
-	}
-
-	// Bottom-Right Corner: θ from 0° to 90° (0 to π/2)
-	for (int i = 0; i <= numSpheres; ++i) {
-		float theta = 0.0f + i * thetaStep;
-		float x = arcRadius * cos(theta);
-		float z = arcRadius * sin(theta);
-		glm::vec3 pos = glm::vec3(boxLengthX / 2, railHeight, boxLengthZ / 2) + glm::vec3(x, 0.0f, z);
-		SetTransformations(scale, 0.0f, 0.0f, 0.0f, pos);
-		m_basicMeshes->DrawSphereMesh();
-	}
-
-	// Bottom-Left Corner: θ from 90° to 180° (π/2 to π)
-	for (int i = 0; i <= numSpheres; ++i) {
-		float theta = glm::half_pi<float>() + i * thetaStep;
-		float x = arcRadius * cos(theta);
-		float z = arcRadius * sin(theta);
-		glm::vec3 pos = glm::vec3(-boxLengthX / 2, railHeight, boxLengthZ / 2) + glm::vec3(x, 0.0f, z); //equation for bottom-left corner position
-		SetTransformations(scale, 0.0f, 0.0f, 0.0f, pos);
-		m_basicMeshes->DrawSphereMesh();
+/***********************************************************
+ *  BeginTransformGroup()
+ *
+ *  This method is used for making a group the parent of
+ *  the objects that are added next.
+ ***********************************************************/
+void SceneManager::BeginTransformGroup(int groupNode)
+{
+	if ((groupNode >= 0) && (groupNode < m_transforms.NodeCount()))
+	{
+		m_transformParent = groupNode;
 	}
+}
 
-	// === WALLS ===
-	glm::vec3 wallScaleX(boxLengthX, 0.1f, 0.1f);
-	glm::vec3 wallScaleZ(0.1f, 0.1f, boxLengthZ);
+/***********************************************************
+ *  EndTransformGroup()
+ *
+ *  This method is used for returning to the parent of the
+ *  current group.
+ ***********************************************************/
+void SceneManager::EndTransformGroup()
+{
+	if (m_transformParent >= 0)
+	{
+		m_transformParent = m_transforms.Parent(m_transformParent);
+	}
+}
 
-	// Top wall
-	SetTransformations(wallScaleX, 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, railHeight, -boxLengthZ / 2 - arcRadius));//equation for top wall position
-	m_basicMeshes->DrawBoxMesh();
+/***********************************************************
+ *  LoadSceneLights()
+ *
+ *  This method is used for adding the lights of the scene
+ *  file in place of SetupSceneLights().  When the file is
+ *  loaded again the point lights that exist already are
+ *  changed in place, and those the file no longer has are
+ *  switched off.
+ ***********************************************************/
+void SceneManager::LoadSceneLights()
+{
+	m_bUseLighting = true;
 
-	// Bottom wall
-	SetTransformations(wallScaleX, 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, railHeight, boxLengthZ / 2 + arcRadius));//equation for bottom wall position
-	m_basicMeshes->DrawBoxMesh();
+	const SceneFile::SCENE_HEADER& header = m_sceneFile.Header();
+	int pointLightCount = 0;
+	m_lightManager.SetDirectionalLight(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), false);
+	for (uint32_t i = 0; i < header.lights.count; ++i)
+	{
+		const SceneFile::SCENE_LIGHT& light = m_sceneFile.Light(i);
+		glm::vec3 position(light.position[0], light.position[1], light.position[2]);
+		glm::vec3 ambient(light.ambient[0], light.ambient[1], light.ambient[2]);
+		glm::vec3 diffuse(light.diffuse[0], light.diffuse[1], light.diffuse[2]);
+		glm::vec3 specular(light.specular[0], light.specular[1], light.specular[2]);
 
-	// Left wall
-	SetTransformations(wallScaleZ, 0.0f, 0.0f, 0.0f, glm::vec3(-boxLengthX / 2 - arcRadius, railHeight, 0.0f)); //equation for left wall position
-	m_basicMeshes->DrawBoxMesh();
+		if (light.type == SceneFile::SCENE_LIGHT_DIRECTIONAL)
+		{
+			m_lightManager.SetDirectionalLight(position, ambient, diffuse, specular);
+		}
+		else if (pointLightCount < m_lightManager.PointLightCount())
+		{
+			m_lightManager.SetPointLightPosition(pointLightCount, position);
+			m_lightManager.SetPointLightColor(pointLightCount, ambient, diffuse, specular);
+			m_lightManager.SetPointLightAttenuation(pointLightCount, light.constant, light.linear, light.quadratic);
+			m_lightManager.SetPointLightActive(pointLightCount, true);
+			pointLightCount++;
+		}
+		else
+		{
+			m_lightManager.AddPointLight(position, ambient, diffuse, specular,
+				light.constant, light.linear, light.quadratic);
+			pointLightCount++;
+		}
+	}
 
-	// Right wall
-	SetTransformations(wallScaleZ, 0.0f, 0.0f, 0.0f, glm::vec3(boxLengthX / 2 + arcRadius, railHeight, 0.0f)); //equation for right wall position
-	m_basicMeshes->DrawBoxMesh();
+	for (int index = pointLightCount; index < m_lightManager.PointLightCount(); ++index)
+	{
+		m_lightManager.SetPointLightActive(index, false);
+	}
+}
 
-	// === SECOND BORDER (renamed variables) ===
-	int    numSpheresFl = 6;
-	float  arcRadiusFl = 0.5f;
-	float  sphereRadiusFl = 0.15f;
-	float  boxLengthXFl = 1.65f;
-	float  boxLengthZFl = 0.9f;
-	float  thetaStepFl = glm::half_pi<float>() / numSpheresFl; // Step size for the angle in radians
-	float  railHeightFloorFl = 2.15f;
+/***********************************************************
+ *  LoadSceneMaterials()
+ *
+ *  This method is used for defining the materials of the
+ *  scene file in place of DefineObjectMaterials().
+ ***********************************************************/
+void SceneManager::LoadSceneMaterials()
+{
+	const SceneFile::SCENE_HEADER& header = m_sceneFile.Header();
+	m_objectMaterials.reserve(m_objectMaterials.size() + header.materials.count);
+	for (uint32_t i = 0; i < header.materials.count; ++i)
+	{
+		const SceneFile::SCENE_MATERIAL& record = m_sceneFile.Material(i);
+		OBJECT_MATERIAL material;
+		material.diffuseColor = glm::vec3(record.diffuseColor[0], record.diffuseColor[1], record.diffuseColor[2]);
+		material.specularColor = glm::vec3(record.specularColor[0], record.specularColor[1], record.specularColor[2]);
+		material.shininess = record.shininess;
+		material.tag = m_sceneFile.TagName(record.tag);
+		m_objectMaterials.push_back(material);
+	}
+}
 
-	// Reusable settings for this border
-	glm::vec3 scaleFl(sphereRadiusFl);
-	SetShaderMaterial("plastic");
-	SetShaderTexture("plasticd_texture");
+/***********************************************************
+ *  LoadSceneTextures()
+ *
+ *  This method is used for requesting the texture images
+ *  of the scene file under their tags.  When the file is
+ *  loaded again a tag that has a slot already keeps it,
+ *  and is only loaded again when its image file changed.
+ ***********************************************************/
+void SceneManager::LoadSceneTextures()
+{
+	const SceneFile::SCENE_HEADER& header = m_sceneFile.Header();
+	for (uint32_t i = 0; i < header.textures.count; ++i)
+	{
+		const SceneFile::SCENE_TEXTURE& texture = m_sceneFile.Texture(i);
+		const char* filename = m_sceneFile.String(texture.pathOffset);
+		int slot = TextureSlotOf(InternTag(m_sceneFile.TagName(texture.tag)));
 
-	// === CORNERS ===
-	// Top-Left: θ from π to 3π/2
-	for (int i = 0; i <= numSpheresFl; ++i) {
-		float theta = glm::pi<float>() + i * thetaStepFl;
-		float x = arcRadiusFl * cos(theta);
-		float z = arcRadiusFl * sin(theta);
-		glm::vec3 pos = glm::vec3(-boxLengthXFl / 2, railHeightFloorFl, -boxLengthZFl / 2) //equation for top-left corner position
-			+ glm::vec3(x, 0.0f, z);
-		SetTransformations(scaleFl, 0, 0, 0, pos);
-		m_basicMeshes->DrawSphereMesh();
-	}
-
-	// Top-Right: θ from 3π/2 to 2π
-	for (int i = 0; i <= numSpheresFl; ++i) {
-		float theta = glm::pi<float>() * 1.5f + i * thetaStepFl;
-		float x = arcRadiusFl * cos(theta);
-		float z = arcRadiusFl * sin(theta);
-		glm::vec3 pos = glm::vec3(boxLengthXFl / 2, railHeightFloorFl, -boxLengthZFl / 2) //equation for top-right corner position
-			+ glm::vec3(x, 0.0f, z);
-		SetTransformations(scaleFl, 0, 0, 0, pos);
-		m_basicMeshes->DrawSphereMesh();
-	}
-
-	// Bottom-Right: θ from 0 to π/2
-	for (int i = 0; i <= numSpheresFl; ++i) {
-		float theta = i * thetaStepFl;
-		float x = arcRadiusFl * cos(theta);
-		float z = arcRadiusFl * sin(theta);
-		glm::vec3 pos = glm::vec3(boxLengthXFl / 2, railHeightFloorFl, boxLengthZFl / 2) //equation for bottom-right corner position
-			+ glm::vec3(x, 0.0f, z);
-		SetTransformations(scaleFl, 0, 0, 0, pos);
-		m_basicMeshes->DrawSphereMesh();
-	}
-
-	// Bottom-Left: θ from π/2 to π
-	for (int i = 0; i <= numSpheresFl; ++i) {
-		float theta = glm::half_pi<float>() + i * thetaStepFl; // π/2 to π
-		float x = arcRadiusFl * cos(theta); // Calculate x position using the arc radius and angle
-		float z = arcRadiusFl * sin(theta); // Calculate z position using the arc radius and angle
-		glm::vec3 pos = glm::vec3(-boxLengthXFl / 2, railHeightFloorFl, boxLengthZFl / 2) //equation for bottom-left corner position
-			+ glm::vec3(x, 0.0f, z);
-		SetTransformations(scaleFl, 0, 0, 0, pos);
-		m_basicMeshes->DrawSphereMesh();
+		if (slot < 0)
+		{
+			CreateGLTexture(filename, m_sceneFile.TagName(texture.tag));
+		}
+		else if (m_textureIDs[slot].filename != filename)
+		{
+			ReloadTexture(slot, filename);
+		}
 	}
+}
 
-	// === WALLS ===
-	glm::vec3 wallScaleXFl(boxLengthXFl, 0.1f, 0.1f); // Scale for the walls
-	glm::vec3 wallScaleZFl(0.1f, 0.1f, boxLengthZFl); // Scale for the walls
+/***********************************************************
+ *  LoadSceneObjects()
+ *
+ *  This method is used for registering the groups and
+ *  objects of the scene file in place of
+ *  DefineSceneObjects().  The file's tags are interned once
+ *  each, and the scene arrays are grown up front, so the
+ *  objects are read straight from the mapping with no
+ *  string work and no allocation per object.  The file's
+ *  top level is attached to the current group.
+ ***********************************************************/
+void SceneManager::LoadSceneObjects()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	const SceneFile::SCENE_HEADER& header = m_sceneFile.Header();
+	const int rootParent = m_transformParent;
 
-	// Top wall
-	SetTransformations(
-		wallScaleXFl,
-		0, 0, 0,
-		glm::vec3(0.0f, railHeightFloorFl, -boxLengthZFl / 2 - arcRadiusFl) //equation for top wall position
-	);
-	m_basicMeshes->DrawBoxMesh();
+	std::vector<int> tagIDs(header.tags.count);
+	for (uint32_t i = 0; i < header.tags.count; ++i)
+	{
+		tagIDs[i] = InternTag(m_sceneFile.TagName(i));
+	}
 
-	// Bottom wall
-	SetTransformations(
-		wallScaleXFl,
-		0, 0, 0,
-		glm::vec3(0.0f, railHeightFloorFl, boxLengthZFl / 2 + arcRadiusFl) //equation for bottom wall position
-	);
-	m_basicMeshes->DrawBoxMesh();
+	int nodeCount = (int)(header.groups.count + header.objects.count);
+	m_transforms.Reserve(nodeCount);
+	m_nodeItems.reserve(m_nodeItems.size() + nodeCount);
+	m_renderItems.reserve(m_renderItems.size() + header.objects.count);
+	m_worldBounds.reserve(m_worldBounds.size() + header.objects.count);
 
-	// Left wall
-	SetTransformations(
-		wallScaleZFl,
-		0, 0, 0,
-		glm::vec3(-boxLengthXFl / 2 - arcRadiusFl, railHeightFloorFl, 0.0f) //equation for left wall position
-	);
-	m_basicMeshes->DrawBoxMesh();
+	// the file lists every group before the groups below it
+	std::vector<int> groupNodes(header.groups.count);
+	for (uint32_t i = 0; i < header.groups.count; ++i)
+	{
+		const SceneFile::SCENE_GROUP& group = m_sceneFile.Group(i);
+		m_transformParent = (group.parent >= 0) ? groupNodes[group.parent] : rootParent;
+		groupNodes[i] = CreateTransformGroup(glm::vec3(group.position[0], group.position[1], group.position[2]));
+		if (0 != (group.flags & SceneFile::SCENE_GROUP_ANIMATED))
+		{
+			m_mobileNodes.push_back(groupNodes[i]);
+		}
+	}
 
-	// Right wall
-	SetTransformations(
-		wallScaleZFl,
-		0, 0, 0,
-		glm::vec3(boxLengthXFl / 2 + arcRadiusFl, railHeightFloorFl, 0.0f) //equation for right wall position
-	);
-	m_basicMeshes->DrawBoxMesh();
+	for (uint32_t i = 0; i < header.objects.count; ++i)
+	{
+		const SceneFile::SCENE_OBJECT& object = m_sceneFile.Object(i);
+		bool bTextured = (object.textureTag >= 0);
+
+		m_transformParent = (object.group >= 0) ? groupNodes[object.group] : rootParent;
+		AddObject(
+			(MESH_TYPE)object.mesh,
+			TransformHierarchy::FromEuler(
+				glm::vec3(object.scale[0], object.scale[1], object.scale[2]),
+				object.rotationDegrees[0],
+				object.rotationDegrees[1],
+				object.rotationDegrees[2],
+				glm::vec3(object.position[0], object.position[1], object.position[2])),
+			bTextured ? glm::vec4(1.0f) : glm::vec4(object.color[0], object.color[1], object.color[2], object.color[3]),
+			glm::vec2(object.uvScale[0], object.uvScale[1]),
+			bTextured ? tagIDs[object.textureTag] : TagTable::INVALID_TAG,
+			(object.materialTag >= 0) ? tagIDs[object.materialTag] : TagTable::INVALID_TAG);
+	}
+	m_transformParent = rootParent;
 
-	//Bassinet Floor and Side walls
-	float  panelThickness = 0.18f;
-	float  panelRise = railHeight - railHeightFloor;           // vertical span
-	float  spanX = boxLengthX + 2 * arcRadius -1;              // full length front/back
-	float  spanZ = boxLengthZ + 2 * arcRadius - 1;              // full length left/right
-	float  midY = (railHeight + railHeightFloor) * 0.5f;  // midpoint Y for positioning
+	double milliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "Loaded " << header.objects.count << " scene objects and " << header.groups.count
+		<< " groups from " << m_sceneFilePath << " in " << milliseconds << " ms" << std::endl;
+}
 
-	// precompute rotation angles (in degrees)
-	// SetTransformations takes degrees for X/Y/Z rotations
-	float angleX = glm::degrees(atan(panelRise / spanX));
-	float angleZ = glm::degrees(atan(panelRise / spanZ));
+/***********************************************************
+ *  ReloadSceneFile()
+ *
+ *  This method is used for loading the scene file again
+ *  after it was cooked again.  The lights and materials
+ *  are replaced, textures already loaded under a tag keep
+ *  their slot, and the groups and objects are registered
+ *  from scratch and batched like a newly prepared scene.
+ *  A file that cannot be opened leaves the scene as it is.
+ ***********************************************************/
+bool SceneManager::ReloadSceneFile()
+{
+	if (m_sceneFile.Open(m_sceneFilePath.c_str()) == false)
+	{
+		std::cout << "Could not reload scene file:" << m_sceneFilePath << ", keeping the current scene" << std::endl;
+		return(false);
+	}
 
-	// one for X-spanning panels, one for Z-spanning
-	glm::vec3 panelScaleX(spanX, panelRise, panelThickness);
-	glm::vec3 panelScaleZ(panelThickness, panelRise, spanZ);
+	LoadSceneLights();
 
-	// switch to a plain white material
-	SetShaderMaterial("plastic");
-	SetShaderTexture("cloth_texture");  
+	m_objectMaterials.clear();
+	std::fill(m_materialIndicesByTag.begin(), m_materialIndicesByTag.end(), -1);
+	LoadSceneMaterials();
+	RegisterMaterialTags();
+	UploadMaterials();
 
-	// --- FRONT PANEL (between the two front rails) ---
-	SetTransformations(
-		panelScaleX,
-		-angleX,  // tilt “up” toward +Y
-		0.0f,
-		0.0f,
-		glm::vec3(
-			0.0f,
-			midY,
-			-boxLengthZ / 2 - arcRadius + panelThickness * 0.5f //equation for front panel position
-		)
-	);
-	m_basicMeshes->DrawBoxMesh();
+	LoadSceneTextures();
 
-	// --- BACK PANEL ---
-	SetTransformations(
-		panelScaleX,
-		angleX,  // tilt “up” toward +Y
-		0.0f,
-		0.0f,
-		glm::vec3(
-			0.0f,
-			midY,
-			boxLengthZ / 2 + arcRadius - panelThickness * 0.5f // equation for back panel position
-		)
-	);
-	m_basicMeshes->DrawBoxMesh();
+	m_transforms.Clear();
+	m_nodeItems.clear();
+	m_renderItems.clear();
+	m_worldBounds.clear();
+	m_transformParent = -1;
+	m_mobileNodes.clear();
+	AddSceneObjectCopies(true);
+	m_sceneFile.Close();
 
-	// --- LEFT PANEL ---
-	SetTransformations(
-		panelScaleZ,
-		0.0f,
-		0.0f,
-		angleZ,  // tilt around Z-axis so it rises toward +Y
-		glm::vec3(
-			-boxLengthX / 2 - arcRadius + panelThickness * 0.5f,
-			midY,
-			0.0f
-		)
-	);
-	m_basicMeshes->DrawBoxMesh();
+	ValidateScene();
+	BuildRenderBatches();
+	m_drawState.bValid = false;
 
-	// --- RIGHT PANEL ---
-	SetTransformations(
-		panelScaleZ,
-		0.0f,
-		0.0f,
-		-angleZ,  // opposite tilt direction
-		glm::vec3(
-			boxLengthX / 2 + arcRadius - panelThickness * 0.5f,
-			midY,
-			0.0f
-		)
-	);
-	m_basicMeshes->DrawBoxMesh();
-	//Cloth at bottom of bassinet
-	scaleXYZ = glm::vec3(1.3f, 1.2f, 1.0f);// Size of the box.
-	YrotationDegrees = 0.0f;//
-	XrotationDegrees = 0.0f;//
-	ZrotationDegrees = 0.0f;//
-	positionXYZ = glm::vec3(0.0f, 2.05f, 0.0f);// Position of the box in the scene.
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the cube..
-	SetShaderTexture("cloth_texture"); // Set the texture for the box.
-	SetShaderMaterial("stone");
-	SetTextureUVScale(1.0f, 1.0f); // Set the texture UV scale for the box.
-	m_basicMeshes->DrawPlaneMesh();// Draw the box..
+	return(true);
+}
 
-	//Cloth at bottom of bassinet
-	scaleXYZ = glm::vec3(0.1f, 1.7f, 0.1f);// Size of the box.
-	YrotationDegrees = 90.0f;//
-	XrotationDegrees = 0.0f;//
-	ZrotationDegrees = 0.0f;//
-	positionXYZ = glm::vec3(1.40f, 0.65f, -1.0f);// Position of the box in the scene.
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the cube..
-	SetShaderTexture("plasticd_texture"); // Set the texture for the box.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(1.0f, 1.0f); // Set the texture UV scale for the box.
-	m_basicMeshes->DrawCylinderMesh();// Draw the box..
-
-	scaleXYZ = glm::vec3(0.1f, 1.7f, 0.1f);// Size of the box.
-	YrotationDegrees = 90.0f;//
-	XrotationDegrees = 0.0f;//
-	ZrotationDegrees = 0.0f;//
-	positionXYZ = glm::vec3(1.40f, 0.65f, -1.0f);// Position of the box in the scene.
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);// Set the transformations for the cube..
-	SetShaderTexture("plasticd_texture"); // Set the texture for the box.
-	SetShaderMaterial("plastic");
-	SetTextureUVScale(1.0f, 1.0f); // Set the texture UV scale for the box.
-	m_basicMeshes->DrawCylinderMesh();// Draw the box..
-
-	{
-	glm::vec3 scaleXYZ = glm::vec3(16.0f, 2.3f, 6.2f);      // width, height, depth
-	float      Xrotation = 0.0f;
-	float      Yrotation = 0.0f;
-	float      Zrotation = 0.0f;
-	glm::vec3 positionXYZ = glm::vec3(5.0f, 0.3f, -8.0f);     // lift it half-height above ground
-
-	SetTransformations(scaleXYZ, Xrotation, Yrotation, Zrotation, positionXYZ);
-	SetShaderTexture("plastic_texture");
-	SetShaderMaterial("wood");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();   // seat as a flattened box
-}
-
-// ——— Couch Backrest ———
-{
-		glm::vec3 scaleXYZ = glm::vec3(13.0f, 7.8f, 1.6f);      //couch backrest size
-	float      Xrotation = 0.0f;
-	float      Yrotation = 0.0f;
-	float      Zrotation = 0.0f;
-	glm::vec3 positionXYZ = glm::vec3(5.0f, 0.8f, -9.4f);    // behind the seat
-
-	SetTransformations(scaleXYZ, Xrotation, Yrotation, Zrotation, positionXYZ);
-	SetShaderTexture("plastic_texture");
-	SetShaderMaterial("wood");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();   // backrest
-}
-
-// ——— Left Armrest ———
-{
-	glm::vec3 scaleXYZ = glm::vec3(3.2f, 1.5f, 3.2f);      // radius-height-radius
-	float      Xrotation = 0.0f;
-	float      Yrotation = 0.0f;
-	float      Zrotation = 90.0f;                          // rotate cylinder to lie along X
-	glm::vec3 positionXYZ = glm::vec3(-1.4f, 0.65f, -8.0f);    // at left edge
-
-	SetTransformations(scaleXYZ, Xrotation, Yrotation, Zrotation, positionXYZ);
-	SetShaderTexture("plastic_texture");
-	SetShaderMaterial("wood");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh(); // left armrest
-}
-
-// ——— Right Armrest ———
-{
-	glm::vec3 scaleXYZ = glm::vec3(3.2f, 1.5f, 3.2f);
-	float      Xrotation = 0.0f;
-	float      Yrotation = 0.0f;
-	float      Zrotation = 90.0f;
-	glm::vec3 positionXYZ = glm::vec3(12.8f, 0.65f, -8.0f);    // at right edge
-
-	SetTransformations(scaleXYZ, Xrotation, Yrotation, Zrotation, positionXYZ);
-	SetShaderTexture("plastic_texture");
-	SetShaderMaterial("wood");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh(); // right armrest
-}
-{
-	glm::vec3 scaleXYZ = glm::vec3(2.5f, 0.3f, 1.2f);
-	float      Xrotation = 72.0f;
-	float      Yrotation = 0.0f;
-	float      Zrotation = 0.0f;
-	glm::vec3 positionXYZ = glm::vec3(1.3f, 2.65f, -8.0f);    // at right edge
-
-	SetTransformations(scaleXYZ, Xrotation, Yrotation, Zrotation, positionXYZ);
-	SetShaderTexture("plasticb_texture");
-	SetShaderMaterial("wood");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawSphereMesh(); // right armrest
-	//couch
+/***********************************************************
+ *  AddSceneObjectCopies()
+ *
+ *  This method is used for registering the scene objects,
+ *  from the open scene file or as DefineSceneObjects()
+ *  builds them, once for every copy of the scene.  A single
+ *  copy is registered as it always was; with more, each
+ *  copy hangs below a group at its place in the grid, so
+ *  its objects and its mobile keep their own positions.
+ ***********************************************************/
+void SceneManager::AddSceneObjectCopies(bool bSceneFile)
+{
+	for (int copy = 0; copy < m_sceneCopies; ++copy)
+	{
+		if (m_sceneCopies > 1)
+		{
+			BeginTransformGroup(CreateTransformGroup(SceneCopyOffset(copy)));
+		}
+
+		if (bSceneFile)
+		{
+			LoadSceneObjects();
+		}
+		else
+		{
+			DefineSceneObjects();
+		}
+
+		if (m_sceneCopies > 1)
+		{
+			EndTransformGroup();
+		}
+	}
 }
+
+/***********************************************************
+ *  SceneCopyOffset()
+ *
+ *  This method is used for placing a copy of the scene in
+ *  a square grid that starts at the first copy and grows
+ *  along +X and away from the camera along -Z.
+ ***********************************************************/
+glm::vec3 SceneManager::SceneCopyOffset(int copy) const
+{
+	int columns = (int)std::ceil(std::sqrt((double)m_sceneCopies));
+	return(glm::vec3(
+		(float)(copy % columns) * g_SceneCopySpacingX,
+		0.0f,
+		-(float)(copy / columns) * g_SceneCopySpacingZ));
+}
+
+/***********************************************************
+ *  GetSceneCopiesExtent()
+ *
+ *  This method is used for getting the corners of the grid
+ *  the copies of the scene are laid out in, as the offsets
+ *  of the copies in them.
+ ***********************************************************/
+void SceneManager::GetSceneCopiesExtent(glm::vec3& minimum, glm::vec3& maximum) const
+{
+	minimum = SceneCopyOffset(0);
+	maximum = minimum;
+	for (int copy = 1; copy < m_sceneCopies; ++copy)
+	{
+		glm::vec3 offset = SceneCopyOffset(copy);
+		minimum = glm::min(minimum, offset);
+		maximum = glm::max(maximum, offset);
+	}
+}
+
+/***********************************************************
+ *  UpdateTransforms()
+ *
+ *  This method is used for recomposing the dirty transform
+ *  nodes and copying the world matrices that changed into
+ *  their render items and the instance buffer.  Nothing is
+ *  done for a frame in which no object moved.  The matrices
+ *  and bounds are copied on the job threads, since every
+ *  changed node belongs to one item, and the dirty ranges
+ *  and flags they share are gathered on this thread after.
+ ***********************************************************/
+void SceneManager::UpdateTransforms()
+{
+	if (m_transforms.Update() == 0)
+	{
+		return;
+	}
+
+	const std::vector<int>& changedNodes = m_transforms.ChangedNodes();
+	m_jobSystem.ParallelFor((int)changedNodes.size(), g_JobGrainItems,
+		[this, &changedNodes](int begin, int end, int)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				int itemIndex = m_nodeItems[changedNodes[i]];
+				if (itemIndex < 0)
+				{
+					continue;
+				}
+
+				RENDER_ITEM& item = m_renderItems[itemIndex];
+				item.modelMatrix = m_transforms.WorldMatrix(changedNodes[i]);
+				m_worldBounds[itemIndex] = CullingBVH::TransformBounds(m_basicMeshes->LocalBounds(item.mesh), item.modelMatrix);
+				if (item.instanceIndex >= 0)
+				{
+					m_instanceMatrices[item.instanceIndex] = item.modelMatrix;
+				}
+			}
+		});
+
+	for (size_t i = 0; i < changedNodes.size(); ++i)
+	{
+		int itemIndex = m_nodeItems[changedNodes[i]];
+		if (itemIndex < 0)
+		{
+			continue;
+		}
+
+		const RENDER_ITEM& item = m_renderItems[itemIndex];
+		m_bBoundsDirty = true;
+
+		// objects registered after the batches were built are
+		// picked up the next time the batches are rebuilt
+		if (item.instanceIndex >= 0)
+		{
+			MarkInstanceDirty(item.instanceIndex);
+			m_gpuCulling.SetInstanceBounds(item.instanceIndex, m_worldBounds[itemIndex]);
+
+			// an instance that moves once casts its shadow with
+			// the moving casters from then on, so that the cached
+			// cascades stay valid
+			if (0 == m_instanceMoving[item.instanceIndex])
+			{
+				m_instanceMoving[item.instanceIndex] = 1;
+				m_bShadowCastersChanged = true;
+			}
+			m_bShadowCastersMoved = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  MarkInstanceDirty()
+ *
+ *  This method is used for growing the range of instance
+ *  matrices that is sent at the next upload.
+ ***********************************************************/
+void SceneManager::MarkInstanceDirty(int instanceIndex)
+{
+	if (m_dirtyInstanceFirst > m_dirtyInstanceLast)
+	{
+		m_dirtyInstanceFirst = instanceIndex;
+		m_dirtyInstanceLast = instanceIndex;
+	}
+	else
+	{
+		m_dirtyInstanceFirst = std::min(m_dirtyInstanceFirst, instanceIndex);
+		m_dirtyInstanceLast = std::max(m_dirtyInstanceLast, instanceIndex);
+	}
+}
+
+/***********************************************************
+ *  SetupProgram()
+ *
+ *  This method is used for looking up the location of every
+ *  uniform of a program permutation that is set while
+ *  drawing, once, so that drawing an object does no uniform
+ *  name lookups, and for the settings a program needs once
+ *  - its uniform blocks attached to their binding points and
+ *  its samplers on their texture units.  A program starts
+ *  with every uniform at zero, so this runs again for each
+ *  program that replaces it.  Blocks, samplers and settings
+ *  are compiled out of the permutations without the feature
+ *  that reads them, so only those that exist are set.
+ ***********************************************************/
+void SceneManager::SetupProgram(int features)
+{
+	const UniformCache& uniformCache = m_pShaderPermutations->Uniforms(features);
+	SCENE_UNIFORMS& uniforms = m_programStates[features].uniforms;
+
+	// the depth pre-pass and the shadow casters only place
+	// the vertices
+	uniforms.model = uniformCache.Handle<glm::mat4>(g_ModelName);
+	uniforms.useInstancing = uniformCache.Handle<bool>(g_UseInstancingName);
+	UniformBuffer::BindProgramBlock(uniformCache.Program(), g_FrameBlockName, FRAME_BLOCK_BINDING);
+	if (0 != (features & ShaderPermutations::FEATURE_SHADOW_CASTER))
+	{
+		uniforms.shadowViewProjection = uniformCache.Handle<glm::mat4>(g_ShadowViewProjectionName);
+	}
+	if (0 != (features & ShaderPermutations::FEATURE_DEPTH_ONLY))
+	{
+		return;
+	}
+
+	uniforms.objectColor = uniformCache.Handle<glm::vec4>(g_ColorValueName);
+	uniforms.textureIndex = uniformCache.Handle<int>(g_TextureIndexName);
+	uniforms.useTexture = uniformCache.Handle<bool>(g_UseTextureName);
+	uniforms.uvScale = uniformCache.Handle<glm::vec2>(g_UVScaleName);
+	uniforms.materialIndex = uniformCache.Handle<int>(g_MaterialIndexName);
+	uniforms.useInstanceSettings = uniformCache.Handle<bool>(g_UseInstanceSettingsName);
+
+	// the light and material data come from shared blocks
+	if (0 != (features & ShaderPermutations::FEATURE_LIT))
+	{
+		UniformBuffer::BindProgramBlock(uniformCache.Program(), g_MaterialBlockName, MATERIAL_BLOCK_BINDING);
+	}
+	if (0 != (features & ShaderPermutations::FEATURE_POINT_LIGHTS))
+	{
+		UniformBuffer::BindProgramBlock(uniformCache.Program(), g_PointLightBlockName, POINT_LIGHT_BLOCK_BINDING);
+	}
+
+	if (0 != (features & ShaderPermutations::FEATURE_TEXTURED))
+	{
+		UniformBuffer::BindProgramBlock(uniformCache.Program(), g_TextureBlockName, TEXTURE_BLOCK_BINDING);
+
+		// texture array N is always on unit N
+		for (int i = 0; i < MAX_TEXTURE_ARRAYS; ++i)
+		{
+			uniformCache.SetValue<int>(std::string(g_TextureArraysName) + "[" + std::to_string(i) + "]", i);
+		}
+		// bindless handles when the driver has them, else arrays
+		if (m_textureResidency.Backend() == TextureResidency::BACKEND_BINDLESS)
+		{
+			uniformCache.SetValue<bool>(g_BindlessTexturesName, true);
+		}
+	}
+
+	// the light cluster buffers always use the same units
+	if (0 != (features & ShaderPermutations::FEATURE_LIGHT_CLUSTERS))
+	{
+		uniformCache.SetValue<int>(g_ClusterRangesName, CLUSTER_RANGE_TEXTURE_UNIT);
+		uniformCache.SetValue<int>(g_ClusterIndicesName, CLUSTER_INDEX_TEXTURE_UNIT);
+	}
+
+	// and so do the shadow cascades
+	if (0 != (features & ShaderPermutations::FEATURE_SHADOWS))
+	{
+		UniformBuffer::BindProgramBlock(uniformCache.Program(), g_ShadowBlockName, SHADOW_BLOCK_BINDING);
+		uniformCache.SetValue<int>(g_ShadowCascadesName, SHADOW_TEXTURE_UNIT);
+	}
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is used for switching the draws over to the
+ *  program of a permutation.  A program that is new, or was
+ *  replaced by a rebuild since it was last drawn with, is
+ *  set up first.  Each program keeps its own uniform values,
+ *  so the draw settings are sent again after a switch.
+ ***********************************************************/
+bool SceneManager::UseProgram(int features, bool bInstanceSettings)
+{
+	if (features == m_currentPermutation)
+	{
+		return(true);
+	}
+	m_currentPermutation = -1;
+
+	GLuint program = m_pShaderPermutations->Program(features);
+	if (0 == program)
+	{
+		return(false);
+	}
+	glUseProgram(program);
+
+	PROGRAM_STATE& state = m_programStates[features];
+	if ((state.program != program) || (state.generation != m_pShaderPermutations->Generation()))
+	{
+		state.program = program;
+		state.generation = m_pShaderPermutations->Generation();
+		SetupProgram(features);
+	}
+
+	m_uniforms = state.uniforms;
+	m_uniforms.useInstancing.Set(true);
+	m_uniforms.useInstanceSettings.Set(bInstanceSettings);
+	m_currentPermutation = features;
+	m_drawState.bValid = false;
+
+	return(true);
+}
+
+/***********************************************************
+ *  SelectSceneFeatures()
+ *
+ *  This method is used for picking the shader features that
+ *  every draw of the frame shares, from the frame data of
+ *  the lights.  A kind of light that is switched off is
+ *  compiled out instead of skipped by the shader, and the
+ *  light features are left out entirely when unlit, so that
+ *  no two permutations draw the same way.
+ ***********************************************************/
+void SceneManager::SelectSceneFeatures()
+{
+	m_sceneFeatures = 0;
+	if (m_bUseLighting == false)
+	{
+		return;
+	}
+
+	m_sceneFeatures |= ShaderPermutations::FEATURE_LIT;
+	if (0 != m_frameData.directionalLight.bActive)
+	{
+		m_sceneFeatures |= ShaderPermutations::FEATURE_DIRECTIONAL_LIGHT;
+		if (m_bUseShadows)
+		{
+			m_sceneFeatures |= ShaderPermutations::FEATURE_SHADOWS;
+		}
+	}
+	if (m_frameData.pointLightCount > 0)
+	{
+		m_sceneFeatures |= ShaderPermutations::FEATURE_POINT_LIGHTS;
+		if (m_frameData.clusterDimensions.x > 0)
+		{
+			m_sceneFeatures |= ShaderPermutations::FEATURE_LIGHT_CLUSTERS;
+		}
+	}
+	if (0 != m_frameData.spotLight.bActive)
+	{
+		m_sceneFeatures |= ShaderPermutations::FEATURE_SPOT_LIGHT;
+	}
+}
+
+/***********************************************************
+ *  ItemFeatures()
+ *
+ *  This method is used for getting the shader features that
+ *  depend on the render item - only whether it is textured.
+ ***********************************************************/
+int SceneManager::ItemFeatures(const RENDER_ITEM& item) const
+{
+	return((item.textureSlot >= 0) ? ShaderPermutations::FEATURE_TEXTURED : 0);
+}
+
+/***********************************************************
+ *  CreateUniformBlocks()
+ *
+ *  This method is used for creating the uniform buffers of
+ *  the frame, material, light and texture blocks, and for
+ *  uploading every defined material into the material table
+ *  once.
+ ***********************************************************/
+void SceneManager::CreateUniformBlocks()
+{
+	m_frameBlock.Create(sizeof(FRAME_DATA_STD140), FRAME_BLOCK_BINDING);
+	m_materialBlock.Create(sizeof(MATERIAL_DATA_STD140), MATERIAL_BLOCK_BINDING);
+	m_lightManager.Create();
+	m_lightClusters.Create();
+	m_bUseShadows = m_shadowCascades.Create(m_shadowMapSize, m_shadowCascadeCount);
+
+	// bindless handles when the driver has them, else arrays
+	m_textureResidency.Create(true);
+	// cooked textures keep only the levels the view needs
+	m_textureStreamer.Create(&m_textureResidency);
+	m_textureLoader.SetStreamCookedTextures(true);
+
+	UploadMaterials();
+}
+
+/***********************************************************
+ *  UploadMaterials()
+ *
+ *  This method is used for writing the defined materials
+ *  into the material block, in material index order.
+ ***********************************************************/
+void SceneManager::UploadMaterials()
+{
+	if (m_objectMaterials.size() > MAX_MATERIALS)
+	{
+		std::cout << "Only the first " << MAX_MATERIALS << " materials fit in the material table" << std::endl;
+	}
+
+	MATERIAL_DATA_STD140 materialData = {};
+	int materialCount = std::min((int)m_objectMaterials.size(), MAX_MATERIALS);
+	for (int index = 0; index < materialCount; ++index)
+	{
+		materialData.materials[index].diffuseColor = m_objectMaterials[index].diffuseColor;
+		materialData.materials[index].specularColor = m_objectMaterials[index].specularColor;
+		materialData.materials[index].shininess = m_objectMaterials[index].shininess;
+	}
+	m_materialBlock.Update(0, sizeof(materialData), &materialData);
+}
+
+/***********************************************************
+ *  BuildRenderBatches()
+ *
+ *  This method is used for grouping the render items that
+ *  share a mesh, texture, material, UV scale and color into
+ *  batches, and for laying out their model matrices so that
+ *  every batch is a contiguous range of the instance buffer.
+ *  Translucent items are never merged, so that each one can
+ *  be ordered by its own distance from the camera.
+ ***********************************************************/
+void SceneManager::BuildRenderBatches()
+{
+	m_renderBatches.clear();
+	m_instanceMatrices.clear();
+	m_instanceMatrices.reserve(m_renderItems.size());
+	m_instanceSettings.clear();
+	m_instanceSettings.reserve(m_renderItems.size());
+
+	// order the items by their draw settings so that items
+	// which can share a draw call end up next to each other,
+	// keeping the registration order inside each group
+	std::vector<int> order(m_renderItems.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = (int)i;
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[this](int a, int b)
+		{
+			const RENDER_ITEM& left = m_renderItems[a];
+			const RENDER_ITEM& right = m_renderItems[b];
+			if (left.mesh != right.mesh) return left.mesh < right.mesh;
+			if (left.textureSlot != right.textureSlot) return left.textureSlot < right.textureSlot;
+			if (left.materialIndex != right.materialIndex) return left.materialIndex < right.materialIndex;
+			if (left.uvScale.x != right.uvScale.x) return left.uvScale.x < right.uvScale.x;
+			if (left.uvScale.y != right.uvScale.y) return left.uvScale.y < right.uvScale.y;
+			for (int c = 0; c < 4; ++c)
+			{
+				if (left.color[c] != right.color[c]) return left.color[c] < right.color[c];
+			}
+			return false;
+		});
+
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		RENDER_ITEM& item = m_renderItems[order[i]];
+		bool bSameBatch = false;
+
+		if (m_renderBatches.size() > 0)
+		{
+			const RENDER_ITEM& first = m_renderItems[m_renderBatches.back().itemIndex];
+			bSameBatch = (first.bTranslucent == false) &&
+				(item.bTranslucent == false) &&
+				(first.mesh == item.mesh) &&
+				(first.textureSlot == item.textureSlot) &&
+				(first.materialIndex == item.materialIndex) &&
+				(first.uvScale == item.uvScale) &&
+				(first.color == item.color);
+		}
+
+		if (bSameBatch == false)
+		{
+			RENDER_BATCH batch;
+			batch.mesh = item.mesh;
+			batch.itemIndex = order[i];
+			batch.firstInstance = (int)m_instanceMatrices.size();
+			batch.instanceCount = 0;
+			m_renderBatches.push_back(batch);
+		}
+
+		item.instanceIndex = (int)m_instanceMatrices.size();
+		m_instanceMatrices.push_back(item.modelMatrix);
+		m_renderBatches.back().instanceCount++;
+
+		// the settings the multi-draw reads in place of uniforms
+		MeshLibrary::INSTANCE_SETTINGS settings;
+		settings.color = item.color;
+		settings.uvScale = item.uvScale;
+		settings.textureSlot = item.textureSlot;
+		settings.materialIndex = std::max(item.materialIndex, 0);
+		m_instanceSettings.push_back(settings);
+	}
+
+	if (m_instanceMatrices.size() > 0)
+	{
+		m_basicMeshes->SetInstanceData(m_instanceMatrices.data(), (int)m_instanceMatrices.size());
+		m_basicMeshes->SetInstanceSettings(m_instanceSettings.data(), (int)m_instanceSettings.size());
+	}
+	m_dirtyInstanceFirst = 0;
+	m_dirtyInstanceLast = -1;
+
+	// the culling tree and the compute pass cover the same
+	// objects as the batches
+	m_cullingBVH.Build(m_worldBounds);
+	m_bBoundsDirty = false;
+	m_instanceVisible.assign(m_instanceMatrices.size(), 1);
+	m_instanceLods.assign(m_instanceMatrices.size(), -1);
+	m_instanceMoving.assign(m_instanceMatrices.size(), 0);
+	BuildShadowCasters();
+	m_shadowCascades.InvalidateStatic();
+	m_gpuCulling.SetInstanceCount((int)m_instanceMatrices.size());
+	for (size_t i = 0; i < m_renderItems.size(); ++i)
+	{
+		m_gpuCulling.SetInstanceBounds(m_renderItems[i].instanceIndex, m_worldBounds[i]);
+	}
+}
+
+/***********************************************************
+ *  CullScene()
+ *
+ *  This method is used for refitting the culling tree to
+ *  the objects that moved and walking it against the
+ *  frustum of the current view.  Only the instances of the
+ *  objects it lets through are drawn this frame.  A large
+ *  tree is cut into subtrees that the job threads cull into
+ *  lists of their own.
+ ***********************************************************/
+void SceneManager::CullScene()
+{
+	if (m_bBoundsDirty)
+	{
+		m_cullingBVH.Refit(m_worldBounds);
+		m_bBoundsDirty = false;
+	}
+
+	if (m_bUseFrustumCulling == false)
+	{
+		std::fill(m_instanceVisible.begin(), m_instanceVisible.end(), 1);
+		m_renderStats.drawnObjects = (int)m_instanceVisible.size();
+		m_renderStats.culledObjects = 0;
+		return;
+	}
+
+	// the compute pass gets every instance and decides on the
+	// GPU, its counts arrive a few frames late
+	if (IsGpuCullingActive())
+	{
+		std::fill(m_instanceVisible.begin(), m_instanceVisible.end(), 1);
+		const GpuCulling::CULL_STATS& stats = m_gpuCulling.Stats();
+		m_renderStats.drawnObjects = stats.visibleInstances;
+		m_renderStats.culledObjects = stats.frustumCulled + stats.occlusionCulled;
+		return;
+	}
+
+	CullingBVH::FRUSTUM frustum;
+	CullingBVH::ExtractFrustum(m_viewState.projection * m_viewState.view, frustum);
+
+	m_visibleItems.clear();
+	if ((m_jobSystem.ThreadCount() > 1) && (m_cullingBVH.ObjectCount() >= g_ParallelCullObjects))
+	{
+		m_cullingBVH.CollectSubtrees(m_jobSystem.ThreadCount() * g_CullSubtreesPerThread, m_cullSubtrees);
+		for (size_t i = 0; i < m_threadVisibleItems.size(); ++i)
+		{
+			m_threadVisibleItems[i].clear();
+		}
+
+		m_jobSystem.ParallelFor((int)m_cullSubtrees.size(), 1,
+			[this, &frustum](int begin, int end, int threadIndex)
+			{
+				for (int i = begin; i < end; ++i)
+				{
+					m_cullingBVH.CullSubtree(frustum, m_cullSubtrees[i], m_threadVisibleItems[threadIndex]);
+				}
+			});
+
+		for (size_t i = 0; i < m_threadVisibleItems.size(); ++i)
+		{
+			m_visibleItems.insert(m_visibleItems.end(), m_threadVisibleItems[i].begin(), m_threadVisibleItems[i].end());
+		}
+	}
+	else
+	{
+		CullingBVH::CULL_STATS stats;
+		m_cullingBVH.Cull(frustum, m_visibleItems, &stats);
+	}
+
+	std::fill(m_instanceVisible.begin(), m_instanceVisible.end(), 0);
+	int drawnObjects = 0;
+	for (size_t i = 0; i < m_visibleItems.size(); ++i)
+	{
+		int instanceIndex = m_renderItems[m_visibleItems[i]].instanceIndex;
+		if (instanceIndex >= 0)
+		{
+			m_instanceVisible[instanceIndex] = 1;
+			drawnObjects++;
+		}
+	}
+	m_renderStats.drawnObjects = drawnObjects;
+	m_renderStats.culledObjects = (int)m_instanceVisible.size() - drawnObjects;
+}
+
+/***********************************************************
+ *  IsGpuCullingActive()
+ *
+ *  This method is used for checking whether the compute
+ *  pass culls this frame, which needs culling turned on
+ *  and the multi-draw to write the commands it culls.
+ ***********************************************************/
+bool SceneManager::IsGpuCullingActive() const
+{
+	return(m_bUseGpuCulling && m_bUseMultiDraw && m_bUseFrustumCulling);
+}
+
+/***********************************************************
+ *  NextVisibleRun()
+ *
+ *  This method is used for finding the next run of visible
+ *  instances in a batch that share a level of detail.  The
+ *  instances stay where the batch put them, so a partly
+ *  culled batch, or one whose instances are at different
+ *  levels, is drawn as one draw per run instead of
+ *  re-sending its matrices.
+ ***********************************************************/
+bool SceneManager::NextVisibleRun(const RENDER_BATCH& batch, int& cursor, int& runFirst, int& runCount, int& runLod) const
+{
+	int end = batch.firstInstance + batch.instanceCount;
+
+	while ((cursor < end) && (m_instanceVisible[cursor] == 0))
+	{
+		cursor++;
+	}
+	runFirst = cursor;
+	runLod = (cursor < end) ? std::max((int)m_instanceLods[cursor], 0) : 0;
+	while ((cursor < end) && (m_instanceVisible[cursor] != 0) &&
+		(std::max((int)m_instanceLods[cursor], 0) == runLod))
+	{
+		cursor++;
+	}
+	runCount = cursor - runFirst;
+
+	return(runCount > 0);
+}
+
+/***********************************************************
+ *  ApplyDrawSettings()
+ *
+ *  This method is used for passing the stored texture, color,
+ *  UV scale and material of one render item into the shader.
+ *  Settings that already match the previous draw are not
+ *  sent again.
+ ***********************************************************/
+void SceneManager::ApplyDrawSettings(const RENDER_ITEM& item)
+{
+	bool bUseTexture = (item.textureSlot >= 0);
+	bool bValid = m_drawState.bValid;
+	bool bSame = false;
+
+	bSame = bValid && (m_drawState.bUseTexture == bUseTexture);
+	if ((bSame == false) || (m_bFilterRedundantState == false))
+	{
+		m_uniforms.useTexture.Set(bUseTexture);
+		m_renderStats.stateChanges++;
+		if (bSame) m_renderStats.redundantStateChanges++;
+	}
+
+	if (bUseTexture)
+	{
+		bSame = bValid && (m_drawState.textureSlot == item.textureSlot);
+		if ((bSame == false) || (m_bFilterRedundantState == false))
+		{
+			m_uniforms.textureIndex.Set(item.textureSlot);
+			m_renderStats.stateChanges++;
+			if (bSame) m_renderStats.redundantStateChanges++;
+		}
+		m_drawState.textureSlot = item.textureSlot;
+	}
+	else
+	{
+		bSame = bValid && (m_drawState.color == item.color);
+		if ((bSame == false) || (m_bFilterRedundantState == false))
+		{
+			m_uniforms.objectColor.Set(item.color);
+			m_renderStats.stateChanges++;
+			if (bSame) m_renderStats.redundantStateChanges++;
+		}
+		m_drawState.color = item.color;
+	}
+
+	bSame = bValid && (m_drawState.uvScale == item.uvScale);
+	if ((bSame == false) || (m_bFilterRedundantState == false))
+	{
+		m_uniforms.uvScale.Set(item.uvScale);
+		m_renderStats.stateChanges++;
+		if (bSame) m_renderStats.redundantStateChanges++;
+	}
+
+	if (item.materialIndex >= 0)
+	{
+		bSame = bValid && (m_drawState.materialIndex == item.materialIndex);
+		if ((bSame == false) || (m_bFilterRedundantState == false))
+		{
+			m_uniforms.materialIndex.Set(item.materialIndex);
+			m_renderStats.stateChanges++;
+			if (bSame) m_renderStats.redundantStateChanges++;
+		}
+		m_drawState.materialIndex = item.materialIndex;
+	}
+
+	m_drawState.bUseTexture = bUseTexture;
+	m_drawState.uvScale = item.uvScale;
+	if (bValid == false)
+	{
+		// a setting that was never sent must not match later
+		if (bUseTexture) m_drawState.color = glm::vec4(-1.0f);
+		else m_drawState.textureSlot = -1;
+		if (item.materialIndex < 0) m_drawState.materialIndex = -1;
+		m_drawState.bValid = true;
+	}
+}
+
+/***********************************************************
+ *  QueueRenderBatches()
+ *
+ *  This method is used for building the sort key of every
+ *  render batch from its settings and its distance from the
+ *  camera, and ordering the frame's draws by those keys.
+ *  The keys are built on the job threads into a command
+ *  array in the frame arena, one slot per batch, and the
+ *  batches that were queued are packed together and added
+ *  to the queue before it is sorted.
+ ***********************************************************/
+void SceneManager::QueueRenderBatches()
+{
+	m_renderQueue.Clear();
+
+	int batchCount = (int)m_renderBatches.size();
+	RenderQueue::RENDER_COMMAND* pCommands = NULL;
+	if (NULL != m_pFrameArena)
+	{
+		pCommands = m_pFrameArena->AllocateArray<RenderQueue::RENDER_COMMAND>(batchCount);
+	}
+	if (NULL == pCommands)
+	{
+		std::cout << "No frame memory for the draw commands of " << batchCount << " batches" << std::endl;
+		return;
+	}
+
+	// the body only captures two pointers, which std::function
+	// keeps without allocating
+	m_jobSystem.ParallelFor(batchCount, g_JobGrainItems,
+		[this, pCommands](int begin, int end, int)
+		{
+			float farPlane = (m_viewState.farPlane > 0.0f) ? m_viewState.farPlane : 1.0f;
+			for (int i = begin; i < end; ++i)
+			{
+				const RENDER_BATCH& batch = m_renderBatches[i];
+				const RENDER_ITEM& item = m_renderItems[batch.itemIndex];
+
+				// batches that were culled completely are not queued,
+				// their slots are marked with no payload
+				int cursor = batch.firstInstance;
+				int runFirst = 0;
+				int runCount = 0;
+				int runLod = 0;
+				if (NextVisibleRun(batch, cursor, runFirst, runCount, runLod) == false)
+				{
+					pCommands[i].payload = -1;
+					continue;
+				}
+
+				// view space distance of the first instance in the batch
+				glm::vec4 viewPosition = m_viewState.view * item.modelMatrix[3];
+				float depth = -viewPosition.z / farPlane;
+
+				// the shader field groups the draws by the features of
+				// their item, the rest of the permutation is per frame
+				RenderQueue::RENDER_COMMAND command;
+				command.payload = i;
+				if (item.bTranslucent)
+				{
+					command.key = RenderQueue::MakeTranslucentKey(
+						ItemFeatures(item), item.textureSlot, item.materialIndex, item.mesh, depth);
+				}
+				else
+				{
+					command.key = RenderQueue::MakeOpaqueKey(
+						ItemFeatures(item), item.textureSlot, item.materialIndex, item.mesh, depth);
+				}
+				pCommands[i] = command;
+			}
+		});
+
+	int queuedCount = 0;
+	for (int i = 0; i < batchCount; ++i)
+	{
+		if (pCommands[i].payload >= 0)
+		{
+			pCommands[queuedCount++] = pCommands[i];
+		}
+	}
+	m_renderQueue.Append(pCommands, queuedCount);
+	m_renderQueue.Sort();
+}
+
+/**************************************************************/
+/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
+/*** preparing and rendering their own 3D replicated scenes.***/
+/*** Please refer to the code in the OpenGL sample project  ***/
+/*** for assistance.                                        ***/
+/**************************************************************/
+
+void SceneManager::DefineObjectMaterials()
+{
+	/*** STUDENTS - add the code BELOW for defining object materials. ***/
+/*** There is no limit to the number of object materials that can ***/
+/*** be defined. Refer to the code in the OpenGL Sample for help ***/
+	OBJECT_MATERIAL plasticMaterial;
+	plasticMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
+	plasticMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
+	plasticMaterial.shininess = 21.0;
+	plasticMaterial.tag = "plastic";
+	m_objectMaterials.push_back(plasticMaterial);
+	OBJECT_MATERIAL woodMaterial;
+	woodMaterial.diffuseColor = glm::vec3(0.6f, 0.5f, 0.2f);
+	woodMaterial.specularColor = glm::vec3(0.1f, 0.2f, 0.2f);
+	woodMaterial.shininess = 1.0;
+	woodMaterial.tag = "wood";
+	m_objectMaterials.push_back(woodMaterial);
+	OBJECT_MATERIAL metalMaterial;
+	metalMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.2f);
+	metalMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.8f);
+	metalMaterial.shininess = 8.0;
+	metalMaterial.tag = "metal";
+	m_objectMaterials.push_back(metalMaterial);
+	OBJECT_MATERIAL glassMaterial;
+	glassMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.2f);
+	glassMaterial.specularColor = glm::vec3(0.9f, 0.9f, 0.8f);
+	glassMaterial.shininess = 10.0;
+	glassMaterial.tag = "glass";
+	m_objectMaterials.push_back(glassMaterial);
+	OBJECT_MATERIAL tileMaterial;
+	tileMaterial.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
+	tileMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.7f);
+	tileMaterial.shininess = 6.0;
+	tileMaterial.tag = "tile";
+	m_objectMaterials.push_back(tileMaterial);
+	OBJECT_MATERIAL stoneMaterial;
+	stoneMaterial.diffuseColor = glm::vec3(0.5f, 0.5f, 0.5f);
+	stoneMaterial.specularColor = glm::vec3(0.73f, 0.3f, 0.3f);
+	stoneMaterial.shininess = 6.0;
+	stoneMaterial.tag = "stone";
+	m_objectMaterials.push_back(stoneMaterial);
+}
+void SceneManager::SetupSceneLights()
+{
+	// this line of code is NEEDED for telling the shaders to render
+	// the 3D scene with custom lighting, if no light sources have
+	// been added then the display window will be black - to use the
+	// default OpenGL lighting then comment out the following line
+	m_bUseLighting = true;
+
+	// the lights are kept by the light manager, which sends a
+	// light to the GPU again only after it has been changed
+
+	/*** STUDENTS - add the code BELOW for setting up light sources ***/
+	/*** Any number of point light sources, up to MAX_POINT_LIGHTS, ***/
+	/*** can be added. Refer to the code in the OpenGL Sample for help ***/
+	//Directional Light
+	m_lightManager.SetDirectionalLight(
+		glm::vec3(0.2f, 5.2f, 0.5f),
+		glm::vec3(0.15f, 0.15f, 0.15f),
+		glm::vec3(0.8f, 0.8f, 0.8f),
+		glm::vec3(1.0f, 0.9f, 0.40f));
+	// point light 1
+	m_lightManager.AddPointLight(
+		glm::vec3(0.0f, 12.0f, 0.0f),
+		glm::vec3(0.35f, 0.35f, 0.35f),
+		glm::vec3(0.8f, 0.8f, 0.8f),
+		glm::vec3(0.25f, 0.25f, 0.25f));
+	// point light 2 - fades with distance
+	m_lightManager.AddPointLight(
+		glm::vec3(0.0f, 8.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 0.0f),
+		glm::vec3(0.6f, 0.6f, 0.65f),
+		glm::vec3(0.2f, 0.2f, 0.2f),
+		1.0f, 0.10f, 0.05f);
+}
+/***********************************************************
+ *  PrepareScene()
+ *
+ *  This method is used for preparing the 3D scene by loading
+ *  the shapes, textures in memory to support the 3D scene
+ *  rendering
+ ***********************************************************/
+void SceneManager::PrepareScene()
+{
+	// a cooked scene file, when one was given, replaces the
+	// lights, materials, textures and objects defined below
+	bool bSceneFile = false;
+	if (false == m_sceneFilePath.empty())
+	{
+		bSceneFile = m_sceneFile.Open(m_sceneFilePath.c_str());
+		if (bSceneFile == false)
+		{
+			std::cout << "Could not load scene file:" << m_sceneFilePath << ", using the built in scene" << std::endl;
+		}
+	}
+
+	if (bSceneFile)
+	{
+		LoadSceneLights();
+		LoadSceneMaterials();
+	}
+	else
+	{
+		SetupSceneLights();
+		DefineObjectMaterials();
+	}
+	RegisterMaterialTags();
+
+	// the buffer updates of every frame go through the ring,
+	// when the driver can map a buffer persistently
+	if (m_bUseUploadRing && m_uploadRing.Create(g_UploadRegionBytes))
+	{
+		m_frameBlock.SetUploadRing(&m_uploadRing);
+		m_materialBlock.SetUploadRing(&m_uploadRing);
+		m_lightManager.SetUploadRing(&m_uploadRing);
+		m_shadowCascades.SetUploadRing(&m_uploadRing);
+		m_basicMeshes->SetUploadRing(&m_uploadRing);
+	}
+
+	// camera and light block, and the table of materials
+	CreateUniformBlocks();
+
+	// only one instance of a particular mesh needs to be
+	// loaded in memory no matter how many times it is drawn
+	// in the rendered 3D scene
+	
+	//add the textures to the scene
+	if (bSceneFile)
+	{
+		LoadSceneTextures();
+	}
+	else
+	{
+		CreateGLTexture("textures/greyplastic.jpg", "plasticd_texture");
+		CreateGLTexture("textures/greenplastic.jpg", "plasticc_texture");
+		CreateGLTexture("textures/blueplastic.jpg", "plasticb_texture");
+		CreateGLTexture("textures/Redplastic.jpg", "plastic_texture");
+		CreateGLTexture("textures/sand.png", "sand_texture");
+		CreateGLTexture("textures/brick.jpg", "brick_texture");
+		CreateGLTexture("textures/whitecloth.jpg", "cloth_texture");
+	}
+
+	// the textures are sampled through the texture table, so
+	// only the texture arrays are bound, once, to fixed units
+	BindGLTextures();
+
+	// plane, box, sphere, cylinder, pyramid, cone and torus
+	m_basicMeshes->LoadMeshes();
+	// the whole scene goes out in one call when the driver can
+	m_bUseMultiDraw = MeshLibrary::SupportsMultiDraw();
+	// and is culled by a compute pass when the driver can
+	m_bUseGpuCulling = m_bUseMultiDraw && m_gpuCulling.Create();
+
+	// the textures and materials are now known, so the scene
+	// objects can be registered once and resolved up front
+	AddSceneObjectCopies(bSceneFile);
+	if (bSceneFile)
+	{
+		m_sceneFile.Close();
+	}
+
+	// every tag is resolved now, so report the ones that are
+	// missing before the first frame instead of drawing wrong
+	ValidateScene();
+
+	// the draw list is built on every core, with a culling
+	// list for each thread
+	m_jobSystem.Create(m_jobWorkerCount);
+	int threadCount = std::max(m_jobSystem.ThreadCount(), 1);
+	m_threadVisibleItems.resize(threadCount);
+
+	// objects with identical settings share one draw call
+	BuildRenderBatches();
+}
+
+/***********************************************************
+ *  UpdateScene()
+ *
+ *  This method is used for posing the animated parts of the
+ *  scene as the simulation left them.  The whole mobile
+ *  turns by rotating its group node, which recomposes the
+ *  objects hanging from it in one update.
+ ***********************************************************/
+void SceneManager::UpdateScene(float mobileDegrees)
+{
+	glm::quat rotation = glm::angleAxis(glm::radians(mobileDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+	for (size_t i = 0; i < m_mobileNodes.size(); ++i)
+	{
+		m_transforms.SetLocalRotation(m_mobileNodes[i], rotation);
+	}
+}
+
+/***********************************************************
+ *  DefineSceneObjects()
+ *
+ *  This method is used for registering every object of the
+ *  3D scene as a render item.  Each object is described once
+ *  here, with its mesh, transformation, texture and material,
+ *  and is then drawn by RenderScene() every frame.
+ ***********************************************************/
+void SceneManager::DefineSceneObjects()
+{
+	// declare the variables for the transformations
+	glm::vec3 scaleXYZ;
+	glm::vec3 positionXYZ;
+
+	//Floor plane
+	scaleXYZ = glm::vec3(20.0f, 1.0f, 10.0f);
+	positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
+	AddTexturedObject(MESH_PLANE, scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ,
+		"sand_texture", "stone");
+
+	//Back wall plane
+	scaleXYZ = glm::vec3(20.0f, 1.0f, 10.0f);
+	positionXYZ = glm::vec3(0.0f, 9.0f, -10.0f);
+	AddTexturedObject(MESH_PLANE, scaleXYZ, 90.0f, 0.0f, 0.0f, positionXYZ,
+		"brick_texture", "stone");
+
+	//Mobile Arm Horizontal
+	scaleXYZ = glm::vec3(0.10f, -2.05f, 0.10f); // Size of the string. Making it thin and tall.
+	positionXYZ = glm::vec3(0.0f, 6.25f, 0.0f);
+	AddTexturedObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 90.0f, positionXYZ,
+		"plasticd_texture", "plastic");
+
+	//Mobile Arm Vertical 2
+	scaleXYZ = glm::vec3(0.10f, -3.35f, 0.10f);
+	positionXYZ = glm::vec3(2.05f, 6.25f, 0.0f);
+	AddTexturedObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ,
+		"plasticd_texture", "plastic");
+
+	//Sphere Joint at the top of the stand
+	scaleXYZ = glm::vec3(0.10f, 0.10f, 0.10f);// Size of the sphere
+	AddTexturedObject(MESH_SPHERE, scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(2.05f, 6.25f, 0.0f),
+		"plasticd_texture", "plastic");
+
+	// the hanging part of the mobile turns as one group around
+	// the joint at the end of the arm - the positions below are
+	// the scene positions, made relative to that joint
+	const glm::vec3 mobilePivot = glm::vec3(0.0f, 6.25f, 0.0f);
+	int mobileNode = CreateTransformGroup(mobilePivot);
+	m_mobileNodes.push_back(mobileNode);
+	BeginTransformGroup(mobileNode);
+
+	//For the torus.
+	scaleXYZ = glm::vec3(0.5f, 0.5f, 0.25f);// Size of the Torus.
+	positionXYZ = glm::vec3(0.0f, 6.0f, 0.0f) - mobilePivot;// Position of the Torus.
+	AddTexturedObject(MESH_TORUS, scaleXYZ, 90.0f, 0.0f, 0.0f, positionXYZ,
+		"plasticd_texture", "plastic");
+
+	//Mobile Arm Vertical 1
+	scaleXYZ = glm::vec3(0.10f, -0.35f, 0.10f);
+	positionXYZ = glm::vec3(0.0f, 6.25f, 0.0f) - mobilePivot;
+	AddTexturedObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ,
+		"plasticd_texture", "plastic");
+
+	//Sphere Joint
+	scaleXYZ = glm::vec3(0.10f, 0.10f, 0.10f);// Size of the sphere
+	AddTexturedObject(MESH_SPHERE, scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(0.00f, 6.25f, 0.0f) - mobilePivot,
+		"plasticd_texture", "plastic");
+
+	//Strings - thin and tall light gray cylinders
+	glm::vec4 stringColor = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f);
+	scaleXYZ = glm::vec3(0.02f, 0.65f, 0.02f);
+	AddColoredObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(0.525f, 5.30f, 0.0f) - mobilePivot,
+		stringColor, "plastic");
+	AddColoredObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(-0.525f, 5.30f, 0.0f) - mobilePivot,
+		stringColor, "plastic");
+	AddColoredObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 5.30f, 0.50f) - mobilePivot,
+		stringColor, "plastic");
+	AddColoredObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, 5.30f, -0.50f) - mobilePivot,
+		stringColor, "plastic");
+
+	//Toy Pyramid
+	scaleXYZ = glm::vec3(0.31f, 0.31f, 0.31f);//Size of the pyramid.
+	positionXYZ = glm::vec3(0.525f, 5.25f, 0.0f) - mobilePivot;// Position of the pyramid in the scene.
+	AddTexturedObject(MESH_PYRAMID4, scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ,
+		"plasticb_texture", "plastic", 0.10f, 0.10f);
+
+	//Toy Sphere
+	scaleXYZ = glm::vec3(0.23f, 0.23f, 0.23f);// Size of the sphere
+	positionXYZ = glm::vec3(0.0f, 5.25f, -0.50f) - mobilePivot;// Position of the sphere in the scene.
+	AddTexturedObject(MESH_SPHERE, scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ,
+		"plasticc_texture", "plastic", 0.20f, 0.20f);
+
+	//Toy Cube
+	scaleXYZ = glm::vec3(0.28f, 0.28f, 0.28f);// Size of the box.
+	positionXYZ = glm::vec3(0.0f, 5.35f, 0.50f) - mobilePivot;// Position of the box in the scene.
+	AddTexturedObject(MESH_BOX, scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ,
+		"plastic_texture", "plastic", 0.10f, 0.10f);
+
+	//Star - five pyramid sides fanned out around the X axis
+	scaleXYZ = glm::vec3(0.18f, 0.25f, 0.08f);//Size of one side.
+	const float starAngles[5] = { 0.0f, 65.0f, -65.0f, 145.0f, -145.0f };
+	const glm::vec3 starPositions[5] = {
+		glm::vec3(-0.525f, 5.35f, 0.0f),
+		glm::vec3(-0.525f, 5.26f, 0.10f),
+		glm::vec3(-0.525f, 5.26f, -0.10f),
+		glm::vec3(-0.525f, 5.15f, 0.05f),
+		glm::vec3(-0.525f, 5.15f, -0.05f) };
+	for (int i = 0; i < 5; ++i)
+	{
+		AddTexturedObject(MESH_PYRAMID4, scaleXYZ, starAngles[i], 0.0f, 0.0f, starPositions[i] - mobilePivot,
+			"plasticb_texture", "plastic", 0.10f, 0.10f);
+	}
+
+	EndTransformGroup();
+
+	//Feet of Bassinet
+	scaleXYZ = glm::vec3(0.1f, 1.72f, 0.1f);// Size of the cylinder.
+	AddTexturedObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(-1.5f, 0.55f, 1.1f),
+		"plasticd_texture", "plastic");
+	//leg 2
+	AddTexturedObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(1.5f, 0.55f, 1.1f),
+		"plasticd_texture", "plastic");
+	//leg 4
+	AddTexturedObject(MESH_CYLINDER, scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(-1.5f, 0.55f, -1.1f),
+		"plasticd_texture", "plastic");
+
+	//Bassinet Border
+	int numSpheres = 10;
+	float arcRadius = 1.0f;
+	float sphereRadius = 0.15f;
+	float railHeight = 2.95f;
+	float boxLengthX = 2.0f;
+	float boxLengthZ = 1.0f;
+
+	float railHeightFloor = 1.95f;
+
+	AddBorderRing(numSpheres, arcRadius, sphereRadius, railHeight, boxLengthX, boxLengthZ);
+
+	// === SECOND BORDER ===
+	int    numSpheresFl = 6;
+	float  arcRadiusFl = 0.5f;
+	float  sphereRadiusFl = 0.15f;
+	float  boxLengthXFl = 1.65f;
+	float  boxLengthZFl = 0.9f;
+	float  railHeightFloorFl = 2.15f;
+
+	AddBorderRing(numSpheresFl, arcRadiusFl, sphereRadiusFl, railHeightFloorFl, boxLengthXFl, boxLengthZFl);
+
+	//Bassinet Floor and Side walls
+	float  panelThickness = 0.18f;
+	float  panelRise = railHeight - railHeightFloor;           // vertical span
+	float  spanX = boxLengthX + 2 * arcRadius -1;              // full length front/back
+	float  spanZ = boxLengthZ + 2 * arcRadius - 1;              // full length left/right
+	float  midY = (railHeight + railHeightFloor) * 0.5f;  // midpoint Y for positioning
+
+	// precompute rotation angles (in degrees)
+	float angleX = glm::degrees(atan(panelRise / spanX));
+	float angleZ = glm::degrees(atan(panelRise / spanZ));
+
+	// one for X-spanning panels, one for Z-spanning
+	glm::vec3 panelScaleX(spanX, panelRise, panelThickness);
+	glm::vec3 panelScaleZ(panelThickness, panelRise, spanZ);
+
+	// --- FRONT PANEL (between the two front rails) ---
+	AddTexturedObject(MESH_BOX, panelScaleX, -angleX, 0.0f, 0.0f,
+		glm::vec3(0.0f, midY, -boxLengthZ / 2 - arcRadius + panelThickness * 0.5f),
+		"cloth_texture", "plastic", 0.3f, 0.2f);
+	// --- BACK PANEL ---
+	AddTexturedObject(MESH_BOX, panelScaleX, angleX, 0.0f, 0.0f,
+		glm::vec3(0.0f, midY, boxLengthZ / 2 + arcRadius - panelThickness * 0.5f),
+		"cloth_texture", "plastic", 0.3f, 0.2f);
+	// --- LEFT PANEL ---
+	AddTexturedObject(MESH_BOX, panelScaleZ, 0.0f, 0.0f, angleZ,
+		glm::vec3(-boxLengthX / 2 - arcRadius + panelThickness * 0.5f, midY, 0.0f),
+		"cloth_texture", "plastic", 0.3f, 0.2f);
+	// --- RIGHT PANEL ---
+	AddTexturedObject(MESH_BOX, panelScaleZ, 0.0f, 0.0f, -angleZ,
+		glm::vec3(boxLengthX / 2 + arcRadius - panelThickness * 0.5f, midY, 0.0f),
+		"cloth_texture", "plastic", 0.3f, 0.2f);
+
+	//Cloth at bottom of bassinet
+	scaleXYZ = glm::vec3(1.3f, 1.2f, 1.0f);
+	positionXYZ = glm::vec3(0.0f, 2.05f, 0.0f);
+	AddTexturedObject(MESH_PLANE, scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ,
+		"cloth_texture", "stone");
+
+	//Crossbar under the bassinet (drawn twice in the original scene)
+	scaleXYZ = glm::vec3(0.1f, 1.7f, 0.1f);
+	positionXYZ = glm::vec3(1.40f, 0.65f, -1.0f);
+	AddTexturedObject(MESH_CYLINDER, scaleXYZ, 0.0f, 90.0f, 0.0f, positionXYZ,
+		"plasticd_texture", "plastic");
+	AddTexturedObject(MESH_CYLINDER, scaleXYZ, 0.0f, 90.0f, 0.0f, positionXYZ,
+		"plasticd_texture", "plastic");
+
+	// ——— Couch Seat ———
+	AddTexturedObject(MESH_BOX, glm::vec3(16.0f, 2.3f, 6.2f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(5.0f, 0.3f, -8.0f), "plastic_texture", "wood");
+	// ——— Couch Backrest ———
+	AddTexturedObject(MESH_BOX, glm::vec3(13.0f, 7.8f, 1.6f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(5.0f, 0.8f, -9.4f), "plastic_texture", "wood");
+	// ——— Left Armrest ———
+	AddTexturedObject(MESH_CYLINDER, glm::vec3(3.2f, 1.5f, 3.2f), 0.0f, 0.0f, 90.0f,
+		glm::vec3(-1.4f, 0.65f, -8.0f), "plastic_texture", "wood");
+	// ——— Right Armrest ———
+	AddTexturedObject(MESH_CYLINDER, glm::vec3(3.2f, 1.5f, 3.2f), 0.0f, 0.0f, 90.0f,
+		glm::vec3(12.8f, 0.65f, -8.0f), "plastic_texture", "wood");
+	// ——— Cushion ———
+	AddTexturedObject(MESH_SPHERE, glm::vec3(2.5f, 0.3f, 1.2f), 72.0f, 0.0f, 0.0f,
+		glm::vec3(1.3f, 2.65f, -8.0f), "plasticb_texture", "wood");
+}
+
+/***********************************************************
+ *  AddBorderRing()
+ *
+ *  This method is used for registering one rounded border
+ *  ring of the bassinet - four quarter arcs of spheres at
+ *  the corners joined by four straight box rails.
+ ***********************************************************/
+void SceneManager::AddBorderRing(
+	int numSpheres,
+	float arcRadius,
+	float sphereRadius,
+	float railHeight,
+	float boxLengthX,
+	float boxLengthZ)
+{
+	float thetaStep = glm::half_pi<float>() / numSpheres;
+	glm::vec3 scale(sphereRadius);
+
+	// === CORNERS ===
+	// each corner arc starts at a multiple of 90 degrees around the
+	// corner center: top-left from π, top-right from 3π/2,
+	// bottom-right from 0 and bottom-left from π/2
+	const float arcStart[4] = {
+		glm::pi<float>(),
+		glm::pi<float>() * 1.5f,
+		0.0f,
+		glm::half_pi<float>() };
+	const glm::vec3 arcCenter[4] = {
+		glm::vec3(-boxLengthX / 2, railHeight, -boxLengthZ / 2),
+		glm::vec3(boxLengthX / 2, railHeight, -boxLengthZ / 2),
+		glm::vec3(boxLengthX / 2, railHeight, boxLengthZ / 2),
+		glm::vec3(-boxLengthX / 2, railHeight, boxLengthZ / 2) };
+
+	for (int corner = 0; corner < 4; ++corner)
+	{
+		for (int i = 0; i <= numSpheres; ++i)
+		{
+			float theta = arcStart[corner] + i * thetaStep;
+			float x = arcRadius * cos(theta);
+			float z = arcRadius * sin(theta);
+			glm::vec3 pos = arcCenter[corner] + glm::vec3(x, 0.0f, z);
+			AddTexturedObject(MESH_SPHERE, scale, 0.0f, 0.0f, 0.0f, pos,
+				"plasticd_texture", "plastic", 0.3f, 0.2f);
+		}
+	}
+
+	// === WALLS ===
+	glm::vec3 wallScaleX(boxLengthX, 0.1f, 0.1f);
+	glm::vec3 wallScaleZ(0.1f, 0.1f, boxLengthZ);
+
+	// Top wall
+	AddTexturedObject(MESH_BOX, wallScaleX, 0.0f, 0.0f, 0.0f,
+		glm::vec3(0.0f, railHeight, -boxLengthZ / 2 - arcRadius),
+		"plasticd_texture", "plastic", 0.3f, 0.2f);
+	// Bottom wall
+	AddTexturedObject(MESH_BOX, wallScaleX, 0.0f, 0.0f, 0.0f,
+		glm::vec3(0.0f, railHeight, boxLengthZ / 2 + arcRadius),
+		"plasticd_texture", "plastic", 0.3f, 0.2f);
+	// Left wall
+	AddTexturedObject(MESH_BOX, wallScaleZ, 0.0f, 0.0f, 0.0f,
+		glm::vec3(-boxLengthX / 2 - arcRadius, railHeight, 0.0f),
+		"plasticd_texture", "plastic", 0.3f, 0.2f);
+	// Right wall
+	AddTexturedObject(MESH_BOX, wallScaleZ, 0.0f, 0.0f, 0.0f,
+		glm::vec3(boxLengthX / 2 + arcRadius, railHeight, 0.0f),
+		"plasticd_texture", "plastic", 0.3f, 0.2f);
+}
+
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by
+ *  drawing the instanced batches in sort key order: opaque
+ *  batches grouped by their settings, then translucent
+ *  objects from the farthest to the nearest
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+	// this frame's buffer updates go into the next region of
+	// the ring, once the GPU has read it
+	m_uploadRing.BeginFrame();
+
+	// swap in the texture images decoded since last frame
+	m_finishedTextures.clear();
+	m_cookedImages.clear();
+	m_textureLoader.ProcessUploads(m_finishedTextures, m_cookedImages);
+	m_textureResidency.MakeResident(m_finishedTextures);
+	FinishTextureReloads();
+	AddStreamedTextures();
+
+	// recompose only the objects that moved since last frame
+	UpdateTransforms();
+
+	// leave out the objects outside the view
+	CullScene();
+	Profiler::CountObjects(m_renderStats.drawnObjects, m_renderStats.culledObjects);
+
+	// coarser meshes for the objects that are small on screen
+	SelectMeshLods();
+
+	// stream the mip levels for where the objects are now
+	RequestTextureDetail();
+	m_textureStreamer.Update();
+	m_textureResidency.UpdateTable();
+
+	// only point lights that changed are re-sent
+	m_lightManager.UploadChanges();
+
+	// cull the point lights into the clusters of this view
+	if (m_bUseLightClusters)
+	{
+		m_lightClusters.Build(m_viewState, m_lightManager);
+		m_lightClusters.BindTextures();
+	}
+
+	// camera and lights go to the GPU in one buffer update
+	m_frameData.view = m_viewState.view;
+	m_frameData.projection = m_viewState.projection;
+	m_frameData.viewPosition = m_viewState.position;
+	m_lightManager.WriteFrameData(m_frameData);
+	m_lightClusters.WriteFrameData(m_frameData, m_bUseLightClusters);
+	m_frameBlock.Stream(sizeof(m_frameData), &m_frameData);
+	SelectSceneFeatures();
+
+	// only the model matrices of moved objects are re-sent
+	if (m_dirtyInstanceFirst <= m_dirtyInstanceLast)
+	{
+		m_basicMeshes->UpdateInstanceData(
+			m_dirtyInstanceFirst,
+			m_dirtyInstanceLast - m_dirtyInstanceFirst + 1,
+			&m_instanceMatrices[m_dirtyInstanceFirst]);
+		m_dirtyInstanceFirst = 0;
+		m_dirtyInstanceLast = -1;
+	}
+
+	// the cascades follow the view, and are only drawn again
+	// where something moved
+	UpdateShadowCascades();
+
+	QueueRenderBatches();
+
+	m_renderStats.drawCalls = 0;
+	m_renderStats.stateChanges = 0;
+	m_renderStats.redundantStateChanges = 0;
+	// other code may have changed the shader since last frame,
+	// so the first draw binds its program again
+	m_currentPermutation = -1;
+
+	if (m_bUseMultiDraw)
+	{
+		SubmitMultiDraw();
+	}
+	else
+	{
+		SubmitDraws();
+	}
+	// a frame culled on the CPU builds no depth pyramid, so
+	// the compute pass must not test against the one it has
+	// once it culls again
+	if (IsGpuCullingActive() == false)
+	{
+		m_gpuCulling.InvalidateDepthPyramid();
+	}
+
+	// SetTransformations() callers use the model uniform of
+	// the program left in use
+	if (m_currentPermutation >= 0)
+	{
+		m_uniforms.useInstancing.Set(false);
+		m_uniforms.useInstanceSettings.Set(false);
+	}
+
+	// how the draw list work spread over the job threads
+	JobSystem::JOB_STATS jobStats;
+	m_jobSystem.TakeStats(jobStats);
+	Profiler::CountJobs(jobStats.jobsRun, jobStats.jobsStolen, jobStats.contendedLocks,
+		(int)(jobStats.utilization * 100.0f + 0.5f));
+
+	// how much went through the upload ring, and the frames it
+	// had to wait for the GPU
+	UploadRing::UPLOAD_STATS uploadStats;
+	m_uploadRing.TakeStats(uploadStats);
+	Profiler::CountUploads((int)(uploadStats.bytes / 1024), uploadStats.stalls);
+}
+
+/***********************************************************
+ *  SubmitDraws()
+ *
+ *  This method is used for drawing the queued batches one
+ *  draw call at a time, sending each batch's settings as
+ *  uniforms first.  The program changes only where the
+ *  queue moves on to another permutation.  With the depth
+ *  pre-pass the opaque batches are drawn twice, first for
+ *  their depth alone and then shaded where they won the
+ *  depth test.
+ ***********************************************************/
+void SceneManager::SubmitDraws()
+{
+	m_basicMeshes->BeginDraws();
+	m_shadowCommandFirst = -1;
+	DrawShadowCascades();
+
+	bool bDepthPrepass = m_bUseDepthPrepass && UseProgram(ShaderPermutations::FEATURE_DEPTH_ONLY, false);
+	if (bDepthPrepass)
+	{
+		BeginDepthPrepass();
+		for (int i = 0; i < m_renderQueue.Size(); ++i)
+		{
+			const RenderQueue::RENDER_COMMAND& command = m_renderQueue.Command(i);
+			if (RenderQueue::IsTranslucent(command.key))
+			{
+				break;
+			}
+			DrawBatch(m_renderBatches[command.payload]);
+		}
+		EndDepthPrepass();
+	}
+
+	bool bTranslucentPass = false;
+	for (int i = 0; i < m_renderQueue.Size(); ++i)
+	{
+		const RenderQueue::RENDER_COMMAND& command = m_renderQueue.Command(i);
+
+		if ((bTranslucentPass == false) && RenderQueue::IsTranslucent(command.key))
+		{
+			BeginTranslucentPass();
+			bTranslucentPass = true;
+		}
+
+		const RENDER_BATCH& batch = m_renderBatches[command.payload];
+		const RENDER_ITEM& item = m_renderItems[batch.itemIndex];
+		if (UseProgram(m_sceneFeatures | ItemFeatures(item), false) == false)
+		{
+			continue;
+		}
+		ApplyDrawSettings(item);
+		DrawBatch(batch);
+	}
+	m_basicMeshes->EndDraws();
+
+	EndScenePasses(bTranslucentPass);
+}
+
+/***********************************************************
+ *  DrawBatch()
+ *
+ *  This method is used for drawing the visible instances of
+ *  a batch, one draw call for each run of them that is at
+ *  the same level of detail.
+ ***********************************************************/
+void SceneManager::DrawBatch(const RENDER_BATCH& batch)
+{
+	int cursor = batch.firstInstance;
+	int runFirst = 0;
+	int runCount = 0;
+	int runLod = 0;
+	while (NextVisibleRun(batch, cursor, runFirst, runCount, runLod))
+	{
+		m_basicMeshes->DrawMeshInstanced(batch.mesh, runLod, runFirst, runCount);
+		m_renderStats.drawCalls++;
+	}
+}
+
+/***********************************************************
+ *  BeginDepthPrepass()
+ *
+ *  This method is used for switching to the depth only
+ *  pass - the depth test and writes as usual, and no color
+ *  writes.
+ ***********************************************************/
+void SceneManager::BeginDepthPrepass()
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+}
+
+/***********************************************************
+ *  EndDepthPrepass()
+ *
+ *  This method is used for switching from the depth pre-pass
+ *  to shading the opaque objects.  The depth buffer already
+ *  holds the nearest opaque surface of every pixel, so only
+ *  fragments at exactly that depth are shaded and the depth
+ *  is not written again.
+ ***********************************************************/
+void SceneManager::EndDepthPrepass()
+{
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc(GL_EQUAL);
+	glDepthMask(GL_FALSE);
+}
+
+/***********************************************************
+ *  BeginTranslucentPass()
+ *
+ *  This method is used for switching to the translucent
+ *  objects.  They are depth tested against the opaque ones
+ *  but do not hide the translucent objects drawn after
+ *  them, and are the only objects drawn with blending.
+ ***********************************************************/
+void SceneManager::BeginTranslucentPass()
+{
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+}
+
+/***********************************************************
+ *  EndScenePasses()
+ *
+ *  This method is used for putting the depth and blend
+ *  state back to the defaults the rest of the frame uses.
+ ***********************************************************/
+void SceneManager::EndScenePasses(bool bTranslucentPass)
+{
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	if (bTranslucentPass)
+	{
+		glDisable(GL_BLEND);
+	}
+}
+
+/***********************************************************
+ *  SubmitMultiDraw()
+ *
+ *  This method is used for writing the queued batches into
+ *  the indirect command buffer, in queue order, and drawing
+ *  them with one multi-draw for each run of commands that
+ *  share their program permutation and pass.  The opaque
+ *  queue is ordered by permutation first, so it takes one
+ *  multi-draw per permutation, plus one for all of it in
+ *  depth pre-pass.  The shaders read each draw's
+ *  settings from the instance settings buffer, so no
+ *  uniform changes between the draws.  With GPU culling the
+ *  commands hold every instance of their batch and the
+ *  compute pass cuts them down before they are drawn.  The
+ *  shadow casters follow the scene's commands in the same
+ *  buffer, and are never culled.  A frame with nothing in
+ *  view still goes through every pass, so the shadow
+ *  commands and the depth pyramid are never left from an
+ *  earlier frame.
+ ***********************************************************/
+void SceneManager::SubmitMultiDraw()
+{
+	m_drawCommands.clear();
+	m_drawCommandFeatures.clear();
+	int opaqueCount = 0;
+	for (int i = 0; i < m_renderQueue.Size(); ++i)
+	{
+		const RenderQueue::RENDER_COMMAND& command = m_renderQueue.Command(i);
+		const RENDER_BATCH& batch = m_renderBatches[command.payload];
+		bool bOpaque = (RenderQueue::IsTranslucent(command.key) == false);
+		int features = m_sceneFeatures | ItemFeatures(m_renderItems[batch.itemIndex]);
+
+		int cursor = batch.firstInstance;
+		int runFirst = 0;
+		int runCount = 0;
+		int runLod = 0;
+		while (NextVisibleRun(batch, cursor, runFirst, runCount, runLod))
+		{
+			MeshLibrary::DRAW_COMMAND drawCommand;
+			m_basicMeshes->MakeDrawCommand(batch.mesh, runLod, runFirst, runCount, drawCommand);
+			m_drawCommands.push_back(drawCommand);
+			m_drawCommandFeatures.push_back(features);
+			if (bOpaque)
+			{
+				opaqueCount++;
+			}
+		}
+	}
+	int commandCount = (int)m_drawCommands.size();
+
+	m_shadowCommandFirst = -1;
+	if (0 != (m_sceneFeatures & ShaderPermutations::FEATURE_SHADOWS))
+	{
+		m_shadowCommandFirst = commandCount;
+		for (size_t i = 0; i < m_shadowRuns.size(); ++i)
+		{
+			MeshLibrary::DRAW_COMMAND drawCommand;
+			m_basicMeshes->MakeDrawCommand(m_shadowRuns[i].mesh, 0, m_shadowRuns[i].firstInstance, m_shadowRuns[i].instanceCount, drawCommand);
+			m_drawCommands.push_back(drawCommand);
+		}
+	}
+	m_basicMeshes->SetDrawCommands(m_drawCommands.data(), (int)m_drawCommands.size());
+
+	bool bGpuCulling = IsGpuCullingActive();
+	glm::mat4 viewProjection = m_viewState.projection * m_viewState.view;
+	if (bGpuCulling)
+	{
+		m_gpuCulling.Cull(viewProjection,
+			m_basicMeshes->IndirectBuffer(), commandCount,
+			m_basicMeshes->InstanceBuffer(), m_basicMeshes->SettingsBuffer());
+	}
+
+	m_basicMeshes->BeginDraws();
+	DrawShadowCascades();
+	if ((opaqueCount > 0) && m_bUseDepthPrepass &&
+		UseProgram(ShaderPermutations::FEATURE_DEPTH_ONLY, true))
+	{
+		BeginDepthPrepass();
+		SubmitMultiDrawRange(0, opaqueCount, bGpuCulling);
+		EndDepthPrepass();
+	}
+
+	int firstCommand = 0;
+	while (firstCommand < commandCount)
+	{
+		bool bOpaque = (firstCommand < opaqueCount);
+		int features = m_drawCommandFeatures[firstCommand];
+		int endCommand = firstCommand + 1;
+		while ((endCommand < commandCount) &&
+			(m_drawCommandFeatures[endCommand] == features) &&
+			((endCommand < opaqueCount) == bOpaque))
+		{
+			endCommand++;
+		}
+
+		if (firstCommand == opaqueCount)
+		{
+			BeginTranslucentPass();
+		}
+		if (UseProgram(features, true))
+		{
+			SubmitMultiDrawRange(firstCommand, endCommand - firstCommand, bGpuCulling);
+		}
+		firstCommand = endCommand;
+	}
+	m_basicMeshes->EndDraws();
+
+	EndScenePasses(opaqueCount < commandCount);
+
+	// the depth now only holds opaque objects, which is what
+	// the next frame is occlusion culled against
+	if (bGpuCulling)
+	{
+		m_gpuCulling.BuildDepthPyramid(viewProjection, m_viewState.viewportWidth, m_viewState.viewportHeight);
+	}
+}
+
+/***********************************************************
+ *  SubmitMultiDrawRange()
+ *
+ *  This method is used for drawing a range of the indirect
+ *  commands, as written by the CPU or as culled by the
+ *  compute pass.  The pass only reports its triangles a
+ *  few frames late, so they are counted with the first
+ *  range, once for each pass that draws it.
+ ***********************************************************/
+void SceneManager::SubmitMultiDrawRange(int firstCommand, int commandCount, bool bGpuCulled)
+{
+	if (bGpuCulled)
+	{
+		int triangles = (firstCommand == 0) ? m_gpuCulling.Stats().triangles : 0;
+		m_basicMeshes->DrawCulledMultiIndirect(
+			m_gpuCulling.CulledCommandBuffer(),
+			m_gpuCulling.CulledMatrixBuffer(),
+			m_gpuCulling.CulledSettingsBuffer(),
+			firstCommand, commandCount, triangles);
+	}
+	else
+	{
+		m_basicMeshes->DrawMultiIndirect(firstCommand, commandCount);
+	}
+	m_renderStats.drawCalls++;
+}
+
+/***********************************************************
+ *  SetShadowSettings()
+ *
+ *  This method is used for choosing the size of the shadow
+ *  maps and the number of cascades they are split into.
+ *  The cascades are created with the scene, so this has no
+ *  effect once it is prepared.
+ ***********************************************************/
+void SceneManager::SetShadowSettings(int mapSize, int cascadeCount)
+{
+	if (mapSize > 0)
+	{
+		m_shadowMapSize = mapSize;
+	}
+	if (cascadeCount > 0)
+	{
+		m_shadowCascadeCount = cascadeCount;
+	}
+}
+
+/***********************************************************
+ *  BuildShadowCasters()
+ *
+ *  This method is used for splitting the opaque instances
+ *  of every batch into runs of static instances and runs
+ *  of instances that have moved.  The static runs come
+ *  first, so each kind is one range of the runs.
+ *  Translucent objects cast no shadow.
+ ***********************************************************/
+void SceneManager::BuildShadowCasters()
+{
+	m_shadowRuns.clear();
+	m_staticShadowRunCount = 0;
+
+	for (int moving = 0; moving <= 1; ++moving)
+	{
+		for (size_t i = 0; i < m_renderBatches.size(); ++i)
+		{
+			const RENDER_BATCH& batch = m_renderBatches[i];
+			if (m_renderItems[batch.itemIndex].bTranslucent)
+			{
+				continue;
+			}
+
+			int end = batch.firstInstance + batch.instanceCount;
+			int cursor = batch.firstInstance;
+			while (cursor < end)
+			{
+				while ((cursor < end) && (m_instanceMoving[cursor] != moving))
+				{
+					cursor++;
+				}
+				SHADOW_RUN run;
+				run.mesh = batch.mesh;
+				run.firstInstance = cursor;
+				while ((cursor < end) && (m_instanceMoving[cursor] == moving))
+				{
+					cursor++;
+				}
+				run.instanceCount = cursor - run.firstInstance;
+				if (run.instanceCount > 0)
+				{
+					m_shadowRuns.push_back(run);
+				}
+			}
+		}
+
+		if (moving == 0)
+		{
+			m_staticShadowRunCount = (int)m_shadowRuns.size();
+		}
+	}
+
+	m_bShadowCastersChanged = false;
+}
+
+/***********************************************************
+ *  UpdateShadowCascades()
+ *
+ *  This method is used for fitting the shadow cascades to
+ *  the view, the directional light and the bounds of the
+ *  opaque objects, and for marking the cascade layers that
+ *  the casters changed or moved in.  While the shadows are
+ *  off every layer is marked, so they are right when the
+ *  shadows are turned back on.
+ ***********************************************************/
+void SceneManager::UpdateShadowCascades()
+{
+	if (m_bShadowCastersChanged)
+	{
+		BuildShadowCasters();
+		m_shadowCascades.InvalidateStatic();
+	}
+
+	if (0 == (m_sceneFeatures & ShaderPermutations::FEATURE_SHADOWS))
+	{
+		m_shadowCascades.InvalidateStatic();
+		return;
+	}
+
+	if (m_bShadowCastersMoved)
+	{
+		m_shadowCascades.InvalidateDynamic();
+		m_bShadowCastersMoved = false;
+	}
+
+	CullingBVH::AABB sceneBounds;
+	sceneBounds.minimum = glm::vec3(FLT_MAX);
+	sceneBounds.maximum = glm::vec3(-FLT_MAX);
+	for (size_t i = 0; i < m_renderItems.size(); ++i)
+	{
+		if (m_renderItems[i].bTranslucent == false)
+		{
+			sceneBounds.minimum = glm::min(sceneBounds.minimum, m_worldBounds[i].minimum);
+			sceneBounds.maximum = glm::max(sceneBounds.maximum, m_worldBounds[i].maximum);
+		}
+	}
+	if (m_shadowRuns.empty())
+	{
+		return;
+	}
+
+	m_shadowCascades.Update(m_viewState, m_frameData.directionalLight.direction, sceneBounds);
+	m_shadowCascades.BindTexture();
+}
+
+/***********************************************************
+ *  DrawShadowCascades()
+ *
+ *  This method is used for drawing the shadow casters into
+ *  each cascade that is out of date, with the depth only
+ *  caster program - the static casters into the cached
+ *  layer once its light projection changed, and the moving
+ *  casters over a copy of it each frame that they moved.
+ ***********************************************************/
+void SceneManager::DrawShadowCascades()
+{
+	if ((0 == (m_sceneFeatures & ShaderPermutations::FEATURE_SHADOWS)) || m_shadowRuns.empty())
+	{
+		return;
+	}
+
+	const int casterFeatures = ShaderPermutations::FEATURE_DEPTH_ONLY | ShaderPermutations::FEATURE_SHADOW_CASTER;
+	int movingRunCount = (int)m_shadowRuns.size() - m_staticShadowRunCount;
+	for (int cascade = 0; cascade < m_shadowCascades.CascadeCount(); ++cascade)
+	{
+		if (m_shadowCascades.BeginStaticPass(cascade) && UseProgram(casterFeatures, m_shadowCommandFirst >= 0))
+		{
+			m_uniforms.shadowViewProjection.Set(m_shadowCascades.CascadeViewProjection(cascade));
+			DrawShadowCasters(0, m_staticShadowRunCount);
+		}
+		if (m_shadowCascades.BeginDynamicPass(cascade) && UseProgram(casterFeatures, m_shadowCommandFirst >= 0))
+		{
+			m_uniforms.shadowViewProjection.Set(m_shadowCascades.CascadeViewProjection(cascade));
+			DrawShadowCasters(m_staticShadowRunCount, movingRunCount);
+		}
+	}
+	m_shadowCascades.EndPasses();
+}
+
+/***********************************************************
+ *  DrawShadowCasters()
+ *
+ *  This method is used for drawing a range of the shadow
+ *  caster runs, with one multi-draw when their commands
+ *  were written for this frame and one instanced draw per
+ *  run otherwise.
+ ***********************************************************/
+void SceneManager::DrawShadowCasters(int firstRun, int runCount)
+{
+	if (runCount <= 0)
+	{
+		return;
+	}
+
+	if (m_shadowCommandFirst >= 0)
+	{
+		m_basicMeshes->DrawMultiIndirect(m_shadowCommandFirst + firstRun, runCount);
+		m_renderStats.drawCalls++;
+		return;
+	}
+
+	for (int i = firstRun; i < firstRun + runCount; ++i)
+	{
+		const SHADOW_RUN& run = m_shadowRuns[i];
+		m_basicMeshes->DrawMeshInstanced(run.mesh, 0, run.firstInstance, run.instanceCount);
+		m_renderStats.drawCalls++;
+	}
 }
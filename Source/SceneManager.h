@@ -9,9 +9,29 @@
 
 #pragma once
 
-#include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "UniformCache.h"
+#include "ShaderPermutations.h"
+#include "UniformBuffer.h"
+#include "UploadRing.h"
+#include "ShaderBlocks.h"
+#include "LightManager.h"
+#include "LightClusters.h"
+#include "TransformHierarchy.h"
+#include "MeshLibrary.h"
+#include "CullingBVH.h"
+#include "GpuCulling.h"
+#include "ShadowCascades.h"
+#include "RenderQueue.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "SceneFile.h"
+#include "TextureLoader.h"
+#include "TextureResidency.h"
+#include "TextureStreamer.h"
+#include "TagTable.h"
+#include "ViewManager.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -25,7 +45,7 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	SceneManager(ShaderPermutations* pShaderPermutations);
 	// destructor
 	~SceneManager();
 
@@ -33,6 +53,10 @@ public:
 	{
 		std::string tag;
 		uint32_t ID;
+		// interned ID of the tag
+		int tagID;
+		// image file the texture was loaded from
+		std::string filename;
 	};
 
 	struct OBJECT_MATERIAL
@@ -43,28 +67,424 @@ public:
 		std::string tag;
 	};
 
+	// one registered scene object with all of its draw
+	// settings resolved when the scene is prepared
+	struct RENDER_ITEM
+	{
+		glm::mat4 modelMatrix;
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		// texture table slot, or -1 to draw with the solid color
+		int textureSlot;
+		// index into the defined materials, or -1 for none
+		int materialIndex;
+		// interned texture and material tags the object asked
+		// for, kept for the validation pass
+		int textureTag;
+		int materialTag;
+		// slot of the model matrix in the instance buffer
+		int instanceIndex;
+		// node in the transform hierarchy that places the object
+		int transformNode;
+		// drawn after the opaque objects, back-to-front
+		bool bTranslucent;
+		MESH_TYPE mesh;
+	};
+
+	// a run of render items with identical draw settings,
+	// drawn together with one instanced draw call
+	struct RENDER_BATCH
+	{
+		MESH_TYPE mesh;
+		// render item whose draw settings the batch uses
+		int itemIndex;
+		int firstInstance;
+		int instanceCount;
+	};
+
+	// shader settings most recently sent to the GPU
+	struct DRAW_STATE
+	{
+		bool bValid;
+		bool bUseTexture;
+		int textureSlot;
+		int materialIndex;
+		glm::vec2 uvScale;
+		glm::vec4 color;
+	};
+
+	// pre-resolved handles for the uniforms set while drawing
+	struct SCENE_UNIFORMS
+	{
+		UniformHandle<glm::mat4> model;
+		UniformHandle<glm::vec4> objectColor;
+		UniformHandle<int> textureIndex;
+		UniformHandle<bool> useTexture;
+		UniformHandle<bool> useInstancing;
+		UniformHandle<glm::vec2> uvScale;
+		UniformHandle<int> materialIndex;
+		UniformHandle<bool> useInstanceSettings;
+		UniformHandle<glm::mat4> shadowViewProjection;
+	};
+
+	// a permutation of the scene program as it was last set up
+	struct PROGRAM_STATE
+	{
+		// program and permutation generation the handles were
+		// resolved from, 0 before it is first drawn with
+		GLuint program;
+		int generation;
+		SCENE_UNIFORMS uniforms;
+	};
+
+	// a run of opaque instances of one batch that cast
+	// shadows, drawn at the finest level of detail
+	struct SHADOW_RUN
+	{
+		MESH_TYPE mesh;
+		int firstInstance;
+		int instanceCount;
+	};
+
+	// per-frame draw submission counters
+	struct RENDER_STATS
+	{
+		int drawCalls;
+		// shader settings sent to the GPU
+		int stateChanges;
+		// shader settings sent that were already current
+		int redundantStateChanges;
+		// objects drawn and objects rejected by frustum culling
+		int drawnObjects;
+		int culledObjects;
+	};
+
 private:
-	// pointer to shader manager object
-	ShaderManager* m_pShaderManager;
+	// the scene program, built once per set of shader features
+	ShaderPermutations* m_pShaderPermutations;
+	// set up state of every program permutation
+	PROGRAM_STATE m_programStates[ShaderPermutations::PERMUTATION_COUNT];
+	// permutation in use, -1 when none has been bound this frame
+	int m_currentPermutation;
+	// feature bits shared by every draw of the frame
+	int m_sceneFeatures;
+	// shade the scene with its lights, else in flat colors
+	bool m_bUseLighting;
+	// uniform handles of the permutation in use
+	SCENE_UNIFORMS m_uniforms;
+	// camera and light values in FrameData block layout
+	FRAME_DATA_STD140 m_frameData;
+	// GPU copy of the FrameData block, read from the upload
+	// ring while it has room
+	UniformBuffer m_frameBlock;
+	// GPU copy of the MaterialData block
+	UniformBuffer m_materialBlock;
+	// directional and point lights of the scene
+	LightManager m_lightManager;
+	// point lights culled into the clusters of the view
+	LightClusters m_lightClusters;
+	// shade only the lights of each fragment's cluster
+	bool m_bUseLightClusters;
+	// cached transformations of every object and group
+	TransformHierarchy m_transforms;
+	// render item placed by each transform node, or -1
+	std::vector<int> m_nodeItems;
+	// group that newly added objects are attached to, or -1
+	int m_transformParent;
+	// group nodes of the hanging mobile above the bassinet, one
+	// for each copy of the scene
+	std::vector<int> m_mobileNodes;
+	// copies of the scene objects laid out side by side
+	int m_sceneCopies;
+	// cooked scene file that replaces the built in scene, and
+	// its mapping while the scene is prepared
+	std::string m_sceneFilePath;
+	SceneFile m_sceneFile;
 	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
-	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	MeshLibrary* m_basicMeshes;
+	// loaded textures info, in texture table order
+	std::vector<TEXTURE_INFO> m_textureIDs;
+	// decodes the texture images in the background
+	TextureLoader m_textureLoader;
+	// texture table that the shaders sample every texture through
+	TextureResidency m_textureResidency;
+	// textures that received their image this frame
+	std::vector<GLuint> m_finishedTextures;
+	// keeps the mip levels of the cooked textures that the view needs
+	TextureStreamer m_textureStreamer;
+	// cooked files handed over by the loader this frame
+	std::vector<TextureLoader::COOKED_IMAGE> m_cookedImages;
+	// a texture being loaded again to replace a table slot
+	struct TEXTURE_RELOAD
+	{
+		// slot to replace, -1 once a newer reload took over
+		int slot;
+		GLuint textureID;
+	};
+	// texture reloads waiting for their image
+	std::vector<TEXTURE_RELOAD> m_textureReloads;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// texture and material tags interned into integer IDs
+	TagTable m_tags;
+	// texture slot and material index of each tag ID, or -1
+	std::vector<int> m_textureSlotsByTag;
+	std::vector<int> m_materialIndicesByTag;
 	// load texture images and convert to OpenGL texture data
-	bool CreateGLTexture(const char* filename, std::string tag);
-	// bind loaded OpenGL textures to slots in memory
+	bool CreateGLTexture(const char* filename, const std::string& tag);
+	// bind the texture arrays to their units, once
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
 	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
+	int FindTextureID(const std::string& tag) const;
+	int FindTextureSlot(const std::string& tag) const;
 	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	bool FindMaterial(const std::string& tag, OBJECT_MATERIAL& material) const;
+	int FindMaterialIndex(const std::string& tag) const;
+	// intern a tag and make room for it in the lookup tables
+	int InternTag(const std::string& tag);
+	// texture slot or material index of an interned tag, or -1
+	int TextureSlotOf(int tagID) const;
+	int MaterialIndexOf(int tagID) const;
+	// intern the tags of the defined materials
+	void RegisterMaterialTags();
+	// report every tag that was used but never defined
+	int ValidateScene() const;
+	// give the new cooked files to the texture streamer
+	void AddStreamedTextures();
+	// load the image of a texture slot again, the slot keeps
+	// its current image until the new one is ready
+	void ReloadTexture(int slot, const std::string& filename);
+	// swap the reloaded images that arrived this frame into
+	// their slots
+	void FinishTextureReloads();
+	// replace the lights, materials and objects with those of
+	// the scene file, keeping the current scene when it fails
+	bool ReloadSceneFile();
+	// ask the streamer for the detail each textured object
+	// needs at its current size on screen
+	void RequestTextureDetail();
+	// pick the mesh level of detail of each drawn instance
+	// from its current size on screen
+	void SelectMeshLods();
+
+	// registered scene objects
+	std::vector<RENDER_ITEM> m_renderItems;
+	// instanced draw calls built from the registered objects
+	std::vector<RENDER_BATCH> m_renderBatches;
+	// model matrices in batch order, mirrored in the GPU buffer
+	std::vector<glm::mat4> m_instanceMatrices;
+	// draw settings of each instance, in the same order
+	std::vector<MeshLibrary::INSTANCE_SETTINGS> m_instanceSettings;
+	// indirect commands of the current frame, in queue order
+	std::vector<MeshLibrary::DRAW_COMMAND> m_drawCommands;
+	// program permutation of each indirect command
+	std::vector<int> m_drawCommandFeatures;
+	// submit the frame with multi-draw-indirect
+	bool m_bUseMultiDraw;
+	// world bounds of every render item, by item index
+	std::vector<CullingBVH::AABB> m_worldBounds;
+	// tree over the world bounds for frustum culling
+	CullingBVH m_cullingBVH;
+	// world bounds changed since the tree was last refit
+	bool m_bBoundsDirty;
+	// skip the objects outside the view frustum
+	bool m_bUseFrustumCulling;
+	// items that passed culling this frame
+	std::vector<int> m_visibleItems;
+	// 1 for each instance that is drawn this frame
+	std::vector<unsigned char> m_instanceVisible;
+	// mesh level of detail of each instance, -1 until it is
+	// first picked
+	std::vector<signed char> m_instanceLods;
+	// draw the curved meshes coarser as they get smaller
+	bool m_bUseMeshLods;
+	// lay down the opaque depth first, so that each opaque
+	// pixel is shaded once
+	bool m_bUseDepthPrepass;
+	// shadow maps of the directional light
+	ShadowCascades m_shadowCascades;
+	// shadow map size and cascade count they are created with
+	int m_shadowMapSize;
+	int m_shadowCascadeCount;
+	// shade the directional light with the shadow cascades
+	bool m_bUseShadows;
+	// persistently mapped buffer the per-frame buffer updates
+	// are written through, and whether it is created
+	UploadRing m_uploadRing;
+	bool m_bUseUploadRing;
+	// 1 for each instance that has moved since the batches were
+	// built, whose shadow is drawn every frame something moves
+	std::vector<unsigned char> m_instanceMoving;
+	// shadow casters, the static runs first and then the runs
+	// of the instances that move
+	std::vector<SHADOW_RUN> m_shadowRuns;
+	int m_staticShadowRunCount;
+	// an instance started moving, so the runs are rebuilt
+	bool m_bShadowCastersChanged;
+	// a moving instance moved since the cascades were drawn
+	bool m_bShadowCastersMoved;
+	// first shadow caster command of the multi-draw, or -1
+	// when the casters are drawn one run at a time
+	int m_shadowCommandFirst;
+	// compute pass that culls the multi-draw on the GPU
+	GpuCulling m_gpuCulling;
+	// cull on the GPU instead of with the tree, when it can
+	bool m_bUseGpuCulling;
+	// range of instance matrices changed since the last upload
+	int m_dirtyInstanceFirst;
+	int m_dirtyInstanceLast;
+	// sorted draw commands of the current frame
+	RenderQueue m_renderQueue;
+	// threads the draw list is built on, and the number of
+	// workers they are created with
+	JobSystem m_jobSystem;
+	int m_jobWorkerCount;
+	// scratch memory of the frame in progress, reset by the
+	// caller once the frame is swapped
+	FrameArena* m_pFrameArena;
+	// visible items collected by each thread this frame, merged
+	// before they are used
+	std::vector<std::vector<int>> m_threadVisibleItems;
+	// subtrees of the culling tree, one for each culling job
+	std::vector<int> m_cullSubtrees;
+	// camera settings used for depth sorting
+	ViewManager::VIEW_STATE m_viewState;
+	// shader settings currently set in the shader
+	DRAW_STATE m_drawState;
+	// skip shader settings that are already current
+	bool m_bFilterRedundantState;
+	// counters of the most recently rendered frame
+	RENDER_STATS m_renderStats;
+	// register a textured object with the retained scene
+	int AddTexturedObject(
+		MESH_TYPE mesh,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ,
+		const std::string& textureTag,
+		const std::string& materialTag,
+		float u = 1.0f,
+		float v = 1.0f);
+	// register an object whose tags are already interned
+	int AddObject(
+		MESH_TYPE mesh,
+		const TransformHierarchy::TRANSFORM& local,
+		glm::vec4 color,
+		glm::vec2 uvScale,
+		int textureTag,
+		int materialTag);
+	// register a solid colored object with the retained scene
+	int AddColoredObject(
+		MESH_TYPE mesh,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ,
+		glm::vec4 color,
+		const std::string& materialTag);
+	// register one rounded border ring of the bassinet
+	void AddBorderRing(
+		int numSpheres,
+		float arcRadius,
+		float sphereRadius,
+		float railHeight,
+		float boxLengthX,
+		float boxLengthZ);
+	// look up the uniform handles of a newly built program
+	// permutation, which must be in use, and make its one time
+	// settings
+	void SetupProgram(int features);
+	// bind the program of a permutation, false when it could
+	// not be built and nothing may be drawn
+	bool UseProgram(int features, bool bInstanceSettings);
+	// pick the shader features the lights of the frame need
+	void SelectSceneFeatures();
+	// shader features of one render item, which fit the
+	// shader field of the sort key
+	int ItemFeatures(const RENDER_ITEM& item) const;
+	// create the uniform buffers and upload the materials
+	void CreateUniformBlocks();
+	// send the defined materials to the material block
+	void UploadMaterials();
+	// group the render items into instanced batches
+	void BuildRenderBatches();
+	// pass the draw settings of one render item into the shader,
+	// skipping any setting that is already current
+	void ApplyDrawSettings(const RENDER_ITEM& item);
+	// queue the render batches with their sort keys
+	void QueueRenderBatches();
+	// mark the instances inside the view frustum as visible
+	void CullScene();
+	// check whether this frame is culled by the compute pass
+	bool IsGpuCullingActive() const;
+	// find the next run of visible instances of a batch at
+	// one level of detail, starting the search at cursor
+	bool NextVisibleRun(const RENDER_BATCH& batch, int& cursor, int& runFirst, int& runCount, int& runLod) const;
+	// draw the queued batches one draw call at a time
+	void SubmitDraws();
+	// draw the visible instances of one batch
+	void DrawBatch(const RENDER_BATCH& batch);
+	// switch the depth and blend state between the passes of
+	// the frame - the optional depth pre-pass, the opaque
+	// objects and the translucent objects
+	void BeginDepthPrepass();
+	void EndDepthPrepass();
+	void BeginTranslucentPass();
+	// put the depth and blend state back after the last pass
+	void EndScenePasses(bool bTranslucentPass);
+	// draw the queued batches with multi-draw-indirect
+	void SubmitMultiDraw();
+	// draw a range of the indirect commands, culled on the
+	// GPU or as they were written
+	void SubmitMultiDrawRange(int firstCommand, int commandCount, bool bGpuCulled);
+	// split the opaque instances into static and moving
+	// shadow caster runs
+	void BuildShadowCasters();
+	// fit the shadow cascades to the view and the light
+	void UpdateShadowCascades();
+	// draw the casters into the cascades that are out of date
+	void DrawShadowCascades();
+	// draw a range of the shadow caster runs
+	void DrawShadowCasters(int firstRun, int runCount);
+	// add a transform node below the current group
+	int AddTransformNode(const TransformHierarchy::TRANSFORM& local, int itemIndex);
+	// copy the changed world matrices into the render items
+	void UpdateTransforms();
+	// add the range of one instance to the next upload
+	void MarkInstanceDirty(int instanceIndex);
+
+	// create a group node that objects can be attached to
+	int CreateTransformGroup(glm::vec3 positionXYZ);
+	// attach the objects added after this call to a group,
+	// their transformations are then relative to the group
+	void BeginTransformGroup(int groupNode);
+	// return to the group that was current before
+	void EndTransformGroup();
+
+	// take the lights, materials, textures and objects of the
+	// scene from the open scene file
+	void LoadSceneLights();
+	void LoadSceneMaterials();
+	void LoadSceneTextures();
+	void LoadSceneObjects();
+	// register the objects of every copy of the scene, each
+	// below a group of its own, from the file or the code
+	void AddSceneObjectCopies(bool bSceneFile);
+	// offset of a copy of the scene from the first one
+	glm::vec3 SceneCopyOffset(int copy) const;
+
+	// build the model matrix from the transformation values
+	glm::mat4 ComposeTransform(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
 
 	// set the transformation values 
 	// into the transform buffer
@@ -84,7 +504,7 @@ private:
 
 	// set the texture data into the shader
 	void SetShaderTexture(
-		std::string textureTag);
+		const std::string& textureTag);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -92,7 +512,7 @@ private:
 
 	// set the object material into the shader
 	void SetShaderMaterial(
-		std::string materialTag);
+		const std::string& materialTag);
 
 public:
 
@@ -100,7 +520,83 @@ public:
 	// customize for their own 3D scene
 	void PrepareScene();
 	void RenderScene();
+	// turn the mobile to the passed in angle in degrees
+	void UpdateScene(float mobileDegrees);
 	void SetupSceneLights();
 	// pre-define the object materials for lighting
 	void DefineObjectMaterials();
-};
\ No newline at end of file
+	// register the objects that make up the 3D scene
+	void DefineSceneObjects();
+
+	// prepare the scene from a cooked .cscene file instead of
+	// the scene built into the code, call before PrepareScene()
+	void SetSceneFile(const std::string& filePath) { m_sceneFilePath = filePath; }
+	// list the files the prepared scene was loaded from - the
+	// texture images, their cooked files and the scene file
+	void GetAssetFiles(std::vector<std::string>& filePaths) const;
+	// load a changed asset file again, false when the scene
+	// does not use the file
+	bool ReloadAsset(const std::string& filePath);
+	// set the camera settings used for ordering the draws
+	void SetViewState(const ViewManager::VIEW_STATE& viewState) { m_viewState = viewState; }
+	// get the scene lights for adding or animating lights
+	LightManager& GetLightManager() { return m_lightManager; }
+	// turn clustered point lighting on or off for comparison
+	void SetUseLightClusters(bool bUse) { m_bUseLightClusters = bUse; }
+	// get the counters of the most recently rendered frame
+	const RENDER_STATS& GetRenderStats() const { return m_renderStats; }
+	// turn redundant state filtering on or off for comparison
+	void SetFilterRedundantState(bool bFilter) { m_bFilterRedundantState = bFilter; }
+	// turn frustum culling on or off for comparison
+	void SetUseFrustumCulling(bool bUse) { m_bUseFrustumCulling = bUse; }
+	// cull on the GPU or with the tree on the CPU, the GPU
+	// needs the compute pass and multi-draw-indirect
+	void SetUseGpuCulling(bool bUse) { m_bUseGpuCulling = bUse && m_gpuCulling.IsCreated(); }
+	// draw the curved meshes at the level of detail of their
+	// size on screen, or always at the finest
+	void SetUseMeshLods(bool bUse) { m_bUseMeshLods = bUse; }
+	// draw the opaque objects' depth before shading them, or
+	// shade every fragment that passes the depth test
+	void SetUseDepthPrepass(bool bUse) { m_bUseDepthPrepass = bUse; }
+	// set the shadow map size and number of cascades, 0 keeps
+	// the default, call before PrepareScene()
+	void SetShadowSettings(int mapSize, int cascadeCount);
+	// shadow the directional light, or light everything it faces
+	void SetUseShadows(bool bUse) { m_bUseShadows = bUse && m_shadowCascades.IsCreated(); }
+	// write the per-frame buffer updates through the upload ring,
+	// or send them with glBufferSubData, call before PrepareScene()
+	void SetUseUploadRing(bool bUse) { m_bUseUploadRing = bUse; }
+	// turn multi-draw-indirect on or off, when the driver has it
+	void SetUseMultiDraw(bool bUse) { m_bUseMultiDraw = bUse && MeshLibrary::SupportsMultiDraw(); }
+	// set the number of job workers that build the draw list,
+	// -1 for one per core and 0 to build it on the calling
+	// thread, call before PrepareScene()
+	void SetJobWorkers(int workerCount) { m_jobWorkerCount = workerCount; }
+	// set the arena the per-frame draw lists are built in, which
+	// must be reset only between frames
+	void SetFrameArena(FrameArena* pFrameArena) { m_pFrameArena = pFrameArena; }
+	// repeat the scene objects the passed in number of times
+	// in a grid, for measuring larger scenes; the lights are
+	// not repeated; call before PrepareScene()
+	void SetSceneCopies(int copies) { m_sceneCopies = std::max(copies, 1); }
+	// get the offsets of the first and the farthest copies of
+	// the scene, the corners of the grid they are laid out in
+	void GetSceneCopiesExtent(glm::vec3& minimum, glm::vec3& maximum) const;
+	// set the memory the streamed texture levels may use
+	void SetTextureBudget(size_t budgetBytes) { m_textureStreamer.SetBudget(budgetBytes); }
+	// get the counters of the texture streaming
+	const TextureStreamer::STREAMING_STATS& GetStreamingStats() const { return m_textureStreamer.Stats(); }
+
+	// get the transform hierarchy for animating groups
+	TransformHierarchy& GetTransforms() { return m_transforms; }
+
+	// move a registered object relative to its group,
+	// recomposing only its matrix and those below it
+	void SetObjectTransform(
+		int objectIndex,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
+};
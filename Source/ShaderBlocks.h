@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderblocks.h
+// ============
+// CPU side mirrors of the std140 uniform blocks declared in the GLSL shaders
+// and the binding points that every shader program shares
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+// uniform block binding points shared by all shader programs
+enum UNIFORM_BLOCK_BINDING
+{
+	FRAME_BLOCK_BINDING = 0,
+	MATERIAL_BLOCK_BINDING = 1,
+	POINT_LIGHT_BLOCK_BINDING = 2,
+	TEXTURE_BLOCK_BINDING = 3,
+	SHADOW_BLOCK_BINDING = 4
+};
+
+// shader storage binding points of the GPU culling pass,
+// these must match the bindings in cullComputeShader.glsl
+enum STORAGE_BLOCK_BINDING
+{
+	CULL_SOURCE_COMMAND_BINDING = 0,
+	CULL_CULLED_COMMAND_BINDING = 1,
+	CULL_BOUNDS_BINDING = 2,
+	CULL_SOURCE_MATRIX_BINDING = 3,
+	CULL_CULLED_MATRIX_BINDING = 4,
+	CULL_SOURCE_SETTINGS_BINDING = 5,
+	CULL_CULLED_SETTINGS_BINDING = 6,
+	CULL_STATS_BINDING = 7
+};
+
+// texture units - texture array N uses unit N, the shadow
+// cascades the unit after them, and the depth pyramid of
+// the culling pass and the light cluster buffers the last
+// three
+const int SHADOW_TEXTURE_UNIT = 12;
+const int DEPTH_PYRAMID_TEXTURE_UNIT = 13;
+const int CLUSTER_RANGE_TEXTURE_UNIT = 14;
+const int CLUSTER_INDEX_TEXTURE_UNIT = 15;
+
+// these sizes must match the defines in fragmentShader.glsl
+const int MAX_POINT_LIGHTS = 256;
+const int MAX_MATERIALS = 32;
+const int MAX_TEXTURES = 1024;
+const int MAX_TEXTURE_ARRAYS = 12;
+const int MAX_SHADOW_CASCADES = 4;
+
+// in std140 a vec3 takes 16 bytes, so each vec3 below is
+// followed by a scalar that fills its last 4 bytes, and
+// GLSL bools are stored as 4 byte integers
+
+struct DIRECTIONAL_LIGHT_STD140
+{
+	glm::vec3 direction;
+	int bActive;
+	glm::vec3 ambient;
+	float padding0;
+	glm::vec3 diffuse;
+	float padding1;
+	glm::vec3 specular;
+	float padding2;
+};
+
+struct POINT_LIGHT_STD140
+{
+	glm::vec3 position;
+	int bActive;
+	glm::vec3 ambient;
+	float constant;
+	glm::vec3 diffuse;
+	float linear;
+	glm::vec3 specular;
+	float quadratic;
+};
+
+struct SPOT_LIGHT_STD140
+{
+	glm::vec3 position;
+	float cutOff;
+	glm::vec3 direction;
+	float outerCutOff;
+	glm::vec3 ambient;
+	float constant;
+	glm::vec3 diffuse;
+	float linear;
+	glm::vec3 specular;
+	float quadratic;
+	int bActive;
+	float padding[3];
+};
+
+// FrameData block - camera and lights, updated once per frame
+struct FRAME_DATA_STD140
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPosition;
+	int pointLightCount;
+	// tiles x, tiles y, depth slices, tile size in pixels
+	glm::ivec4 clusterDimensions;
+	// near plane, far plane, depth slice scale and bias
+	glm::vec4 clusterDepth;
+	DIRECTIONAL_LIGHT_STD140 directionalLight;
+	SPOT_LIGHT_STD140 spotLight;
+};
+
+// PointLightData block - the point light list, only the
+// first pointLightCount entries are read by the shaders
+struct POINT_LIGHT_DATA_STD140
+{
+	POINT_LIGHT_STD140 pointLights[MAX_POINT_LIGHTS];
+};
+
+// one entry of the MaterialData block
+struct MATERIAL_STD140
+{
+	glm::vec3 diffuseColor;
+	float shininess;
+	glm::vec3 specularColor;
+	float padding0;
+};
+
+// MaterialData block - every defined material, indexed by ID
+struct MATERIAL_DATA_STD140
+{
+	MATERIAL_STD140 materials[MAX_MATERIALS];
+};
+
+// TextureData block - one entry per registered texture, the
+// array and layer in x and y, or a bindless handle split
+// into its low and high 32 bits
+struct TEXTURE_DATA_STD140
+{
+	glm::uvec4 textures[MAX_TEXTURES];
+};
+
+// ShadowData block - the directional light's shadow cascades
+struct SHADOW_DATA_STD140
+{
+	// world to shadow map texture space of each cascade
+	glm::mat4 cascadeMatrices[MAX_SHADOW_CASCADES];
+	// view-space depth at which each cascade ends
+	glm::vec4 cascadeSplits;
+	// world size of one shadow map texel in each cascade
+	glm::vec4 cascadeTexelSizes;
+	int cascadeCount;
+	// size of one texel in texture coordinates
+	float texelSize;
+	float padding[2];
+};
+
+static_assert(sizeof(DIRECTIONAL_LIGHT_STD140) == 64, "std140 layout mismatch");
+static_assert(sizeof(POINT_LIGHT_STD140) == 64, "std140 layout mismatch");
+static_assert(sizeof(SPOT_LIGHT_STD140) == 96, "std140 layout mismatch");
+static_assert(sizeof(FRAME_DATA_STD140) == 336, "std140 layout mismatch");
+static_assert(sizeof(POINT_LIGHT_DATA_STD140) <= 16384, "block exceeds the OpenGL 3.3 minimum");
+static_assert(sizeof(MATERIAL_STD140) == 32, "std140 layout mismatch");
+static_assert(sizeof(TEXTURE_DATA_STD140) <= 16384, "block exceeds the OpenGL 3.3 minimum");
+static_assert(sizeof(SHADOW_DATA_STD140) == 304, "std140 layout mismatch");
+static_assert(MAX_TEXTURE_ARRAYS <= SHADOW_TEXTURE_UNIT, "texture arrays overlap the shadow cascade unit");
+static_assert(SHADOW_TEXTURE_UNIT < DEPTH_PYRAMID_TEXTURE_UNIT, "shadow cascades overlap the depth pyramid unit");
@@ -0,0 +1,716 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderpermutations.cpp
+// ======================
+// This file contains the implementation of the `ShaderPermutations` class,
+// which builds and caches the feature permutations of the scene program.
+//
+// RESPONSIBILITIES:
+// - Add the #define lines of a permutation to the scene shader sources.
+// - Build each permutation when it is first drawn with, from the program
+//   binary cache when it can.
+// - Write newly linked programs to the cache, keyed by a hash of their
+//   sources, defines and the driver.
+// - Rebuild the built permutations when the shader files change.
+//
+// NOTE: A binary from the cache is only a shortcut - when its key does not
+// match, or the driver refuses it, the program is compiled from source and
+// the cache file is written again.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderPermutations.h"
+#include "MappedFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// Namespace for the permutation settings
+namespace
+{
+	// #define names of the feature bits, in bit order
+	const char* const FEATURE_NAMES[ShaderPermutations::FEATURE_COUNT] =
+	{
+		"TEXTURED",
+		"LIT",
+		"DIRECTIONAL_LIGHT",
+		"POINT_LIGHTS",
+		"LIGHT_CLUSTERS",
+		"SPOT_LIGHT",
+		"DEPTH_ONLY",
+		"SHADOWS",
+		"SHADOW_CASTER"
+	};
+	// lets the driver pick its number of compiler threads
+	const GLuint DRIVER_COMPILER_THREADS = 0xFFFFFFFF;
+	// FNV-1a 64-bit offset basis and prime
+	const uint64_t HASH_OFFSET_BASIS = 14695981039346656037ULL;
+	const uint64_t HASH_PRIME = 1099511628211ULL;
+}
+
+const int ShaderPermutations::FEATURE_COUNT;
+const int ShaderPermutations::PERMUTATION_COUNT;
+const uint32_t ShaderPermutations::FILE_VERSION;
+
+/***********************************************************
+ *  ShaderPermutations()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderPermutations::ShaderPermutations()
+{
+	for (int i = 0; i < PERMUTATION_COUNT; ++i)
+	{
+		m_permutations[i].program = 0;
+		m_permutations[i].bFailed = false;
+		m_permutations[i].rebuild.program = 0;
+		m_permutations[i].rebuild.shaders[0] = 0;
+		m_permutations[i].rebuild.shaders[1] = 0;
+	}
+	m_bRebuilding = false;
+	m_generation = 0;
+	m_bParallelCompile = false;
+	m_bBinaryCacheSupported = false;
+	m_bUseBinaryCache = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~ShaderPermutations()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderPermutations::~ShaderPermutations()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for reading the scene shader files,
+ *  letting the driver compile on its own threads when it
+ *  can, and checking that the driver can hand out program
+ *  binaries.  No program is built here.
+ ***********************************************************/
+bool ShaderPermutations::Create(const char* vertexShaderPath, const char* fragmentShaderPath, const char* cachePath)
+{
+	m_vertexShaderPath = vertexShaderPath;
+	m_fragmentShaderPath = fragmentShaderPath;
+	m_cachePath = cachePath;
+
+	if ((ReadFile(m_vertexShaderPath, m_vertexSource) == false) ||
+		(ReadFile(m_fragmentShaderPath, m_fragmentSource) == false))
+	{
+		return(false);
+	}
+
+	m_bParallelCompile = GLEW_KHR_parallel_shader_compile ? true : false;
+	if (m_bParallelCompile)
+	{
+		glMaxShaderCompilerThreadsKHR(DRIVER_COMPILER_THREADS);
+	}
+
+	// a driver can have the extension and still no formats
+	GLint formatCount = 0;
+	if (GLEW_ARB_get_program_binary)
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	}
+	m_bBinaryCacheSupported = (formatCount > 0);
+	m_bUseBinaryCache = m_bBinaryCacheSupported;
+
+	const GLubyte* vendor = glGetString(GL_VENDOR);
+	const GLubyte* renderer = glGetString(GL_RENDERER);
+	const GLubyte* version = glGetString(GL_VERSION);
+	m_driverName = std::string(vendor ? (const char*)vendor : "") + "\n" +
+		(renderer ? (const char*)renderer : "") + "\n" +
+		(version ? (const char*)version : "");
+
+	if (m_bBinaryCacheSupported == false)
+	{
+		std::cout << "Program binaries are not supported, the shader programs are always compiled" << std::endl;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for deleting every built program and
+ *  any rebuild that is under way.
+ ***********************************************************/
+void ShaderPermutations::Destroy()
+{
+	DiscardRebuild();
+	for (int i = 0; i < PERMUTATION_COUNT; ++i)
+	{
+		if (0 != m_permutations[i].program)
+		{
+			glDeleteProgram(m_permutations[i].program);
+			m_permutations[i].program = 0;
+		}
+		m_permutations[i].bFailed = false;
+	}
+}
+
+/***********************************************************
+ *  Program()
+ *
+ *  This method is used for getting the program of a
+ *  permutation.  The first call builds it - from the cache
+ *  when the cache has it, else from source, writing the
+ *  result to the cache - and reflects its uniforms.  This
+ *  waits for the driver, so a permutation first seen in the
+ *  middle of a run costs that frame one compile, or one
+ *  binary load on a warm start.
+ ***********************************************************/
+GLuint ShaderPermutations::Program(int features)
+{
+	if ((features < 0) || (features >= PERMUTATION_COUNT))
+	{
+		return(0);
+	}
+
+	PERMUTATION& permutation = m_permutations[features];
+	if ((0 != permutation.program) || permutation.bFailed)
+	{
+		return(permutation.program);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool bFromCache = false;
+
+	permutation.program = LoadBinary(features);
+	if (0 != permutation.program)
+	{
+		bFromCache = true;
+		m_stats.binaryLoads++;
+	}
+	else
+	{
+		PROGRAM_BUILD build;
+		StartBuild(features, m_vertexSource, m_fragmentSource, build);
+		if (FinishBuild(features, build) == false)
+		{
+			permutation.bFailed = true;
+			return(0);
+		}
+		permutation.program = build.program;
+		m_stats.compiles++;
+		SaveBinary(features);
+	}
+	permutation.uniforms.Reflect(permutation.program);
+
+	double milliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+	std::cout << "Built shader program [" << Describe(features) << "] in " << milliseconds << " ms"
+		<< (bFromCache ? " from the program cache" : "") << std::endl;
+
+	return(permutation.program);
+}
+
+/***********************************************************
+ *  BeginRebuild()
+ *
+ *  This method is used for reading the shader files again
+ *  and starting a build of every permutation that has a
+ *  program.  No status is asked for here - with parallel
+ *  compiling the driver does the work on its own threads
+ *  and the frame goes on, without it the work happens here
+ *  or at the first query.
+ ***********************************************************/
+void ShaderPermutations::BeginRebuild()
+{
+	DiscardRebuild();
+
+	if ((ReadFile(m_vertexShaderPath, m_rebuildVertexSource) == false) ||
+		(ReadFile(m_fragmentShaderPath, m_rebuildFragmentSource) == false))
+	{
+		return;
+	}
+
+	int buildCount = 0;
+	for (int i = 0; i < PERMUTATION_COUNT; ++i)
+	{
+		if (0 != m_permutations[i].program)
+		{
+			StartBuild(i, m_rebuildVertexSource, m_rebuildFragmentSource, m_permutations[i].rebuild);
+			buildCount++;
+		}
+	}
+	m_bRebuilding = true;
+
+	std::cout << "Rebuilding " << buildCount << " shader programs" << std::endl;
+}
+
+/***********************************************************
+ *  FinishRebuild()
+ *
+ *  This method is used for checking a rebuild.  With
+ *  parallel compiling it waits, frame by frame, until the
+ *  driver reports every build complete.  When all of them
+ *  linked they replace the running programs together and
+ *  the generation goes up, so users resolve their uniform
+ *  handles again; when any failed its log is printed and
+ *  the running programs stay.
+ ***********************************************************/
+bool ShaderPermutations::FinishRebuild()
+{
+	if (m_bRebuilding == false)
+	{
+		return(false);
+	}
+
+	if (m_bParallelCompile)
+	{
+		for (int i = 0; i < PERMUTATION_COUNT; ++i)
+		{
+			GLint status = GL_TRUE;
+			if (0 != m_permutations[i].rebuild.program)
+			{
+				glGetProgramiv(m_permutations[i].rebuild.program, GL_COMPLETION_STATUS_KHR, &status);
+			}
+			if (status == GL_FALSE)
+			{
+				return(false);
+			}
+		}
+	}
+
+	for (int i = 0; i < PERMUTATION_COUNT; ++i)
+	{
+		if ((0 != m_permutations[i].rebuild.program) &&
+			(FinishBuild(i, m_permutations[i].rebuild) == false))
+		{
+			std::cout << "Keeping the running shader programs" << std::endl;
+			DiscardRebuild();
+			return(false);
+		}
+	}
+
+	m_vertexSource.swap(m_rebuildVertexSource);
+	m_fragmentSource.swap(m_rebuildFragmentSource);
+	m_rebuildVertexSource.clear();
+	m_rebuildFragmentSource.clear();
+	m_bRebuilding = false;
+
+	// a deleted program that is still in use lives on until it
+	// is unbound, and passes that save and restore the current
+	// program would then restore a name that no longer exists
+	GLint currentProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+
+	int reloadCount = 0;
+	for (int i = 0; i < PERMUTATION_COUNT; ++i)
+	{
+		PERMUTATION& permutation = m_permutations[i];
+		if (0 != permutation.program)
+		{
+			if ((GLuint)currentProgram == permutation.program)
+			{
+				glUseProgram(0);
+			}
+			glDeleteProgram(permutation.program);
+		}
+		// a permutation built while the rebuild was under way
+		// came from the old sources and is built again on use
+		permutation.program = permutation.rebuild.program;
+		permutation.rebuild.program = 0;
+		permutation.bFailed = false;
+		if (0 != permutation.program)
+		{
+			permutation.uniforms.Reflect(permutation.program);
+			m_stats.compiles++;
+			SaveBinary(i);
+			reloadCount++;
+		}
+	}
+	m_generation++;
+
+	std::cout << "Reloaded " << reloadCount << " shader programs" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  StartBuild()
+ *
+ *  This method is used for compiling both shaders of a
+ *  permutation and linking them, without waiting for the
+ *  result.  The program is marked retrievable so that its
+ *  binary can be cached.
+ ***********************************************************/
+void ShaderPermutations::StartBuild(int features, const std::string& vertexSource, const std::string& fragmentSource, PROGRAM_BUILD& build)
+{
+	const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	const std::string* sources[2] = { &vertexSource, &fragmentSource };
+
+	build.program = glCreateProgram();
+	for (int i = 0; i < 2; ++i)
+	{
+		std::string source = ApplyDefines(*sources[i], features);
+		const char* sourceText = source.c_str();
+
+		build.shaders[i] = glCreateShader(types[i]);
+		glShaderSource(build.shaders[i], 1, &sourceText, NULL);
+		glCompileShader(build.shaders[i]);
+		glAttachShader(build.program, build.shaders[i]);
+	}
+	if (m_bBinaryCacheSupported)
+	{
+		glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(build.program);
+}
+
+/***********************************************************
+ *  FinishBuild()
+ *
+ *  This method is used for checking a started build.  The
+ *  shaders are freed either way; the program is kept when
+ *  it linked and deleted, after printing the compile or
+ *  link log, when it did not.
+ ***********************************************************/
+bool ShaderPermutations::FinishBuild(int features, PROGRAM_BUILD& build)
+{
+	GLint status = GL_FALSE;
+	glGetProgramiv(build.program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char log[1024] = { 0 };
+		const std::string* paths[2] = { &m_vertexShaderPath, &m_fragmentShaderPath };
+		bool bCompiled = true;
+
+		for (int i = 0; i < 2; ++i)
+		{
+			glGetShaderiv(build.shaders[i], GL_COMPILE_STATUS, &status);
+			if (status != GL_TRUE)
+			{
+				glGetShaderInfoLog(build.shaders[i], sizeof(log), NULL, log);
+				std::cout << "Shader " << *paths[i] << " [" << Describe(features) << "] failed to compile:"
+					<< std::endl << log << std::endl;
+				bCompiled = false;
+			}
+		}
+		if (bCompiled)
+		{
+			glGetProgramInfoLog(build.program, sizeof(log), NULL, log);
+			std::cout << "Shader program [" << Describe(features) << "] failed to link:"
+				<< std::endl << log << std::endl;
+		}
+
+		DiscardBuild(build);
+		return(false);
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		glDetachShader(build.program, build.shaders[i]);
+		glDeleteShader(build.shaders[i]);
+		build.shaders[i] = 0;
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  DiscardBuild()
+ *
+ *  This method is used for deleting a build's program and
+ *  shaders.
+ ***********************************************************/
+void ShaderPermutations::DiscardBuild(PROGRAM_BUILD& build)
+{
+	if (0 != build.program)
+	{
+		glDeleteProgram(build.program);
+		build.program = 0;
+	}
+	for (int i = 0; i < 2; ++i)
+	{
+		if (0 != build.shaders[i])
+		{
+			glDeleteShader(build.shaders[i]);
+			build.shaders[i] = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  DiscardRebuild()
+ *
+ *  This method is used for dropping every build of a
+ *  rebuild that is under way.
+ ***********************************************************/
+void ShaderPermutations::DiscardRebuild()
+{
+	for (int i = 0; i < PERMUTATION_COUNT; ++i)
+	{
+		DiscardBuild(m_permutations[i].rebuild);
+	}
+	m_rebuildVertexSource.clear();
+	m_rebuildFragmentSource.clear();
+	m_bRebuilding = false;
+}
+
+/***********************************************************
+ *  LoadBinary()
+ *
+ *  This method is used for creating a permutation's program
+ *  from its cache file.  The file is only used when its key
+ *  matches the current sources, defines and driver, and the
+ *  program only when the driver accepts the binary.
+ ***********************************************************/
+GLuint ShaderPermutations::LoadBinary(int features)
+{
+	if (m_bUseBinaryCache == false)
+	{
+		return(0);
+	}
+
+	std::string filePath = CacheFilePath(features);
+	MappedFile file;
+	if (file.Open(filePath.c_str()) == false)
+	{
+		return(0);
+	}
+
+	const BINARY_HEADER* pHeader = (const BINARY_HEADER*)file.Data();
+	bool bValid = (file.Size() >= sizeof(BINARY_HEADER)) &&
+		(memcmp(pHeader->magic, "SPRG", 4) == 0) &&
+		(pHeader->version == FILE_VERSION) &&
+		(pHeader->key == CacheKey(features)) &&
+		(file.Size() - sizeof(BINARY_HEADER) >= pHeader->length);
+	if (bValid == false)
+	{
+		return(0);
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, pHeader->format, file.Data() + sizeof(BINARY_HEADER), (GLsizei)pHeader->length);
+
+	// a driver update can turn down binaries of the same key
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		return(0);
+	}
+
+	return(program);
+}
+
+/***********************************************************
+ *  SaveBinary()
+ *
+ *  This method is used for writing the program of a
+ *  permutation to its cache file.  The file is written
+ *  beside the cache file and moved over it once complete,
+ *  so a second instance never reads a half-written binary.
+ ***********************************************************/
+void ShaderPermutations::SaveBinary(int features)
+{
+	GLuint program = m_permutations[features].program;
+	if ((m_bUseBinaryCache == false) || (0 == program))
+	{
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return;
+	}
+
+	std::vector<unsigned char> binary((size_t)length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, (GLsizei)length, &written, &format, binary.data());
+
+	BINARY_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "SPRG", 4);
+	header.version = FILE_VERSION;
+	header.key = CacheKey(features);
+	header.format = (uint32_t)format;
+	header.length = (uint32_t)written;
+
+	std::string filePath = CacheFilePath(features);
+	std::string writePath = filePath + ".tmp";
+	std::ofstream file(writePath.c_str(), std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cout << "Could not write program binary:" << filePath << std::endl;
+		return;
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)binary.data(), written);
+	file.close();
+	if (file.fail() || (MappedFile::MoveOver(writePath.c_str(), filePath.c_str()) == false))
+	{
+		std::cout << "Could not write program binary:" << filePath << std::endl;
+		remove(writePath.c_str());
+		return;
+	}
+
+	m_stats.binarySaves++;
+}
+
+/***********************************************************
+ *  CacheKey()
+ *
+ *  This method is used for hashing everything a program
+ *  binary depends on - both sources, the defines of the
+ *  permutation and the driver that linked it.
+ ***********************************************************/
+uint64_t ShaderPermutations::CacheKey(int features) const
+{
+	std::string defines = DefineBlock(features);
+
+	uint64_t hash = HASH_OFFSET_BASIS;
+	hash = HashBytes(hash, m_driverName.data(), m_driverName.size());
+	hash = HashBytes(hash, defines.data(), defines.size());
+	hash = HashBytes(hash, m_vertexSource.data(), m_vertexSource.size());
+	hash = HashBytes(hash, m_fragmentSource.data(), m_fragmentSource.size());
+
+	return(hash);
+}
+
+/***********************************************************
+ *  CacheFilePath()
+ *
+ *  This method is used for naming the cache file of a
+ *  permutation - the cache path, the feature bits in hex
+ *  and .programbin.
+ ***********************************************************/
+std::string ShaderPermutations::CacheFilePath(int features) const
+{
+	char suffix[32] = { 0 };
+	snprintf(suffix, sizeof(suffix), ".%03x.programbin", features);
+	return(m_cachePath + suffix);
+}
+
+/***********************************************************
+ *  DefineBlock()
+ *
+ *  This method is used for writing one #define line for
+ *  each feature of a permutation.
+ ***********************************************************/
+std::string ShaderPermutations::DefineBlock(int features)
+{
+	std::string defines;
+	for (int i = 0; i < FEATURE_COUNT; ++i)
+	{
+		if (0 != (features & (1 << i)))
+		{
+			defines += std::string("#define ") + FEATURE_NAMES[i] + "\n";
+		}
+	}
+	return(defines);
+}
+
+/***********************************************************
+ *  Describe()
+ *
+ *  This method is used for listing the feature names of a
+ *  permutation for the log.
+ ***********************************************************/
+std::string ShaderPermutations::Describe(int features)
+{
+	std::string names;
+	for (int i = 0; i < FEATURE_COUNT; ++i)
+	{
+		if (0 != (features & (1 << i)))
+		{
+			if (names.empty() == false)
+			{
+				names += " ";
+			}
+			names += FEATURE_NAMES[i];
+		}
+	}
+	return(names.empty() ? std::string("no features") : names);
+}
+
+/***********************************************************
+ *  ApplyDefines()
+ *
+ *  This method is used for inserting the #define lines of
+ *  a permutation into a source.  GLSL wants #version first
+ *  and #extension before any code, so the lines go right
+ *  after the last of those, followed by a #line so that the
+ *  compiler logs keep the line numbers of the file.
+ ***********************************************************/
+std::string ShaderPermutations::ApplyDefines(const std::string& source, int features)
+{
+	size_t insertAt = 0;
+	int insertLine = 0;
+	size_t lineStart = 0;
+	int lineNumber = 0;
+
+	while (lineStart < source.size())
+	{
+		size_t lineEnd = source.find('\n', lineStart);
+		lineEnd = (lineEnd == std::string::npos) ? source.size() : lineEnd + 1;
+		lineNumber++;
+
+		if ((source.compare(lineStart, 8, "#version") == 0) ||
+			(source.compare(lineStart, 10, "#extension") == 0))
+		{
+			insertAt = lineEnd;
+			insertLine = lineNumber;
+		}
+		lineStart = lineEnd;
+	}
+
+	std::string defines = DefineBlock(features);
+	if ((insertAt > 0) && (source[insertAt - 1] != '\n'))
+	{
+		defines = "\n" + defines;
+	}
+	defines += "#line " + std::to_string(insertLine + 1) + "\n";
+
+	return(source.substr(0, insertAt) + defines + source.substr(insertAt));
+}
+
+/***********************************************************
+ *  ReadFile()
+ *
+ *  This method is used for reading a shader file into a
+ *  string.
+ ***********************************************************/
+bool ShaderPermutations::ReadFile(const std::string& filePath, std::string& text)
+{
+	std::ifstream file(filePath.c_str());
+	if (file.is_open() == false)
+	{
+		std::cout << "Could not open shader " << filePath << std::endl;
+		return(false);
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+	text = stream.str();
+	return(true);
+}
+
+/***********************************************************
+ *  HashBytes()
+ *
+ *  This method is used for adding a run of bytes to a
+ *  64-bit FNV-1a hash.
+ ***********************************************************/
+uint64_t ShaderPermutations::HashBytes(uint64_t hash, const void* pData, size_t size)
+{
+	const unsigned char* pBytes = (const unsigned char*)pData;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= pBytes[i];
+		hash *= HASH_PRIME;
+	}
+	return(hash);
+}
@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderpermutations.h
+// ============
+// build the scene shader program once per combination of shader features,
+// with each feature compiled in or out by a #define, and keep the linked
+// programs in an on-disk binary cache so a warm start skips the compiler
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "UniformCache.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  ShaderPermutations
+ *
+ *  This class holds the scene shader sources and one linked
+ *  program for each permutation - a set of feature bits,
+ *  each of which adds a #define to both shaders.  A program
+ *  is built the first time it is asked for, from the binary
+ *  cache when the cache has a program for the same sources,
+ *  defines and driver, and from source otherwise, after
+ *  which it is written to the cache.  Each program has its
+ *  own reflected uniform table.  Rebuilding for changed
+ *  sources happens in the background, frame by frame, and
+ *  replaces every built program at once.
+ ***********************************************************/
+class ShaderPermutations
+{
+public:
+	// shader features, each one a #define of the same name
+	// without the FEATURE_ prefix
+	enum FEATURE
+	{
+		// the draw samples its texture, set per render item
+		FEATURE_TEXTURED = 1,
+		// the features below are the same for the whole frame
+		FEATURE_LIT = 2,
+		FEATURE_DIRECTIONAL_LIGHT = 4,
+		FEATURE_POINT_LIGHTS = 8,
+		FEATURE_LIGHT_CLUSTERS = 16,
+		FEATURE_SPOT_LIGHT = 32,
+		// only the depth is written, for the depth pre-pass, and
+		// used without any of the other features
+		FEATURE_DEPTH_ONLY = 64,
+		// the directional light is shadowed by the shadow cascades
+		FEATURE_SHADOWS = 128,
+		// the vertices are placed for the light of a shadow
+		// cascade, used together with FEATURE_DEPTH_ONLY
+		FEATURE_SHADOW_CASTER = 256
+	};
+	// number of feature bits and of their combinations
+	static const int FEATURE_COUNT = 9;
+	static const int PERMUTATION_COUNT = 1 << FEATURE_COUNT;
+
+	// where built programs come from, counted over the run
+	struct CACHE_STATS
+	{
+		// programs loaded from the binary cache
+		int binaryLoads;
+		// programs compiled and linked from source
+		int compiles;
+		// programs written to the binary cache
+		int binarySaves;
+	};
+
+	// constructor
+	ShaderPermutations();
+	// destructor
+	~ShaderPermutations();
+
+	// read the shader sources and check whether the driver can
+	// cache programs, the cache files start with cachePath
+	bool Create(const char* vertexShaderPath, const char* fragmentShaderPath, const char* cachePath);
+	// delete every program
+	void Destroy();
+
+	// get the program of a permutation, built the first time it
+	// is asked for, 0 when it fails to build
+	GLuint Program(int features);
+	// get the uniform table of a built permutation
+	const UniformCache& Uniforms(int features) const { return m_permutations[features].uniforms; }
+	// number of times the built programs were replaced, so
+	// users can tell that their handles are out of date
+	int Generation() const { return m_generation; }
+
+	// read the shader files again and start rebuilding every
+	// built permutation from them
+	void BeginRebuild();
+	// check the rebuild, true in the frame its programs
+	// replaced the running ones
+	bool FinishRebuild();
+	// check whether a rebuild is under way
+	bool IsRebuilding() const { return m_bRebuilding; }
+	// check whether the driver compiles on threads of its own
+	bool IsParallelCompile() const { return m_bParallelCompile; }
+
+	// turn the binary cache off, for timing cold starts
+	void SetUseBinaryCache(bool bUse) { m_bUseBinaryCache = bUse && m_bBinaryCacheSupported; }
+	// get the counters of the builds so far
+	const CACHE_STATS& Stats() const { return m_stats; }
+
+private:
+	// a program being compiled and linked, and its shaders,
+	// all 0 when no build is under way
+	struct PROGRAM_BUILD
+	{
+		GLuint program;
+		GLuint shaders[2];
+	};
+
+	// one permutation of the scene program
+	struct PERMUTATION
+	{
+		// linked program, 0 until it is first asked for
+		GLuint program;
+		// uniforms reflected from the program
+		UniformCache uniforms;
+		// the sources did not build, they are not tried again
+		// until they change
+		bool bFailed;
+		// build from the changed sources during a rebuild
+		PROGRAM_BUILD rebuild;
+	};
+
+	// start of every file in the binary cache, followed by
+	// length bytes of the driver's program binary
+	struct BINARY_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		// hash of the sources, defines and driver
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	// current binary cache file version
+	static const uint32_t FILE_VERSION = 1;
+
+	PERMUTATION m_permutations[PERMUTATION_COUNT];
+	// shader files and the sources the programs are built from
+	std::string m_vertexShaderPath;
+	std::string m_fragmentShaderPath;
+	std::string m_vertexSource;
+	std::string m_fragmentSource;
+	// sources read for a rebuild that has not finished yet
+	std::string m_rebuildVertexSource;
+	std::string m_rebuildFragmentSource;
+	bool m_bRebuilding;
+	int m_generation;
+	// whether the driver compiles and links in the background
+	bool m_bParallelCompile;
+	// path and name start of the binary cache files
+	std::string m_cachePath;
+	// vendor, renderer and version of the driver, part of the
+	// cache key as a binary only loads on the driver it came from
+	std::string m_driverName;
+	bool m_bBinaryCacheSupported;
+	bool m_bUseBinaryCache;
+	CACHE_STATS m_stats;
+
+	// start compiling and linking a permutation from sources
+	void StartBuild(int features, const std::string& vertexSource, const std::string& fragmentSource, PROGRAM_BUILD& build);
+	// wait for a build and check it, printing the logs when it
+	// failed, the program is kept only when it linked
+	bool FinishBuild(int features, PROGRAM_BUILD& build);
+	// delete a build and its shaders
+	static void DiscardBuild(PROGRAM_BUILD& build);
+	// drop a rebuild under way
+	void DiscardRebuild();
+
+	// load a permutation from the binary cache, 0 when the
+	// cache has no usable program for it
+	GLuint LoadBinary(int features);
+	// write the program of a permutation to the binary cache
+	void SaveBinary(int features);
+	// cache key of a permutation built from the current sources
+	uint64_t CacheKey(int features) const;
+	// cache file of a permutation
+	std::string CacheFilePath(int features) const;
+
+	// lines that #define the features of a permutation
+	static std::string DefineBlock(int features);
+	// feature names of a permutation, for the log
+	static std::string Describe(int features);
+	// add the #define lines after the #version and #extension
+	// lines of a source
+	static std::string ApplyDefines(const std::string& source, int features);
+	// read a whole text file, false when it cannot be opened
+	static bool ReadFile(const std::string& filePath, std::string& text);
+	// add bytes to a 64-bit FNV-1a hash
+	static uint64_t HashBytes(uint64_t hash, const void* pData, size_t size);
+};
@@ -0,0 +1,512 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowcascades.cpp
+// ==================
+// This file contains the implementation of the `ShadowCascades` class, which
+// renders the directional light's cascaded shadow maps.
+//
+// RESPONSIBILITIES:
+// - Split the view depth between the near plane and the scene into cascades.
+// - Fit a texel snapped orthographic light projection around each cascade.
+// - Keep the static casters of each cascade cached between frames.
+// - Send the cascade matrices and splits to the shaders in the ShadowData
+//   block.
+//
+// NOTE: Each cascade is fitted with a sphere rather than a box, so that the
+// light projection keeps its size as the camera turns, and its center is
+// moved in whole texels, so the shadow edges do not crawl as the camera
+// moves.  The far end of the cascades and their depth range are rounded
+// outward, so an object moving inside the scene does not change them.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadowCascades.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// declaration of the global variables and defines
+namespace
+{
+	// blend between logarithmic (1) and even (0) splits
+	const float SPLIT_LAMBDA = 0.75f;
+	// world distance that the far end of the cascades and the
+	// light depth range are rounded out to
+	const float DEPTH_STEP = 1.0f;
+	// steps per world unit that the cascade radius is rounded
+	// up to, so that rounding errors do not change it
+	const float RADIUS_STEPS = 16.0f;
+	// smallest shadow map that is created
+	const int MIN_MAP_SIZE = 256;
+	// slope scaled and constant depth offset of the casters
+	const float CASTER_SLOPE_OFFSET = 2.0f;
+	const float CASTER_CONSTANT_OFFSET = 4.0f;
+}
+
+/***********************************************************
+ *  ShadowCascades()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadowCascades::ShadowCascades()
+{
+	m_mapSize = 0;
+	m_cascadeCount = 0;
+	m_shadowTexture = 0;
+	m_staticTexture = 0;
+	m_shadowFramebuffer = 0;
+	m_staticFramebuffer = 0;
+	for (int i = 0; i < MAX_SHADOW_CASCADES; ++i)
+	{
+		m_viewProjections[i] = glm::mat4(0.0f);
+		m_bStaticDirty[i] = true;
+		m_bShadowDirty[i] = true;
+	}
+	m_shadowData = SHADOW_DATA_STD140();
+	m_bInPass = false;
+	m_previousDrawFramebuffer = 0;
+	m_previousReadFramebuffer = 0;
+	memset(m_previousViewport, 0, sizeof(m_previousViewport));
+	m_staticLayersDrawn = 0;
+	m_dynamicLayersDrawn = 0;
+}
+
+/***********************************************************
+ *  ~ShadowCascades()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadowCascades::~ShadowCascades()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the sampled and the
+ *  cached depth arrays with one layer per cascade, the two
+ *  framebuffers that their layers are drawn through and
+ *  the ShadowData block.  The map size is limited to what
+ *  the driver supports.
+ ***********************************************************/
+bool ShadowCascades::Create(int mapSize, int cascadeCount)
+{
+	Destroy();
+
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	m_mapSize = std::max(std::min(mapSize, (int)maxSize), MIN_MAP_SIZE);
+	m_cascadeCount = std::max(std::min(cascadeCount, MAX_SHADOW_CASCADES), 1);
+
+	// the casters are only compared to, so the sampled array
+	// compares in hardware, and the cached one is only copied
+	m_shadowTexture = CreateDepthArray(true);
+	m_staticTexture = CreateDepthArray(false);
+	glGenFramebuffers(1, &m_shadowFramebuffer);
+	glGenFramebuffers(1, &m_staticFramebuffer);
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	bool bComplete = (0 != m_shadowTexture) && (0 != m_staticTexture) &&
+		(0 != m_shadowFramebuffer) && (0 != m_staticFramebuffer);
+	const GLuint framebuffers[2] = { m_shadowFramebuffer, m_staticFramebuffer };
+	const GLuint textures[2] = { m_shadowTexture, m_staticTexture };
+	for (int i = 0; (i < 2) && bComplete; ++i)
+	{
+		// depth only, there is no color to draw or read
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textures[i], 0, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		bComplete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+
+	if (bComplete == false)
+	{
+		std::cout << "Could not create the shadow cascade framebuffers" << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	m_shadowBlock.Create(sizeof(SHADOW_DATA_STD140), SHADOW_BLOCK_BINDING);
+	m_shadowData = SHADOW_DATA_STD140();
+	m_shadowBlock.Update(0, sizeof(m_shadowData), &m_shadowData);
+	InvalidateStatic();
+
+	return(true);
+}
+
+/***********************************************************
+ *  CreateDepthArray()
+ *
+ *  This method is used for allocating a depth texture array
+ *  with one layer per cascade.  The sampled array filters
+ *  its compare results, so each lookup of the fragment
+ *  shader already blends four texels.
+ ***********************************************************/
+GLuint ShadowCascades::CreateDepthArray(bool bCompare) const
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	if (0 == texture)
+	{
+		return(0);
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_mapSize, m_mapSize, m_cascadeCount,
+		0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, bCompare ? GL_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, bCompare ? GL_LINEAR : GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	if (bCompare)
+	{
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	return(texture);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the depth arrays, the
+ *  framebuffers and the ShadowData block.
+ ***********************************************************/
+void ShadowCascades::Destroy()
+{
+	if (0 != m_shadowFramebuffer) glDeleteFramebuffers(1, &m_shadowFramebuffer);
+	if (0 != m_staticFramebuffer) glDeleteFramebuffers(1, &m_staticFramebuffer);
+	if (0 != m_shadowTexture) glDeleteTextures(1, &m_shadowTexture);
+	if (0 != m_staticTexture) glDeleteTextures(1, &m_staticTexture);
+	m_shadowFramebuffer = 0;
+	m_staticFramebuffer = 0;
+	m_shadowTexture = 0;
+	m_staticTexture = 0;
+	m_shadowBlock.Destroy();
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for splitting the view depth from
+ *  the near plane to the far side of the scene bounds into
+ *  the cascades and fitting the light to each.  A cascade
+ *  whose light projection changed has its cached casters
+ *  drawn again, and the ShadowData block is only sent when
+ *  something in it changed.
+ ***********************************************************/
+void ShadowCascades::Update(const ViewManager::VIEW_STATE& viewState, glm::vec3 lightDirection, const CullingBVH::AABB& sceneBounds)
+{
+	m_staticLayersDrawn = 0;
+	m_dynamicLayersDrawn = 0;
+	if ((IsCreated() == false) || (glm::length(lightDirection) <= 0.0f))
+	{
+		return;
+	}
+
+	// nothing past the scene can receive a shadow
+	float sceneDepth = viewState.nearPlane;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 position(
+			(corner & 1) ? sceneBounds.maximum.x : sceneBounds.minimum.x,
+			(corner & 2) ? sceneBounds.maximum.y : sceneBounds.minimum.y,
+			(corner & 4) ? sceneBounds.maximum.z : sceneBounds.minimum.z);
+		sceneDepth = std::max(sceneDepth, -(viewState.view * glm::vec4(position, 1.0f)).z);
+	}
+	float nearPlane = viewState.nearPlane;
+	float farPlane = std::ceil(sceneDepth / DEPTH_STEP) * DEPTH_STEP;
+	farPlane = std::max(std::min(farPlane, viewState.farPlane), nearPlane + DEPTH_STEP);
+
+	float splits[MAX_SHADOW_CASCADES];
+	ComputeSplits(nearPlane, farPlane, splits);
+
+	// the light looks down its direction from the origin, the
+	// cascades only move it sideways and along the direction
+	glm::vec3 direction = glm::normalize(lightDirection);
+	glm::vec3 up = (std::fabs(direction.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+	// clip space to texture coordinates and compare depth
+	const glm::mat4 textureBias =
+		glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+
+	SHADOW_DATA_STD140 shadowData = {};
+	shadowData.cascadeCount = m_cascadeCount;
+	shadowData.texelSize = 1.0f / (float)m_mapSize;
+
+	float startDepth = nearPlane;
+	for (int cascade = 0; cascade < m_cascadeCount; ++cascade)
+	{
+		float texelWorldSize = 0.0f;
+		glm::mat4 viewProjection = FitCascade(viewState, lightView, startDepth, splits[cascade], sceneBounds, texelWorldSize);
+		if (viewProjection != m_viewProjections[cascade])
+		{
+			m_viewProjections[cascade] = viewProjection;
+			m_bStaticDirty[cascade] = true;
+		}
+
+		shadowData.cascadeMatrices[cascade] = textureBias * viewProjection;
+		shadowData.cascadeSplits[cascade] = splits[cascade];
+		shadowData.cascadeTexelSizes[cascade] = texelWorldSize;
+		startDepth = splits[cascade];
+	}
+
+	if (memcmp(&shadowData, &m_shadowData, sizeof(shadowData)) != 0)
+	{
+		m_shadowData = shadowData;
+		m_shadowBlock.Update(0, sizeof(m_shadowData), &m_shadowData);
+	}
+}
+
+/***********************************************************
+ *  ComputeSplits()
+ *
+ *  This method is used for placing the far end of every
+ *  cascade between the near and far plane, blending evenly
+ *  spaced splits with logarithmic ones so that the near
+ *  cascades get the detail without the far ones getting
+ *  too long.
+ ***********************************************************/
+void ShadowCascades::ComputeSplits(float nearPlane, float farPlane, float splits[MAX_SHADOW_CASCADES]) const
+{
+	for (int cascade = 0; cascade < m_cascadeCount; ++cascade)
+	{
+		float fraction = (float)(cascade + 1) / (float)m_cascadeCount;
+		float logarithmic = nearPlane * std::pow(farPlane / nearPlane, fraction);
+		float uniform = nearPlane + ((farPlane - nearPlane) * fraction);
+		splits[cascade] = (SPLIT_LAMBDA * logarithmic) + ((1.0f - SPLIT_LAMBDA) * uniform);
+	}
+	splits[m_cascadeCount - 1] = farPlane;
+}
+
+/***********************************************************
+ *  FitCascade()
+ *
+ *  This method is used for building the light projection of
+ *  one cascade.  The corners of the view frustum between
+ *  the two depths are found along the frustum edges, and a
+ *  sphere around them is projected, moved to a whole texel
+ *  of the light's view.  The depth range reaches over the
+ *  whole scene, so casters outside the cascade still shade
+ *  it.
+ ***********************************************************/
+glm::mat4 ShadowCascades::FitCascade(const ViewManager::VIEW_STATE& viewState, const glm::mat4& lightView,
+	float startDepth, float endDepth, const CullingBVH::AABB& sceneBounds, float& texelWorldSize) const
+{
+	glm::mat4 inverseViewProjection = glm::inverse(viewState.projection * viewState.view);
+	float depthRange = viewState.farPlane - viewState.nearPlane;
+	float startFraction = (startDepth - viewState.nearPlane) / depthRange;
+	float endFraction = (endDepth - viewState.nearPlane) / depthRange;
+
+	glm::vec3 corners[8];
+	glm::vec3 center(0.0f);
+	for (int edge = 0; edge < 4; ++edge)
+	{
+		float x = (edge & 1) ? 1.0f : -1.0f;
+		float y = (edge & 2) ? 1.0f : -1.0f;
+		glm::vec4 nearCorner = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+		glm::vec4 farCorner = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+		glm::vec3 nearPoint = glm::vec3(nearCorner) / nearCorner.w;
+		glm::vec3 farPoint = glm::vec3(farCorner) / farCorner.w;
+
+		corners[edge] = glm::mix(nearPoint, farPoint, startFraction);
+		corners[edge + 4] = glm::mix(nearPoint, farPoint, endFraction);
+		center += corners[edge] + corners[edge + 4];
+	}
+	center /= 8.0f;
+
+	float radius = 0.0f;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		radius = std::max(radius, glm::length(corners[corner] - center));
+	}
+	radius = std::ceil(radius * RADIUS_STEPS) / RADIUS_STEPS;
+	texelWorldSize = (2.0f * radius) / (float)m_mapSize;
+
+	glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+	lightCenter.x = std::floor(lightCenter.x / texelWorldSize) * texelWorldSize;
+	lightCenter.y = std::floor(lightCenter.y / texelWorldSize) * texelWorldSize;
+
+	// the light looks down -z, so the nearest caster has the
+	// largest z
+	float minimumZ = FLT_MAX;
+	float maximumZ = -FLT_MAX;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 position(
+			(corner & 1) ? sceneBounds.maximum.x : sceneBounds.minimum.x,
+			(corner & 2) ? sceneBounds.maximum.y : sceneBounds.minimum.y,
+			(corner & 4) ? sceneBounds.maximum.z : sceneBounds.minimum.z);
+		float z = (lightView * glm::vec4(position, 1.0f)).z;
+		minimumZ = std::min(minimumZ, z);
+		maximumZ = std::max(maximumZ, z);
+	}
+	float nearPlane = std::floor(-maximumZ / DEPTH_STEP) * DEPTH_STEP - DEPTH_STEP;
+	float farPlane = std::ceil(-minimumZ / DEPTH_STEP) * DEPTH_STEP + DEPTH_STEP;
+
+	glm::mat4 projection = glm::ortho(
+		lightCenter.x - radius, lightCenter.x + radius,
+		lightCenter.y - radius, lightCenter.y + radius,
+		nearPlane, farPlane);
+
+	return(projection * lightView);
+}
+
+/***********************************************************
+ *  InvalidateStatic()
+ *
+ *  This method is used for marking every cached layer, and
+ *  so every sampled layer, to be drawn again.
+ ***********************************************************/
+void ShadowCascades::InvalidateStatic()
+{
+	for (int i = 0; i < MAX_SHADOW_CASCADES; ++i)
+	{
+		m_bStaticDirty[i] = true;
+		m_bShadowDirty[i] = true;
+	}
+}
+
+/***********************************************************
+ *  InvalidateDynamic()
+ *
+ *  This method is used for marking every sampled layer to
+ *  be copied from its cached layer and have the moving
+ *  casters drawn over it again.
+ ***********************************************************/
+void ShadowCascades::InvalidateDynamic()
+{
+	for (int i = 0; i < MAX_SHADOW_CASCADES; ++i)
+	{
+		m_bShadowDirty[i] = true;
+	}
+}
+
+/***********************************************************
+ *  BeginPass()
+ *
+ *  This method is used for keeping the framebuffers and the
+ *  viewport of the frame before the first cascade is drawn,
+ *  and for setting the caster state the passes share.
+ ***********************************************************/
+void ShadowCascades::BeginPass()
+{
+	if (m_bInPass)
+	{
+		return;
+	}
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousDrawFramebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &m_previousReadFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+	glViewport(0, 0, m_mapSize, m_mapSize);
+	glDepthMask(GL_TRUE);
+	// pushes the caster depth back along its slope, so a lit
+	// surface does not shadow itself
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(CASTER_SLOPE_OFFSET, CASTER_CONSTANT_OFFSET);
+	m_bInPass = true;
+}
+
+/***********************************************************
+ *  BeginStaticPass()
+ *
+ *  This method is used for clearing the cached layer of a
+ *  cascade for its static casters, when its light
+ *  projection or the static casters changed.  The sampled
+ *  layer is then rebuilt from it too.
+ ***********************************************************/
+bool ShadowCascades::BeginStaticPass(int cascade)
+{
+	if ((IsCreated() == false) || (cascade < 0) || (cascade >= m_cascadeCount) ||
+		(m_bStaticDirty[cascade] == false))
+	{
+		return(false);
+	}
+
+	BeginPass();
+	glBindFramebuffer(GL_FRAMEBUFFER, m_staticFramebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_staticTexture, 0, cascade);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	m_bStaticDirty[cascade] = false;
+	m_bShadowDirty[cascade] = true;
+	m_staticLayersDrawn++;
+
+	return(true);
+}
+
+/***********************************************************
+ *  BeginDynamicPass()
+ *
+ *  This method is used for copying the cached layer of a
+ *  cascade into its sampled layer, ready for the moving
+ *  casters to be drawn over it.
+ ***********************************************************/
+bool ShadowCascades::BeginDynamicPass(int cascade)
+{
+	if ((IsCreated() == false) || (cascade < 0) || (cascade >= m_cascadeCount) ||
+		(m_bShadowDirty[cascade] == false))
+	{
+		return(false);
+	}
+
+	BeginPass();
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_staticFramebuffer);
+	glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_staticTexture, 0, cascade);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_shadowFramebuffer);
+	glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_shadowTexture, 0, cascade);
+	glBlitFramebuffer(
+		0, 0, m_mapSize, m_mapSize,
+		0, 0, m_mapSize, m_mapSize,
+		GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	m_bShadowDirty[cascade] = false;
+	m_dynamicLayersDrawn++;
+
+	return(true);
+}
+
+/***********************************************************
+ *  EndPasses()
+ *
+ *  This method is used for putting the framebuffers, the
+ *  viewport and the depth offset back as they were before
+ *  the first pass of the frame.
+ ***********************************************************/
+void ShadowCascades::EndPasses()
+{
+	if (m_bInPass == false)
+	{
+		return;
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)m_previousDrawFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)m_previousReadFramebuffer);
+	glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+	m_bInPass = false;
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding the sampled depth array
+ *  to the shadow texture unit.
+ ***********************************************************/
+void ShadowCascades::BindTexture() const
+{
+	glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadowTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
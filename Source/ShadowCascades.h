@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowcascades.h
+// ============
+// render the depth of the scene from the directional light into a set of
+// cascaded shadow maps that cover successive depth ranges of the view
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderBlocks.h"
+#include "UniformBuffer.h"
+#include "CullingBVH.h"
+#include "ViewManager.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  ShadowCascades
+ *
+ *  This class splits the view between the near plane and
+ *  the far side of the scene into depth ranges, and fits an
+ *  orthographic light projection around each range.  Each
+ *  cascade is one layer of a depth texture array that the
+ *  fragment shader samples with hardware compare.  The
+ *  static shadow casters are drawn into a second array that
+ *  is kept between frames, and only drawn again once the
+ *  cascade's light projection or the static casters change;
+ *  each frame that a moving caster moved, the cached layer
+ *  is copied into the sampled one and the moving casters
+ *  are drawn over it.
+ ***********************************************************/
+class ShadowCascades
+{
+public:
+	// constructor
+	ShadowCascades();
+	// destructor
+	~ShadowCascades();
+
+	// create the depth arrays, framebuffers and ShadowData
+	// block, with square maps of mapSize texels
+	bool Create(int mapSize, int cascadeCount);
+	// free the GPU resources
+	void Destroy();
+	// check whether Create() succeeded
+	bool IsCreated() const { return (0 != m_shadowTexture); }
+	// send the ShadowData updates through an upload ring
+	void SetUploadRing(UploadRing* pUploadRing) { m_shadowBlock.SetUploadRing(pUploadRing); }
+
+	// split the view into cascades and fit the light to each,
+	// the projections are kept while nothing moves
+	void Update(const ViewManager::VIEW_STATE& viewState, glm::vec3 lightDirection, const CullingBVH::AABB& sceneBounds);
+	// the static casters changed, so every cached layer is
+	// drawn again
+	void InvalidateStatic();
+	// a moving caster moved, so every sampled layer is drawn
+	// again over its cached layer
+	void InvalidateDynamic();
+
+	// number of cascades and the light projection of one
+	int CascadeCount() const { return m_cascadeCount; }
+	const glm::mat4& CascadeViewProjection(int cascade) const { return m_viewProjections[cascade]; }
+
+	// start drawing the static casters of a cascade, false
+	// when its cached layer is still up to date
+	bool BeginStaticPass(int cascade);
+	// start drawing the moving casters of a cascade over its
+	// cached layer, false when the sampled layer is up to date
+	bool BeginDynamicPass(int cascade);
+	// put the framebuffer and viewport back after the passes
+	void EndPasses();
+	// bind the sampled array to its texture unit
+	void BindTexture() const;
+
+	// layers drawn by the passes of the last frame
+	int StaticLayersDrawn() const { return m_staticLayersDrawn; }
+	int DynamicLayersDrawn() const { return m_dynamicLayersDrawn; }
+
+private:
+	int m_mapSize;
+	int m_cascadeCount;
+	// sampled depth array, and the array the static casters
+	// are cached in
+	GLuint m_shadowTexture;
+	GLuint m_staticTexture;
+	// framebuffers that a layer of each array is attached to
+	GLuint m_shadowFramebuffer;
+	GLuint m_staticFramebuffer;
+	// light view-projection of each cascade, for the casters
+	glm::mat4 m_viewProjections[MAX_SHADOW_CASCADES];
+	// layers that have to be drawn again
+	bool m_bStaticDirty[MAX_SHADOW_CASCADES];
+	bool m_bShadowDirty[MAX_SHADOW_CASCADES];
+	// cascades in the ShadowData block layout, and its GPU copy
+	SHADOW_DATA_STD140 m_shadowData;
+	UniformBuffer m_shadowBlock;
+	// framebuffers and viewport in use before the passes
+	bool m_bInPass;
+	GLint m_previousDrawFramebuffer;
+	GLint m_previousReadFramebuffer;
+	GLint m_previousViewport[4];
+	// layers drawn so far this frame
+	int m_staticLayersDrawn;
+	int m_dynamicLayersDrawn;
+
+	// view-space depth at which each cascade ends
+	void ComputeSplits(float nearPlane, float farPlane, float splits[MAX_SHADOW_CASCADES]) const;
+	// fit the light projection around one view depth range
+	glm::mat4 FitCascade(const ViewManager::VIEW_STATE& viewState, const glm::mat4& lightView,
+		float startDepth, float endDepth, const CullingBVH::AABB& sceneBounds, float& texelWorldSize) const;
+	// save the framebuffers and viewport before the first pass
+	void BeginPass();
+	// allocate one depth array
+	GLuint CreateDepthArray(bool bCompare) const;
+};
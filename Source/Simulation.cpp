@@ -0,0 +1,435 @@
+///////////////////////////////////////////////////////////////////////////////
+// simulation.cpp
+// ==============
+// This file contains the implementation of the `Simulation` class, which
+// moves the camera and animates the scene in fixed ticks, apart from the
+// frames that draw them.
+//
+// RESPONSIBILITIES:
+// - Step the camera and the mobile at a fixed rate on a thread of its own.
+// - Take the input the main thread gathers from GLFW each frame.
+// - Publish each ticked state to the render thread through a triple buffer.
+// - Blend the last two ticked states to the time of the frame.
+// - Fly a camera path or record one, on a clock of fixed frames if asked.
+//
+// NOTE: The render thread never waits for the simulation - it draws whatever
+// was published last.  A tick only takes a lock to copy the submitted input,
+// which the main thread holds for no longer than the same copy.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Simulation.h"
+
+#include <cmath>
+
+// declaration of the global variables and defines
+namespace
+{
+	// how fast the hanging mobile turns
+	const float g_MobileDegreesPerSecond = 12.0f;
+
+	// range the scroll wheel sets the camera speed in
+	const float g_MinMovementSpeed = 1.0f;
+	const float g_MaxMovementSpeed = 50.0f;
+}
+
+const int Simulation::TICKS_PER_SECOND;
+const int Simulation::MAX_CATCH_UP_TICKS;
+const int Simulation::RECORD_INTERVAL_TICKS;
+
+/***********************************************************
+ *  Simulation()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+Simulation::Simulation()
+{
+	// default camera view parameters
+	m_camera.Position = glm::vec3(0.5f, 5.5f, 10.0f);
+	m_camera.Front = glm::vec3(0.0f, -0.5f, -2.0f);
+	m_camera.Up = glm::vec3(0.0f, 1.0f, 0.0f);
+	m_camera.Zoom = 80;
+	m_camera.MovementSpeed = 10;
+	m_bOrthographic = false;
+	m_mobileDegrees = 0.0f;
+	m_state = CaptureState();
+	m_tick = 0;
+	m_startTime = CLOCK::now();
+	m_pCameraPath = NULL;
+	m_pRecording = NULL;
+	m_fixedFrameSeconds = 0.0;
+	m_sampledFrames = 0;
+
+	m_input.keys = 0;
+	m_input.mouseOffsetX = 0.0f;
+	m_input.mouseOffsetY = 0.0f;
+	m_input.scrollOffset = 0.0f;
+
+	m_bStopping = false;
+	m_bThreaded = false;
+}
+
+/***********************************************************
+ *  ~Simulation()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+Simulation::~Simulation()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for publishing the starting state
+ *  and, when asked to, starting the simulation thread.  The
+ *  ticks are counted from this call.
+ ***********************************************************/
+void Simulation::Start(bool bThreaded)
+{
+	if (m_thread.joinable())
+	{
+		return;
+	}
+
+	m_startTime = CLOCK::now();
+	m_tick = 0;
+	m_sampledFrames = 0;
+	if (NULL != m_pCameraPath)
+	{
+		FollowPath(0);
+	}
+	m_state = CaptureState();
+
+	SNAPSHOT& snapshot = m_snapshots.WriteBuffer();
+	snapshot.previous = m_state;
+	snapshot.current = m_state;
+	snapshot.tick = 0;
+	m_snapshots.Publish();
+
+	m_bThreaded = bThreaded;
+	m_bStopping = false;
+	if (m_bThreaded)
+	{
+		m_thread = std::thread(&Simulation::SimulationMain, this);
+	}
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for waking and joining the
+ *  simulation thread.  The state it reached is kept, so a
+ *  later Start() carries on from it.
+ ***********************************************************/
+void Simulation::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_all();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+/***********************************************************
+ *  SubmitInput()
+ *
+ *  This method is used for handing the simulation the input
+ *  of a frame.  The held keys replace the ones submitted
+ *  before, while the mouse and scroll motion is added to
+ *  any that no tick has used yet, so none of it is lost
+ *  when frames come faster than ticks.
+ ***********************************************************/
+void Simulation::SubmitInput(const INPUT_STATE& input)
+{
+	std::lock_guard<std::mutex> lock(m_inputMutex);
+	m_input.keys = input.keys;
+	m_input.mouseOffsetX += input.mouseOffsetX;
+	m_input.mouseOffsetY += input.mouseOffsetY;
+	m_input.scrollOffset += input.scrollOffset;
+}
+
+/***********************************************************
+ *  Sample()
+ *
+ *  This method is used for getting the state to draw the
+ *  frame with.  The newest snapshot holds the states before
+ *  and after its tick, and the frame is placed between them
+ *  by the time passed since that tick, so it trails the
+ *  simulation by at most one tick.  When the time is
+ *  counted in frames, each call is one frame later.
+ ***********************************************************/
+void Simulation::Sample(STATE& state)
+{
+	if (m_bThreaded == false)
+	{
+		m_sampledFrames++;
+		Advance();
+	}
+
+	m_snapshots.Update();
+	const SNAPSHOT& snapshot = m_snapshots.ReadBuffer();
+
+	double tickSeconds = (double)snapshot.tick / (double)TICKS_PER_SECOND;
+	float fraction = (float)((ElapsedSeconds() - tickSeconds) * TICKS_PER_SECOND);
+	fraction = glm::clamp(fraction, 0.0f, 1.0f);
+
+	state = Interpolate(snapshot.previous, snapshot.current, fraction);
+}
+
+/***********************************************************
+ *  SimulationMain()
+ *
+ *  This method is used for running the simulation thread -
+ *  step the ticks that are due, then sleep until the next
+ *  one is or until the simulation is stopped.
+ ***********************************************************/
+void Simulation::SimulationMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_bStopping == false)
+	{
+		lock.unlock();
+		Advance();
+		lock.lock();
+
+		std::chrono::duration<double> nextTick((double)(m_tick + 1) / (double)TICKS_PER_SECOND);
+		m_wake.wait_until(lock, m_startTime + std::chrono::duration_cast<CLOCK::duration>(nextTick));
+	}
+}
+
+/***********************************************************
+ *  Advance()
+ *
+ *  This method is used for stepping every tick that the
+ *  clock has reached and publishing the states around the
+ *  last one.  The input is taken once for all of them: the
+ *  keys stay held for each tick, and the mouse and scroll
+ *  motion is used by the first.  After a stall longer than
+ *  MAX_CATCH_UP_TICKS the missing time is dropped, so the
+ *  camera does not jump to make up for it.
+ ***********************************************************/
+void Simulation::Advance()
+{
+	long long dueTick = (long long)(ElapsedSeconds() * TICKS_PER_SECOND);
+	if (dueTick <= m_tick)
+	{
+		return;
+	}
+	if (dueTick - m_tick > MAX_CATCH_UP_TICKS)
+	{
+		m_tick = dueTick - MAX_CATCH_UP_TICKS;
+	}
+
+	INPUT_STATE input;
+	{
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		input = m_input;
+		m_input.mouseOffsetX = 0.0f;
+		m_input.mouseOffsetY = 0.0f;
+		m_input.scrollOffset = 0.0f;
+	}
+
+	const float tickSeconds = 1.0f / (float)TICKS_PER_SECOND;
+	STATE previous = m_state;
+	while (m_tick < dueTick)
+	{
+		previous = m_state;
+		Step(input, tickSeconds);
+		input.mouseOffsetX = 0.0f;
+		input.mouseOffsetY = 0.0f;
+		input.scrollOffset = 0.0f;
+		++m_tick;
+	}
+
+	SNAPSHOT& snapshot = m_snapshots.WriteBuffer();
+	snapshot.previous = previous;
+	snapshot.current = m_state;
+	snapshot.tick = m_tick;
+	m_snapshots.Publish();
+}
+
+/***********************************************************
+ *  Step()
+ *
+ *  This method is used for moving the camera by the input
+ *  and turning the mobile, over one tick of the passed in
+ *  length.
+ ***********************************************************/
+void Simulation::Step(const INPUT_STATE& input, float seconds)
+{
+	// a flown path replaces the input, the mobile turns as usual
+	if (NULL != m_pCameraPath)
+	{
+		FollowPath(m_tick + 1);
+		m_mobileDegrees = std::fmod(m_mobileDegrees + g_MobileDegreesPerSecond * seconds, 360.0f);
+		m_state = CaptureState();
+		return;
+	}
+
+	// look around with the mouse
+	if ((0.0f != input.mouseOffsetX) || (0.0f != input.mouseOffsetY))
+	{
+		m_camera.ProcessMouseMovement(input.mouseOffsetX, input.mouseOffsetY);
+	}
+
+	// adjust movement speed by the scroll amount, within a
+	// reasonable range
+	if (0.0f != input.scrollOffset)
+	{
+		m_camera.MovementSpeed = glm::clamp(
+			m_camera.MovementSpeed + input.scrollOffset,
+			g_MinMovementSpeed,
+			g_MaxMovementSpeed);
+	}
+
+	if (0 != (input.keys & KEY_PERSPECTIVE))
+	{
+		// the camera position and orientation are left as they
+		// are, so the user can orbit normally
+		m_bOrthographic = false;
+	}
+	if (0 != (input.keys & KEY_ORTHOGRAPHIC))
+	{
+		m_bOrthographic = true;
+		// snap the camera so it looks directly at the object
+		// with no tilt, facing -Z level with the horizon
+		m_camera.Position = glm::vec3(0.0f, 0.0f, 10.0f);
+		m_camera.Front = glm::normalize(glm::vec3(0.0f, 0.0f, -1.0f));
+		m_camera.Up = glm::vec3(0.0f, 1.0f, 0.0f);
+		m_camera.Yaw = -90.0f;
+		m_camera.Pitch = 0.0f;
+	}
+
+	// move the camera in and out, left and right
+	if (0 != (input.keys & KEY_FORWARD))
+	{
+		m_camera.ProcessKeyboard(FORWARD, seconds);
+	}
+	if (0 != (input.keys & KEY_BACKWARD))
+	{
+		m_camera.ProcessKeyboard(BACKWARD, seconds);
+	}
+	if (0 != (input.keys & KEY_LEFT))
+	{
+		m_camera.ProcessKeyboard(LEFT, seconds);
+	}
+	if (0 != (input.keys & KEY_RIGHT))
+	{
+		m_camera.ProcessKeyboard(RIGHT, seconds);
+	}
+	// move the camera up and down along its Up vector
+	if (0 != (input.keys & KEY_UP))
+	{
+		m_camera.Position += m_camera.Up * m_camera.MovementSpeed * seconds;
+	}
+	if (0 != (input.keys & KEY_DOWN))
+	{
+		m_camera.Position -= m_camera.Up * m_camera.MovementSpeed * seconds;
+	}
+
+	// turn the mobile, kept within one revolution
+	m_mobileDegrees = std::fmod(m_mobileDegrees + g_MobileDegreesPerSecond * seconds, 360.0f);
+
+	// keep every few ticks of the flight as a path key
+	if ((NULL != m_pRecording) && (0 == (m_tick % RECORD_INTERVAL_TICKS)))
+	{
+		m_pRecording->AddKey(
+			(float)((double)m_tick / (double)TICKS_PER_SECOND),
+			m_camera.Position,
+			m_camera.Position + m_camera.Front);
+	}
+
+	m_state = CaptureState();
+}
+
+/***********************************************************
+ *  FollowPath()
+ *
+ *  This method is used for placing the camera where the
+ *  path is at the time of a tick.  The time wraps at the
+ *  end of the path, so a run longer than the path flies it
+ *  again, and the camera stays in perspective.
+ ***********************************************************/
+void Simulation::FollowPath(long long tick)
+{
+	double seconds = (double)tick / (double)TICKS_PER_SECOND;
+	double duration = m_pCameraPath->Duration();
+	if (duration > 0.0)
+	{
+		seconds = std::fmod(seconds, duration);
+	}
+
+	glm::vec3 front = m_camera.Front;
+	m_pCameraPath->Evaluate((float)seconds, m_camera.Position, front);
+	m_camera.Front = front;
+	m_camera.Up = glm::vec3(0.0f, 1.0f, 0.0f);
+	m_bOrthographic = false;
+}
+
+/***********************************************************
+ *  CaptureState()
+ *
+ *  This method is used for copying the camera and mobile
+ *  into the state that is published.
+ ***********************************************************/
+Simulation::STATE Simulation::CaptureState() const
+{
+	STATE state;
+	state.camera.position = m_camera.Position;
+	state.camera.front = m_camera.Front;
+	state.camera.up = m_camera.Up;
+	state.camera.zoom = m_camera.Zoom;
+	state.camera.bOrthographic = m_bOrthographic;
+	state.mobileDegrees = m_mobileDegrees;
+	return(state);
+}
+
+/***********************************************************
+ *  ElapsedSeconds()
+ *
+ *  This method is used for getting the time since Start()
+ *  on the clock the ticks are counted with, or in sampled
+ *  frames of a fixed length.
+ ***********************************************************/
+double Simulation::ElapsedSeconds() const
+{
+	if ((m_fixedFrameSeconds > 0.0) && (m_bThreaded == false))
+	{
+		return((double)m_sampledFrames * m_fixedFrameSeconds);
+	}
+
+	std::chrono::duration<double> elapsed = CLOCK::now() - m_startTime;
+	return(elapsed.count());
+}
+
+/***********************************************************
+ *  Interpolate()
+ *
+ *  This method is used for blending two ticked states.  The
+ *  directions are blended and renormalized, which is close
+ *  enough to a rotation over the small turn of one tick, the
+ *  mobile takes the short way across a full revolution, and
+ *  the projection switches with the newer state.
+ ***********************************************************/
+Simulation::STATE Simulation::Interpolate(const STATE& previous, const STATE& current, float fraction)
+{
+	STATE state;
+	state.camera.position = glm::mix(previous.camera.position, current.camera.position, fraction);
+	state.camera.front = glm::normalize(glm::mix(previous.camera.front, current.camera.front, fraction));
+	state.camera.up = glm::normalize(glm::mix(previous.camera.up, current.camera.up, fraction));
+	state.camera.zoom = glm::mix(previous.camera.zoom, current.camera.zoom, fraction);
+	state.camera.bOrthographic = current.camera.bOrthographic;
+
+	float mobileTurn = current.mobileDegrees - previous.mobileDegrees;
+	if (mobileTurn < -180.0f)
+	{
+		mobileTurn += 360.0f;
+	}
+	state.mobileDegrees = previous.mobileDegrees + mobileTurn * fraction;
+	return(state);
+}
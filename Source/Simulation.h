@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+// simulation.h
+// ============
+// step the camera and the scene animation at a fixed rate on a thread of
+// their own, and hand the renderer their state interpolated to the frame
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TripleBuffer.h"
+#include "CameraPath.h"
+#include "camera.h"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/***********************************************************
+ *  Simulation
+ *
+ *  This class owns the camera and the mobile's angle and
+ *  advances them in fixed ticks of 1/TICKS_PER_SECOND
+ *  seconds, so movement no longer depends on how long a
+ *  frame took.  The main thread gathers the keys and mouse
+ *  motion, since GLFW only reports them there, and submits
+ *  them once a frame; each tick uses the latest submitted
+ *  input.  After its ticks the simulation publishes the
+ *  state before and after the last one through a triple
+ *  buffer, and the render thread blends between the two by
+ *  how far the frame is past that tick - it shows the scene
+ *  one tick late, in exchange for motion that stays smooth
+ *  at any frame rate.  Without the thread the ticks that
+ *  are due are stepped on the render thread when it samples.
+ *  For repeatable runs the camera can follow a CameraPath
+ *  instead of the input, and the unthreaded simulation can
+ *  count its time in whole frames of a fixed length rather
+ *  than on the clock, so every run shows the same frames.
+ ***********************************************************/
+class Simulation
+{
+public:
+	// keys the simulation reacts to, as bits of INPUT_STATE
+	enum INPUT_KEY
+	{
+		KEY_FORWARD = 1,
+		KEY_BACKWARD = 2,
+		KEY_LEFT = 4,
+		KEY_RIGHT = 8,
+		KEY_UP = 16,
+		KEY_DOWN = 32,
+		KEY_ORTHOGRAPHIC = 64,
+		KEY_PERSPECTIVE = 128
+	};
+
+	// input gathered by the main thread for one submit
+	struct INPUT_STATE
+	{
+		// INPUT_KEY bits of the keys held down
+		unsigned int keys;
+		// mouse and scroll wheel motion since the last submit
+		float mouseOffsetX;
+		float mouseOffsetY;
+		float scrollOffset;
+	};
+
+	// camera placement the view is built from
+	struct CAMERA_STATE
+	{
+		glm::vec3 position;
+		glm::vec3 front;
+		glm::vec3 up;
+		// vertical field of view in degrees
+		float zoom;
+		bool bOrthographic;
+	};
+
+	// everything the renderer takes from a tick
+	struct STATE
+	{
+		CAMERA_STATE camera;
+		// turn of the mobile around its hanging point, in degrees
+		float mobileDegrees;
+	};
+
+	// fixed rate the simulation is stepped at
+	static const int TICKS_PER_SECOND = 120;
+	// most ticks stepped at once after a stall, the rest of the
+	// stalled time is skipped
+	static const int MAX_CATCH_UP_TICKS = 8;
+	// ticks between the keys of a recorded camera path
+	static const int RECORD_INTERVAL_TICKS = 12;
+
+	// constructor
+	Simulation();
+	// destructor
+	~Simulation();
+
+	// start ticking from the current state, on a thread of its
+	// own or on the caller's thread when it samples
+	void Start(bool bThreaded);
+	// stop and join the simulation thread
+	void Stop();
+	// check whether the ticks run on the simulation thread
+	bool IsThreaded() const { return m_bThreaded; }
+
+	// fly the camera along a path instead of steering it by
+	// the input, looping at its end, NULL to hand it back to
+	// the input; call before Start()
+	void SetCameraPath(const CameraPath* pPath) { m_pCameraPath = pPath; }
+	// add a key of the camera to the passed in path every few
+	// ticks, NULL to stop; the path may be read once the
+	// simulation is stopped
+	void SetRecording(CameraPath* pRecording) { m_pRecording = pRecording; }
+	// advance the unthreaded simulation by the passed in
+	// seconds at every Sample() instead of by the clock, 0 to
+	// use the clock again; call before Start()
+	void SetFixedFrameTime(double seconds) { m_fixedFrameSeconds = seconds; }
+
+	// hand over the input gathered since the last submit, the
+	// mouse and scroll motion adds up until a tick uses it
+	void SubmitInput(const INPUT_STATE& input);
+	// get the simulated state at the current time, between
+	// the last two ticks
+	void Sample(STATE& state);
+
+private:
+	typedef std::chrono::steady_clock CLOCK;
+
+	// what a tick publishes - the states before and after it
+	struct SNAPSHOT
+	{
+		STATE previous;
+		STATE current;
+		// ticks stepped when current was reached
+		long long tick;
+	};
+
+	// state stepped by the ticks, only touched by the thread
+	// that runs them
+	Camera m_camera;
+	bool m_bOrthographic;
+	float m_mobileDegrees;
+	STATE m_state;
+	long long m_tick;
+	// time the ticks are counted from
+	CLOCK::time_point m_startTime;
+	// path flown instead of the input, and the path that the
+	// camera is recorded into, or NULL
+	const CameraPath* m_pCameraPath;
+	CameraPath* m_pRecording;
+	// length of a sampled frame when the time is counted in
+	// frames, or 0, and the frames sampled since Start()
+	double m_fixedFrameSeconds;
+	long long m_sampledFrames;
+
+	// input not used by a tick yet, guarded by m_inputMutex
+	INPUT_STATE m_input;
+	std::mutex m_inputMutex;
+	// ticked states on their way to the render thread
+	TripleBuffer<SNAPSHOT> m_snapshots;
+
+	// simulation thread, woken early when it is stopped
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_bStopping;
+	bool m_bThreaded;
+
+	// simulation thread loop
+	void SimulationMain();
+	// step every tick that is due and publish the result
+	void Advance();
+	// move the camera and the mobile on by one tick
+	void Step(const INPUT_STATE& input, float seconds);
+	// place the camera on the path at the time of a tick
+	void FollowPath(long long tick);
+	// copy the stepped values into a STATE
+	STATE CaptureState() const;
+	// seconds since Start()
+	double ElapsedSeconds() const;
+	// blend two states, fraction 0 gives the first
+	static STATE Interpolate(const STATE& previous, const STATE& current, float fraction);
+};
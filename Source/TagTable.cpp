@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// tagtable.cpp
+// ============
+// This file contains the implementation of the `TagTable` class, which maps
+// texture and material tags to integer IDs.
+//
+// RESPONSIBILITIES:
+// - Hand out one stable ID per distinct tag string.
+// - Look up tags without adding them, for reporting unknown ones.
+//
+// NOTE: IDs are never reused or removed, so they stay valid for as long as
+// the scene that interned them.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TagTable.h"
+
+const int TagTable::INVALID_TAG;
+
+/***********************************************************
+ *  Intern()
+ *
+ *  This method is used for getting the ID of the passed in
+ *  tag, giving it the next free ID the first time it is
+ *  seen.
+ ***********************************************************/
+int TagTable::Intern(const std::string& tag)
+{
+	std::unordered_map<std::string, int>::const_iterator found = m_ids.find(tag);
+	if (found != m_ids.end())
+	{
+		return(found->second);
+	}
+
+	int tagID = (int)m_names.size();
+	m_names.push_back(tag);
+	m_ids[tag] = tagID;
+
+	return(tagID);
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method is used for getting the ID of a tag that was
+ *  interned before, without adding it.
+ ***********************************************************/
+int TagTable::Find(const std::string& tag) const
+{
+	std::unordered_map<std::string, int>::const_iterator found = m_ids.find(tag);
+	if (found == m_ids.end())
+	{
+		return(INVALID_TAG);
+	}
+
+	return(found->second);
+}
@@ -0,0 +1,42 @@
+///////////////////////////////////////////////////////////////////////////////
+// tagtable.h
+// ============
+// intern the string tags that name scene textures and materials into compact
+// integer IDs, so they are hashed once while the scene is built
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  TagTable
+ *
+ *  This class gives every distinct tag string a small ID,
+ *  handed out in order from 0.  The IDs can index plain
+ *  vectors, so a tag is resolved with one hash lookup when
+ *  it is interned and by array access afterwards.
+ ***********************************************************/
+class TagTable
+{
+public:
+	// ID returned for a tag that is not in the table
+	static const int INVALID_TAG = -1;
+
+	// get the ID of a tag, adding the tag when it is new
+	int Intern(const std::string& tag);
+	// get the ID of a tag, or INVALID_TAG when it is not known
+	int Find(const std::string& tag) const;
+	// get the string of an interned tag
+	const std::string& Name(int tagID) const { return m_names[tagID]; }
+	// number of interned tags
+	int Count() const { return (int)m_names.size(); }
+
+private:
+	// tag string to ID table
+	std::unordered_map<std::string, int> m_ids;
+	// tag strings by ID
+	std::vector<std::string> m_names;
+};
@@ -0,0 +1,450 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecooker.cpp
+// =================
+// This file contains the implementation of the `TextureCooker` class, which
+// writes the cooked texture files read by `CookedTexture`.
+//
+// RESPONSIBILITIES:
+// - Decode a source image and build every mip level on the CPU.
+// - Compress each level to BC1 or BC3 blocks.
+// - Write the header, level table and blocks as one .ctex file.
+//
+// NOTE: The encoder fits each block's end points to the corners of its color
+// bounding box along the main diagonal - fast and close to what a real-time
+// encoder does, not a high quality offline search.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCooker.h"
+#include "CookedTexture.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Namespace for the block encoding helpers
+namespace
+{
+	/***********************************************************
+	 *  To565()
+	 *
+	 *  This function is used for rounding an 8-bit color to
+	 *  the 5:6:5 format of the block end points.
+	 ***********************************************************/
+	uint16_t To565(const int color[3])
+	{
+		int red = (color[0] * 31 + 127) / 255;
+		int green = (color[1] * 63 + 127) / 255;
+		int blue = (color[2] * 31 + 127) / 255;
+		return((uint16_t)((red << 11) | (green << 5) | blue));
+	}
+
+	/***********************************************************
+	 *  From565()
+	 *
+	 *  This function is used for expanding a 5:6:5 color back
+	 *  to 8 bits per channel the way the GPU does.
+	 ***********************************************************/
+	void From565(uint16_t packed, int color[3])
+	{
+		int red = (packed >> 11) & 31;
+		int green = (packed >> 5) & 63;
+		int blue = packed & 31;
+		color[0] = (red << 3) | (red >> 2);
+		color[1] = (green << 2) | (green >> 4);
+		color[2] = (blue << 3) | (blue >> 2);
+	}
+
+	/***********************************************************
+	 *  WriteLittleEndian()
+	 *
+	 *  This function is used for storing the low bytes of a
+	 *  value in little endian order.
+	 ***********************************************************/
+	void WriteLittleEndian(unsigned char* output, uint64_t value, int byteCount)
+	{
+		for (int i = 0; i < byteCount; ++i)
+		{
+			output[i] = (unsigned char)((value >> (i * 8)) & 0xFF);
+		}
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for cooking every passed in image.
+ *  EXIT_FAILURE is returned when any of them failed.
+ ***********************************************************/
+int TextureCooker::Run(const std::vector<std::string>& sourcePaths)
+{
+	int failures = 0;
+
+	if (sourcePaths.empty())
+	{
+		std::cout << "Usage: --cook-textures <image> [<image> ...]" << std::endl;
+		return(EXIT_FAILURE);
+	}
+
+	// flip like the runtime loader, so cooked and decoded
+	// textures have the same orientation
+	stbi_set_flip_vertically_on_load(true);
+
+	for (size_t i = 0; i < sourcePaths.size(); ++i)
+	{
+		if (CookFile(sourcePaths[i]) == false)
+		{
+			failures++;
+		}
+	}
+
+	std::cout << "Cooked " << (sourcePaths.size() - failures) << " of " << sourcePaths.size() << " textures" << std::endl;
+	return((failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/***********************************************************
+ *  CookFile()
+ *
+ *  This method is used for cooking one image into the
+ *  .ctex file next to it.
+ ***********************************************************/
+bool TextureCooker::CookFile(const std::string& sourcePath)
+{
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+
+	unsigned char* image = stbi_load(sourcePath.c_str(), &width, &height, &colorChannels, 4);
+	if (NULL == image)
+	{
+		std::cout << "Could not load image:" << sourcePath << std::endl;
+		return(false);
+	}
+
+	std::vector<unsigned char> pixels(image, image + (size_t)width * height * 4);
+	stbi_image_free(image);
+
+	// BC3 only pays off when some pixel is not opaque
+	bool bAlpha = false;
+	for (size_t i = 3; (i < pixels.size()) && (bAlpha == false); i += 4)
+	{
+		bAlpha = (pixels[i] < 255);
+	}
+	uint32_t format = bAlpha ? CookedTexture::COOKED_FORMAT_BC3 : CookedTexture::COOKED_FORMAT_BC1;
+
+	uint32_t mipCount = 1;
+	while ((mipCount < CookedTexture::MAX_MIP_LEVELS) &&
+		(((width >> mipCount) > 0) || ((height >> mipCount) > 0)))
+	{
+		mipCount++;
+	}
+
+	CookedTexture::COOKED_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "CTEX", 4);
+	header.version = CookedTexture::FILE_VERSION;
+	header.format = format;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.mipCount = mipCount;
+
+	std::vector<CookedTexture::COOKED_LEVEL> levels(mipCount);
+	std::vector<unsigned char> blocks;
+	std::vector<unsigned char> levelBlocks;
+	std::vector<unsigned char> nextPixels;
+	uint32_t offset = (uint32_t)(sizeof(header) + mipCount * sizeof(CookedTexture::COOKED_LEVEL));
+	int levelWidth = width;
+	int levelHeight = height;
+	size_t uncompressedBytes = 0;
+
+	for (uint32_t level = 0; level < mipCount; ++level)
+	{
+		EncodeLevel(pixels, levelWidth, levelHeight, bAlpha, levelBlocks);
+
+		levels[level].width = (uint32_t)levelWidth;
+		levels[level].height = (uint32_t)levelHeight;
+		levels[level].offset = offset + (uint32_t)blocks.size();
+		levels[level].size = (uint32_t)levelBlocks.size();
+		blocks.insert(blocks.end(), levelBlocks.begin(), levelBlocks.end());
+		uncompressedBytes += (size_t)levelWidth * levelHeight * 4;
+
+		if (level + 1 < mipCount)
+		{
+			Downsample(pixels, levelWidth, levelHeight, nextPixels);
+			pixels.swap(nextPixels);
+			levelWidth = std::max(levelWidth / 2, 1);
+			levelHeight = std::max(levelHeight / 2, 1);
+		}
+	}
+
+	std::string cookedPath = CookedTexture::CookedPath(sourcePath);
+	// written beside the cooked file and moved over it once
+	// complete, for a running application that watches it
+	std::string writePath = cookedPath + ".tmp";
+	std::ofstream file(writePath.c_str(), std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cout << "Could not write cooked texture:" << cookedPath << std::endl;
+		return(false);
+	}
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)levels.data(), levels.size() * sizeof(CookedTexture::COOKED_LEVEL));
+	file.write((const char*)blocks.data(), blocks.size());
+	file.close();
+	if (file.fail() || (MappedFile::MoveOver(writePath.c_str(), cookedPath.c_str()) == false))
+	{
+		std::cout << "Could not write cooked texture:" << cookedPath << std::endl;
+		remove(writePath.c_str());
+		return(false);
+	}
+
+	std::cout << "Cooked " << sourcePath << " -> " << cookedPath
+		<< " (" << (bAlpha ? "BC3" : "BC1") << ", " << width << "x" << height
+		<< ", " << mipCount << " mips, " << (blocks.size() / 1024) << " KB, "
+		<< (uncompressedBytes / 1024) << " KB as RGBA8)" << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Downsample()
+ *
+ *  This method is used for building the next mip level.
+ *  Odd sizes repeat the last row or column, matching the
+ *  size rule of OpenGL mip chains.
+ ***********************************************************/
+void TextureCooker::Downsample(
+	const std::vector<unsigned char>& source,
+	int width,
+	int height,
+	std::vector<unsigned char>& output)
+{
+	int outputWidth = std::max(width / 2, 1);
+	int outputHeight = std::max(height / 2, 1);
+
+	output.resize((size_t)outputWidth * outputHeight * 4);
+
+	for (int y = 0; y < outputHeight; ++y)
+	{
+		int y0 = std::min(y * 2, height - 1);
+		int y1 = std::min(y * 2 + 1, height - 1);
+
+		for (int x = 0; x < outputWidth; ++x)
+		{
+			int x0 = std::min(x * 2, width - 1);
+			int x1 = std::min(x * 2 + 1, width - 1);
+
+			for (int channel = 0; channel < 4; ++channel)
+			{
+				int sum = source[((size_t)y0 * width + x0) * 4 + channel] +
+					source[((size_t)y0 * width + x1) * 4 + channel] +
+					source[((size_t)y1 * width + x0) * 4 + channel] +
+					source[((size_t)y1 * width + x1) * 4 + channel];
+				output[((size_t)y * outputWidth + x) * 4 + channel] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  EncodeLevel()
+ *
+ *  This method is used for compressing a level block by
+ *  block, in rows from the first pixel row.  Blocks over
+ *  the edge repeat the edge pixels.
+ ***********************************************************/
+void TextureCooker::EncodeLevel(
+	const std::vector<unsigned char>& pixels,
+	int width,
+	int height,
+	bool bAlpha,
+	std::vector<unsigned char>& output)
+{
+	int blocksWide = (width + 3) / 4;
+	int blocksHigh = (height + 3) / 4;
+	size_t blockBytes = bAlpha ? 16 : 8;
+	BLOCK_PIXELS block;
+
+	output.resize((size_t)blocksWide * blocksHigh * blockBytes);
+
+	for (int blockY = 0; blockY < blocksHigh; ++blockY)
+	{
+		for (int blockX = 0; blockX < blocksWide; ++blockX)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				int x = std::min(blockX * 4 + (i % 4), width - 1);
+				int y = std::min(blockY * 4 + (i / 4), height - 1);
+				memcpy(block[i], &pixels[((size_t)y * width + x) * 4], 4);
+			}
+
+			unsigned char* pOutput = &output[((size_t)blockY * blocksWide + blockX) * blockBytes];
+			if (bAlpha)
+			{
+				EncodeAlphaBlock(block, pOutput);
+				EncodeColorBlock(block, pOutput + 8);
+			}
+			else
+			{
+				EncodeColorBlock(block, pOutput);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  EncodeColorBlock()
+ *
+ *  This method is used for compressing the colors of a
+ *  block to two 5:6:5 end points and a 2-bit index per
+ *  pixel.  The end points are the bounding box corners on
+ *  the diagonal the colors spread along, pulled in by a
+ *  sixteenth so they sit on the colors rather than beyond.
+ *  The first end point is stored larger, which selects the
+ *  four color mode.
+ ***********************************************************/
+void TextureCooker::EncodeColorBlock(const BLOCK_PIXELS& pixels, unsigned char output[8])
+{
+	int minimum[3] = { 255, 255, 255 };
+	int maximum[3] = { 0, 0, 0 };
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int channel = 0; channel < 3; ++channel)
+		{
+			minimum[channel] = std::min(minimum[channel], (int)pixels[i][channel]);
+			maximum[channel] = std::max(maximum[channel], (int)pixels[i][channel]);
+			mean[channel] += pixels[i][channel] / 16.0f;
+		}
+	}
+
+	// green and blue are flipped when they fall while red
+	// rises, so the end points follow the spread of colors
+	float covarianceGreen = 0.0f;
+	float covarianceBlue = 0.0f;
+	for (int i = 0; i < 16; ++i)
+	{
+		float red = pixels[i][0] - mean[0];
+		covarianceGreen += red * (pixels[i][1] - mean[1]);
+		covarianceBlue += red * (pixels[i][2] - mean[2]);
+	}
+
+	int start[3] = { maximum[0], maximum[1], maximum[2] };
+	int end[3] = { minimum[0], minimum[1], minimum[2] };
+	if (covarianceGreen < 0.0f)
+	{
+		std::swap(start[1], end[1]);
+	}
+	if (covarianceBlue < 0.0f)
+	{
+		std::swap(start[2], end[2]);
+	}
+	for (int channel = 0; channel < 3; ++channel)
+	{
+		int inset = (start[channel] - end[channel]) / 16;
+		start[channel] -= inset;
+		end[channel] += inset;
+	}
+
+	uint16_t color0 = To565(start);
+	uint16_t color1 = To565(end);
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		From565(color0, palette[0]);
+		From565(color1, palette[1]);
+		for (int channel = 0; channel < 3; ++channel)
+		{
+			palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+			palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+		}
+
+		for (int i = 0; i < 16; ++i)
+		{
+			int bestIndex = 0;
+			int bestDistance = 0x7FFFFFFF;
+			for (int index = 0; index < 4; ++index)
+			{
+				int distance = 0;
+				for (int channel = 0; channel < 3; ++channel)
+				{
+					int difference = pixels[i][channel] - palette[index][channel];
+					distance += difference * difference;
+				}
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = index;
+				}
+			}
+			indices |= (uint32_t)bestIndex << (i * 2);
+		}
+	}
+
+	WriteLittleEndian(output, color0, 2);
+	WriteLittleEndian(output + 2, color1, 2);
+	WriteLittleEndian(output + 4, indices, 4);
+}
+
+/***********************************************************
+ *  EncodeAlphaBlock()
+ *
+ *  This method is used for compressing the alpha of a block
+ *  to the largest and smallest value and a 3-bit index per
+ *  pixel into the eight values between them.
+ ***********************************************************/
+void TextureCooker::EncodeAlphaBlock(const BLOCK_PIXELS& pixels, unsigned char output[8])
+{
+	int alpha0 = 0;
+	int alpha1 = 255;
+
+	for (int i = 0; i < 16; ++i)
+	{
+		alpha0 = std::max(alpha0, (int)pixels[i][3]);
+		alpha1 = std::min(alpha1, (int)pixels[i][3]);
+	}
+
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		// alpha0 > alpha1 selects the eight value mode
+		int palette[8];
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		for (int step = 1; step < 7; ++step)
+		{
+			palette[step + 1] = ((7 - step) * alpha0 + step * alpha1) / 7;
+		}
+
+		for (int i = 0; i < 16; ++i)
+		{
+			int bestIndex = 0;
+			int bestDistance = 256;
+			for (int index = 0; index < 8; ++index)
+			{
+				int distance = std::abs(pixels[i][3] - palette[index]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = index;
+				}
+			}
+			indices |= (uint64_t)bestIndex << (i * 3);
+		}
+	}
+
+	output[0] = (unsigned char)alpha0;
+	output[1] = (unsigned char)alpha1;
+	WriteLittleEndian(output + 2, indices, 6);
+}
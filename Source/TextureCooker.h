@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecooker.h
+// ============
+// offline tool that turns texture images into cooked .ctex files with a
+// block compressed, fully built mip chain
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCooker
+ *
+ *  This class runs the texture cooking started by the
+ *  --cook-textures command line option.  Each image is
+ *  decoded once, its mip chain is built with a box filter,
+ *  and every level is compressed to BC1, or to BC3 when the
+ *  image has any transparent pixel.  No window or GL
+ *  context is needed.
+ ***********************************************************/
+class TextureCooker
+{
+public:
+	// cook every passed in image next to its source file
+	static int Run(const std::vector<std::string>& sourcePaths);
+	// cook one image, false when it cannot be read or written
+	static bool CookFile(const std::string& sourcePath);
+
+private:
+	// one 4x4 block of RGBA pixels
+	typedef unsigned char BLOCK_PIXELS[16][4];
+
+	// halve an RGBA image, averaging each 2x2 group of pixels
+	static void Downsample(
+		const std::vector<unsigned char>& source,
+		int width,
+		int height,
+		std::vector<unsigned char>& output);
+	// compress a whole RGBA level into its blocks
+	static void EncodeLevel(
+		const std::vector<unsigned char>& pixels,
+		int width,
+		int height,
+		bool bAlpha,
+		std::vector<unsigned char>& output);
+	// compress the color part shared by BC1 and BC3
+	static void EncodeColorBlock(const BLOCK_PIXELS& pixels, unsigned char output[8]);
+	// compress the alpha part of BC3
+	static void EncodeAlphaBlock(const BLOCK_PIXELS& pixels, unsigned char output[8]);
+};
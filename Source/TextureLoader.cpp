@@ -0,0 +1,445 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.cpp
+// =================
+// This file contains the implementation of the `TextureLoader` class, which
+// loads texture images in the background.
+//
+// RESPONSIBILITIES:
+// - Hand out usable placeholder textures as soon as they are requested.
+// - Map cooked .ctex files, or decode JPEG/PNG files, on worker threads.
+// - Stream the decoded pixels into GPU memory through pixel buffer objects,
+//   and cooked mip chains straight from their mapping, within a per-frame
+//   upload budget.
+//
+// NOTE: Every OpenGL call happens on the thread that calls Request() and
+// ProcessUploads(); the workers only touch files and memory.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// Namespace for the loader limits
+namespace
+{
+	// decoded images that can wait for the GL thread at once
+	const size_t DECODED_QUEUE_CAPACITY = 64;
+	// most worker threads, one core is left for the GL thread
+	const unsigned int MAX_TEXTURE_WORKERS = 8;
+	// bytes uploaded per frame before the rest waits for the
+	// next frame, so a burst of finished images does not hitch
+	const size_t MAX_UPLOAD_BYTES_PER_FRAME = 16 * 1024 * 1024;
+	// color of the 1x1 placeholder texture
+	const unsigned char PLACEHOLDER_PIXEL[4] = { 128, 128, 128, 255 };
+}
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader() :
+	m_decoded(DECODED_QUEUE_CAPACITY)
+{
+	m_bStopping = false;
+	m_bUseCookedTextures = false;
+	m_bStreamCookedTextures = false;
+	m_pendingCount = 0;
+	m_pixelBuffers[0] = 0;
+	m_pixelBuffers[1] = 0;
+	m_nextPixelBuffer = 0;
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+	Stop();
+
+	if (m_pixelBuffers[0] != 0)
+	{
+		glDeleteBuffers(2, m_pixelBuffers);
+	}
+}
+
+/***********************************************************
+ *  Request()
+ *
+ *  This method is used for creating a texture with the same
+ *  wrapping and filtering as the scene textures and a 1x1
+ *  placeholder image, then queueing the image file for the
+ *  workers.  The returned texture can be used immediately.
+ ***********************************************************/
+GLuint TextureLoader::Request(const char* filename)
+{
+	GLuint textureID = 0;
+	GLint previousTexture = 0;
+
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_PIXEL);
+	glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+
+	if (m_workers.empty())
+	{
+		// the flip setting is global in stb_image, so it is set
+		// once here before any worker starts decoding
+		stbi_set_flip_vertically_on_load(true);
+		StartWorkers();
+	}
+
+	LOAD_REQUEST* pRequest = new LOAD_REQUEST();
+	pRequest->filename = filename;
+	pRequest->textureID = textureID;
+	{
+		std::lock_guard<std::mutex> lock(m_requestMutex);
+		m_requests.push_back(pRequest);
+	}
+	m_requestReady.notify_one();
+	m_pendingCount++;
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  ProcessUploads()
+ *
+ *  This method is used for uploading the images that the
+ *  workers have finished, until the frame's upload budget
+ *  is used up.  Each texture that received its image is
+ *  added to the first list.  When cooked files are streamed
+ *  they are added to the second list, still mapped, and the
+ *  caller owns them from then on.
+ ***********************************************************/
+int TextureLoader::ProcessUploads(std::vector<GLuint>& finishedTextures, std::vector<COOKED_IMAGE>& cookedImages)
+{
+	size_t uploadedBytes = 0;
+	int finished = 0;
+	DECODED_IMAGE image;
+
+	while ((uploadedBytes < MAX_UPLOAD_BYTES_PER_FRAME) && m_decoded.Pop(image))
+	{
+		bool bUploaded = false;
+		if ((NULL != image.pCooked) && m_bStreamCookedTextures)
+		{
+			COOKED_IMAGE cooked;
+			cooked.textureID = image.pRequest->textureID;
+			cooked.pCooked = image.pCooked;
+			cookedImages.push_back(cooked);
+			image.pCooked = NULL;
+		}
+		else if (NULL != image.pCooked)
+		{
+			uploadedBytes += image.pCooked->DataSize();
+			bUploaded = UploadCooked(image);
+		}
+		else
+		{
+			uploadedBytes += (size_t)image.width * image.height * image.colorChannels;
+			bUploaded = Upload(image);
+		}
+		if (bUploaded)
+		{
+			finishedTextures.push_back(image.pRequest->textureID);
+		}
+		Release(image);
+		m_pendingCount--;
+		finished++;
+	}
+
+	return(finished);
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for blocking until every requested
+ *  texture holds its real image.
+ ***********************************************************/
+void TextureLoader::Finish(std::vector<GLuint>& finishedTextures, std::vector<COOKED_IMAGE>& cookedImages)
+{
+	while (m_pendingCount > 0)
+	{
+		if (ProcessUploads(finishedTextures, cookedImages) == 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for joining the worker threads.  The
+ *  textures that were not uploaded keep their placeholder.
+ ***********************************************************/
+void TextureLoader::Stop()
+{
+	{
+		// set under the lock so no worker misses the wake up
+		std::lock_guard<std::mutex> lock(m_requestMutex);
+		m_bStopping = true;
+	}
+	m_requestReady.notify_all();
+	for (size_t i = 0; i < m_workers.size(); ++i)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	for (size_t i = 0; i < m_requests.size(); ++i)
+	{
+		delete m_requests[i];
+	}
+	m_requests.clear();
+
+	DECODED_IMAGE image;
+	while (m_decoded.Pop(image))
+	{
+		Release(image);
+	}
+
+	m_pendingCount = 0;
+	m_bStopping = false;
+}
+
+/***********************************************************
+ *  StartWorkers()
+ *
+ *  This method is used for starting one worker per core,
+ *  leaving one core for the GL thread.
+ ***********************************************************/
+void TextureLoader::StartWorkers()
+{
+	// the workers read this without a lock, so it is set
+	// before they start and never changes afterwards
+	m_bUseCookedTextures = CookedTexture::IsSupported();
+
+	unsigned int cores = std::thread::hardware_concurrency();
+	unsigned int workerCount = std::min(std::max(cores, 2u) - 1, MAX_TEXTURE_WORKERS);
+
+	for (unsigned int i = 0; i < workerCount; ++i)
+	{
+		m_workers.push_back(std::thread(&TextureLoader::WorkerMain, this));
+	}
+}
+
+/***********************************************************
+ *  WorkerMain()
+ *
+ *  This method is used for running a worker - wait for a
+ *  request, map its cooked file or decode the image file,
+ *  and push the result for the GL thread.  A failed decode
+ *  is pushed too, with no pixels, so the GL thread can
+ *  report it.
+ ***********************************************************/
+void TextureLoader::WorkerMain()
+{
+	for (;;)
+	{
+		LOAD_REQUEST* pRequest = NULL;
+		{
+			std::unique_lock<std::mutex> lock(m_requestMutex);
+			m_requestReady.wait(lock, [this]() { return m_bStopping || !m_requests.empty(); });
+			if (m_bStopping)
+			{
+				return;
+			}
+			pRequest = m_requests.front();
+			m_requests.pop_front();
+		}
+
+		DECODED_IMAGE image;
+		image.pRequest = pRequest;
+		image.pCooked = NULL;
+		image.pixels = NULL;
+		image.width = 0;
+		image.height = 0;
+		image.colorChannels = 0;
+
+		if (m_bUseCookedTextures)
+		{
+			CookedTexture* pCooked = new CookedTexture();
+			if (pCooked->Open(CookedTexture::CookedPath(pRequest->filename).c_str()))
+			{
+				// page the file in here rather than in the driver,
+				// unless the streamer reads in the levels it needs
+				if (m_bStreamCookedTextures == false)
+				{
+					pCooked->Prefetch();
+				}
+				image.pCooked = pCooked;
+			}
+			else
+			{
+				delete pCooked;
+			}
+		}
+
+		if (NULL == image.pCooked)
+		{
+			image.pixels = stbi_load(
+				pRequest->filename.c_str(),
+				&image.width,
+				&image.height,
+				&image.colorChannels,
+				0);
+		}
+
+		// the queue only fills up when the GL thread falls
+		// behind, so waiting here is the back pressure
+		while (m_decoded.Push(image) == false)
+		{
+			if (m_bStopping)
+			{
+				Release(image);
+				return;
+			}
+			std::this_thread::yield();
+		}
+	}
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for copying one decoded image into
+ *  a pixel buffer object and from there into its texture,
+ *  then generating the mipmaps.  The two pixel buffers are
+ *  used in turn and orphaned before each copy, so the copy
+ *  never waits for an earlier upload to finish.  False is
+ *  returned when the texture keeps its placeholder.
+ ***********************************************************/
+bool TextureLoader::Upload(const DECODED_IMAGE& image)
+{
+	bool bUploaded = false;
+	const char* filename = image.pRequest->filename.c_str();
+	GLenum format = GL_NONE;
+	GLint internalFormat = GL_NONE;
+
+	// if the loaded image is in RGB format
+	if (image.colorChannels == 3)
+	{
+		format = GL_RGB;
+		internalFormat = GL_RGB8;
+	}
+	// if the loaded image is in RGBA format - it supports transparency
+	else if (image.colorChannels == 4)
+	{
+		format = GL_RGBA;
+		internalFormat = GL_RGBA8;
+	}
+
+	if (NULL == image.pixels)
+	{
+		std::cout << "Could not load image:" << filename << std::endl;
+	}
+	else if (format == GL_NONE)
+	{
+		std::cout << "Not implemented to handle image with " << image.colorChannels << " channels" << std::endl;
+	}
+	else
+	{
+		std::cout << "Successfully loaded image:" << filename << ", width:" << image.width << ", height:" << image.height << ", channels:" << image.colorChannels << std::endl;
+
+		if (m_pixelBuffers[0] == 0)
+		{
+			glGenBuffers(2, m_pixelBuffers);
+		}
+
+		GLsizeiptr size = (GLsizeiptr)image.width * image.height * image.colorChannels;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffers[m_nextPixelBuffer]);
+		m_nextPixelBuffer = (m_nextPixelBuffer + 1) % 2;
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+
+		void* pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (NULL != pMapped)
+		{
+			memcpy(pMapped, image.pixels, (size_t)size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			GLint previousTexture = 0;
+			glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+			glBindTexture(GL_TEXTURE_2D, image.pRequest->textureID);
+
+			// rows of RGB images are not always 4-byte aligned
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, (void*)0);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+			// generate the texture mipmaps for mapping textures to lower resolutions
+			glGenerateMipmap(GL_TEXTURE_2D);
+
+			glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+			bUploaded = true;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	return(bUploaded);
+}
+
+/***********************************************************
+ *  UploadCooked()
+ *
+ *  This method is used for passing the compressed mip chain
+ *  of a cooked file to its texture.  The driver reads the
+ *  blocks directly from the mapped file, so there is no
+ *  decode, no copy into a pixel buffer and no mipmap
+ *  generation.
+ ***********************************************************/
+bool TextureLoader::UploadCooked(const DECODED_IMAGE& image)
+{
+	const CookedTexture::COOKED_HEADER& header = image.pCooked->Header();
+
+	std::cout << "Successfully loaded cooked image:" << CookedTexture::CookedPath(image.pRequest->filename)
+		<< ", width:" << header.width << ", height:" << header.height << ", mips:" << header.mipCount << std::endl;
+
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	glBindTexture(GL_TEXTURE_2D, image.pRequest->textureID);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	image.pCooked->Upload();
+
+	glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  This method is used for freeing the pixels, the mapping
+ *  and the request of a finished or dropped image.
+ ***********************************************************/
+void TextureLoader::Release(const DECODED_IMAGE& image)
+{
+	if (NULL != image.pixels)
+	{
+		stbi_image_free(image.pixels);
+	}
+	if (NULL != image.pCooked)
+	{
+		delete image.pCooked;
+	}
+	delete image.pRequest;
+}
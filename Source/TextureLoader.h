@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.h
+// ============
+// decode texture images on worker threads and stream the pixels into OpenGL
+// textures on the GL thread, with a placeholder until each one is ready
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "LockFreeQueue.h"
+#include "CookedTexture.h"
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class creates a texture object right away for each
+ *  request, filled with a 1x1 placeholder, so it can be
+ *  bound and drawn with at once.  Worker threads map the
+ *  cooked .ctex file of each image when there is one, or
+ *  else decode the image file, and push the result onto a
+ *  lock-free queue.
+ *  ProcessUploads(), called once per frame on the GL
+ *  thread, copies them through a pixel buffer object into
+ *  the texture, which keeps its name, so no binding or
+ *  texture slot changes.  Cooked files can instead be
+ *  handed over still mapped, for the texture streamer.
+ ***********************************************************/
+class TextureLoader
+{
+public:
+	// a mapped cooked file handed over instead of uploaded
+	struct COOKED_IMAGE
+	{
+		GLuint textureID;
+		CookedTexture* pCooked;
+	};
+
+	// constructor
+	TextureLoader();
+	// destructor
+	~TextureLoader();
+
+	// create a placeholder texture and queue the image file to
+	// be decoded, returning the texture name
+	GLuint Request(const char* filename);
+	// hand mapped cooked files over to the caller instead of
+	// uploading them, set before the first request
+	void SetStreamCookedTextures(bool bStream) { m_bStreamCookedTextures = bStream; }
+
+	// upload the decoded images that are ready, adding the
+	// textures that got their image to the first list and the
+	// handed over cooked files to the second, returning how
+	// many requests were finished
+	int ProcessUploads(std::vector<GLuint>& finishedTextures, std::vector<COOKED_IMAGE>& cookedImages);
+	// wait for and upload every queued image
+	void Finish(std::vector<GLuint>& finishedTextures, std::vector<COOKED_IMAGE>& cookedImages);
+
+	// requests not uploaded yet
+	int PendingCount() const { return m_pendingCount; }
+
+	// stop the worker threads and drop unfinished images
+	void Stop();
+
+private:
+	// one image file to decode into a texture
+	struct LOAD_REQUEST
+	{
+		std::string filename;
+		GLuint textureID;
+	};
+
+	// decoded pixels or a mapped cooked file on their way to
+	// the GL thread
+	struct DECODED_IMAGE
+	{
+		LOAD_REQUEST* pRequest;
+		CookedTexture* pCooked;
+		unsigned char* pixels;
+		int width;
+		int height;
+		int colorChannels;
+	};
+
+	// requests waiting for a worker, guarded by m_requestMutex
+	std::deque<LOAD_REQUEST*> m_requests;
+	std::mutex m_requestMutex;
+	std::condition_variable m_requestReady;
+	// decoded images waiting for the GL thread
+	LockFreeQueue<DECODED_IMAGE> m_decoded;
+	// worker threads, started with the first request
+	std::vector<std::thread> m_workers;
+	std::atomic<bool> m_bStopping;
+	// whether cooked files are used and whether they are handed
+	// over, both fixed before the workers start
+	bool m_bUseCookedTextures;
+	bool m_bStreamCookedTextures;
+	// requests not uploaded yet, only used on the GL thread
+	int m_pendingCount;
+	// pixel buffer objects used in turn for the uploads
+	GLuint m_pixelBuffers[2];
+	int m_nextPixelBuffer;
+
+	// start the worker threads
+	void StartWorkers();
+	// worker thread loop
+	void WorkerMain();
+	// copy one decoded image into its texture
+	bool Upload(const DECODED_IMAGE& image);
+	// copy the mip chain of a cooked file into its texture
+	bool UploadCooked(const DECODED_IMAGE& image);
+	// free what a decoded image holds
+	static void Release(const DECODED_IMAGE& image);
+};
@@ -0,0 +1,738 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureresidency.cpp
+// ====================
+// This file contains the implementation of the `TextureResidency` class, which
+// lets the shaders reach every scene texture without per-draw binds.
+//
+// RESPONSIBILITIES:
+// - Keep the texture table uniform block that the shaders index per draw.
+// - Make bindless handles resident when ARB_bindless_texture is available.
+// - Otherwise pack the textures into texture arrays grouped by size and
+//   format, growing an array when it runs out of layers and freeing it
+//   once every layer is released.
+//
+// NOTE: The copies into the arrays go through a pixel buffer on the GPU, so
+// they work with the compressed cooked textures too and never read the
+// pixels back to the CPU.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureResidency.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+// Namespace for the residency limits
+namespace
+{
+	// layers of a new texture array, doubled when it fills up
+	const int INITIAL_ARRAY_LAYERS = 4;
+	// color shown until a texture is resident
+	const unsigned char PLACEHOLDER_PIXEL[4] = { 128, 128, 128, 255 };
+
+	// number of levels in a full mip chain
+	int FullMipLevels(int width, int height)
+	{
+		int levels = 1;
+		while ((width > 1) || (height > 1))
+		{
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+			levels++;
+		}
+		return(levels);
+	}
+
+	// bytes of one 4x4 block of a compressed format, 0 when
+	// the format cannot be placed in an array
+	GLsizei CompressedBlockBytes(GLint internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+			return(8);
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+			return(16);
+		default:
+			return(0);
+		}
+	}
+}
+
+/***********************************************************
+ *  TextureResidency()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureResidency::TextureResidency()
+{
+	m_backend = BACKEND_TEXTURE_ARRAYS;
+	m_dirtyFirst = 0;
+	m_dirtyLast = -1;
+	m_placeholderTexture = 0;
+	m_placeholderHandle = 0;
+	m_copyBuffer = 0;
+	m_maxArrayLayers = 256;
+}
+
+/***********************************************************
+ *  ~TextureResidency()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureResidency::~TextureResidency()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the texture table and
+ *  the placeholder that pending textures show.  Bindless
+ *  handles are used when the caller allows them and the
+ *  driver supports ARB_bindless_texture.
+ ***********************************************************/
+bool TextureResidency::Create(bool bAllowBindless)
+{
+	m_backend = (bAllowBindless && GLEW_ARB_bindless_texture) ? BACKEND_BINDLESS : BACKEND_TEXTURE_ARRAYS;
+
+	if (m_tableBlock.Create(sizeof(TEXTURE_DATA_STD140), TEXTURE_BLOCK_BINDING) == false)
+	{
+		return(false);
+	}
+
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &m_maxArrayLayers);
+
+	if (m_backend == BACKEND_BINDLESS)
+	{
+		GLint previousTexture = 0;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+		glGenTextures(1, &m_placeholderTexture);
+		glBindTexture(GL_TEXTURE_2D, m_placeholderTexture);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_PIXEL);
+		glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+
+		// a texture cannot change once it has a handle, so the
+		// placeholder is the only texture made resident up front
+		m_placeholderHandle = glGetTextureHandleARB(m_placeholderTexture);
+		glMakeTextureHandleResidentARB(m_placeholderHandle);
+	}
+	else
+	{
+		// the first array holds the placeholder, so a zeroed
+		// table entry always samples something valid
+		TEXTURE_ARRAY placeholder;
+		placeholder.width = 1;
+		placeholder.height = 1;
+		placeholder.levels = 1;
+		placeholder.internalFormat = GL_RGBA8;
+		placeholder.bCompressed = false;
+		placeholder.layerCount = 1;
+		placeholder.capacity = 1;
+		placeholder.texture = CreateArrayTexture(placeholder, 1);
+
+		GLint previousTexture = 0;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousTexture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, placeholder.texture);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_PIXEL);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, (GLuint)previousTexture);
+
+		m_arrays.push_back(placeholder);
+		BindTextureArrays();
+	}
+
+	std::cout << "Texture residency: "
+		<< ((m_backend == BACKEND_BINDLESS) ? "bindless handles" : "texture arrays") << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for releasing the handles, the
+ *  registered textures, the arrays and the texture table.
+ ***********************************************************/
+void TextureResidency::Destroy()
+{
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		if (m_textures[i].handle != 0)
+		{
+			glMakeTextureHandleNonResidentARB(m_textures[i].handle);
+		}
+		if (m_textures[i].texture != 0)
+		{
+			glDeleteTextures(1, &m_textures[i].texture);
+		}
+	}
+	m_textures.clear();
+	m_entries.clear();
+
+	for (size_t i = 0; i < m_arrays.size(); ++i)
+	{
+		glDeleteTextures(1, &m_arrays[i].texture);
+	}
+	m_arrays.clear();
+
+	if (m_placeholderHandle != 0)
+	{
+		glMakeTextureHandleNonResidentARB(m_placeholderHandle);
+		m_placeholderHandle = 0;
+	}
+	if (m_placeholderTexture != 0)
+	{
+		glDeleteTextures(1, &m_placeholderTexture);
+		m_placeholderTexture = 0;
+	}
+	if (m_copyBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_copyBuffer);
+		m_copyBuffer = 0;
+	}
+
+	m_tableBlock.Destroy();
+	m_dirtyFirst = 0;
+	m_dirtyLast = -1;
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used for registering a texture from the
+ *  texture loader.  The residency manager owns the texture
+ *  from then on, and its entry shows the placeholder until
+ *  MakeResident() is called for it.
+ ***********************************************************/
+int TextureResidency::Add(GLuint texture)
+{
+	if ((int)m_textures.size() >= MAX_TEXTURES)
+	{
+		std::cout << "Only " << MAX_TEXTURES << " textures fit in the texture table" << std::endl;
+		return(-1);
+	}
+
+	RESIDENT_TEXTURE resident;
+	resident.texture = texture;
+	resident.arrayIndex = -1;
+	resident.layer = -1;
+	resident.handle = 0;
+	m_textures.push_back(resident);
+	m_entries.push_back(glm::uvec4(0u));
+
+	int index = (int)m_textures.size() - 1;
+	SetEntry(index);
+
+	return(index);
+}
+
+/***********************************************************
+ *  MakeResident()
+ *
+ *  This method is used for switching the table entries of
+ *  the passed in textures from the placeholder to their
+ *  uploaded images.
+ ***********************************************************/
+void TextureResidency::MakeResident(const std::vector<GLuint>& textures)
+{
+	for (size_t i = 0; i < textures.size(); ++i)
+	{
+		for (size_t index = 0; index < m_textures.size(); ++index)
+		{
+			RESIDENT_TEXTURE& resident = m_textures[index];
+			if ((resident.texture != textures[i]) || (resident.texture == 0))
+			{
+				continue;
+			}
+
+			if (m_backend == BACKEND_BINDLESS)
+			{
+				MakeHandleResident(resident);
+			}
+			else
+			{
+				MoveIntoArray(resident);
+			}
+			SetEntry((int)index);
+			break;
+		}
+	}
+}
+
+/***********************************************************
+ *  Replace()
+ *
+ *  This method is used for switching a table entry to a
+ *  different finished texture, as the texture streamer does
+ *  when it adds or drops mip levels.  The new texture is
+ *  made resident first, so the entry never shows the
+ *  placeholder in between.
+ ***********************************************************/
+bool TextureResidency::Replace(int index, GLuint texture)
+{
+	if ((index < 0) || (index >= (int)m_textures.size()))
+	{
+		glDeleteTextures(1, &texture);
+		return(false);
+	}
+
+	RESIDENT_TEXTURE replacement;
+	replacement.texture = texture;
+	replacement.arrayIndex = -1;
+	replacement.layer = -1;
+	replacement.handle = 0;
+
+	if (m_backend == BACKEND_BINDLESS)
+	{
+		MakeHandleResident(replacement);
+	}
+	else if (MoveIntoArray(replacement) == false)
+	{
+		glDeleteTextures(1, &replacement.texture);
+		return(false);
+	}
+
+	Release(m_textures[index]);
+	m_textures[index] = replacement;
+	SetEntry(index);
+
+	return(true);
+}
+
+/***********************************************************
+ *  UpdateTable()
+ *
+ *  This method is used for sending the range of table
+ *  entries that changed since the last call.
+ ***********************************************************/
+void TextureResidency::UpdateTable()
+{
+	if (m_dirtyLast < m_dirtyFirst)
+	{
+		return;
+	}
+
+	GLsizeiptr entrySize = sizeof(glm::uvec4);
+	m_tableBlock.Update(
+		m_dirtyFirst * entrySize,
+		(m_dirtyLast - m_dirtyFirst + 1) * entrySize,
+		&m_entries[m_dirtyFirst]);
+
+	m_dirtyFirst = 0;
+	m_dirtyLast = -1;
+}
+
+/***********************************************************
+ *  BindTextureArrays()
+ *
+ *  This method is used for attaching each texture array to
+ *  the unit matching its index.  It only needs to run again
+ *  when an array is created or replaced, never per draw.
+ ***********************************************************/
+void TextureResidency::BindTextureArrays() const
+{
+	for (size_t i = 0; i < m_arrays.size(); ++i)
+	{
+		glActiveTexture(GL_TEXTURE0 + (GLenum)i);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[i].texture);
+		Profiler::CountTextureBind();
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  TextureName()
+ *
+ *  This method is used for getting the OpenGL texture that
+ *  currently holds the image of a table entry - its array
+ *  once it was copied into one, else the loader's texture.
+ ***********************************************************/
+GLuint TextureResidency::TextureName(int index) const
+{
+	if ((index < 0) || (index >= (int)m_textures.size()))
+	{
+		return(0);
+	}
+
+	const RESIDENT_TEXTURE& resident = m_textures[index];
+	if (resident.arrayIndex >= 0)
+	{
+		return(m_arrays[resident.arrayIndex].texture);
+	}
+	return(resident.texture);
+}
+
+/***********************************************************
+ *  SetEntry()
+ *
+ *  This method is used for writing the table entry of one
+ *  texture - its handle split into two 32-bit halves, or its
+ *  array and layer - and adding it to the next upload.
+ ***********************************************************/
+void TextureResidency::SetEntry(int index)
+{
+	const RESIDENT_TEXTURE& resident = m_textures[index];
+	glm::uvec4 entry(0u);
+
+	if (m_backend == BACKEND_BINDLESS)
+	{
+		GLuint64 handle = (resident.handle != 0) ? resident.handle : m_placeholderHandle;
+		entry.x = (GLuint)(handle & 0xFFFFFFFFull);
+		entry.y = (GLuint)(handle >> 32);
+	}
+	else if (resident.arrayIndex >= 0)
+	{
+		entry.x = (GLuint)resident.arrayIndex;
+		entry.y = (GLuint)resident.layer;
+	}
+
+	m_entries[index] = entry;
+	if (m_dirtyLast < m_dirtyFirst)
+	{
+		m_dirtyFirst = index;
+		m_dirtyLast = index;
+	}
+	else
+	{
+		m_dirtyFirst = std::min(m_dirtyFirst, index);
+		m_dirtyLast = std::max(m_dirtyLast, index);
+	}
+}
+
+/***********************************************************
+ *  MakeHandleResident()
+ *
+ *  This method is used for getting the bindless handle of a
+ *  finished texture and making it resident.
+ ***********************************************************/
+void TextureResidency::MakeHandleResident(RESIDENT_TEXTURE& texture)
+{
+	texture.handle = glGetTextureHandleARB(texture.texture);
+	glMakeTextureHandleResidentARB(texture.handle);
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  This method is used for giving up what a table entry
+ *  holds - its bindless handle and texture, its array layer
+ *  for reuse, or the loader's texture it was never moved
+ *  out of.  The array goes too when that was its last
+ *  layer.
+ ***********************************************************/
+void TextureResidency::Release(RESIDENT_TEXTURE& texture)
+{
+	if (texture.handle != 0)
+	{
+		glMakeTextureHandleNonResidentARB(texture.handle);
+		texture.handle = 0;
+	}
+	if (texture.arrayIndex >= 0)
+	{
+		TEXTURE_ARRAY& textureArray = m_arrays[texture.arrayIndex];
+		textureArray.freeLayers.push_back(texture.layer);
+		// the placeholder array is never freed
+		if ((texture.arrayIndex > 0) && ((int)textureArray.freeLayers.size() >= textureArray.layerCount))
+		{
+			FreeArray(textureArray);
+		}
+		texture.arrayIndex = -1;
+		texture.layer = -1;
+	}
+	if (texture.texture != 0)
+	{
+		glDeleteTextures(1, &texture.texture);
+		texture.texture = 0;
+	}
+}
+
+/***********************************************************
+ *  MoveIntoArray()
+ *
+ *  This method is used for copying a finished texture into
+ *  a free layer of the array for its size and format, then
+ *  deleting the original.  A texture that fits in no array
+ *  is left as it is and false is returned.
+ ***********************************************************/
+bool TextureResidency::MoveIntoArray(RESIDENT_TEXTURE& texture)
+{
+	GLint width = 0;
+	GLint height = 0;
+	GLint internalFormat = GL_NONE;
+	GLint compressed = GL_FALSE;
+	GLint maxLevel = 0;
+
+	GLint previousTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	glBindTexture(GL_TEXTURE_2D, texture.texture);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+	glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+
+	// loaded images have a generated full chain, cooked ones
+	// end at the last stored level
+	int levels = std::min(FullMipLevels(width, height), maxLevel + 1);
+	bool bCompressed = (compressed != GL_FALSE);
+
+	int arrayIndex = FindArray(width, height, levels, internalFormat, bCompressed);
+	if (arrayIndex < 0)
+	{
+		return(false);
+	}
+
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	int layer = textureArray.layerCount;
+	if (textureArray.freeLayers.empty() == false)
+	{
+		layer = textureArray.freeLayers.back();
+		textureArray.freeLayers.pop_back();
+	}
+	else
+	{
+		textureArray.layerCount++;
+	}
+	CopyLevels(GL_TEXTURE_2D, texture.texture, textureArray, textureArray.texture, layer, 1);
+
+	glDeleteTextures(1, &texture.texture);
+	texture.texture = 0;
+	texture.arrayIndex = arrayIndex;
+	texture.layer = layer;
+
+	return(true);
+}
+
+/***********************************************************
+ *  FindArray()
+ *
+ *  This method is used for finding the array that the next
+ *  texture of the given shape goes into.  Released layers
+ *  are reused first, a full array is replaced by one with
+ *  twice the layers, and a new array is started for a new
+ *  shape in the unit of a freed array, or in a new unit
+ *  while there are any left.
+ ***********************************************************/
+int TextureResidency::FindArray(int width, int height, int levels, GLint internalFormat, bool bCompressed)
+{
+	if (bCompressed && (CompressedBlockBytes(internalFormat) == 0))
+	{
+		std::cout << "Texture format " << internalFormat << " cannot be placed in a texture array" << std::endl;
+		return(-1);
+	}
+
+	for (size_t i = 0; i < m_arrays.size(); ++i)
+	{
+		TEXTURE_ARRAY& textureArray = m_arrays[i];
+		bool bSameShape = (textureArray.width == width) &&
+			(textureArray.height == height) &&
+			(textureArray.levels == levels) &&
+			(textureArray.internalFormat == internalFormat);
+
+		// the placeholder array is never shared
+		if ((bSameShape == false) || (i == 0) || (textureArray.texture == 0))
+		{
+			continue;
+		}
+		if ((textureArray.layerCount < textureArray.capacity) || (textureArray.freeLayers.empty() == false))
+		{
+			return((int)i);
+		}
+		if (textureArray.capacity < m_maxArrayLayers)
+		{
+			int capacity = std::min(textureArray.capacity * 2, m_maxArrayLayers);
+			GLuint texture = CreateArrayTexture(textureArray, capacity);
+			CopyLevels(GL_TEXTURE_2D_ARRAY, textureArray.texture, textureArray, texture, 0, textureArray.layerCount);
+			glDeleteTextures(1, &textureArray.texture);
+			textureArray.texture = texture;
+			textureArray.capacity = capacity;
+			BindTextureArrays();
+			return((int)i);
+		}
+	}
+
+	int arrayIndex = -1;
+	for (size_t i = 1; (arrayIndex < 0) && (i < m_arrays.size()); ++i)
+	{
+		if (m_arrays[i].texture == 0)
+		{
+			arrayIndex = (int)i;
+		}
+	}
+	if ((arrayIndex < 0) && ((int)m_arrays.size() >= MAX_TEXTURE_ARRAYS))
+	{
+		std::cout << "No free texture array for a " << width << "x" << height << " texture" << std::endl;
+		return(-1);
+	}
+
+	TEXTURE_ARRAY textureArray;
+	textureArray.width = width;
+	textureArray.height = height;
+	textureArray.levels = levels;
+	textureArray.internalFormat = internalFormat;
+	textureArray.bCompressed = bCompressed;
+	textureArray.layerCount = 0;
+	textureArray.capacity = std::min(INITIAL_ARRAY_LAYERS, m_maxArrayLayers);
+	textureArray.texture = CreateArrayTexture(textureArray, textureArray.capacity);
+	if (arrayIndex < 0)
+	{
+		arrayIndex = (int)m_arrays.size();
+		m_arrays.push_back(textureArray);
+	}
+	else
+	{
+		m_arrays[arrayIndex] = textureArray;
+	}
+	BindTextureArrays();
+
+	return(arrayIndex);
+}
+
+/***********************************************************
+ *  FreeArray()
+ *
+ *  This method is used for deleting an array that no table
+ *  entry uses any more.  Its slot stays in the list, since
+ *  the arrays after it keep their units, and matches no
+ *  shape until FindArray() starts a new array in it.
+ ***********************************************************/
+void TextureResidency::FreeArray(TEXTURE_ARRAY& textureArray)
+{
+	glDeleteTextures(1, &textureArray.texture);
+	textureArray.texture = 0;
+	textureArray.width = 0;
+	textureArray.height = 0;
+	textureArray.levels = 0;
+	textureArray.layerCount = 0;
+	textureArray.capacity = 0;
+	textureArray.freeLayers.clear();
+}
+
+/***********************************************************
+ *  CreateArrayTexture()
+ *
+ *  This method is used for allocating every level of an
+ *  array texture with the same wrapping and filtering as
+ *  the loader's textures.
+ ***********************************************************/
+GLuint TextureResidency::CreateArrayTexture(const TEXTURE_ARRAY& shape, int capacity) const
+{
+	GLuint texture = 0;
+	GLint previousTexture = 0;
+
+	glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousTexture);
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, shape.levels - 1);
+
+	for (int level = 0; level < shape.levels; ++level)
+	{
+		GLsizei width = std::max(shape.width >> level, 1);
+		GLsizei height = std::max(shape.height >> level, 1);
+
+		if (shape.bCompressed)
+		{
+			GLsizei size = ((width + 3) / 4) * ((height + 3) / 4) *
+				CompressedBlockBytes(shape.internalFormat) * capacity;
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, (GLenum)shape.internalFormat,
+				width, height, capacity, 0, size, NULL);
+		}
+		else
+		{
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, shape.internalFormat,
+				width, height, capacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, (GLuint)previousTexture);
+
+	return(texture);
+}
+
+/***********************************************************
+ *  CopyLevels()
+ *
+ *  This method is used for copying every level of a 2D
+ *  texture or of the used layers of an array into layers
+ *  of an array texture.  Each level is read into the copy
+ *  buffer and written from it, without leaving the GPU.
+ ***********************************************************/
+void TextureResidency::CopyLevels(
+	GLenum sourceTarget,
+	GLuint source,
+	const TEXTURE_ARRAY& destination,
+	GLuint destinationTexture,
+	int firstLayer,
+	int layerCount)
+{
+	if (m_copyBuffer == 0)
+	{
+		glGenBuffers(1, &m_copyBuffer);
+	}
+
+	GLint previousTexture2D = 0;
+	GLint previousTextureArray = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture2D);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousTextureArray);
+
+	for (int level = 0; level < destination.levels; ++level)
+	{
+		GLsizei width = std::max(destination.width >> level, 1);
+		GLsizei height = std::max(destination.height >> level, 1);
+		GLint size = 0;
+
+		glBindTexture(sourceTarget, source);
+		if (destination.bCompressed)
+		{
+			glGetTexLevelParameteriv(sourceTarget, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+		}
+		else
+		{
+			size = width * height * 4 * layerCount;
+		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_copyBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_COPY);
+		if (destination.bCompressed)
+		{
+			glGetCompressedTexImage(sourceTarget, level, (void*)0);
+		}
+		else
+		{
+			glGetTexImage(sourceTarget, level, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_copyBuffer);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, destinationTexture);
+		if (destination.bCompressed)
+		{
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, firstLayer,
+				width, height, layerCount, (GLenum)destination.internalFormat, size, (void*)0);
+		}
+		else
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, firstLayer,
+				width, height, layerCount, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture2D);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, (GLuint)previousTextureArray);
+}
@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureresidency.h
+// ============
+// make any number of loaded textures visible to the shaders at once, through
+// bindless handles or texture arrays, so that drawing needs no texture binds
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "UniformBuffer.h"
+#include "ShaderBlocks.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  TextureResidency
+ *
+ *  This class keeps the texture table, a uniform block with
+ *  one entry per texture that the fragment shader indexes
+ *  with the textureIndex uniform.  With ARB_bindless_texture
+ *  an entry holds the texture's 64-bit handle.  Without it,
+ *  each texture is copied into a layer of a texture array
+ *  shared with the textures of the same size and format,
+ *  and the entry holds the array and the layer.  An array
+ *  is freed once its last layer is released, as streaming
+ *  moves textures between sizes, so its unit can take
+ *  another size.  The arrays stay bound to fixed units, so
+ *  in both cases a draw only changes an integer uniform.
+ ***********************************************************/
+class TextureResidency
+{
+public:
+	// how the textures are reached from the shaders
+	enum BACKEND
+	{
+		BACKEND_TEXTURE_ARRAYS,
+		BACKEND_BINDLESS
+	};
+
+	// constructor
+	TextureResidency();
+	// destructor
+	~TextureResidency();
+
+	// create the texture table and the placeholder, choosing
+	// bindless handles when they are allowed and supported
+	bool Create(bool bAllowBindless);
+	// free the table, the arrays and the handles
+	void Destroy();
+
+	// register a texture made by the texture loader, returning
+	// its index in the texture table, or -1 when it is full
+	int Add(GLuint texture);
+	// make textures whose images finished uploading visible,
+	// the others keep showing the placeholder
+	void MakeResident(const std::vector<GLuint>& textures);
+	// give a table entry a new texture, such as one with more
+	// or fewer mip levels, releasing the old one - false when
+	// the new texture cannot be placed, which is then deleted
+	bool Replace(int index, GLuint texture);
+	// send the changed table entries to the GPU
+	void UpdateTable();
+	// attach the texture arrays to their units
+	void BindTextureArrays() const;
+
+	// backend chosen by Create()
+	BACKEND Backend() const { return m_backend; }
+	// number of registered textures
+	int Count() const { return (int)m_textures.size(); }
+	// number of texture array units handed out, including the
+	// placeholder and the freed ones
+	int ArrayCount() const { return (int)m_arrays.size(); }
+	// OpenGL texture that holds the image of a table entry
+	GLuint TextureName(int index) const;
+
+private:
+	// one texture array, all layers with the same shape
+	struct TEXTURE_ARRAY
+	{
+		GLuint texture;
+		int width;
+		int height;
+		int levels;
+		GLint internalFormat;
+		bool bCompressed;
+		// layers handed out and layers allocated
+		int layerCount;
+		int capacity;
+		// handed out layers that were released again
+		std::vector<int> freeLayers;
+	};
+
+	// one registered texture
+	struct RESIDENT_TEXTURE
+	{
+		// loader texture, 0 once it was copied into an array
+		GLuint texture;
+		// array and layer, or -1 while not in an array
+		int arrayIndex;
+		int layer;
+		// bindless handle, 0 while not resident
+		GLuint64 handle;
+	};
+
+	BACKEND m_backend;
+	// GPU copy of the texture table
+	UniformBuffer m_tableBlock;
+	// CPU copy of the texture table
+	std::vector<glm::uvec4> m_entries;
+	// range of table entries changed since the last upload
+	int m_dirtyFirst;
+	int m_dirtyLast;
+	std::vector<RESIDENT_TEXTURE> m_textures;
+	std::vector<TEXTURE_ARRAY> m_arrays;
+	// shown until a texture is resident, a 1x1 2D texture
+	// for bindless, the first array otherwise
+	GLuint m_placeholderTexture;
+	GLuint64 m_placeholderHandle;
+	// staging buffer for the copies into the arrays
+	GLuint m_copyBuffer;
+	// most layers OpenGL allows in one array
+	int m_maxArrayLayers;
+
+	// point a table entry at its texture or the placeholder
+	void SetEntry(int index);
+	// find an array that can take one more layer of the given
+	// shape, creating or growing one when needed
+	int FindArray(int width, int height, int levels, GLint internalFormat, bool bCompressed);
+	// delete an array whose layers were all released, leaving
+	// its unit free for a new shape
+	void FreeArray(TEXTURE_ARRAY& textureArray);
+	// allocate an array texture with the given layer count
+	GLuint CreateArrayTexture(const TEXTURE_ARRAY& shape, int capacity) const;
+	// copy every level of a texture into layers of an array
+	void CopyLevels(GLenum sourceTarget, GLuint source, const TEXTURE_ARRAY& destination, GLuint destinationTexture, int firstLayer, int layerCount);
+	// make a finished texture resident with a bindless handle
+	void MakeHandleResident(RESIDENT_TEXTURE& texture);
+	// copy a finished texture into an array layer, false when
+	// no array can take it
+	bool MoveIntoArray(RESIDENT_TEXTURE& texture);
+	// free the handle, layer or texture an entry holds
+	void Release(RESIDENT_TEXTURE& texture);
+};
@@ -0,0 +1,563 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.cpp
+// ===================
+// This file contains the implementation of the `TextureStreamer` class, which
+// keeps the resident mip levels of the cooked textures matched to the view.
+//
+// RESPONSIBILITIES:
+// - Turn the per-frame screen footprint of each texture into the finest mip
+//   level worth keeping.
+// - Read the pages of missing levels in on a worker thread, and rebuild the
+//   texture with them on the GL thread within a per-frame upload limit.
+// - Keep the resident levels within a memory budget by dropping unneeded
+//   levels of the least recently used textures first.
+//
+// NOTE: A texture is rebuilt as a new texture object and swapped into the
+// texture table, so draws never see a texture with half its levels, and the
+// smallest levels (the tail) stay resident at all times.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Namespace for the streaming limits
+namespace
+{
+	// levels this size and smaller are loaded right away and
+	// never evicted, so a texture always has something to show
+	const uint32_t STREAM_TAIL_SIZE = 64;
+	// textures whose levels can be read in at the same time
+	const int MAX_PENDING_FETCHES = 8;
+	// finished fetches that can wait for the GL thread
+	const size_t FETCHED_QUEUE_CAPACITY = 64;
+	// bytes placed per frame, the rest waits for next frame
+	const size_t MAX_STREAM_BYTES_PER_FRAME = 8 * 1024 * 1024;
+	// memory for the streamed levels unless set otherwise
+	const size_t DEFAULT_TEXTURE_BUDGET = 256 * 1024 * 1024;
+}
+
+/***********************************************************
+ *  TextureStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureStreamer::TextureStreamer() :
+	m_fetched(FETCHED_QUEUE_CAPACITY)
+{
+	m_pResidency = NULL;
+	m_budgetBytes = DEFAULT_TEXTURE_BUDGET;
+	m_residentBytes = 0;
+	m_pendingBytes = 0;
+	m_pendingFetches = 0;
+	m_frame = 0;
+	m_bStopping = false;
+	m_stats.textureCount = 0;
+	m_stats.pendingFetches = 0;
+	m_stats.residentBytes = 0;
+	m_stats.budgetBytes = m_budgetBytes;
+	m_stats.streamedIn = 0;
+	m_stats.evicted = 0;
+}
+
+/***********************************************************
+ *  ~TextureStreamer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureStreamer::~TextureStreamer()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for connecting the streamer to the
+ *  texture table and starting its worker.
+ ***********************************************************/
+void TextureStreamer::Create(TextureResidency* pResidency)
+{
+	m_pResidency = pResidency;
+	m_bStopping = false;
+	if (m_worker.joinable() == false)
+	{
+		m_worker = std::thread(&TextureStreamer::WorkerMain, this);
+	}
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used for taking over a mapped cooked
+ *  file.  Its tail - the first level no larger than
+ *  STREAM_TAIL_SIZE and everything below it - is uploaded
+ *  at once, and the finer levels wait for a request.  When
+ *  the slot is streamed already, as when its file was
+ *  cooked again, the new file takes over the slot's entry;
+ *  an old file that a fetch is still reading is kept until
+ *  that fetch comes back.
+ ***********************************************************/
+void TextureStreamer::Add(int slot, CookedTexture* pCooked)
+{
+	const CookedTexture::COOKED_HEADER& header = pCooked->Header();
+
+	STREAMED_TEXTURE texture;
+	texture.slot = slot;
+	texture.pCooked = pCooked;
+	texture.tailLevel = (int)header.mipCount - 1;
+	for (uint32_t level = 0; level < header.mipCount; ++level)
+	{
+		const CookedTexture::COOKED_LEVEL& info = pCooked->Level(level);
+		if (std::max(info.width, info.height) <= STREAM_TAIL_SIZE)
+		{
+			texture.tailLevel = (int)level;
+			break;
+		}
+	}
+	texture.residentLevel = (int)header.mipCount;
+	texture.requestedLevel = texture.tailLevel;
+	texture.fetchLevel = -1;
+	texture.lastUsedFrame = m_frame;
+
+	if ((int)m_textureBySlot.size() <= slot)
+	{
+		m_textureBySlot.resize(slot + 1, -1);
+	}
+
+	int index = m_textureBySlot[slot];
+	if (index >= 0)
+	{
+		ReleaseFile(m_textures[index]);
+		m_textures[index] = texture;
+	}
+	else
+	{
+		index = (int)m_textures.size();
+		m_textureBySlot[slot] = index;
+		m_textures.push_back(texture);
+	}
+
+	// the tail is small, so it is read on this thread
+	pCooked->PrefetchLevels(texture.tailLevel, header.mipCount - 1);
+	if (SetResidentLevel(m_textures[index], texture.tailLevel) == false)
+	{
+		std::cout << "Could not make streamed texture resident, slot:" << slot << std::endl;
+	}
+}
+
+/***********************************************************
+ *  Remove()
+ *
+ *  This method is used for handing a table slot back, as
+ *  when its image is loaded again from a file that is not
+ *  cooked.  The entry stays, since fetches refer to it by
+ *  index, but holds no levels and never asks for any.
+ ***********************************************************/
+void TextureStreamer::Remove(int slot)
+{
+	if (IsStreamed(slot) == false)
+	{
+		return;
+	}
+
+	STREAMED_TEXTURE& texture = m_textures[m_textureBySlot[slot]];
+	ReleaseFile(texture);
+	texture.slot = -1;
+	texture.pCooked = NULL;
+	texture.tailLevel = 0;
+	texture.residentLevel = 0;
+	texture.requestedLevel = 0;
+	texture.fetchLevel = -1;
+	m_textureBySlot[slot] = -1;
+}
+
+/***********************************************************
+ *  IsStreamed()
+ *
+ *  This method is used for checking whether the texture of
+ *  a table slot is managed by the streamer.
+ ***********************************************************/
+bool TextureStreamer::IsStreamed(int slot) const
+{
+	return((slot >= 0) && (slot < (int)m_textureBySlot.size()) && (m_textureBySlot[slot] >= 0));
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for forgetting the requests of the
+ *  previous frame.  A texture nobody asks for falls back
+ *  to its tail, so its finer levels can be evicted.
+ ***********************************************************/
+void TextureStreamer::BeginFrame()
+{
+	m_frame++;
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		m_textures[i].requestedLevel = m_textures[i].tailLevel;
+	}
+}
+
+/***********************************************************
+ *  RequestDetail()
+ *
+ *  This method is used for turning the pixels that one
+ *  repeat of a texture covers into a mip level.  The level
+ *  chosen is the smallest with at least one texel for each
+ *  covered pixel, and the finest request of the frame wins.
+ ***********************************************************/
+void TextureStreamer::RequestDetail(int slot, float pixelsPerRepeat)
+{
+	if (IsStreamed(slot) == false)
+	{
+		return;
+	}
+
+	STREAMED_TEXTURE& texture = m_textures[m_textureBySlot[slot]];
+	const CookedTexture::COOKED_LEVEL& top = texture.pCooked->Level(0);
+	float texels = (float)std::max(top.width, top.height);
+	int level = 0;
+
+	if (pixelsPerRepeat < texels)
+	{
+		level = (int)std::floor(std::log2(texels / std::max(pixelsPerRepeat, 1.0f)));
+	}
+	level = std::min(std::max(level, 0), texture.tailLevel);
+
+	texture.requestedLevel = std::min(texture.requestedLevel, level);
+	texture.lastUsedFrame = m_frame;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for running the streaming on the GL
+ *  thread once per frame.  The fetches the worker finished
+ *  are placed first, then the textures that still lack
+ *  detail get new fetches, the largest shortfall first,
+ *  for the finest level the budget can take.
+ ***********************************************************/
+void TextureStreamer::Update()
+{
+	m_stats.streamedIn = 0;
+	m_stats.evicted = 0;
+
+	size_t placedBytes = 0;
+	FETCH_JOB job;
+	while ((placedBytes < MAX_STREAM_BYTES_PER_FRAME) && m_fetched.Pop(job))
+	{
+		STREAMED_TEXTURE& texture = m_textures[job.textureIndex];
+
+		m_pendingBytes -= std::min(m_pendingBytes, job.reservedBytes);
+		m_pendingFetches--;
+
+		// the file was replaced while its pages were read
+		if (job.pCooked != texture.pCooked)
+		{
+			std::vector<CookedTexture*>::iterator retired =
+				std::find(m_retiredFiles.begin(), m_retiredFiles.end(), job.pCooked);
+			if (retired != m_retiredFiles.end())
+			{
+				delete *retired;
+				m_retiredFiles.erase(retired);
+			}
+			continue;
+		}
+		texture.fetchLevel = -1;
+
+		// the view can have moved on while the pages were read
+		int level = std::max(job.firstLevel, texture.requestedLevel);
+		if (level >= texture.residentLevel)
+		{
+			continue;
+		}
+
+		size_t extra = LevelBytes(texture, level) - LevelBytes(texture, texture.residentLevel);
+		if (MakeRoom(extra, job.textureIndex) && SetResidentLevel(texture, level))
+		{
+			placedBytes += extra;
+			m_stats.streamedIn++;
+		}
+	}
+
+	m_candidates.clear();
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		const STREAMED_TEXTURE& texture = m_textures[i];
+		if ((texture.requestedLevel < texture.residentLevel) && (texture.fetchLevel < 0))
+		{
+			m_candidates.push_back((int)i);
+		}
+	}
+	std::sort(m_candidates.begin(), m_candidates.end(), [this](int a, int b)
+	{
+		const STREAMED_TEXTURE& first = m_textures[a];
+		const STREAMED_TEXTURE& second = m_textures[b];
+		return((first.residentLevel - first.requestedLevel) > (second.residentLevel - second.requestedLevel));
+	});
+
+	// what can be placed once every unneeded level is dropped
+	size_t committed = m_residentBytes + m_pendingBytes;
+	size_t available = (m_budgetBytes > committed) ? (m_budgetBytes - committed) : 0;
+	available += SurplusBytes();
+
+	bool bIssued = false;
+	for (size_t i = 0; (i < m_candidates.size()) && (m_pendingFetches < MAX_PENDING_FETCHES); ++i)
+	{
+		STREAMED_TEXTURE& texture = m_textures[m_candidates[i]];
+		size_t residentBytes = LevelBytes(texture, texture.residentLevel);
+		int level = texture.requestedLevel;
+
+		while ((level < texture.residentLevel) && ((LevelBytes(texture, level) - residentBytes) > available))
+		{
+			level++;
+		}
+		if (level >= texture.residentLevel)
+		{
+			continue;
+		}
+
+		FETCH_JOB fetch;
+		fetch.textureIndex = m_candidates[i];
+		fetch.pCooked = texture.pCooked;
+		fetch.firstLevel = level;
+		fetch.lastLevel = texture.residentLevel - 1;
+		fetch.reservedBytes = LevelBytes(texture, level) - residentBytes;
+		{
+			std::lock_guard<std::mutex> lock(m_jobMutex);
+			m_jobs.push_back(fetch);
+		}
+
+		available -= fetch.reservedBytes;
+		m_pendingBytes += fetch.reservedBytes;
+		m_pendingFetches++;
+		texture.fetchLevel = level;
+		bIssued = true;
+	}
+	if (bIssued)
+	{
+		m_jobReady.notify_one();
+	}
+
+	m_stats.textureCount = (int)m_textures.size();
+	m_stats.pendingFetches = m_pendingFetches;
+	m_stats.residentBytes = m_residentBytes;
+	m_stats.budgetBytes = m_budgetBytes;
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for joining the worker and closing
+ *  every cooked file.  The textures stay in the texture
+ *  table with the levels they have.
+ ***********************************************************/
+void TextureStreamer::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_bStopping = true;
+		m_jobs.clear();
+	}
+	m_jobReady.notify_all();
+	if (m_worker.joinable())
+	{
+		m_worker.join();
+	}
+
+	FETCH_JOB job;
+	while (m_fetched.Pop(job))
+	{
+	}
+
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		delete m_textures[i].pCooked;
+	}
+	for (size_t i = 0; i < m_retiredFiles.size(); ++i)
+	{
+		delete m_retiredFiles[i];
+	}
+	m_retiredFiles.clear();
+	m_textures.clear();
+	m_textureBySlot.clear();
+	m_residentBytes = 0;
+	m_pendingBytes = 0;
+	m_pendingFetches = 0;
+}
+
+/***********************************************************
+ *  WorkerMain()
+ *
+ *  This method is used for running the worker - wait for a
+ *  fetch, touch the pages of its levels so they are in
+ *  memory, and hand it back to the GL thread.
+ ***********************************************************/
+void TextureStreamer::WorkerMain()
+{
+	for (;;)
+	{
+		FETCH_JOB job;
+		{
+			std::unique_lock<std::mutex> lock(m_jobMutex);
+			m_jobReady.wait(lock, [this]() { return m_bStopping || !m_jobs.empty(); });
+			if (m_bStopping)
+			{
+				return;
+			}
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		job.pCooked->PrefetchLevels((uint32_t)job.firstLevel, (uint32_t)job.lastLevel);
+
+		while (m_fetched.Push(job) == false)
+		{
+			if (m_bStopping)
+			{
+				return;
+			}
+			std::this_thread::yield();
+		}
+	}
+}
+
+/***********************************************************
+ *  SetResidentLevel()
+ *
+ *  This method is used for building a new texture from the
+ *  passed in level down and swapping it into the texture
+ *  table.  Levels coarser than the current ones evict,
+ *  finer ones stream in.
+ ***********************************************************/
+bool TextureStreamer::SetResidentLevel(STREAMED_TEXTURE& texture, int level)
+{
+	GLuint textureID = 0;
+	GLint previousTexture = 0;
+
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// the same sampling the loader gives its textures
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	texture.pCooked->Upload((uint32_t)level);
+	glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+
+	if (m_pResidency->Replace(texture.slot, textureID) == false)
+	{
+		return(false);
+	}
+
+	m_residentBytes -= std::min(m_residentBytes, LevelBytes(texture, texture.residentLevel));
+	m_residentBytes += LevelBytes(texture, level);
+	texture.residentLevel = level;
+
+	return(true);
+}
+
+/***********************************************************
+ *  MakeRoom()
+ *
+ *  This method is used for dropping the levels that are
+ *  finer than requested, oldest request first, until the
+ *  passed in bytes fit the budget.  The texture being
+ *  placed is never touched.
+ ***********************************************************/
+bool TextureStreamer::MakeRoom(size_t bytes, int keepIndex)
+{
+	if (m_residentBytes + bytes <= m_budgetBytes)
+	{
+		return(true);
+	}
+
+	m_candidates.clear();
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		const STREAMED_TEXTURE& texture = m_textures[i];
+		if (((int)i != keepIndex) && (texture.residentLevel < texture.requestedLevel))
+		{
+			m_candidates.push_back((int)i);
+		}
+	}
+	std::sort(m_candidates.begin(), m_candidates.end(), [this](int a, int b)
+	{
+		return(m_textures[a].lastUsedFrame < m_textures[b].lastUsedFrame);
+	});
+
+	for (size_t i = 0; (i < m_candidates.size()) && (m_residentBytes + bytes > m_budgetBytes); ++i)
+	{
+		STREAMED_TEXTURE& texture = m_textures[m_candidates[i]];
+		if (SetResidentLevel(texture, texture.requestedLevel))
+		{
+			m_stats.evicted++;
+		}
+	}
+
+	return(m_residentBytes + bytes <= m_budgetBytes);
+}
+
+/***********************************************************
+ *  SurplusBytes()
+ *
+ *  This method is used for adding up the bytes of every
+ *  resident level finer than its texture's request.
+ ***********************************************************/
+size_t TextureStreamer::SurplusBytes() const
+{
+	size_t bytes = 0;
+
+	for (size_t i = 0; i < m_textures.size(); ++i)
+	{
+		const STREAMED_TEXTURE& texture = m_textures[i];
+		if (texture.residentLevel < texture.requestedLevel)
+		{
+			bytes += LevelBytes(texture, texture.residentLevel) - LevelBytes(texture, texture.requestedLevel);
+		}
+	}
+	return(bytes);
+}
+
+/***********************************************************
+ *  ReleaseFile()
+ *
+ *  This method is used for taking a texture's levels out of
+ *  the resident bytes and deleting its cooked file, unless
+ *  a fetch is still reading its pages - then the file is
+ *  deleted when the fetch comes back.
+ ***********************************************************/
+void TextureStreamer::ReleaseFile(STREAMED_TEXTURE& texture)
+{
+	m_residentBytes -= std::min(m_residentBytes, LevelBytes(texture, texture.residentLevel));
+	if (texture.fetchLevel >= 0)
+	{
+		m_retiredFiles.push_back(texture.pCooked);
+	}
+	else
+	{
+		delete texture.pCooked;
+	}
+}
+
+/***********************************************************
+ *  LevelBytes()
+ *
+ *  This method is used for getting the bytes of the levels
+ *  from the passed in level down, 0 past the last level.
+ ***********************************************************/
+size_t TextureStreamer::LevelBytes(const STREAMED_TEXTURE& texture, int level)
+{
+	if (level >= (int)texture.pCooked->Header().mipCount)
+	{
+		return(0);
+	}
+	return(texture.pCooked->DataSize((uint32_t)level));
+}
@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.h
+// ============
+// keep only the mip levels of the cooked textures that the view needs
+// resident, reading finer levels in the background within a memory budget
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CookedTexture.h"
+#include "LockFreeQueue.h"
+#include "TextureResidency.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureStreamer
+ *
+ *  This class takes over the mapped cooked files from the
+ *  texture loader and makes only their smallest levels
+ *  resident at first.  Each frame the scene reports how many
+ *  pixels every streamed texture covers, which gives the
+ *  finest level worth having.  A worker thread reads the
+ *  pages of the missing levels in, and the GL thread then
+ *  rebuilds the texture with them within a per-frame upload
+ *  limit.  When the resident levels would go over the memory
+ *  budget, levels finer than currently needed are dropped
+ *  from the least recently used textures first.
+ ***********************************************************/
+class TextureStreamer
+{
+public:
+	// counters of the most recent Update()
+	struct STREAMING_STATS
+	{
+		int textureCount;
+		// textures whose finer levels are being read in
+		int pendingFetches;
+		size_t residentBytes;
+		size_t budgetBytes;
+		// textures that gained or lost levels
+		int streamedIn;
+		int evicted;
+	};
+
+	// constructor
+	TextureStreamer();
+	// destructor
+	~TextureStreamer();
+
+	// connect to the texture table the textures are placed in
+	void Create(TextureResidency* pResidency);
+	// set the bytes the streamed levels may use together
+	void SetBudget(size_t budgetBytes) { m_budgetBytes = budgetBytes; }
+	// take over a mapped cooked file for a texture table slot
+	// and make its smallest levels resident, a slot that is
+	// streamed already switches over to the new file
+	void Add(int slot, CookedTexture* pCooked);
+	// stop streaming a table slot that was given a texture of
+	// its own, dropping the cooked file
+	void Remove(int slot);
+	// check whether the texture of a table slot is streamed
+	bool IsStreamed(int slot) const;
+
+	// start collecting the detail requests of a frame
+	void BeginFrame();
+	// ask for enough detail for one repeat of a texture to
+	// cover the passed in number of pixels
+	void RequestDetail(int slot, float pixelsPerRepeat);
+	// place the levels that were read in, evict over budget
+	// and start reading the next levels
+	void Update();
+
+	// counters of the most recent update
+	const STREAMING_STATS& Stats() const { return m_stats; }
+
+	// stop the worker and release every cooked file
+	void Stop();
+
+private:
+	// one streamed texture
+	struct STREAMED_TEXTURE
+	{
+		int slot;
+		CookedTexture* pCooked;
+		// coarsest level kept, it and the smaller levels are
+		// resident for as long as the texture is streamed
+		int tailLevel;
+		// finest resident level, mipCount when none is
+		int residentLevel;
+		// finest level asked for this frame
+		int requestedLevel;
+		// finest level being read in, or -1
+		int fetchLevel;
+		// frame that last asked for the texture
+		unsigned int lastUsedFrame;
+	};
+
+	// a range of levels for the worker to read in
+	struct FETCH_JOB
+	{
+		int textureIndex;
+		const CookedTexture* pCooked;
+		int firstLevel;
+		int lastLevel;
+		// budget set aside for the levels until they are placed
+		size_t reservedBytes;
+	};
+
+	TextureResidency* m_pResidency;
+	std::vector<STREAMED_TEXTURE> m_textures;
+	// streamed texture of each table slot, or -1
+	std::vector<int> m_textureBySlot;
+	size_t m_budgetBytes;
+	size_t m_residentBytes;
+	// bytes set aside for the fetches in flight
+	size_t m_pendingBytes;
+	int m_pendingFetches;
+	unsigned int m_frame;
+	STREAMING_STATS m_stats;
+	// scratch list of texture indices, kept to avoid allocating
+	std::vector<int> m_candidates;
+	// replaced cooked files that a fetch still reads from
+	std::vector<CookedTexture*> m_retiredFiles;
+
+	// jobs waiting for the worker, guarded by m_jobMutex
+	std::deque<FETCH_JOB> m_jobs;
+	std::mutex m_jobMutex;
+	std::condition_variable m_jobReady;
+	// jobs the worker has finished
+	LockFreeQueue<FETCH_JOB> m_fetched;
+	std::thread m_worker;
+	std::atomic<bool> m_bStopping;
+
+	// worker thread loop
+	void WorkerMain();
+	// rebuild a texture with its levels from the passed in
+	// level down and give it to the texture table
+	bool SetResidentLevel(STREAMED_TEXTURE& texture, int level);
+	// drop levels that are no longer needed, least recently
+	// used first, until the passed in bytes fit the budget
+	bool MakeRoom(size_t bytes, int keepIndex);
+	// bytes that dropping all unneeded levels would free
+	size_t SurplusBytes() const;
+	// let go of the cooked file of a texture, or keep it until
+	// the fetch that reads it comes back
+	void ReleaseFile(STREAMED_TEXTURE& texture);
+	// bytes of the levels from the passed in level down
+	static size_t LevelBytes(const STREAMED_TEXTURE& texture, int level);
+};
@@ -0,0 +1,534 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformbatch.cpp
+// ==================
+// This file contains the implementation of the `TransformBatch` class, which
+// composes model matrices in bulk for the instance buffer.
+//
+// RESPONSIBILITIES:
+// - Build translation * rotation * scale matrices four or eight at a time.
+// - Pick the AVX2, SSE2 or NEON kernel at run time, with a scalar fallback.
+// - Write the results as a contiguous column-major matrix array.
+//
+// NOTE: Every kernel uses the same formula as TransformHierarchy::Compose(),
+// so the SIMD and scalar results only differ by floating-point rounding.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformBatch.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define TRANSFORM_BATCH_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define TRANSFORM_BATCH_NEON
+#include <arm_neon.h>
+#endif
+
+// MSVC accepts AVX2 intrinsics in any function, while GCC and
+// Clang need the instruction set enabled on the function itself
+#if defined(TRANSFORM_BATCH_X86) && !defined(_MSC_VER)
+#define TRANSFORM_BATCH_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define TRANSFORM_BATCH_AVX2_TARGET
+#endif
+
+// Namespace for the CPU feature checks and SIMD helpers
+namespace
+{
+#if defined(TRANSFORM_BATCH_X86)
+	// CPUID leaf 1 and leaf 7 feature bits
+	const unsigned int CPUID_EDX_SSE2 = (1u << 26);
+	const unsigned int CPUID_ECX_OSXSAVE = (1u << 27);
+	const unsigned int CPUID_ECX_AVX = (1u << 28);
+	const unsigned int CPUID_EBX_AVX2 = (1u << 5);
+	// XCR0 bits for the SSE and AVX register state
+	const unsigned int XCR0_SSE_AVX_STATE = 0x6;
+
+	// x86 features found at startup
+	struct CPU_FEATURES
+	{
+		bool bSSE2;
+		bool bAVX2;
+	};
+
+	/***********************************************************
+	 *  QueryCPUID()
+	 *
+	 *  This function is used for reading one CPUID leaf into
+	 *  EAX, EBX, ECX and EDX.
+	 ***********************************************************/
+	void QueryCPUID(unsigned int leaf, unsigned int registers[4])
+	{
+#if defined(_MSC_VER)
+		int values[4];
+		__cpuidex(values, (int)leaf, 0);
+		for (int i = 0; i < 4; ++i)
+		{
+			registers[i] = (unsigned int)values[i];
+		}
+#else
+		__cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	/***********************************************************
+	 *  ReadXCR0()
+	 *
+	 *  This function is used for reading which register state
+	 *  the operating system saves across context switches.
+	 ***********************************************************/
+	unsigned int ReadXCR0()
+	{
+#if defined(_MSC_VER)
+		return((unsigned int)_xgetbv(0));
+#else
+		unsigned int low = 0;
+		unsigned int high = 0;
+		__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return(low);
+#endif
+	}
+
+	/***********************************************************
+	 *  DetectCPUFeatures()
+	 *
+	 *  This function is used for checking SSE2 and AVX2.  AVX2
+	 *  also needs the operating system to save the wide
+	 *  registers, which OSXSAVE and XCR0 report.
+	 ***********************************************************/
+	CPU_FEATURES DetectCPUFeatures()
+	{
+		CPU_FEATURES features;
+		unsigned int registers[4];
+
+		features.bSSE2 = false;
+		features.bAVX2 = false;
+
+		QueryCPUID(0, registers);
+		unsigned int highestLeaf = registers[0];
+		if (highestLeaf < 1)
+		{
+			return(features);
+		}
+
+		QueryCPUID(1, registers);
+		features.bSSE2 = (registers[3] & CPUID_EDX_SSE2) != 0;
+
+		bool bAVX = ((registers[2] & CPUID_ECX_OSXSAVE) != 0) &&
+			((registers[2] & CPUID_ECX_AVX) != 0) &&
+			((ReadXCR0() & XCR0_SSE_AVX_STATE) == XCR0_SSE_AVX_STATE);
+		if ((bAVX == true) && (highestLeaf >= 7))
+		{
+			QueryCPUID(7, registers);
+			features.bAVX2 = (registers[1] & CPUID_EBX_AVX2) != 0;
+		}
+
+		return(features);
+	}
+
+	/***********************************************************
+	 *  CPUFeatures()
+	 *
+	 *  This function is used for running the feature check
+	 *  once and returning the cached result.
+	 ***********************************************************/
+	const CPU_FEATURES& CPUFeatures()
+	{
+		static const CPU_FEATURES features = DetectCPUFeatures();
+		return(features);
+	}
+
+	/***********************************************************
+	 *  StoreColumnSSE()
+	 *
+	 *  This function is used for turning one column of four
+	 *  matrices, held as x, y, z and w registers, into four
+	 *  column vectors and storing each into its own matrix.
+	 ***********************************************************/
+	inline void StoreColumnSSE(glm::mat4* output, int column, __m128 x, __m128 y, __m128 z, __m128 w)
+	{
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(&output[0][column][0], x);
+		_mm_storeu_ps(&output[1][column][0], y);
+		_mm_storeu_ps(&output[2][column][0], z);
+		_mm_storeu_ps(&output[3][column][0], w);
+	}
+#endif
+
+#if defined(TRANSFORM_BATCH_NEON)
+	/***********************************************************
+	 *  StoreColumnNEON()
+	 *
+	 *  This function is used for the same column transpose and
+	 *  store as StoreColumnSSE(), with NEON registers.
+	 ***********************************************************/
+	inline void StoreColumnNEON(glm::mat4* output, int column, float32x4_t x, float32x4_t y, float32x4_t z, float32x4_t w)
+	{
+		float32x4x2_t xy = vtrnq_f32(x, y);
+		float32x4x2_t zw = vtrnq_f32(z, w);
+
+		vst1q_f32(&output[0][column][0], vcombine_f32(vget_low_f32(xy.val[0]), vget_low_f32(zw.val[0])));
+		vst1q_f32(&output[1][column][0], vcombine_f32(vget_low_f32(xy.val[1]), vget_low_f32(zw.val[1])));
+		vst1q_f32(&output[2][column][0], vcombine_f32(vget_high_f32(xy.val[0]), vget_high_f32(zw.val[0])));
+		vst1q_f32(&output[3][column][0], vcombine_f32(vget_high_f32(xy.val[1]), vget_high_f32(zw.val[1])));
+	}
+#endif
+}
+
+/***********************************************************
+ *  Compose()
+ *
+ *  This method is used for composing the matrices with the
+ *  fastest kernel available.
+ ***********************************************************/
+void TransformBatch::Compose(const TRANSFORM_STREAMS& input, int count, glm::mat4* output)
+{
+	static const KERNEL bestKernel = BestKernel();
+	ComposeWith(bestKernel, input, count, output);
+}
+
+/***********************************************************
+ *  ComposeWith()
+ *
+ *  This method is used for composing the matrices with the
+ *  passed in kernel.  A kernel that cannot run here falls
+ *  back to the scalar one.
+ ***********************************************************/
+void TransformBatch::ComposeWith(KERNEL kernel, const TRANSFORM_STREAMS& input, int count, glm::mat4* output)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (IsSupported(kernel) == false)
+	{
+		kernel = KERNEL_SCALAR;
+	}
+
+	switch (kernel)
+	{
+	case KERNEL_AVX2:
+		ComposeAVX2(input, count, output);
+		break;
+	case KERNEL_SSE2:
+		ComposeSSE2(input, count, output);
+		break;
+	case KERNEL_NEON:
+		ComposeNEON(input, count, output);
+		break;
+	default:
+		ComposeScalar(input, 0, count, output);
+		break;
+	}
+}
+
+/***********************************************************
+ *  BestKernel()
+ *
+ *  This method is used for choosing the widest kernel that
+ *  this build and CPU can run.
+ ***********************************************************/
+TransformBatch::KERNEL TransformBatch::BestKernel()
+{
+	if (IsSupported(KERNEL_AVX2) == true)
+	{
+		return(KERNEL_AVX2);
+	}
+	if (IsSupported(KERNEL_SSE2) == true)
+	{
+		return(KERNEL_SSE2);
+	}
+	if (IsSupported(KERNEL_NEON) == true)
+	{
+		return(KERNEL_NEON);
+	}
+	return(KERNEL_SCALAR);
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking whether a kernel was
+ *  compiled into this build and the CPU has its
+ *  instructions.
+ ***********************************************************/
+bool TransformBatch::IsSupported(KERNEL kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SCALAR:
+		return(true);
+#if defined(TRANSFORM_BATCH_X86)
+	case KERNEL_SSE2:
+		return(CPUFeatures().bSSE2);
+	case KERNEL_AVX2:
+		return(CPUFeatures().bAVX2);
+#endif
+#if defined(TRANSFORM_BATCH_NEON)
+	case KERNEL_NEON:
+		// NEON is part of every ARMv8 CPU
+		return(true);
+#endif
+	default:
+		return(false);
+	}
+}
+
+/***********************************************************
+ *  KernelName()
+ *
+ *  This method is used for getting a printable name of a
+ *  kernel.
+ ***********************************************************/
+const char* TransformBatch::KernelName(KERNEL kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SCALAR:
+		return("scalar");
+	case KERNEL_SSE2:
+		return("SSE2");
+	case KERNEL_AVX2:
+		return("AVX2");
+	case KERNEL_NEON:
+		return("NEON");
+	default:
+		return("unknown");
+	}
+}
+
+/***********************************************************
+ *  ComposeScalar()
+ *
+ *  This method is used for composing the matrices from
+ *  first up to count one at a time.  The SIMD kernels use
+ *  it for the transforms left over after their last full
+ *  group.
+ ***********************************************************/
+void TransformBatch::ComposeScalar(const TRANSFORM_STREAMS& input, int first, int count, glm::mat4* output)
+{
+	for (int i = first; i < count; ++i)
+	{
+		float x = input.rotationX[i];
+		float y = input.rotationY[i];
+		float z = input.rotationZ[i];
+		float w = input.rotationW[i];
+		float sx = input.scaleX[i];
+		float sy = input.scaleY[i];
+		float sz = input.scaleZ[i];
+
+		float xx = x * x;
+		float yy = y * y;
+		float zz = z * z;
+		float xy = x * y;
+		float xz = x * z;
+		float yz = y * z;
+		float wx = w * x;
+		float wy = w * y;
+		float wz = w * z;
+
+		glm::mat4& matrix = output[i];
+		matrix[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * sx, 2.0f * (xy + wz) * sx, 2.0f * (xz - wy) * sx, 0.0f);
+		matrix[1] = glm::vec4(2.0f * (xy - wz) * sy, (1.0f - 2.0f * (xx + zz)) * sy, 2.0f * (yz + wx) * sy, 0.0f);
+		matrix[2] = glm::vec4(2.0f * (xz + wy) * sz, 2.0f * (yz - wx) * sz, (1.0f - 2.0f * (xx + yy)) * sz, 0.0f);
+		matrix[3] = glm::vec4(input.positionX[i], input.positionY[i], input.positionZ[i], 1.0f);
+	}
+}
+
+/***********************************************************
+ *  ComposeSSE2()
+ *
+ *  This method is used for composing four matrices per
+ *  step.  Each register holds the same component of four
+ *  transforms, and the columns are transposed into matrix
+ *  order while storing.
+ ***********************************************************/
+void TransformBatch::ComposeSSE2(const TRANSFORM_STREAMS& input, int count, glm::mat4* output)
+{
+	int i = 0;
+
+#if defined(TRANSFORM_BATCH_X86)
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(input.rotationX + i);
+		__m128 y = _mm_loadu_ps(input.rotationY + i);
+		__m128 z = _mm_loadu_ps(input.rotationZ + i);
+		__m128 w = _mm_loadu_ps(input.rotationW + i);
+		__m128 sx = _mm_loadu_ps(input.scaleX + i);
+		__m128 sy = _mm_loadu_ps(input.scaleY + i);
+		__m128 sz = _mm_loadu_ps(input.scaleZ + i);
+
+		__m128 xx = _mm_mul_ps(x, x);
+		__m128 yy = _mm_mul_ps(y, y);
+		__m128 zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y);
+		__m128 xz = _mm_mul_ps(x, z);
+		__m128 yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x);
+		__m128 wy = _mm_mul_ps(w, y);
+		__m128 wz = _mm_mul_ps(w, z);
+
+		__m128 m00 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		__m128 m01 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		__m128 m02 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		__m128 m10 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		__m128 m11 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		__m128 m12 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		__m128 m20 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		__m128 m21 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		__m128 m22 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+
+		StoreColumnSSE(output + i, 0, m00, m01, m02, zero);
+		StoreColumnSSE(output + i, 1, m10, m11, m12, zero);
+		StoreColumnSSE(output + i, 2, m20, m21, m22, zero);
+		StoreColumnSSE(output + i, 3,
+			_mm_loadu_ps(input.positionX + i),
+			_mm_loadu_ps(input.positionY + i),
+			_mm_loadu_ps(input.positionZ + i),
+			one);
+	}
+#endif
+
+	ComposeScalar(input, i, count, output);
+}
+
+/***********************************************************
+ *  ComposeAVX2()
+ *
+ *  This method is used for composing eight matrices per
+ *  step.  The math runs on 256-bit registers, and each half
+ *  is stored through the same transpose as the SSE2 kernel.
+ ***********************************************************/
+TRANSFORM_BATCH_AVX2_TARGET
+void TransformBatch::ComposeAVX2(const TRANSFORM_STREAMS& input, int count, glm::mat4* output)
+{
+	int i = 0;
+
+#if defined(TRANSFORM_BATCH_X86)
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one4 = _mm_set1_ps(1.0f);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(input.rotationX + i);
+		__m256 y = _mm256_loadu_ps(input.rotationY + i);
+		__m256 z = _mm256_loadu_ps(input.rotationZ + i);
+		__m256 w = _mm256_loadu_ps(input.rotationW + i);
+		__m256 sx = _mm256_loadu_ps(input.scaleX + i);
+		__m256 sy = _mm256_loadu_ps(input.scaleY + i);
+		__m256 sz = _mm256_loadu_ps(input.scaleZ + i);
+
+		__m256 xx = _mm256_mul_ps(x, x);
+		__m256 yy = _mm256_mul_ps(y, y);
+		__m256 zz = _mm256_mul_ps(z, z);
+		__m256 xy = _mm256_mul_ps(x, y);
+		__m256 xz = _mm256_mul_ps(x, z);
+		__m256 yz = _mm256_mul_ps(y, z);
+		__m256 wx = _mm256_mul_ps(w, x);
+		__m256 wy = _mm256_mul_ps(w, y);
+		__m256 wz = _mm256_mul_ps(w, z);
+
+		__m256 m[4][3];
+		m[0][0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx);
+		m[0][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+		m[0][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+		m[1][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+		m[1][1] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy);
+		m[1][2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+		m[2][0] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+		m[2][1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+		m[2][2] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz);
+		m[3][0] = _mm256_loadu_ps(input.positionX + i);
+		m[3][1] = _mm256_loadu_ps(input.positionY + i);
+		m[3][2] = _mm256_loadu_ps(input.positionZ + i);
+
+		for (int column = 0; column < 4; ++column)
+		{
+			__m128 w4 = (column == 3) ? one4 : zero;
+
+			StoreColumnSSE(output + i, column,
+				_mm256_castps256_ps128(m[column][0]),
+				_mm256_castps256_ps128(m[column][1]),
+				_mm256_castps256_ps128(m[column][2]),
+				w4);
+			StoreColumnSSE(output + i + 4, column,
+				_mm256_extractf128_ps(m[column][0], 1),
+				_mm256_extractf128_ps(m[column][1], 1),
+				_mm256_extractf128_ps(m[column][2], 1),
+				w4);
+		}
+	}
+#endif
+
+	ComposeScalar(input, i, count, output);
+}
+
+/***********************************************************
+ *  ComposeNEON()
+ *
+ *  This method is used for composing four matrices per
+ *  step on ARM, in the same way as the SSE2 kernel.
+ ***********************************************************/
+void TransformBatch::ComposeNEON(const TRANSFORM_STREAMS& input, int count, glm::mat4* output)
+{
+	int i = 0;
+
+#if defined(TRANSFORM_BATCH_NEON)
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t two = vdupq_n_f32(2.0f);
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t x = vld1q_f32(input.rotationX + i);
+		float32x4_t y = vld1q_f32(input.rotationY + i);
+		float32x4_t z = vld1q_f32(input.rotationZ + i);
+		float32x4_t w = vld1q_f32(input.rotationW + i);
+		float32x4_t sx = vld1q_f32(input.scaleX + i);
+		float32x4_t sy = vld1q_f32(input.scaleY + i);
+		float32x4_t sz = vld1q_f32(input.scaleZ + i);
+
+		float32x4_t xx = vmulq_f32(x, x);
+		float32x4_t yy = vmulq_f32(y, y);
+		float32x4_t zz = vmulq_f32(z, z);
+		float32x4_t xy = vmulq_f32(x, y);
+		float32x4_t xz = vmulq_f32(x, z);
+		float32x4_t yz = vmulq_f32(y, z);
+		float32x4_t wx = vmulq_f32(w, x);
+		float32x4_t wy = vmulq_f32(w, y);
+		float32x4_t wz = vmulq_f32(w, z);
+
+		float32x4_t m00 = vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(yy, zz))), sx);
+		float32x4_t m01 = vmulq_f32(vmulq_f32(two, vaddq_f32(xy, wz)), sx);
+		float32x4_t m02 = vmulq_f32(vmulq_f32(two, vsubq_f32(xz, wy)), sx);
+		float32x4_t m10 = vmulq_f32(vmulq_f32(two, vsubq_f32(xy, wz)), sy);
+		float32x4_t m11 = vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, zz))), sy);
+		float32x4_t m12 = vmulq_f32(vmulq_f32(two, vaddq_f32(yz, wx)), sy);
+		float32x4_t m20 = vmulq_f32(vmulq_f32(two, vaddq_f32(xz, wy)), sz);
+		float32x4_t m21 = vmulq_f32(vmulq_f32(two, vsubq_f32(yz, wx)), sz);
+		float32x4_t m22 = vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, yy))), sz);
+
+		StoreColumnNEON(output + i, 0, m00, m01, m02, zero);
+		StoreColumnNEON(output + i, 1, m10, m11, m12, zero);
+		StoreColumnNEON(output + i, 2, m20, m21, m22, zero);
+		StoreColumnNEON(output + i, 3,
+			vld1q_f32(input.positionX + i),
+			vld1q_f32(input.positionY + i),
+			vld1q_f32(input.positionZ + i),
+			one);
+	}
+#endif
+
+	ComposeScalar(input, i, count, output);
+}
@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformbatch.h
+// ============
+// compose many translation * rotation * scale matrices at once from
+// structure-of-arrays input, using the widest SIMD path the CPU supports
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  TransformBatch
+ *
+ *  This class holds the batch transform kernels.  The input
+ *  is ten separate float streams so that four or eight
+ *  transforms load straight into SIMD registers, and the
+ *  output is a contiguous array of column-major matrices in
+ *  the layout the instance buffer expects.  The rotation
+ *  quaternions are expected to be normalized.
+ ***********************************************************/
+class TransformBatch
+{
+public:
+	// the batch kernels, from slowest to fastest
+	enum KERNEL
+	{
+		KERNEL_SCALAR,
+		KERNEL_SSE2,
+		KERNEL_AVX2,
+		KERNEL_NEON,
+		KERNEL_COUNT
+	};
+
+	// structure-of-arrays input, one stream per component
+	struct TRANSFORM_STREAMS
+	{
+		const float* positionX;
+		const float* positionY;
+		const float* positionZ;
+		const float* rotationX;
+		const float* rotationY;
+		const float* rotationZ;
+		const float* rotationW;
+		const float* scaleX;
+		const float* scaleY;
+		const float* scaleZ;
+	};
+
+	// compose the matrices with the best kernel for this CPU
+	static void Compose(const TRANSFORM_STREAMS& input, int count, glm::mat4* output);
+	// compose the matrices with one specific kernel
+	static void ComposeWith(KERNEL kernel, const TRANSFORM_STREAMS& input, int count, glm::mat4* output);
+
+	// fastest kernel that this build and CPU can run
+	static KERNEL BestKernel();
+	// check whether a kernel can run on this build and CPU
+	static bool IsSupported(KERNEL kernel);
+	// readable name of a kernel
+	static const char* KernelName(KERNEL kernel);
+
+private:
+	// the kernel implementations, each one handles a tail
+	// of fewer than its width with the scalar kernel
+	static void ComposeScalar(const TRANSFORM_STREAMS& input, int first, int count, glm::mat4* output);
+	static void ComposeSSE2(const TRANSFORM_STREAMS& input, int count, glm::mat4* output);
+	static void ComposeAVX2(const TRANSFORM_STREAMS& input, int count, glm::mat4* output);
+	static void ComposeNEON(const TRANSFORM_STREAMS& input, int count, glm::mat4* output);
+};
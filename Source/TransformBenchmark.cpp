@@ -0,0 +1,218 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformbenchmark.cpp
+// ======================
+// This file contains the implementation of the `TransformBenchmark` class,
+// which measures how fast model matrices can be composed on the CPU.
+//
+// RESPONSIBILITIES:
+// - Generate random scale, euler rotation and position values.
+// - Time the per-object SetTransformations() composition as the baseline.
+// - Time every batch kernel this CPU supports and check it against the
+//   baseline matrices.
+//
+// NOTE: The baseline converts euler angles on every pass, as the scene code
+// does; the batch kernels start from quaternions that are converted once,
+// which is how the transform hierarchy stores them.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformBenchmark.h"
+#include "TransformBatch.h"
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Namespace for the benchmark helpers
+namespace
+{
+	// random values are repeatable between runs
+	const unsigned int BENCHMARK_SEED = 330;
+
+	// euler transformation as passed to SetTransformations()
+	struct EULER_TRANSFORM
+	{
+		glm::vec3 scale;
+		glm::vec3 rotationDegrees;
+		glm::vec3 position;
+	};
+
+	/***********************************************************
+	 *  RandomRange()
+	 *
+	 *  This function is used for a random float between the
+	 *  passed in limits.
+	 ***********************************************************/
+	float RandomRange(float minimum, float maximum)
+	{
+		return(minimum + (maximum - minimum) * ((float)rand() / (float)RAND_MAX));
+	}
+
+	/***********************************************************
+	 *  Checksum()
+	 *
+	 *  This function is used for summing the matrices so the
+	 *  compiler cannot skip the timed work.
+	 ***********************************************************/
+	float Checksum(const std::vector<glm::mat4>& matrices)
+	{
+		float sum = 0.0f;
+		for (size_t i = 0; i < matrices.size(); ++i)
+		{
+			sum += matrices[i][0][0] + matrices[i][1][1] + matrices[i][2][2] + matrices[i][3][0];
+		}
+		return(sum);
+	}
+
+	/***********************************************************
+	 *  MaxDifference()
+	 *
+	 *  This function is used for the largest element
+	 *  difference between two matrix arrays.
+	 ***********************************************************/
+	float MaxDifference(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b)
+	{
+		float difference = 0.0f;
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				for (int row = 0; row < 4; ++row)
+				{
+					difference = std::max(difference, std::fabs(a[i][column][row] - b[i][column][row]));
+				}
+			}
+		}
+		return(difference);
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for running the benchmark and
+ *  printing the best pass time of each path.  EXIT_SUCCESS
+ *  is returned unless a kernel disagrees with the baseline.
+ ***********************************************************/
+int TransformBenchmark::Run(int count, int passes)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	count = std::max(count, 1);
+	passes = std::max(passes, 1);
+	srand(BENCHMARK_SEED);
+
+	std::vector<EULER_TRANSFORM> eulers(count);
+	std::vector<float> streams((size_t)count * 10);
+	TransformBatch::TRANSFORM_STREAMS input;
+	input.positionX = &streams[0];
+	input.positionY = &streams[count];
+	input.positionZ = &streams[(size_t)count * 2];
+	input.rotationX = &streams[(size_t)count * 3];
+	input.rotationY = &streams[(size_t)count * 4];
+	input.rotationZ = &streams[(size_t)count * 5];
+	input.rotationW = &streams[(size_t)count * 6];
+	input.scaleX = &streams[(size_t)count * 7];
+	input.scaleY = &streams[(size_t)count * 8];
+	input.scaleZ = &streams[(size_t)count * 9];
+
+	for (int i = 0; i < count; ++i)
+	{
+		EULER_TRANSFORM& euler = eulers[i];
+		euler.scale = glm::vec3(RandomRange(0.1f, 4.0f), RandomRange(0.1f, 4.0f), RandomRange(0.1f, 4.0f));
+		euler.rotationDegrees = glm::vec3(RandomRange(-180.0f, 180.0f), RandomRange(-180.0f, 180.0f), RandomRange(-180.0f, 180.0f));
+		euler.position = glm::vec3(RandomRange(-20.0f, 20.0f), RandomRange(0.0f, 10.0f), RandomRange(-20.0f, 20.0f));
+
+		TransformHierarchy::TRANSFORM local = TransformHierarchy::FromEuler(
+			euler.scale,
+			euler.rotationDegrees.x,
+			euler.rotationDegrees.y,
+			euler.rotationDegrees.z,
+			euler.position);
+		streams[i] = local.position.x;
+		streams[i + count] = local.position.y;
+		streams[i + count * 2] = local.position.z;
+		streams[i + count * 3] = local.rotation.x;
+		streams[i + count * 4] = local.rotation.y;
+		streams[i + count * 5] = local.rotation.z;
+		streams[i + count * 6] = local.rotation.w;
+		streams[i + count * 7] = local.scale.x;
+		streams[i + count * 8] = local.scale.y;
+		streams[i + count * 9] = local.scale.z;
+	}
+
+	std::vector<glm::mat4> baseline(count);
+	std::vector<glm::mat4> batch(count);
+	float checksum = 0.0f;
+	int result = EXIT_SUCCESS;
+
+	printf("Transform benchmark: %d transforms, best of %d passes\n", count, passes);
+
+	// baseline - one euler conversion and compose per object,
+	// the same work SetTransformations() does before its upload
+	double baselineBest = 0.0;
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < count; ++i)
+		{
+			const EULER_TRANSFORM& euler = eulers[i];
+			baseline[i] = TransformHierarchy::Compose(TransformHierarchy::FromEuler(
+				euler.scale,
+				euler.rotationDegrees.x,
+				euler.rotationDegrees.y,
+				euler.rotationDegrees.z,
+				euler.position));
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		baselineBest = (pass == 0) ? seconds : std::min(baselineBest, seconds);
+		checksum += Checksum(baseline);
+	}
+	printf("  %-20s %10.3f ms %8.2f ns/matrix\n",
+		"SetTransformations",
+		baselineBest * 1000.0,
+		baselineBest * 1.0e9 / count);
+
+	for (int kernel = 0; kernel < TransformBatch::KERNEL_COUNT; ++kernel)
+	{
+		TransformBatch::KERNEL batchKernel = (TransformBatch::KERNEL)kernel;
+		if (TransformBatch::IsSupported(batchKernel) == false)
+		{
+			continue;
+		}
+
+		double best = 0.0;
+		for (int pass = 0; pass < passes; ++pass)
+		{
+			Clock::time_point start = Clock::now();
+			TransformBatch::ComposeWith(batchKernel, input, count, batch.data());
+			double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			best = (pass == 0) ? seconds : std::min(best, seconds);
+			checksum += Checksum(batch);
+		}
+
+		// matrix elements reach about 4, so this allows a
+		// few units of float rounding
+		float difference = MaxDifference(baseline, batch);
+		if (difference > 1.0e-4f)
+		{
+			result = EXIT_FAILURE;
+		}
+
+		printf("  %-20s %10.3f ms %8.2f ns/matrix %6.2fx  max error %g\n",
+			TransformBatch::KernelName(batchKernel),
+			best * 1000.0,
+			best * 1.0e9 / count,
+			(best > 0.0) ? baselineBest / best : 0.0,
+			difference);
+	}
+
+	printf("  selected kernel: %s (checksum %g)\n",
+		TransformBatch::KernelName(TransformBatch::BestKernel()),
+		checksum);
+
+	return(result);
+}
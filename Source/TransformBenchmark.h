@@ -0,0 +1,23 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformbenchmark.h
+// ============
+// time the batch transform kernels against composing one model matrix per
+// object the way SetTransformations() does
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+/***********************************************************
+ *  TransformBenchmark
+ *
+ *  This class runs the transform microbenchmark started by
+ *  the --bench-transforms command line option.  It needs no
+ *  window or GL context, and prints one line per path.
+ ***********************************************************/
+class TransformBenchmark
+{
+public:
+	// compose count random transforms per pass, for the
+	// passed in number of passes, and print the results
+	static int Run(int count, int passes);
+};
@@ -0,0 +1,308 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformhierarchy.cpp
+// ======================
+// This file contains the implementation of the `TransformHierarchy` class,
+// which caches the world matrices of a tree of transform nodes.
+//
+// RESPONSIBILITIES:
+// - Store position, quaternion rotation and scale for every node.
+// - Recompose world matrices only for dirty nodes and their children.
+// - Report which nodes changed so their GPU copies can be refreshed.
+//
+// NOTE: Static nodes are composed once when they are created and never
+// touched again, so a scene that does not move costs nothing per frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformHierarchy.h"
+#include "TransformBatch.h"
+
+#include <algorithm>
+
+/***********************************************************
+ *  TransformHierarchy()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransformHierarchy::TransformHierarchy()
+{
+	m_firstDirty = -1;
+}
+
+/***********************************************************
+ *  CreateNode()
+ *
+ *  This method is used for adding a node.  Its world matrix
+ *  is composed right away, so it is valid before the next
+ *  update.  The index of the new node is returned, or -1
+ *  when the parent does not exist yet.
+ ***********************************************************/
+int TransformHierarchy::CreateNode(int parent, const TRANSFORM& local)
+{
+	if (parent >= (int)m_local.size())
+	{
+		return(-1);
+	}
+
+	glm::mat4 world = Compose(local);
+	if (parent >= 0)
+	{
+		world = m_world[parent] * world;
+	}
+
+	m_local.push_back(local);
+	m_parent.push_back(parent);
+	m_world.push_back(world);
+	m_dirty.push_back(0);
+
+	return((int)m_local.size() - 1);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every node.
+ ***********************************************************/
+void TransformHierarchy::Clear()
+{
+	m_local.clear();
+	m_parent.clear();
+	m_world.clear();
+	m_dirty.clear();
+	m_changedNodes.clear();
+	m_firstDirty = -1;
+}
+
+/***********************************************************
+ *  Reserve()
+ *
+ *  This method is used for growing the node arrays ahead
+ *  of adding many nodes at once, such as a loaded scene.
+ ***********************************************************/
+void TransformHierarchy::Reserve(int nodeCount)
+{
+	size_t capacity = m_local.size() + (size_t)std::max(nodeCount, 0);
+	m_local.reserve(capacity);
+	m_parent.reserve(capacity);
+	m_world.reserve(capacity);
+	m_dirty.reserve(capacity);
+	m_changedNodes.reserve(capacity);
+}
+
+/***********************************************************
+ *  SetLocalTransform()
+ *
+ *  This method is used for replacing the local position,
+ *  rotation and scale of a node.
+ ***********************************************************/
+void TransformHierarchy::SetLocalTransform(int node, const TRANSFORM& local)
+{
+	if ((node < 0) || (node >= (int)m_local.size()))
+	{
+		return;
+	}
+
+	m_local[node] = local;
+	MarkDirty(node);
+}
+
+/***********************************************************
+ *  SetLocalPosition()
+ *
+ *  This method is used for moving a node.
+ ***********************************************************/
+void TransformHierarchy::SetLocalPosition(int node, glm::vec3 position)
+{
+	if ((node < 0) || (node >= (int)m_local.size()))
+	{
+		return;
+	}
+
+	m_local[node].position = position;
+	MarkDirty(node);
+}
+
+/***********************************************************
+ *  SetLocalRotation()
+ *
+ *  This method is used for rotating a node.
+ ***********************************************************/
+void TransformHierarchy::SetLocalRotation(int node, glm::quat rotation)
+{
+	if ((node < 0) || (node >= (int)m_local.size()))
+	{
+		return;
+	}
+
+	m_local[node].rotation = rotation;
+	MarkDirty(node);
+}
+
+/***********************************************************
+ *  SetLocalScale()
+ *
+ *  This method is used for resizing a node.
+ ***********************************************************/
+void TransformHierarchy::SetLocalScale(int node, glm::vec3 scale)
+{
+	if ((node < 0) || (node >= (int)m_local.size()))
+	{
+		return;
+	}
+
+	m_local[node].scale = scale;
+	MarkDirty(node);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for recomposing the world matrices
+ *  of the dirty nodes.  Walking the nodes in creation order
+ *  visits each parent before its children, so a child is
+ *  recomposed when it is dirty itself or when its parent
+ *  changed during this pass.  The local matrices of all
+ *  changed nodes are built in one batch, then multiplied by
+ *  their parents in the same order.  The number of changed
+ *  nodes is returned.
+ ***********************************************************/
+int TransformHierarchy::Update()
+{
+	m_changedNodes.clear();
+
+	if (m_firstDirty < 0)
+	{
+		return(0);
+	}
+
+	for (int node = m_firstDirty; node < (int)m_local.size(); ++node)
+	{
+		int parent = m_parent[node];
+		bool bParentChanged = (parent >= 0) && (m_dirty[parent] != 0);
+
+		if ((m_dirty[node] == 0) && (bParentChanged == false))
+		{
+			continue;
+		}
+
+		// the flag stays set for this pass so the children see it
+		m_dirty[node] = 1;
+		m_changedNodes.push_back(node);
+	}
+
+	// split the changed transforms into one stream per component
+	int changedCount = (int)m_changedNodes.size();
+	m_streams.resize((size_t)changedCount * 10);
+	m_composed.resize(changedCount);
+
+	float* streams = m_streams.data();
+	TransformBatch::TRANSFORM_STREAMS input;
+	input.positionX = streams;
+	input.positionY = streams + changedCount;
+	input.positionZ = streams + changedCount * 2;
+	input.rotationX = streams + changedCount * 3;
+	input.rotationY = streams + changedCount * 4;
+	input.rotationZ = streams + changedCount * 5;
+	input.rotationW = streams + changedCount * 6;
+	input.scaleX = streams + changedCount * 7;
+	input.scaleY = streams + changedCount * 8;
+	input.scaleZ = streams + changedCount * 9;
+
+	for (int i = 0; i < changedCount; ++i)
+	{
+		const TRANSFORM& local = m_local[m_changedNodes[i]];
+		streams[i] = local.position.x;
+		streams[i + changedCount] = local.position.y;
+		streams[i + changedCount * 2] = local.position.z;
+		streams[i + changedCount * 3] = local.rotation.x;
+		streams[i + changedCount * 4] = local.rotation.y;
+		streams[i + changedCount * 5] = local.rotation.z;
+		streams[i + changedCount * 6] = local.rotation.w;
+		streams[i + changedCount * 7] = local.scale.x;
+		streams[i + changedCount * 8] = local.scale.y;
+		streams[i + changedCount * 9] = local.scale.z;
+	}
+
+	TransformBatch::Compose(input, changedCount, m_composed.data());
+
+	for (int i = 0; i < changedCount; ++i)
+	{
+		int node = m_changedNodes[i];
+		int parent = m_parent[node];
+
+		if (parent >= 0)
+		{
+			m_world[node] = m_world[parent] * m_composed[i];
+		}
+		else
+		{
+			m_world[node] = m_composed[i];
+		}
+		m_dirty[node] = 0;
+	}
+	m_firstDirty = -1;
+
+	return(changedCount);
+}
+
+/***********************************************************
+ *  MarkDirty()
+ *
+ *  This method is used for flagging a node for the next
+ *  update.
+ ***********************************************************/
+void TransformHierarchy::MarkDirty(int node)
+{
+	m_dirty[node] = 1;
+	if ((m_firstDirty < 0) || (node < m_firstDirty))
+	{
+		m_firstDirty = node;
+	}
+}
+
+/***********************************************************
+ *  FromEuler()
+ *
+ *  This method is used for converting the scale, euler
+ *  rotation and position arguments that the scene code
+ *  uses into a local transformation.  The rotation order
+ *  matches ComposeTransform() - X first, then Y, then Z.
+ ***********************************************************/
+TransformHierarchy::TRANSFORM TransformHierarchy::FromEuler(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	TRANSFORM local;
+
+	glm::quat rotationX = glm::angleAxis(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+	glm::quat rotationY = glm::angleAxis(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::quat rotationZ = glm::angleAxis(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	local.position = positionXYZ;
+	local.rotation = rotationZ * rotationY * rotationX;
+	local.scale = scaleXYZ;
+
+	return(local);
+}
+
+/***********************************************************
+ *  Compose()
+ *
+ *  This method is used for building translation * rotation
+ *  * scale directly, by scaling the rotation columns,
+ *  instead of multiplying separate matrices together.
+ ***********************************************************/
+glm::mat4 TransformHierarchy::Compose(const TRANSFORM& local)
+{
+	glm::mat3 rotation = glm::mat3_cast(local.rotation);
+	glm::mat4 matrix(1.0f);
+
+	matrix[0] = glm::vec4(rotation[0] * local.scale.x, 0.0f);
+	matrix[1] = glm::vec4(rotation[1] * local.scale.y, 0.0f);
+	matrix[2] = glm::vec4(rotation[2] * local.scale.z, 0.0f);
+	matrix[3] = glm::vec4(local.position, 1.0f);
+
+	return(matrix);
+}
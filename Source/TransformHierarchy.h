@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformhierarchy.h
+// ============
+// store position, rotation and scale of scene nodes, cache their composed
+// world matrices, and recompute them only when a node or a parent changes
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  TransformHierarchy
+ *
+ *  This class keeps every transform node in flat arrays.
+ *  A node is always created after its parent, so a single
+ *  pass in creation order visits parents before children.
+ *  Changing a node only sets its dirty flag; Update() then
+ *  recomposes that node and everything below it in one
+ *  batch, and lists the nodes whose world matrix changed.
+ ***********************************************************/
+class TransformHierarchy
+{
+public:
+	// local transformation of one node, relative to its parent
+	struct TRANSFORM
+	{
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+	};
+
+	// constructor
+	TransformHierarchy();
+
+	// add a node below the passed in parent, or a root for -1
+	int CreateNode(int parent, const TRANSFORM& local);
+	// remove every node
+	void Clear();
+	// make room for more nodes, so that adding them does not
+	// allocate
+	void Reserve(int nodeCount);
+
+	// replace the whole local transformation of a node
+	void SetLocalTransform(int node, const TRANSFORM& local);
+	// change one part of the local transformation of a node
+	void SetLocalPosition(int node, glm::vec3 position);
+	void SetLocalRotation(int node, glm::quat rotation);
+	void SetLocalScale(int node, glm::vec3 scale);
+
+	// recompose the dirty nodes and their children
+	int Update();
+	// nodes whose world matrix changed in the last update
+	const std::vector<int>& ChangedNodes() const { return m_changedNodes; }
+
+	// number of nodes
+	int NodeCount() const { return (int)m_local.size(); }
+	// parent of a node, or -1 for a root
+	int Parent(int node) const { return m_parent[node]; }
+	// local transformation of a node
+	const TRANSFORM& LocalTransform(int node) const { return m_local[node]; }
+	// cached world matrix of a node, valid after Update()
+	const glm::mat4& WorldMatrix(int node) const { return m_world[node]; }
+
+	// build a local transformation from euler angles in degrees,
+	// rotating about X, then Y, then Z like the scene code does
+	static TRANSFORM FromEuler(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
+	// compose the matrix of a local transformation
+	static glm::mat4 Compose(const TRANSFORM& local);
+
+private:
+	// local transformation of every node
+	std::vector<TRANSFORM> m_local;
+	// parent of every node, always lower than the node itself
+	std::vector<int> m_parent;
+	// cached world matrix of every node
+	std::vector<glm::mat4> m_world;
+	// nodes changed since the last update
+	std::vector<unsigned char> m_dirty;
+	// nodes whose world matrix changed in the last update
+	std::vector<int> m_changedNodes;
+	// lowest dirty node, so the update can start there
+	int m_firstDirty;
+	// changed local transforms split into component streams,
+	// and their local matrices, for the batch kernel
+	std::vector<float> m_streams;
+	std::vector<glm::mat4> m_composed;
+
+	// mark a node so that the next update recomposes it
+	void MarkDirty(int node);
+};
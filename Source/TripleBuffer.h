@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// triplebuffer.h
+// ============
+// hand the latest value from one producer thread to one consumer thread
+// without either of them waiting on the other
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+
+/***********************************************************
+ *  TripleBuffer
+ *
+ *  This class keeps three copies of a value: the producer
+ *  fills its back copy and publishes it, the consumer reads
+ *  its front copy, and the third sits in the middle holding
+ *  the newest published value.  Publishing and taking the
+ *  newest value each swap one copy with the middle one in a
+ *  single atomic exchange, so neither thread ever blocks or
+ *  sees a copy the other one is writing.  Values published
+ *  faster than they are read are overwritten, the consumer
+ *  only ever gets the latest one.
+ ***********************************************************/
+template <typename T>
+class TripleBuffer
+{
+public:
+	// constructor
+	TripleBuffer() : m_middle(1)
+	{
+		m_back = 0;
+		m_front = 2;
+	}
+
+	// get the copy the producer fills before it publishes
+	T& WriteBuffer() { return m_slots[m_back]; }
+
+	// make the filled copy the newest value, the producer gets
+	// the old middle copy to fill next
+	void Publish()
+	{
+		int previous = m_middle.exchange(m_back | FRESH_BIT, std::memory_order_acq_rel);
+		m_back = previous & INDEX_MASK;
+	}
+
+	// take the newest value for reading, false when nothing was
+	// published since the last call and the front copy is kept
+	bool Update()
+	{
+		if (0 == (m_middle.load(std::memory_order_relaxed) & FRESH_BIT))
+		{
+			return(false);
+		}
+
+		int previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+		m_front = previous & INDEX_MASK;
+		return(true);
+	}
+
+	// get the copy the consumer took last
+	const T& ReadBuffer() const { return m_slots[m_front]; }
+
+private:
+	// the middle index carries a bit that is set while it holds
+	// a value the consumer has not taken yet
+	static const int INDEX_MASK = 3;
+	static const int FRESH_BIT = 4;
+
+	T m_slots[3];
+	// copy owned by the producer, padded away from the middle
+	// index and the consumer's copy so they do not share a line
+	int m_back;
+	char m_backPadding[64];
+	std::atomic<int> m_middle;
+	char m_middlePadding[64];
+	int m_front;
+};
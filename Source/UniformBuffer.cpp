@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformbuffer.cpp
+// =================
+// This file contains the implementation of the `UniformBuffer` class, which
+// owns the GPU storage of one std140 uniform block.
+//
+// RESPONSIBILITIES:
+// - Allocate uniform buffers and attach them to binding points.
+// - Update ranges of a buffer with a single glBufferSubData call, or
+//   through the upload ring when one is set.
+// - Bind blocks that are sent whole every frame straight from the ring.
+// - Connect the uniform blocks of shader programs to binding points.
+//
+// NOTE: glUniformBlockBinding is used instead of a GLSL binding layout
+// qualifier so that the shaders stay compatible with OpenGL 3.3.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformBuffer.h"
+#include "UploadRing.h"
+#include "Profiler.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  UniformBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformBuffer::UniformBuffer()
+{
+	m_buffer = 0;
+	m_size = 0;
+	m_bindingPoint = 0;
+	m_pUploadRing = NULL;
+	m_bBoundToRing = false;
+}
+
+/***********************************************************
+ *  ~UniformBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UniformBuffer::~UniformBuffer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for allocating the uniform buffer
+ *  and attaching it to the passed in binding point.
+ ***********************************************************/
+bool UniformBuffer::Create(GLsizeiptr size, GLuint bindingPoint)
+{
+	Destroy();
+
+	glGenBuffers(1, &m_buffer);
+	if (0 == m_buffer)
+	{
+		std::cout << "Could not create uniform buffer for binding point:" << bindingPoint << std::endl;
+		return(false);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, m_buffer);
+	m_size = size;
+	m_bindingPoint = bindingPoint;
+	m_bBoundToRing = false;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for copying new data into a range of
+ *  the uniform buffer, through the upload ring while it has
+ *  room.
+ ***********************************************************/
+void UniformBuffer::Update(GLintptr offset, GLsizeiptr size, const void* data) const
+{
+	if ((0 == m_buffer) || (offset < 0) || (offset + size > m_size))
+	{
+		return;
+	}
+
+	Profiler::CountUniformUpload();
+	if ((NULL != m_pUploadRing) && m_pUploadRing->CopyToBuffer(m_buffer, offset, size, data))
+	{
+		return;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Stream()
+ *
+ *  This method is used for sending the whole block for one
+ *  frame.  The binding point reads the block from a slice
+ *  of the upload ring, without a copy; when there is no
+ *  ring or it is full, the buffer is bound back and updated
+ *  instead.
+ ***********************************************************/
+void UniformBuffer::Stream(GLsizeiptr size, const void* data)
+{
+	if ((0 == m_buffer) || (size > m_size))
+	{
+		return;
+	}
+
+	Profiler::CountUniformUpload();
+	if ((NULL != m_pUploadRing) && m_pUploadRing->BindUniformBlock(m_bindingPoint, size, data))
+	{
+		m_bBoundToRing = true;
+		return;
+	}
+
+	if (m_bBoundToRing)
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, m_bindingPoint, m_buffer);
+		m_bBoundToRing = false;
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the uniform buffer.
+ ***********************************************************/
+void UniformBuffer::Destroy()
+{
+	if (0 != m_buffer)
+	{
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+	m_size = 0;
+}
+
+/***********************************************************
+ *  BindProgramBlock()
+ *
+ *  This method is used for connecting the named uniform
+ *  block of a program to a binding point.  Programs that
+ *  do not use the block are left unchanged.
+ ***********************************************************/
+bool UniformBuffer::BindProgramBlock(GLuint programID, const char* blockName, GLuint bindingPoint)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, blockName);
+	if (GL_INVALID_INDEX == blockIndex)
+	{
+		std::cout << "Uniform block is not active in the shader program:" << blockName << std::endl;
+		return(false);
+	}
+
+	glUniformBlockBinding(programID, blockIndex, bindingPoint);
+
+	return(true);
+}
@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformbuffer.h
+// ============
+// own one uniform buffer object that is attached to a shared binding point
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+class UploadRing;
+
+/***********************************************************
+ *  UniformBuffer
+ *
+ *  This class holds the GPU storage of one uniform block.
+ *  The buffer stays attached to its binding point, so every
+ *  program that binds the same block name to that point
+ *  reads the same data.  With an upload ring set, updates
+ *  are written into the ring and copied on the GPU, and a
+ *  block sent whole every frame can be read from the ring
+ *  directly.
+ ***********************************************************/
+class UniformBuffer
+{
+public:
+	// constructor
+	UniformBuffer();
+	// destructor
+	~UniformBuffer();
+
+	// allocate the buffer and attach it to a binding point
+	bool Create(GLsizeiptr size, GLuint bindingPoint);
+	// copy new data into a range of the buffer
+	void Update(GLintptr offset, GLsizeiptr size, const void* data) const;
+	// replace the whole block for this frame only, to be called
+	// again every frame
+	void Stream(GLsizeiptr size, const void* data);
+	// free the buffer
+	void Destroy();
+
+	// send the updates through an upload ring, NULL to send
+	// them with glBufferSubData
+	void SetUploadRing(UploadRing* pUploadRing) { m_pUploadRing = pUploadRing; }
+
+	// connect a named block of a program to a binding point
+	static bool BindProgramBlock(GLuint programID, const char* blockName, GLuint bindingPoint);
+
+private:
+	// OpenGL buffer name
+	GLuint m_buffer;
+	// size of the buffer in bytes
+	GLsizeiptr m_size;
+	// binding point the block is read at
+	GLuint m_bindingPoint;
+	// ring the updates go through, and whether the binding
+	// point reads a slice of it instead of the buffer
+	UploadRing* m_pUploadRing;
+	bool m_bBoundToRing;
+};
@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.cpp
+// ================
+// This file contains the implementation of the `UniformCache` class, which
+// reflects the active uniforms of a shader program into a location table.
+//
+// RESPONSIBILITIES:
+// - Query every active uniform of a linked program once.
+// - Expand uniform arrays so each element can be found by name.
+// - Resolve uniform names into typed handles for the draw code.
+//
+// NOTE: The handles set values on the currently bound program, so the
+// program passed to Reflect() must be in use while they are set.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformCache.h"
+
+#include <iostream>
+#include <vector>
+
+/***********************************************************
+ *  UniformCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformCache::UniformCache()
+{
+	m_programID = 0;
+}
+
+/***********************************************************
+ *  Reflect()
+ *
+ *  This method is used for reading the name and location of
+ *  every active uniform in the passed in program.  Arrays of
+ *  basic types are reported once by OpenGL as "name[0]", so
+ *  the remaining elements and the bare name are added too.
+ *  Members of uniform blocks have no location and are left
+ *  out of the table.
+ ***********************************************************/
+bool UniformCache::Reflect(GLuint programID)
+{
+	m_locations.clear();
+	m_programID = programID;
+
+	if (0 == programID)
+	{
+		std::cout << "Uniform reflection needs a linked shader program" << std::endl;
+		return(false);
+	}
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<GLchar> nameBuffer(maxNameLength + 1, '\0');
+
+	for (GLint index = 0; index < uniformCount; ++index)
+	{
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type = 0;
+		glGetActiveUniform(
+			programID,
+			(GLuint)index,
+			(GLsizei)nameBuffer.size(),
+			&nameLength,
+			&arraySize,
+			&type,
+			nameBuffer.data());
+
+		std::string name(nameBuffer.data(), nameLength);
+		GLint location = glGetUniformLocation(programID, name.c_str());
+		if (location < 0)
+		{
+			continue;
+		}
+		m_locations[name] = location;
+
+		// "name[0]" - add the bare name and the other elements
+		size_t suffix = name.size() - 3;
+		if ((name.size() > 3) && (name.compare(suffix, 3, "[0]") == 0))
+		{
+			std::string baseName = name.substr(0, suffix);
+			m_locations[baseName] = location;
+
+			for (GLint element = 1; element < arraySize; ++element)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				GLint elementLocation = glGetUniformLocation(programID, elementName.c_str());
+				if (elementLocation >= 0)
+				{
+					m_locations[elementName] = elementLocation;
+				}
+			}
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  FindLocation()
+ *
+ *  This method is used for getting the location of the named
+ *  uniform from the table.  Uniforms that the compiler has
+ *  removed, or that are misspelled, are reported once here
+ *  instead of silently failing on every draw.
+ ***********************************************************/
+GLint UniformCache::FindLocation(const std::string& name) const
+{
+	std::unordered_map<std::string, GLint>::const_iterator found = m_locations.find(name);
+	if (found == m_locations.end())
+	{
+		std::cout << "Uniform is not active in the shader program:" << name << std::endl;
+		return(-1);
+	}
+
+	return(found->second);
+}
@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformcache.h
+// ============
+// reflect the active uniforms of a linked shader program once and hand out
+// pre-resolved, typed uniform handles so that no name lookups are needed
+// while the scene is being drawn
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Profiler.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <string>
+#include <unordered_map>
+
+/***********************************************************
+ *  UniformHandle
+ *
+ *  This class holds the location of one uniform of a known
+ *  type.  Setting a value is a single glUniform call on the
+ *  currently bound program.  A handle for a uniform that is
+ *  not in the program is invalid and setting it does nothing.
+ ***********************************************************/
+template <typename T>
+class UniformHandle
+{
+public:
+	// constructors
+	UniformHandle() : m_location(-1) {}
+	explicit UniformHandle(GLint location) : m_location(location) {}
+
+	// check whether the uniform exists in the program
+	bool IsValid() const { return m_location >= 0; }
+	// location of the uniform in the program
+	GLint Location() const { return m_location; }
+
+	// send a new value for the uniform into the bound program
+	void Set(const T& value) const;
+
+private:
+	// location reflected from the program, -1 when missing
+	GLint m_location;
+};
+
+template <>
+inline void UniformHandle<bool>::Set(const bool& value) const
+{
+	glUniform1i(m_location, (int)value);
+	Profiler::CountUniformUpload();
+}
+
+template <>
+inline void UniformHandle<int>::Set(const int& value) const
+{
+	glUniform1i(m_location, value);
+	Profiler::CountUniformUpload();
+}
+
+template <>
+inline void UniformHandle<float>::Set(const float& value) const
+{
+	glUniform1f(m_location, value);
+	Profiler::CountUniformUpload();
+}
+
+template <>
+inline void UniformHandle<glm::vec2>::Set(const glm::vec2& value) const
+{
+	glUniform2fv(m_location, 1, glm::value_ptr(value));
+	Profiler::CountUniformUpload();
+}
+
+template <>
+inline void UniformHandle<glm::vec3>::Set(const glm::vec3& value) const
+{
+	glUniform3fv(m_location, 1, glm::value_ptr(value));
+	Profiler::CountUniformUpload();
+}
+
+template <>
+inline void UniformHandle<glm::vec4>::Set(const glm::vec4& value) const
+{
+	glUniform4fv(m_location, 1, glm::value_ptr(value));
+	Profiler::CountUniformUpload();
+}
+
+template <>
+inline void UniformHandle<glm::mat4>::Set(const glm::mat4& value) const
+{
+	glUniformMatrix4fv(m_location, 1, GL_FALSE, glm::value_ptr(value));
+	Profiler::CountUniformUpload();
+}
+
+/***********************************************************
+ *  UniformCache
+ *
+ *  This class keeps a hashed table of every active uniform
+ *  location of a shader program.  The table is filled once,
+ *  right after the program is linked, and is then used for
+ *  resolving the typed handles that the managers keep.
+ ***********************************************************/
+class UniformCache
+{
+public:
+	// constructor
+	UniformCache();
+
+	// read the active uniforms of the passed in program
+	bool Reflect(GLuint programID);
+
+	// program whose uniforms are in the table
+	GLuint Program() const { return m_programID; }
+	// number of uniform names in the table
+	int Size() const { return (int)m_locations.size(); }
+
+	// find the location of a uniform, -1 when it is not active
+	GLint FindLocation(const std::string& name) const;
+
+	// resolve a typed handle for the named uniform
+	template <typename T>
+	UniformHandle<T> Handle(const std::string& name) const
+	{
+		return(UniformHandle<T>(FindLocation(name)));
+	}
+
+	// set a uniform by name - for one time setup code only
+	template <typename T>
+	void SetValue(const std::string& name, const T& value) const
+	{
+		UniformHandle<T> handle = Handle<T>(name);
+		if (handle.IsValid())
+		{
+			handle.Set(value);
+		}
+	}
+
+private:
+	// linked program the locations belong to
+	GLuint m_programID;
+	// uniform name to location table
+	std::unordered_map<std::string, GLint> m_locations;
+};
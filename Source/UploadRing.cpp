@@ -0,0 +1,326 @@
+///////////////////////////////////////////////////////////////////////////////
+// uploadring.cpp
+// ==============
+// This file contains the implementation of the `UploadRing` class, which
+// carries the per-frame buffer updates of the scene to the GPU.
+//
+// RESPONSIBILITIES:
+// - Create and persistently map a buffer of REGION_COUNT frame regions.
+// - Hand out aligned slices of the current frame's region.
+// - Fence each region and wait, counted as a stall, before it is reused.
+// - Copy slices into their destination buffers or bind them as uniforms.
+//
+// NOTE: The mapping is coherent, so a write is seen by every GL command
+// issued after it without a flush; the fences only keep the CPU from
+// overwriting a region the GPU has not read yet.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UploadRing.h"
+
+#include <cstring>
+#include <iostream>
+
+const int UploadRing::REGION_COUNT;
+
+// declaration of the global variables and defines
+namespace
+{
+	// alignment of the slices that are only copied from
+	const GLsizeiptr g_CopyAlignment = 16;
+	// longest single wait on a fence before it is waited on
+	// again, in nanoseconds
+	const GLuint64 g_FenceWaitNanoseconds = 1000000;
+
+	// round a size up to a multiple of an alignment
+	GLsizeiptr AlignUp(GLsizeiptr size, GLsizeiptr alignment)
+	{
+		return(((size + alignment - 1) / alignment) * alignment);
+	}
+}
+
+/***********************************************************
+ *  UploadRing()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UploadRing::UploadRing()
+{
+	m_buffer = 0;
+	m_pMapped = NULL;
+	m_regionSize = 0;
+	m_region = 0;
+	m_regionUsed = 0;
+	for (int i = 0; i < REGION_COUNT; ++i)
+	{
+		m_fences[i] = 0;
+	}
+	m_uniformAlignment = 256;
+	m_requestedBytes = 0;
+	m_bOverflowed = false;
+	m_stats.bytes = 0;
+	m_stats.stalls = 0;
+	m_stats.overflows = 0;
+}
+
+/***********************************************************
+ *  ~UploadRing()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UploadRing::~UploadRing()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking for glBufferStorage,
+ *  which persistent mappings need.
+ ***********************************************************/
+bool UploadRing::IsSupported()
+{
+	return((GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) ? true : false);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the buffer and mapping
+ *  it for the life of the ring.  The regions are a multiple
+ *  of the uniform offset alignment, so every region starts
+ *  where a uniform range may.
+ ***********************************************************/
+bool UploadRing::Create(GLsizeiptr regionSize)
+{
+	Destroy();
+
+	if (IsSupported() == false)
+	{
+		std::cout << "Persistently mapped buffers are not supported, uploads use glBufferSubData" << std::endl;
+		return(false);
+	}
+
+	GLint uniformAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	if (uniformAlignment > 0)
+	{
+		m_uniformAlignment = uniformAlignment;
+	}
+	m_regionSize = AlignUp(regionSize, m_uniformAlignment);
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, m_regionSize * REGION_COUNT, NULL, flags);
+	m_pMapped = static_cast<unsigned char*>(
+		glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_regionSize * REGION_COUNT, flags));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (NULL == m_pMapped)
+	{
+		std::cout << "Could not map the upload ring of " << m_regionSize * REGION_COUNT << " bytes" << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	m_region = 0;
+	m_regionUsed = 0;
+	m_requestedBytes = 0;
+	m_bOverflowed = false;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the buffer.  Deleting it
+ *  also ends the mapping, and the GPU keeps the storage
+ *  until the commands that still read it are done.
+ ***********************************************************/
+void UploadRing::Destroy()
+{
+	for (int i = 0; i < REGION_COUNT; ++i)
+	{
+		if (0 != m_fences[i])
+		{
+			glDeleteSync(m_fences[i]);
+			m_fences[i] = 0;
+		}
+	}
+	if (0 != m_buffer)
+	{
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+	m_pMapped = NULL;
+	m_regionSize = 0;
+	m_regionUsed = 0;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting the uploads of a frame.
+ *  The region the last frame wrote - and anything uploaded
+ *  before the first frame - is fenced, and the next region
+ *  is waited for.  With REGION_COUNT regions that fence was
+ *  put down two frames ago, so the wait only stalls when
+ *  the GPU is more than two frames behind.
+ ***********************************************************/
+void UploadRing::BeginFrame()
+{
+	if (0 == m_buffer)
+	{
+		return;
+	}
+
+	// the slices handed out before are all copied or bound,
+	// so a larger ring can simply replace the old one
+	if (m_bOverflowed)
+	{
+		GLsizeiptr regionSize = m_requestedBytes + m_requestedBytes / 2;
+		if (Create(regionSize) == false)
+		{
+			return;
+		}
+	}
+
+	if ((m_regionUsed > 0) && (0 == m_fences[m_region]))
+	{
+		m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	m_region = (m_region + 1) % REGION_COUNT;
+	WaitForRegion(m_region);
+	m_regionUsed = 0;
+	m_requestedBytes = 0;
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used for taking the next aligned slice of
+ *  the current region.  A slice that does not fit is
+ *  counted, so the regions grow to the frame that asked for
+ *  it, and the caller uploads the data its own way.
+ ***********************************************************/
+bool UploadRing::Allocate(GLsizeiptr size, GLsizeiptr alignment, SLICE& slice)
+{
+	if ((0 == m_buffer) || (size <= 0))
+	{
+		return(false);
+	}
+
+	GLsizeiptr start = AlignUp(m_regionUsed, alignment);
+	m_requestedBytes = AlignUp(m_requestedBytes, alignment) + size;
+	if (start + size > m_regionSize)
+	{
+		m_bOverflowed = true;
+		m_stats.overflows++;
+		return(false);
+	}
+
+	m_regionUsed = start + size;
+	slice.buffer = m_buffer;
+	slice.offset = m_region * m_regionSize + start;
+	slice.size = size;
+	slice.pData = m_pMapped + slice.offset;
+	m_stats.bytes += size;
+	return(true);
+}
+
+/***********************************************************
+ *  CopyToBuffer()
+ *
+ *  This method is used for writing data into a slice and
+ *  having the GPU copy it into another buffer, in order
+ *  with the commands that read that buffer before and
+ *  after, so neither side waits for the other.
+ ***********************************************************/
+bool UploadRing::CopyToBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	SLICE slice;
+	if (Allocate(size, g_CopyAlignment, slice) == false)
+	{
+		return(false);
+	}
+
+	memcpy(slice.pData, data, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, slice.offset, offset, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return(true);
+}
+
+/***********************************************************
+ *  BindUniformBlock()
+ *
+ *  This method is used for writing a uniform block into a
+ *  slice and reading the block straight from it.  The
+ *  binding only holds for this frame, since the region is
+ *  written again REGION_COUNT frames later.
+ ***********************************************************/
+bool UploadRing::BindUniformBlock(GLuint bindingPoint, GLsizeiptr size, const void* data)
+{
+	SLICE slice;
+	if (Allocate(size, m_uniformAlignment, slice) == false)
+	{
+		return(false);
+	}
+
+	memcpy(slice.pData, data, size);
+	glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, m_buffer, slice.offset, size);
+	return(true);
+}
+
+/***********************************************************
+ *  TakeStats()
+ *
+ *  This method is used for getting the traffic since the
+ *  last call and starting the counters again from zero.
+ ***********************************************************/
+void UploadRing::TakeStats(UPLOAD_STATS& stats)
+{
+	stats = m_stats;
+	m_stats.bytes = 0;
+	m_stats.stalls = 0;
+	m_stats.overflows = 0;
+}
+
+/***********************************************************
+ *  WaitForRegion()
+ *
+ *  This method is used for waiting until the GPU has run
+ *  the commands before a region's fence.  A fence that is
+ *  not signaled at the first look counts as a stall, and
+ *  the commands are flushed so the wait cannot last
+ *  forever.
+ ***********************************************************/
+void UploadRing::WaitForRegion(int region)
+{
+	GLsync fence = m_fences[region];
+	if (0 == fence)
+	{
+		return;
+	}
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (GL_TIMEOUT_EXPIRED == result)
+	{
+		m_stats.stalls++;
+		do
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, g_FenceWaitNanoseconds);
+		} while (GL_TIMEOUT_EXPIRED == result);
+	}
+	if (GL_WAIT_FAILED == result)
+	{
+		std::cout << "Waiting for upload ring region " << region << " failed" << std::endl;
+	}
+
+	glDeleteSync(fence);
+	m_fences[region] = 0;
+}
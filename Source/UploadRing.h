@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// uploadring.h
+// ============
+// stream the data the CPU changes every frame to the GPU through one
+// persistently mapped buffer split into fenced per-frame regions
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  UploadRing
+ *
+ *  This class keeps one buffer created with glBufferStorage
+ *  and mapped once, persistent and coherent, so the CPU
+ *  writes land directly in memory the GPU reads and no
+ *  glBufferSubData copy goes through the driver.  The
+ *  buffer is split into REGION_COUNT regions, one per frame
+ *  in flight; each frame hands out aligned slices of its
+ *  region, and when the frame after the next comes back to
+ *  the region, the fence put down after its last use tells
+ *  whether the GPU is done reading it - normally it is, and
+ *  the wait is counted as a stall when it is not.  A slice
+ *  is either copied on the GPU into the buffer that keeps
+ *  the data, or bound as the uniform block itself for data
+ *  that is sent again every frame.  A frame that does not
+ *  fit its region makes its callers fall back to their own
+ *  uploads, and the regions grow before the next frame.
+ ***********************************************************/
+class UploadRing
+{
+public:
+	// part of the ring handed out for one upload
+	struct SLICE
+	{
+		// buffer and byte offset the GPU reads the slice at
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+		// where the CPU writes it
+		void* pData;
+	};
+
+	// traffic since the last TakeStats()
+	struct UPLOAD_STATS
+	{
+		long long bytes;
+		// frames that had to wait for the GPU to free a region
+		int stalls;
+		// uploads that did not fit and took the fallback
+		int overflows;
+	};
+
+	// frames the CPU may write ahead of the GPU
+	static const int REGION_COUNT = 3;
+
+	// constructor
+	UploadRing();
+	// destructor
+	~UploadRing();
+
+	// check for persistently mapped buffers, OpenGL 4.4 or
+	// ARB_buffer_storage
+	static bool IsSupported();
+
+	// create and map the buffer with regions of at least the
+	// passed in size
+	bool Create(GLsizeiptr regionSize);
+	// unmap and free the buffer
+	void Destroy();
+	// check whether the ring can take uploads
+	bool IsCreated() const { return 0 != m_buffer; }
+
+	// fence the region of the frame that ended and move on to
+	// the next one once the GPU has finished reading it,
+	// growing the ring first when the last frame overflowed
+	void BeginFrame();
+
+	// hand out a slice of the current region, false when the
+	// region is full
+	bool Allocate(GLsizeiptr size, GLsizeiptr alignment, SLICE& slice);
+	// write data into a slice and copy it on the GPU into a
+	// range of another buffer, false when it did not fit
+	bool CopyToBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+	// write a whole uniform block into a slice and bind the
+	// slice at a uniform binding point for this frame, false
+	// when it did not fit
+	bool BindUniformBlock(GLuint bindingPoint, GLsizeiptr size, const void* data);
+
+	// get the traffic since the last call and reset it
+	void TakeStats(UPLOAD_STATS& stats);
+
+private:
+	GLuint m_buffer;
+	unsigned char* m_pMapped;
+	GLsizeiptr m_regionSize;
+	// region written this frame and the bytes used in it
+	int m_region;
+	GLsizeiptr m_regionUsed;
+	// fence after the last frame that wrote each region, 0 for
+	// a region the GPU has no commands on
+	GLsync m_fences[REGION_COUNT];
+	// offset alignment the driver needs for uniform ranges
+	GLsizeiptr m_uniformAlignment;
+	// bytes asked for this frame, including those that did not
+	// fit, which the regions grow to after an overflow
+	GLsizeiptr m_requestedBytes;
+	bool m_bOverflowed;
+	UPLOAD_STATS m_stats;
+
+	// wait for the fence of a region and delete it
+	void WaitForRegion(int region);
+};
@@ -25,6 +25,8 @@
 
 #include "ViewManager.h"
 
+#include <algorithm>
+
 // GLM Math Header inclusions
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
@@ -37,38 +39,30 @@ namespace
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
-	const char* g_ViewName = "view";
-	const char* g_ProjectionName = "projection";
 
-	// camera object used for viewing and interacting with
-	// the 3D scene
-	Camera* g_pCamera = nullptr;
+	// size of the light clusters - screen tiles in pixels and
+	// the number of depth slices between the near and far plane
+	const int CLUSTER_TILE_SIZE = 64;
+	const int CLUSTER_DEPTH_SLICES = 16;
 
 	// these variables are used for mouse movement processing
 	float gLastX = WINDOW_WIDTH / 2.0f;
 	float gLastY = WINDOW_HEIGHT / 2.0f;
 	bool gFirstMouse = true;
 
-	// time between current frame and last frame
-	float gDeltaTime = 0.0f;
-	float gLastFrame = 0.0f;
-
-	// if orthographic projection is on, this value will be
-	// true
-	bool bOrthographicProjection = false;
+	// mouse and scroll wheel motion received since the input
+	// was last handed to the simulation
+	float gMouseOffsetX = 0.0f;
+	float gMouseOffsetY = 0.0f;
+	float gScrollOffset = 0.0f;
 }
 
 
 static void Scroll_Callback(GLFWwindow* window, double xoffset, double yoffset) //callback function for mouse scroll events.
 {
-	if (!g_pCamera) // if the camera object is null, then exit this method.
-		return;
-
-	// Adjust movement speed by the scroll amount.
-	float newSpeed = g_pCamera->MovementSpeed + static_cast<float>(yoffset); // "yoffset" is the scroll amount.
-	if (newSpeed < 1.0f)      newSpeed = 1.0f;		//	
-	if (newSpeed > 50.0f)     newSpeed = 50.0f; // To ensure speed is within a reasonable range.
-	g_pCamera->MovementSpeed = newSpeed;
+	// the simulation adjusts the movement speed by the scroll
+	// amount on its next tick
+	gScrollOffset += static_cast<float>(yoffset); // "yoffset" is the scroll amount.
 }
 /***********************************************************
  *  ViewManager()
@@ -81,13 +75,27 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
-	g_pCamera = new Camera();
-	// default camera view parameters
-	g_pCamera->Position = glm::vec3(0.5f, 5.5f, 10.0f);
-	g_pCamera->Front = glm::vec3(0.0f, -0.5f, -2.0f);
-	g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
-	g_pCamera->Zoom = 80;
-	g_pCamera->MovementSpeed = 10;
+	m_viewState.view = glm::mat4(1.0f);
+	m_viewState.projection = glm::mat4(1.0f);
+	m_viewState.position = glm::vec3(0.0f);
+	m_viewState.nearPlane = 0.1f;
+	m_viewState.farPlane = 100.0f;
+	m_viewState.bOrthographic = false;
+	m_viewState.viewportWidth = WINDOW_WIDTH;
+	m_viewState.viewportHeight = WINDOW_HEIGHT;
+	m_viewState.clusterGrid.tilesX = 0;
+	m_viewState.clusterGrid.tilesY = 0;
+	m_viewState.clusterGrid.depthSlices = 0;
+	m_viewState.clusterGrid.tileSize = CLUSTER_TILE_SIZE;
+	m_pSimulation = NULL;
+	m_simulationState.camera.position = glm::vec3(0.0f);
+	m_simulationState.camera.front = glm::vec3(0.0f, 0.0f, -1.0f);
+	m_simulationState.camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+	m_simulationState.camera.zoom = 45.0f;
+	m_simulationState.camera.bOrthographic = false;
+	m_simulationState.mobileDegrees = 0.0f;
+	m_offscreenWidth = 0;
+	m_offscreenHeight = 0;
 }
 
 /***********************************************************
@@ -100,11 +108,7 @@ ViewManager::~ViewManager()
 	// free up allocated memory
 	m_pShaderManager = NULL;
 	m_pWindow = NULL;
-	if (NULL != g_pCamera)
-	{
-		delete g_pCamera;
-		g_pCamera = NULL;
-	}
+	m_pSimulation = NULL;
 }
 
 /***********************************************************
@@ -115,6 +119,14 @@ ViewManager::~ViewManager()
 GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 {
 	GLFWwindow* window = nullptr;
+	bool bOffscreen = (m_offscreenWidth > 0);
+
+	// an offscreen run only needs the window for its OpenGL
+	// context, so it is never shown
+	if (bOffscreen)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
 
 	// try to create the displayed OpenGL window
 	window = glfwCreateWindow(
@@ -130,16 +142,25 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	}
 	glfwMakeContextCurrent(window);
 
-	// this callback is used to receive mouse moving events
-	glfwSetCursorPosCallback(window, &ViewManager::Mouse_Position_Callback); \
+	if (bOffscreen)
+	{
+		// frames are not shown, so they are not held back to
+		// the display's refresh either
+		glfwSwapInterval(0);
+	}
+	else
+	{
+		// this callback is used to receive mouse moving events
+		glfwSetCursorPosCallback(window, &ViewManager::Mouse_Position_Callback);
 		// this callback is used to receive mouse scroll events.
 		glfwSetScrollCallback(window, Scroll_Callback);
 
-	// tell GLFW to capture all mouse events
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		// tell GLFW to capture all mouse events
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	}
 
-	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
+	// blending for supporting tranparent rendering - it is only
+	// switched on while the translucent objects are drawn
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_pWindow = window;
@@ -147,6 +168,25 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	return(window);
 }
 
+/***********************************************************
+ *  SetOffscreenSize()
+ *
+ *  This method is used for drawing the frames into an
+ *  offscreen target of a given size, which the caller
+ *  binds, instead of the window.  The projection and the
+ *  light clusters are then fitted to that size.
+ ***********************************************************/
+void ViewManager::SetOffscreenSize(int width, int height)
+{
+	m_offscreenWidth = std::max(width, 0);
+	m_offscreenHeight = std::max(height, 0);
+	if ((m_offscreenWidth == 0) || (m_offscreenHeight == 0))
+	{
+		m_offscreenWidth = 0;
+		m_offscreenHeight = 0;
+	}
+}
+
 /***********************************************************
  *  Mouse_Position_Callback()
  *
@@ -173,15 +213,21 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
 	gLastX = xMousePos;
 	gLastY = yMousePos;
 
-	// move the 3D camera according to the calculated offsets
-	g_pCamera->ProcessMouseMovement(xOffset, yOffset);
+	// keep the offsets until the next frame hands them to the
+	// simulation, which moves the 3D camera accordingly
+	gMouseOffsetX += xOffset;
+	gMouseOffsetY += yOffset;
 }
 
 /***********************************************************
  *  ProcessKeyboardEvents()
  *
  *  This method is called to process any keyboard events
- *  that may be waiting in the event queue.
+ *  that may be waiting in the event queue.  The keys that
+ *  move the camera are only read here, on the thread GLFW
+ *  reports them on, and are handed to the simulation along
+ *  with the mouse motion, which moves the camera on its
+ *  next tick.
  ***********************************************************/
 void ViewManager::ProcessKeyboardEvents()
 {
@@ -190,58 +236,64 @@ void ViewManager::ProcessKeyboardEvents()
 	{
 		glfwSetWindowShouldClose(m_pWindow, true);
 	}
-	if (glfwGetKey(m_pWindow, GLFW_KEY_P) == GLFW_PRESS)
+
+	// if the simulation is not set, then exit this method
+	if (NULL == m_pSimulation)
 	{
-		bOrthographicProjection = false;
-		// When returning to perspective, you might want to allow free‐look:
-		// We leave camera position/orientation as‐is, so the user can orbit normally.
+		return;
 	}
 
-	if (glfwGetKey(m_pWindow, GLFW_KEY_O) == GLFW_PRESS)
+	Simulation::INPUT_STATE input;
+	input.keys = 0;
+	// P returns to perspective, O snaps the camera to look
+	// straight at the scene in orthographic projection
+	if (glfwGetKey(m_pWindow, GLFW_KEY_P) == GLFW_PRESS)
 	{
-		bOrthographicProjection = true;
-		// Snap camera so it looks directly at the object (no tilt):
-		g_pCamera->Position = glm::vec3(0.0f, 0.0f, 10.0f);
-		g_pCamera->Front = glm::normalize(glm::vec3(0.0f, 0.0f, -1.0f));
-		g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
-		g_pCamera->Yaw = -90.0f;   // Facing –Z
-		g_pCamera->Pitch = 0.0f;    // Level with the "horizon"
+		input.keys |= Simulation::KEY_PERSPECTIVE;
 	}
-	// if the camera object is null, then exit this method
-	if (NULL == g_pCamera)
+	if (glfwGetKey(m_pWindow, GLFW_KEY_O) == GLFW_PRESS)
 	{
-		return;
+		input.keys |= Simulation::KEY_ORTHOGRAPHIC;
 	}
 
 	// process camera zooming in and out
 	if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
 	{
-		g_pCamera->ProcessKeyboard(FORWARD, gDeltaTime);
+		input.keys |= Simulation::KEY_FORWARD;
 	}
 	if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS)
 	{
-		g_pCamera->ProcessKeyboard(BACKWARD, gDeltaTime);
+		input.keys |= Simulation::KEY_BACKWARD;
 	}
 
 	// process camera panning left and right
 	if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS)
 	{
-		g_pCamera->ProcessKeyboard(LEFT, gDeltaTime);
+		input.keys |= Simulation::KEY_LEFT;
 	}
 	if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS)
 	{
-		g_pCamera->ProcessKeyboard(RIGHT, gDeltaTime);
+		input.keys |= Simulation::KEY_RIGHT;
 	}
+
+	// process camera moving up and down along its Up vector
 	if (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS)
 	{
-		// Adjust camera position upward using camera's Up vector
-		g_pCamera->Position += g_pCamera->Up * g_pCamera->MovementSpeed * gDeltaTime;
+		input.keys |= Simulation::KEY_UP;
 	}
-	// Adjust camera position  downward (along world Up direction)
 	if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS)
 	{
-		g_pCamera->Position -= g_pCamera->Up * g_pCamera->MovementSpeed * gDeltaTime;
+		input.keys |= Simulation::KEY_DOWN;
 	}
+
+	input.mouseOffsetX = gMouseOffsetX;
+	input.mouseOffsetY = gMouseOffsetY;
+	input.scrollOffset = gScrollOffset;
+	gMouseOffsetX = 0.0f;
+	gMouseOffsetY = 0.0f;
+	gScrollOffset = 0.0f;
+
+	m_pSimulation->SubmitInput(input);
 }
 
 /***********************************************************
@@ -256,23 +308,34 @@ void ViewManager::PrepareSceneView()
 	glm::mat4 view;
 	glm::mat4 projection;
 
-	// 1) Timing
-	float currentFrame = glfwGetTime();
-	gDeltaTime = currentFrame - gLastFrame;
-	gLastFrame = currentFrame;
-
-	// 2) Process keyboard events
+	// 1) Process keyboard events
 	ProcessKeyboardEvents();
 
+	// 2) Take the camera from the simulation, between its last
+	// two ticks at the time of this frame
+	if (NULL != m_pSimulation)
+	{
+		m_pSimulation->Sample(m_simulationState);
+	}
+	const Simulation::CAMERA_STATE& camera = m_simulationState.camera;
+
 	// 3) Compute the view matrix from the camera
-	view = g_pCamera->GetViewMatrix();
+	view = glm::lookAt(camera.position, camera.position + camera.front, camera.up);
 
-	// 4) Choose projection mode
-	if (bOrthographicProjection)
+	// 4) Choose projection mode, shaped like the window or
+	// the offscreen target
+	float viewWidth = (float)WINDOW_WIDTH;
+	float viewHeight = (float)WINDOW_HEIGHT;
+	if (m_offscreenWidth > 0)
+	{
+		viewWidth = (float)m_offscreenWidth;
+		viewHeight = (float)m_offscreenHeight;
+	}
+	if (camera.bOrthographic)
 	{
 
 		float orthoHalfHeight = 10.0f;
-		float aspect = (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT;
+		float aspect = viewWidth / viewHeight;
 		float orthoHalfWidth = orthoHalfHeight * aspect;
 
 		float nearPlane = 0.1f;
@@ -289,19 +352,39 @@ void ViewManager::PrepareSceneView()
 	else
 	{
 		projection = glm::perspective(
-			glm::radians(g_pCamera->Zoom),
-			(GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT,
+			glm::radians(camera.zoom),
+			viewWidth / viewHeight,
 			0.1f,
 			100.0f
 		);
 	}
 
-	// 5) Send both view and projection into the shader
-	if (NULL != m_pShaderManager)
+	// 5) keep the frame's view settings - SceneManager sends
+	// them to the shaders in the FrameData block and uses
+	// them for depth sorting
+	m_viewState.view = view;
+	m_viewState.projection = projection;
+	m_viewState.position = camera.position;
+	m_viewState.nearPlane = 0.1f;
+	m_viewState.farPlane = 100.0f;
+	m_viewState.bOrthographic = camera.bOrthographic;
+
+	// 6) the light cluster grid covers the whole framebuffer
+	int framebufferWidth = WINDOW_WIDTH;
+	int framebufferHeight = WINDOW_HEIGHT;
+	if (m_offscreenWidth > 0)
+	{
+		framebufferWidth = m_offscreenWidth;
+		framebufferHeight = m_offscreenHeight;
+	}
+	else if (NULL != m_pWindow)
 	{
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		// Keep passing along camera position for any lighting calculations
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		glfwGetFramebufferSize(m_pWindow, &framebufferWidth, &framebufferHeight);
 	}
+	m_viewState.viewportWidth = framebufferWidth;
+	m_viewState.viewportHeight = framebufferHeight;
+	m_viewState.clusterGrid.tileSize = CLUSTER_TILE_SIZE;
+	m_viewState.clusterGrid.tilesX = (framebufferWidth + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+	m_viewState.clusterGrid.tilesY = (framebufferHeight + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+	m_viewState.clusterGrid.depthSlices = CLUSTER_DEPTH_SLICES;
 }
\ No newline at end of file
@@ -10,7 +10,7 @@
 #pragma once
 
 #include "ShaderManager.h"
-#include "camera.h"
+#include "Simulation.h"
 
 // GLFW library
 #include "GLFW/glfw3.h" 
@@ -27,19 +27,67 @@ public:
 	// mouse position callback for mouse interaction with the 3D scene
 	static void Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos);
 
+	// screen tiles and depth slices used for clustered lighting
+	struct CLUSTER_GRID
+	{
+		int tilesX;
+		int tilesY;
+		int depthSlices;
+		// tile width and height in pixels
+		int tileSize;
+	};
+
+	// camera and projection settings of the prepared frame
+	struct VIEW_STATE
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 position;
+		float nearPlane;
+		float farPlane;
+		bool bOrthographic;
+		// framebuffer size in pixels
+		int viewportWidth;
+		int viewportHeight;
+		// cluster layout matching the projection and viewport
+		CLUSTER_GRID clusterGrid;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// view settings of the most recently prepared frame
+	VIEW_STATE m_viewState;
+	// moves the camera, and the state it gave for this frame
+	Simulation* m_pSimulation;
+	Simulation::STATE m_simulationState;
+	// size of the offscreen target the frames are drawn into
+	// instead of the window, 0 when they go to the window
+	int m_offscreenWidth;
+	int m_offscreenHeight;
 
 	// process keyboard events for interaction with the 3D scene
+	// and hand them to the simulation
 	void ProcessKeyboardEvents();
 
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
+	// draw into an offscreen target of the passed in size, with
+	// the window kept hidden, unsynchronized and without input;
+	// call before CreateDisplayWindow()
+	void SetOffscreenSize(int width, int height);
+	// set the simulation that the input is sent to and the
+	// camera is taken from
+	void SetSimulation(Simulation* pSimulation) { m_pSimulation = pSimulation; }
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// get the view settings used for the current frame
+	const VIEW_STATE& GetViewState() const { return m_viewState; }
+	// get the simulated state the current frame was prepared with
+	const Simulation::STATE& GetSimulationState() const { return m_simulationState; }
 };
\ No newline at end of file
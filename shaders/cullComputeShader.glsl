@@ -0,0 +1,232 @@
+#version 430 core
+// one work group per indirect command, the group size must
+// match GpuCulling::GROUP_SIZE
+#define GROUP_SIZE 64
+layout (local_size_x = GROUP_SIZE) in;
+
+// laid out like MeshLibrary::DRAW_COMMAND
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+// laid out like MeshLibrary::INSTANCE_SETTINGS
+struct InstanceSettings
+{
+    vec4 color;
+    vec2 uvScale;
+    int textureSlot;
+    int materialIndex;
+};
+
+// the bindings must match STORAGE_BLOCK_BINDING in
+// ShaderBlocks.h
+layout (std430, binding = 0) readonly buffer SourceCommands
+{
+    DrawCommand sourceCommands[];
+};
+layout (std430, binding = 1) writeonly buffer CulledCommands
+{
+    DrawCommand culledCommands[];
+};
+// world minimum and maximum of every instance, back to back
+layout (std430, binding = 2) readonly buffer InstanceBounds
+{
+    vec4 instanceBounds[];
+};
+layout (std430, binding = 3) readonly buffer SourceMatrices
+{
+    mat4 sourceMatrices[];
+};
+layout (std430, binding = 4) writeonly buffer CulledMatrices
+{
+    mat4 culledMatrices[];
+};
+layout (std430, binding = 5) readonly buffer SourceSettings
+{
+    InstanceSettings sourceSettings[];
+};
+layout (std430, binding = 6) writeonly buffer CulledSettings
+{
+    InstanceSettings culledSettings[];
+};
+// laid out like GpuCulling::CULL_STATS
+layout (std430, binding = 7) buffer CullStats
+{
+    uint visibleInstances;
+    uint frustumCulled;
+    uint occlusionCulled;
+    uint triangles;
+};
+
+// planes of the current view, inside where dot(n, p) + w >= 0
+uniform vec4 frustumPlanes[6];
+// view-projection the depth pyramid was rendered with
+uniform mat4 occlusionViewProjection;
+uniform bool bUseOcclusion = false;
+// max depth pyramid, level 0 is half the viewport size
+// rounded down, and each level half the one before
+uniform sampler2D depthPyramid;
+uniform int pyramidLevels;
+uniform ivec2 pyramidSize;
+uniform vec2 viewportSize;
+
+#define INSTANCE_VISIBLE 0
+#define INSTANCE_OUTSIDE 1
+#define INSTANCE_OCCLUDED 2
+
+// visibility of each instance of the current chunk, and the
+// instances kept by the chunks before it
+shared uint chunkVisible[GROUP_SIZE];
+shared uint keptBefore;
+
+int TestFrustum(vec3 center, vec3 extent)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        vec4 plane = frustumPlanes[i];
+        if (dot(plane.xyz, center) + dot(abs(plane.xyz), extent) + plane.w < 0.0)
+        {
+            return INSTANCE_OUTSIDE;
+        }
+    }
+    return INSTANCE_VISIBLE;
+}
+
+int TestOcclusion(vec3 minimum, vec3 maximum)
+{
+    // screen rectangle and nearest depth of the box corners
+    vec2 lower = vec2(1.0);
+    vec2 upper = vec2(-1.0);
+    float nearest = 1.0;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        vec3 select = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+        vec4 clip = occlusionViewProjection * vec4(mix(minimum, maximum, select), 1.0);
+        // boxes that reach behind the camera are not culled
+        if (clip.w <= 0.0)
+        {
+            return INSTANCE_VISIBLE;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        lower = min(lower, ndc.xy);
+        upper = max(upper, ndc.xy);
+        nearest = min(nearest, ndc.z);
+    }
+    float boxDepth = nearest * 0.5 + 0.5;
+
+    ivec2 viewportPixels = ivec2(viewportSize);
+    ivec2 firstPixel = clamp(ivec2((lower * 0.5 + 0.5) * viewportSize), ivec2(0), viewportPixels - 1);
+    ivec2 lastPixel = clamp(ivec2((upper * 0.5 + 0.5) * viewportSize), ivec2(0), viewportPixels - 1);
+
+    // a level texel covers 2^(level + 1) pixels, so at this
+    // level the rectangle touches at most 2x2 texels
+    ivec2 span = lastPixel - firstPixel + 1;
+    int level = int(ceil(log2(float(max(span.x, span.y))))) - 1;
+    level = clamp(level, 0, pyramidLevels - 1);
+
+    ivec2 levelSize = max(pyramidSize >> level, ivec2(1));
+    ivec2 first = min(firstPixel >> (level + 1), levelSize - 1);
+    ivec2 last = min(lastPixel >> (level + 1), levelSize - 1);
+
+    // depending on where the rectangle falls, the level below
+    // may still only need 2x2 texels and is a tighter test
+    if (level > 0)
+    {
+        ivec2 finerSize = max(pyramidSize >> (level - 1), ivec2(1));
+        ivec2 finerFirst = min(firstPixel >> level, finerSize - 1);
+        ivec2 finerLast = min(lastPixel >> level, finerSize - 1);
+        if (all(lessThanEqual(finerLast - finerFirst, ivec2(1))))
+        {
+            level = level - 1;
+            first = finerFirst;
+            last = finerLast;
+        }
+    }
+    float farthest = max(
+        max(texelFetch(depthPyramid, first, level).r, texelFetch(depthPyramid, ivec2(last.x, first.y), level).r),
+        max(texelFetch(depthPyramid, ivec2(first.x, last.y), level).r, texelFetch(depthPyramid, last, level).r));
+
+    return (boxDepth > farthest) ? INSTANCE_OCCLUDED : INSTANCE_VISIBLE;
+}
+
+int TestInstance(uint instance)
+{
+    vec3 minimum = instanceBounds[instance * 2].xyz;
+    vec3 maximum = instanceBounds[instance * 2 + 1].xyz;
+
+    int result = TestFrustum((minimum + maximum) * 0.5, (maximum - minimum) * 0.5);
+    if ((result == INSTANCE_VISIBLE) && bUseOcclusion)
+    {
+        result = TestOcclusion(minimum, maximum);
+    }
+    return result;
+}
+
+void main()
+{
+    uint commandIndex = gl_WorkGroupID.x;
+    uint local = gl_LocalInvocationID.x;
+    DrawCommand command = sourceCommands[commandIndex];
+
+    if (local == 0)
+    {
+        keptBefore = 0;
+    }
+    barrier();
+
+    // the instances are tested a chunk at a time, and the
+    // kept ones are packed to the front of the command's
+    // range in their original order
+    for (uint chunk = 0; chunk < command.instanceCount; chunk += GROUP_SIZE)
+    {
+        uint index = chunk + local;
+        uint instance = command.baseInstance + index;
+        uint visible = 0;
+        if (index < command.instanceCount)
+        {
+            int result = TestInstance(instance);
+            if (result == INSTANCE_OUTSIDE)
+            {
+                atomicAdd(frustumCulled, 1);
+            }
+            else if (result == INSTANCE_OCCLUDED)
+            {
+                atomicAdd(occlusionCulled, 1);
+            }
+            visible = (result == INSTANCE_VISIBLE) ? 1 : 0;
+        }
+        chunkVisible[local] = visible;
+        barrier();
+
+        uint slot = keptBefore;
+        for (uint i = 0; i < local; ++i)
+        {
+            slot += chunkVisible[i];
+        }
+        if (visible != 0)
+        {
+            culledMatrices[command.baseInstance + slot] = sourceMatrices[instance];
+            culledSettings[command.baseInstance + slot] = sourceSettings[instance];
+        }
+        barrier();
+
+        if (local == GROUP_SIZE - 1)
+        {
+            keptBefore = slot + visible;
+        }
+        barrier();
+    }
+
+    if (local == 0)
+    {
+        command.instanceCount = keptBefore;
+        culledCommands[commandIndex] = command;
+        atomicAdd(visibleInstances, keptBefore);
+        atomicAdd(triangles, (command.count / 3) * keptBefore);
+    }
+}
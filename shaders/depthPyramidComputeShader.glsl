@@ -0,0 +1,40 @@
+#version 430 core
+// one invocation per texel of the pyramid level written,
+// the group size must match PYRAMID_GROUP_SIZE in GpuCulling
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// depth copy for level 0, the level before otherwise
+uniform sampler2D sourceDepth;
+uniform int sourceLevel;
+uniform ivec2 sourceSize;
+
+layout (r32f, binding = 0) writeonly uniform image2D destination;
+
+void main()
+{
+    ivec2 destinationSize = imageSize(destination);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, destinationSize)))
+    {
+        return;
+    }
+
+    // each texel covers 2x2 source texels, and the last
+    // column and row of an odd sized source also take the
+    // source texels left without a pair
+    ivec2 first = texel * 2;
+    ivec2 last = first + 1 + ivec2(equal(texel, destinationSize - 1)) * (sourceSize & 1);
+    last = min(last, sourceSize - 1);
+
+    // keep the farthest depth, so that a box behind it is
+    // behind everything the texel covers
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; ++y)
+    {
+        for (int x = first.x; x <= last.x; ++x)
+        {
+            depth = max(depth, texelFetch(sourceDepth, ivec2(x, y), sourceLevel).r);
+        }
+    }
+    imageStore(destination, texel, vec4(depth));
+}
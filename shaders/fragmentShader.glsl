@@ -1,128 +1,252 @@
 #version 330 core
+// bindless texture handles are used when the driver offers them
+#extension GL_ARB_bindless_texture : enable
+// the features of the program permutation are #defined right
+// after this line by ShaderPermutations.cpp - TEXTURED, LIT,
+// DIRECTIONAL_LIGHT, POINT_LIGHTS, LIGHT_CLUSTERS, SPOT_LIGHT,
+// DEPTH_ONLY, SHADOWS and SHADOW_CASTER
 out vec4 fragmentColor;
 
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
+// draw settings picked by the vertex shader, from the uniforms
+// or from the instance settings of a multi-draw
+flat in vec4 drawColor;
+flat in vec2 drawUVScale;
+flat in int drawTextureIndex;
+flat in int drawMaterialIndex;
 
+// the std140 blocks below are mirrored by ShaderBlocks.h - every
+// vec3 is followed by a scalar that fills out its 16 bytes
 struct Material {
     vec3 diffuseColor;
-    vec3 specularColor;
     float shininess;
+    vec3 specularColor;
 }; 
 
 struct DirectionalLight {
     vec3 direction;
+    bool bActive;
 	
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
-
-    bool bActive;
 };
 
 struct PointLight {
     vec3 position;
+    bool bActive;
     
     vec3 ambient;
+    float constant;
     vec3 diffuse;
+    float linear;
     vec3 specular;
-
-    bool bActive;
+    float quadratic;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
   
-    float constant;
-    float linear;
-    float quadratic;
-  
     vec3 ambient;
+    float constant;
     vec3 diffuse;
+    float linear;
     vec3 specular;       
+    float quadratic;
 
     bool bActive;
 };
 
-#define TOTAL_POINT_LIGHTS 5
+#define MAX_POINT_LIGHTS 256
+#define MAX_MATERIALS 32
+#define MAX_TEXTURES 1024
+#define MAX_TEXTURE_ARRAYS 12
+#define MAX_SHADOW_CASCADES 4
+
+// how far a shadow lookup is pushed out along the surface
+// normal, in shadow map texels
+#define SHADOW_NORMAL_OFFSET 1.5
 
-uniform bool bUseTexture=false;
-uniform bool bUseLighting=false;
-uniform vec4 objectColor = vec4(1.0f);
-uniform vec3 viewPosition;
-uniform DirectionalLight directionalLight;
-uniform PointLight pointLights[TOTAL_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
-uniform sampler2D objectTexture;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
+// camera and lights, shared by every program and updated once per frame
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    int pointLightCount;
+    ivec4 clusterDimensions;    // tiles x, tiles y, depth slices, tile size
+    vec4 clusterDepth;          // near, far, slice scale, slice bias
+    DirectionalLight directionalLight;
+    SpotLight spotLight;
+};
+
+// the point light list, filled up to pointLightCount
+layout (std140) uniform PointLightData
+{
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
+
+// every defined material, selected per draw by drawMaterialIndex
+layout (std140) uniform MaterialData
+{
+    Material materials[MAX_MATERIALS];
+};
+
+// every registered texture, selected per draw by drawTextureIndex - the
+// array and layer in x and y, or a bindless handle in x and y
+layout (std140) uniform TextureData
+{
+    uvec4 textureEntries[MAX_TEXTURES];
+};
+
+// the directional light's shadow cascades, each one ends at its
+// split depth and has its own world to shadow map matrix
+layout (std140) uniform ShadowData
+{
+    mat4 cascadeMatrices[MAX_SHADOW_CASCADES];
+    vec4 cascadeSplits;
+    vec4 cascadeTexelSizes;     // world size of a texel
+    int cascadeCount;
+    float shadowTexelSize;      // size of a texel in texture coordinates
+};
+
+uniform bool bBindlessTextures = false;
+uniform sampler2DArray textureArrays[MAX_TEXTURE_ARRAYS];
+
+// light clusters - an offset and count per cluster into a shared
+// list of point light indices, built on the CPU every frame
+uniform usamplerBuffer clusterLightRanges;
+uniform usamplerBuffer clusterLightIndices;
+
+// one depth layer per shadow cascade, compared in hardware
+uniform sampler2DArrayShadow shadowCascades;
+
+// the material of the object being drawn
+Material material;
 
 // the scaled texture coordinate to use in calculations
-vec2 fragmentTextureCoordinateScaled = fragmentTextureCoordinate * UVscale;
+vec2 fragmentTextureCoordinateScaled = vec2(0.0f);
+
+// the object texture, sampled once per fragment, or the object
+// color when the permutation is not TEXTURED
+vec4 surfaceColor = vec4(1.0f);
 
 // function prototypes
 vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+int FindCluster();
+float CalcShadow(vec3 lightDirection);
+vec4 SampleObjectTexture(vec2 coordinate);
 
 void main()
 {   
-    if(bUseLighting == true)
+#ifdef DEPTH_ONLY
+    // the depth pre-pass only lays down depth, its color writes
+    // are masked off and nothing else is computed
+    fragmentColor = vec4(0.0f);
+#else
+    material = materials[drawMaterialIndex];
+    fragmentTextureCoordinateScaled = fragmentTextureCoordinate * drawUVScale;
+
+#ifdef TEXTURED
+    surfaceColor = SampleObjectTexture(fragmentTextureCoordinateScaled);
+#else
+    surfaceColor = drawColor;
+#endif
+
+#ifdef LIT
+    vec3 phongResult = vec3(0.0f);
+    // properties
+    vec3 norm = normalize(fragmentVertexNormal);
+    vec3 viewDir = normalize(viewPosition - fragmentPosition);
+
+    // == =====================================================
+    // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
+    // For each phase, a calculate function is defined that calculates the corresponding color
+    // per light source. In the main() function we take all the calculated colors and sum them 
+    // up for this fragment's final color.  A phase is only compiled in when the scene has
+    // that kind of light switched on.
+    // == =====================================================
+    // phase 1: directional lighting
+#ifdef DIRECTIONAL_LIGHT
+    phongResult += CalcDirectionalLight(directionalLight, norm, viewDir);
+#endif
+    // phase 2: point lights - only the lights that reach this
+    // fragment's cluster, or every light when clustering is off
+#ifdef POINT_LIGHTS
+#ifdef LIGHT_CLUSTERS
+    uvec2 lightRange = texelFetch(clusterLightRanges, FindCluster()).rg;
+    for(uint i = 0u; i < lightRange.y; i++)
     {
-        vec3 phongResult = vec3(0.0f);
-        // properties
-        vec3 norm = normalize(fragmentVertexNormal);
-        vec3 viewDir = normalize(viewPosition - fragmentPosition);
-    
-        // == =====================================================
-        // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
-        // For each phase, a calculate function is defined that calculates the corresponding color
-        // per light source. In the main() function we take all the calculated colors and sum them 
-        // up for this fragment's final color.
-        // == =====================================================
-        // phase 1: directional lighting
-        if(directionalLight.bActive == true)
-        {
-            phongResult += CalcDirectionalLight(directionalLight, norm, viewDir);
-        }
-        // phase 2: point lights
-        for(int i = 0; i < TOTAL_POINT_LIGHTS; i++)
-        {
-	    if(pointLights[i].bActive == true)
-            {
-                phongResult += CalcPointLight(pointLights[i], norm, fragmentPosition, viewDir);   
-            }
-        } 
-        // phase 3: spot light
-        if(spotLight.bActive == true)
-        {
-            phongResult += CalcSpotLight(spotLight, norm, fragmentPosition, viewDir);    
-        }
-    
-        if(bUseTexture == true)
-        {
-            fragmentColor = vec4(phongResult, (texture(objectTexture, fragmentTextureCoordinateScaled)).a);
-        }
-        else
-        {
-            fragmentColor = vec4(phongResult, objectColor.a);
-        }
+        int lightIndex = int(texelFetch(clusterLightIndices, int(lightRange.x + i)).r);
+        phongResult += CalcPointLight(pointLights[lightIndex], norm, fragmentPosition, viewDir);
     }
-    else
+#else
+    for(int i = 0; i < pointLightCount; i++)
     {
-        if(bUseTexture == true)
-        {
-            fragmentColor = texture(objectTexture, fragmentTextureCoordinateScaled);
-        }
-        else
+        if(pointLights[i].bActive == true)
         {
-            fragmentColor = objectColor;
+            phongResult += CalcPointLight(pointLights[i], norm, fragmentPosition, viewDir);   
         }
     }
+#endif
+#endif
+    // phase 3: spot light
+#ifdef SPOT_LIGHT
+    phongResult += CalcSpotLight(spotLight, norm, fragmentPosition, viewDir);    
+#endif
+
+    fragmentColor = vec4(phongResult, surfaceColor.a);
+#else
+    fragmentColor = surfaceColor;
+#endif
+#endif
+}
+
+// reads the object texture through its texture table entry - sampler
+// arrays can only be indexed with constants in GLSL 3.30, hence the switch
+vec4 SampleObjectTexture(vec2 coordinate)
+{
+    uvec4 entry = textureEntries[drawTextureIndex];
+#ifdef GL_ARB_bindless_texture
+    if(bBindlessTextures == true)
+    {
+        return texture(sampler2D(entry.xy), coordinate);
+    }
+#endif
+    vec3 arrayCoordinate = vec3(coordinate, float(entry.y));
+    switch(int(entry.x))
+    {
+    case 1: return texture(textureArrays[1], arrayCoordinate);
+    case 2: return texture(textureArrays[2], arrayCoordinate);
+    case 3: return texture(textureArrays[3], arrayCoordinate);
+    case 4: return texture(textureArrays[4], arrayCoordinate);
+    case 5: return texture(textureArrays[5], arrayCoordinate);
+    case 6: return texture(textureArrays[6], arrayCoordinate);
+    case 7: return texture(textureArrays[7], arrayCoordinate);
+    case 8: return texture(textureArrays[8], arrayCoordinate);
+    case 9: return texture(textureArrays[9], arrayCoordinate);
+    case 10: return texture(textureArrays[10], arrayCoordinate);
+    case 11: return texture(textureArrays[11], arrayCoordinate);
+    default: return texture(textureArrays[0], arrayCoordinate);
+    }
+}
+
+// finds the light cluster of this fragment from its screen tile
+// and its exponential depth slice, matching LightClusters.cpp
+int FindCluster()
+{
+    float depth = -(view * vec4(fragmentPosition, 1.0)).z;
+    int slice = int(max(log(max(depth, clusterDepth.x)) * clusterDepth.z - clusterDepth.w, 0.0));
+    slice = min(slice, clusterDimensions.z - 1);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy) / clusterDimensions.w, clusterDimensions.xy - 1);
+    return tile.x + clusterDimensions.x * (tile.y + clusterDimensions.y * slice);
 }
 
 // calculates the color when using a directional light.
@@ -139,20 +263,62 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDirection, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    if(bUseTexture == true)
+    ambient = light.ambient * vec3(surfaceColor);
+    diffuse = light.diffuse * diff * material.diffuseColor * vec3(surfaceColor);
+    specular = light.specular * spec * material.specularColor * vec3(surfaceColor);
+    
+    // the ambient light is not blocked by the shadow casters
+#ifdef SHADOWS
+    float shadow = CalcShadow(lightDirection);
+    diffuse *= shadow;
+    specular *= shadow;
+#endif
+    return (ambient + diffuse + specular);
+}
+
+// calculates how much of the directional light reaches the fragment
+// from its shadow cascade, 3x3 filtered lookups of the light's depth
+float CalcShadow(vec3 lightDirection)
+{
+    // the face normal, turned to the camera, pushes the lookup off the
+    // surface so that it does not shadow itself - more so where the
+    // light grazes it; derivatives need to be taken before any branch
+    vec3 faceNormal = normalize(cross(dFdx(fragmentPosition), dFdy(fragmentPosition)));
+    if (dot(faceNormal, viewPosition - fragmentPosition) < 0.0)
+    {
+        faceNormal = -faceNormal;
+    }
+
+    float depth = -(view * vec4(fragmentPosition, 1.0)).z;
+    int cascade = 0;
+    while ((cascade < cascadeCount) && (depth > cascadeSplits[cascade]))
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinateScaled));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinateScaled));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinateScaled));
+        cascade++;
     }
-    else
+    if (cascade >= cascadeCount)
     {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * spec * material.specularColor * vec3(objectColor);
+        return 1.0;
     }
-    
-    return (ambient + diffuse + specular);
+
+    float grazing = 1.0 - abs(dot(faceNormal, lightDirection));
+    vec3 position = fragmentPosition + faceNormal * cascadeTexelSizes[cascade] * SHADOW_NORMAL_OFFSET * (1.0 + grazing);
+
+    vec3 coordinate = vec3(cascadeMatrices[cascade] * vec4(position, 1.0));
+    if (any(lessThan(coordinate, vec3(0.0))) || any(greaterThan(coordinate, vec3(1.0))))
+    {
+        return 1.0;
+    }
+
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec2 offset = vec2(float(x), float(y)) * shadowTexelSize;
+            lit += texture(shadowCascades, vec4(coordinate.xy + offset, float(cascade), coordinate.z));
+        }
+    }
+    return lit / 9.0;
 }
 
 // calculates the color when using a point light.
@@ -169,22 +335,16 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     // Calculate specular component
     float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
    
     // combine results
-    if(bUseTexture == true)
-    {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinateScaled));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinateScaled));
-        specular = light.specular * specularComponent * material.specularColor;
-    }
-    else
-    {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * specularComponent * material.specularColor;
-    }
+    ambient = light.ambient * vec3(surfaceColor);
+    diffuse = light.diffuse * diff * material.diffuseColor * vec3(surfaceColor);
+    specular = light.specular * specularComponent * material.specularColor;
     
-    return (ambient + diffuse + specular);
+    return (ambient + diffuse + specular) * attenuation;
 }
 
 // calculates the color when using a spot light.
@@ -208,18 +368,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    if(bUseTexture == true)
-    {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinateScaled));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinateScaled));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinateScaled));
-    }
-    else
-    {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * spec * material.specularColor * vec3(objectColor);
-    }
+    ambient = light.ambient * vec3(surfaceColor);
+    diffuse = light.diffuse * diff * material.diffuseColor * vec3(surfaceColor);
+    specular = light.specular * spec * material.specularColor * vec3(surfaceColor);
     
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
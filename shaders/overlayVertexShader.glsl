@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec2 inVertexPosition;
+layout (location = 1) in vec4 inVertexColor;
+
+out vec4 fragmentColor;
+
+// framebuffer size in pixels
+uniform vec2 screenSize;
+
+void main()
+{
+    // overlay positions are in pixels from the top left corner
+    vec2 normalized = inVertexPosition / screenSize * 2.0 - 1.0;
+    gl_Position = vec4(normalized.x, -normalized.y, 0.0, 1.0);
+    fragmentColor = inVertexColor;
+}
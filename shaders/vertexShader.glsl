@@ -1,20 +1,123 @@
 #version 330 core
-layout (location = 0) in vec3 inVertexPosition;
-layout (location = 1) in vec3 inVertexNormal;
+// the features of the program permutation are #defined right
+// after this line by ShaderPermutations.cpp, only SHADOW_CASTER
+// changes this stage
+// quantized by MeshLibrary - snorm16 position over the mesh
+// range, snorm16 octahedral normal and unorm16 coordinate
+layout (location = 0) in vec4 inVertexPosition;
+layout (location = 1) in vec2 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
+// per-instance model matrix, occupies locations 3 to 6
+layout (location = 3) in mat4 inInstanceModel;
+// per-instance draw settings, read instead of the uniforms
+// below when the scene goes out as one multi-draw
+layout (location = 7) in vec4 inInstanceColor;
+layout (location = 8) in vec2 inInstanceUVScale;
+layout (location = 9) in ivec2 inInstanceIndices;   // texture slot or -1, material
 
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
+flat out vec4 drawColor;
+flat out vec2 drawUVScale;
+flat out int drawTextureIndex;
+flat out int drawMaterialIndex;
+
+// the depth pre-pass and the shading pass are different programs
+// built from this shader, and the shading pass only draws where
+// its depth is equal, so both must place every vertex exactly alike
+invariant gl_Position;
+
+// must match the declarations in fragmentShader.glsl, since
+// both stages share the FrameData block
+struct DirectionalLight {
+    vec3 direction;
+    bool bActive;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+    vec3 ambient;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+    bool bActive;
+};
+
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    int pointLightCount;
+    ivec4 clusterDimensions;    // tiles x, tiles y, depth slices, tile size
+    vec4 clusterDepth;          // near, far, slice scale, slice bias
+    DirectionalLight directionalLight;
+    SpotLight spotLight;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform bool bUseInstancing = false;
+
+#ifdef SHADOW_CASTER
+// light view and projection of the shadow cascade being drawn
+uniform mat4 shadowViewProjection;
+#endif
+uniform bool bUseInstanceSettings = false;
+
+// per-draw settings of the draw-by-draw path
+uniform bool bUseTexture = false;
+uniform vec4 objectColor = vec4(1.0f);
+uniform int materialIndex = 0;
+uniform int textureIndex = 0;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+
+// must match MESH_POSITION_RANGE in MeshLibrary.cpp
+#define MESH_POSITION_RANGE 2.0
+
+// unfold an octahedral encoded normal back onto the sphere
+vec3 DecodeOctahedral(vec2 encoded)
+{
+   vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+   float fold = max(-normal.z, 0.0);
+   normal.x += (normal.x >= 0.0) ? -fold : fold;
+   normal.y += (normal.y >= 0.0) ? -fold : fold;
+   return normalize(normal);
+}
 
 void main()
 {
-   fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
-   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
-   fragmentVertexNormal = inVertexNormal;
+   vec3 position = inVertexPosition.xyz * MESH_POSITION_RANGE;
+   mat4 modelMatrix = bUseInstancing ? inInstanceModel : model;
+   fragmentPosition = vec3(modelMatrix * vec4(position, 1.0));
+#ifdef SHADOW_CASTER
+   gl_Position = shadowViewProjection * modelMatrix * vec4(position, 1.0f);
+#else
+   gl_Position = projection * view * modelMatrix * vec4(position, 1.0f);
+#endif
+   fragmentVertexNormal = DecodeOctahedral(inVertexNormal);
    fragmentTextureCoordinate = inTextureCoordinate;
+
+   if (bUseInstanceSettings)
+   {
+      drawColor = inInstanceColor;
+      drawUVScale = inInstanceUVScale;
+      drawTextureIndex = inInstanceIndices.x;
+      drawMaterialIndex = inInstanceIndices.y;
+   }
+   else
+   {
+      drawColor = objectColor;
+      drawUVScale = UVscale;
+      drawTextureIndex = bUseTexture ? textureIndex : -1;
+      drawMaterialIndex = materialIndex;
+   }
 }
\ No newline at end of file